@@ -33,17 +33,22 @@ import com.example.esp32pairingapp.alerts.showMotionNotification
 import com.example.esp32pairingapp.auth.LoginScreen
 import com.example.esp32pairingapp.network.CloudBackendPrefs
 import com.example.esp32pairingapp.network.EspHttpClient
+import com.example.esp32pairingapp.network.HubEventsClient
+import com.example.esp32pairingapp.network.HubFrame
 import com.example.esp32pairingapp.clips.HlsPlayerView
 import com.example.esp32pairingapp.clips.SavedClipsContent
 import com.example.esp32pairingapp.pairing.OtpGenerator
 import com.example.esp32pairingapp.network.PiBackendPrefs
 import com.example.esp32pairingapp.ui.theme.ESP32PairingAppTheme
+import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.currentCoroutineContext
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.first
 import kotlinx.coroutines.isActive
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
+import kotlinx.coroutines.withTimeoutOrNull
 import org.json.JSONArray
 import org.json.JSONObject
 import java.net.URLEncoder
@@ -340,6 +345,26 @@ fun StreamPage(
         }
     }
 
+    // Hub push channel: an intrusion the hub sees shows up here as soon as
+    // it is recorded, without waiting for the cloud poll above. Reconnects
+    // on its own while the phone is off the hub's network.
+    LaunchedEffect(Unit) {
+        HubEventsClient(network).subscribe().collect { frame ->
+            val event = (frame as? HubFrame.Event)?.event ?: return@collect
+            if (event.type != "intrusion") return@collect
+            val alertId = "hub-${event.hubMs}"
+            if (alertId == lastShownAlertId) return@collect
+            val newAlert = MotionAlertInfo(
+                id          = alertId,
+                deviceId    = event.detail.ifBlank { "hub" },
+                createdAtMs = System.currentTimeMillis(),
+            )
+            activeMotionAlert = newAlert
+            lastShownAlertId  = alertId
+            showMotionNotification(context, newAlert.deviceId)
+        }
+    }
+
     // Full-screen ESP setup wizard overlay
     if (showEspSetupWizard) {
         com.example.esp32pairingapp.setup.EspMainSetupScreen(
@@ -1415,8 +1440,9 @@ fun ScheduleSection(
 }
 
 /**
- * Polls /api/wifistatus every ~750ms until ESP32 returns connected=true.
- * Stops on success, timeout, or coroutine cancellation.
+ * Waits for the hub to report its home Wi-Fi up, from the state frames on
+ * its WebSocket. Hubs without /ws are polled on /api/wifistatus every
+ * ~750ms instead. Stops on success, timeout, or coroutine cancellation.
  * When connected is true, calls onConnected (e.g. to send encrypted pass) then onStatus(true, ...).
  */
 private suspend fun pollWifiStatus(
@@ -1424,6 +1450,33 @@ private suspend fun pollWifiStatus(
     onStatus: (isConnected: Boolean, status: String) -> Unit,
     onConnected: suspend () -> Unit = {}
 ) {
+    onStatus(false, "Waiting for ESP32…")
+    val pushed: Boolean? = try {
+        withTimeoutOrNull(POLL_TIMEOUT_MS) {
+            HubEventsClient().frames().first { (it as? HubFrame.State)?.state?.wifiConnected == true }
+            true
+        } ?: false
+    } catch (e: CancellationException) {
+        throw e
+    } catch (e: Exception) {
+        null   // no push channel on this hub
+    }
+    when (pushed) {
+        true -> {
+            onConnected()
+            onStatus(true, "Connected to home Wi-Fi ✅")
+            return
+        }
+        false -> {
+            onStatus(
+                false,
+                "Timeout ❌\nESP32 did not confirm home Wi-Fi within ${POLL_TIMEOUT_MS / 1000}s."
+            )
+            return
+        }
+        null -> Unit
+    }
+
     val startTime = System.currentTimeMillis()
 
     fun secondsElapsed(): Long = (System.currentTimeMillis() - startTime) / 1000
@@ -0,0 +1,112 @@
+package com.example.esp32pairingapp.network
+
+import android.net.Network
+import android.util.Log
+import kotlinx.coroutines.channels.awaitClose
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.callbackFlow
+import kotlinx.coroutines.flow.onEach
+import kotlinx.coroutines.flow.retryWhen
+import okhttp3.OkHttpClient
+import okhttp3.Request
+import okhttp3.Response
+import okhttp3.WebSocket
+import okhttp3.WebSocketListener
+import org.json.JSONObject
+import java.io.IOException
+import java.util.concurrent.TimeUnit
+
+/** Hub push channel, GET /ws on the hub's soft AP. */
+const val HUB_WS_URL = "ws://192.168.10.1/ws"
+
+private const val RECONNECT_FIRST_MS = 1_000L
+private const val RECONNECT_MAX_MS = 30_000L
+
+/** What the hub is doing, sent on connect and after every change. */
+data class HubState(
+    val armed: Boolean,
+    val wifiConnected: Boolean,
+    val modules: Int,
+    val lastIntrusionMs: Long,
+)
+
+/** One hub event: "armed", "intrusion", "module_joined", "wifi_lost", ... */
+data class HubEvent(
+    val type: String,
+    val hubMs: Long,
+    val detail: String,
+)
+
+sealed class HubFrame {
+    data class State(val state: HubState) : HubFrame()
+    data class Event(val event: HubEvent) : HubFrame()
+}
+
+/**
+ * Subscribes to the hub's WebSocket instead of polling its HTTP API.
+ * Frames are the hub's compact JSON:
+ *   {"e":"state","armed":1,"wifi":1,"modules":2,"intr":12345}
+ *   {"e":"intrusion","t":12345,"d":"192.168.10.2"}
+ */
+class HubEventsClient(network: Network? = null) {
+
+    private val client: OkHttpClient = OkHttpClient.Builder()
+        .connectTimeout(10, TimeUnit.SECONDS)
+        // Frames only come when something happens. A dead link shows up
+        // as a missing pong, the hub answers pings.
+        .readTimeout(0, TimeUnit.MILLISECONDS)
+        .pingInterval(20, TimeUnit.SECONDS)
+        .apply { network?.let { socketFactory(it.socketFactory) } }
+        .build()
+
+    /** Frames from one connection. Fails when it cannot be opened, drops or is closed. */
+    fun frames(url: String = HUB_WS_URL): Flow<HubFrame> = callbackFlow {
+        val socket = client.newWebSocket(Request.Builder().url(url).build(), object : WebSocketListener() {
+            override fun onMessage(webSocket: WebSocket, text: String) {
+                parseFrame(text)?.let { trySend(it) }
+            }
+
+            override fun onClosing(webSocket: WebSocket, code: Int, reason: String) {
+                webSocket.close(1000, null)
+                close(IOException("hub closed the WebSocket ($code)"))
+            }
+
+            override fun onFailure(webSocket: WebSocket, t: Throwable, response: Response?) {
+                close(IOException("hub WebSocket: ${t.message}", t))
+            }
+        })
+        awaitClose { socket.cancel() }
+    }
+
+    /**
+     * Frames for as long as the collector wants them, reconnecting with a
+     * backoff from 1 s up to 30 s whenever the hub is out of reach.
+     */
+    fun subscribe(url: String = HUB_WS_URL): Flow<HubFrame> {
+        var backoffMs = RECONNECT_FIRST_MS
+        return frames(url).onEach { backoffMs = RECONNECT_FIRST_MS }.retryWhen { cause, _ ->
+            Log.d("HubEventsClient", "reconnecting in ${backoffMs}ms: ${cause.message}")
+            delay(backoffMs)
+            backoffMs = (backoffMs * 2).coerceAtMost(RECONNECT_MAX_MS)
+            true
+        }
+    }
+
+    private fun parseFrame(text: String): HubFrame? {
+        val json = runCatching { JSONObject(text) }.getOrNull() ?: return null
+        val type = json.optString("e", "")
+        return when (type) {
+            "" -> null
+            "state" -> HubFrame.State(
+                HubState(
+                    armed = json.optInt("armed", 0) != 0,
+                    wifiConnected = json.optInt("wifi", 0) != 0,
+                    modules = json.optInt("modules", 0),
+                    lastIntrusionMs = json.optLong("intr", 0L),
+                )
+            )
+            else -> HubFrame.Event(HubEvent(type, json.optLong("t", 0L), json.optString("d", "")))
+        }
+    }
+}
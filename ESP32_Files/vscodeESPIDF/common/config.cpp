@@ -0,0 +1,102 @@
+#include "config.h"
+#include <Preferences.h>
+#include "dlog.h"
+#include "metrics.h"
+
+#define CONFIG_BLOB_MAX 256   // room for a newer firmware's longer blob
+
+struct configheader {
+  uint16_t version;
+  uint16_t length;
+};
+
+static configdata current;
+static configdata stored;     // what the blob in NVS holds
+static bool dirty = false;
+static uint32_t editedms = 0;
+
+const configdata& config = current;
+
+// One case per version this firmware reads.
+static bool configupgrade(const configheader& header, const uint8_t* data, size_t length){
+  switch (header.version) {
+    case 1:
+      memcpy(&current, data, min(length, sizeof(current)));
+      break;
+    default:
+      return false;
+  }
+#define CONFIG_STRING(name, size) current.name[size - 1] = '\0';
+#define CONFIG_FIELD(type, name)
+#define CONFIG_ARRAY(type, name, count)
+#include "configlist.h"
+#undef CONFIG_STRING
+#undef CONFIG_FIELD
+#undef CONFIG_ARRAY
+  return true;
+}
+
+static bool configcommit(){
+  uint8_t blob[sizeof(configheader) + sizeof(configdata)];
+  configheader header = {CONFIG_VERSION, sizeof(configdata)};
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), &current, sizeof(current));
+  Preferences prefs;
+  bool ok = prefs.begin(CONFIG_NAMESPACE, false) && prefs.putBytes(CONFIG_KEY, blob, sizeof(blob)) == sizeof(blob);
+  prefs.end();
+  if (!ok) {
+    DLOG("config: write failed\r\n");
+    return false;
+  }
+  stored = current;
+  dirty = false;
+  metricinc(M_CONFIG_WRITES);
+  return true;
+}
+
+void configload(void (*defaults)(configdata& c)){
+  memset(&current, 0, sizeof(current));
+  Preferences prefs;
+  bool found = false;
+  if (prefs.begin(CONFIG_NAMESPACE, true)) {
+    uint8_t blob[CONFIG_BLOB_MAX];
+    size_t length = prefs.getBytesLength(CONFIG_KEY);
+    found = length > 0;
+    if (length >= sizeof(configheader) && length <= sizeof(blob) &&
+        prefs.getBytes(CONFIG_KEY, blob, sizeof(blob)) == length) {
+      configheader header;
+      memcpy(&header, blob, sizeof(header));
+      if (!configupgrade(header, blob + sizeof(header), min((size_t)header.length, length - sizeof(header))))
+        DLOG("config: version %u unknown, using defaults\r\n", header.version);
+    }
+    prefs.end();
+  }
+  stored = current;
+  // Stored straight away, the next boot reads it back without LittleFS.
+  // A blob from a newer firmware is left alone until something is edited.
+  if (!found) {
+    defaults(current);
+    configcommit();
+  }
+}
+
+configdata& configedit(){
+  dirty = true;
+  editedms = millis();
+  return current;
+}
+
+void configloop(){
+  if (dirty && millis() - editedms >= CONFIG_COMMIT_MS) configflush();
+}
+
+bool configflush(){
+  if (!dirty) return true;
+  if (memcmp(&current, &stored, sizeof(current)) == 0) {
+    dirty = false;
+    return true;
+  }
+  if (configcommit()) return true;
+  editedms = millis();   // try again after another CONFIG_COMMIT_MS
+  return false;
+}
@@ -0,0 +1,52 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <Arduino.h>
+
+// Settings a board changes itself, as opposed to the flasher's provision
+// namespace. Each firmware lists its fields in its own configlist.h:
+//
+//   CONFIG_STRING(name, size)          char name[size], always terminated
+//   CONFIG_FIELD(type, name)
+//   CONFIG_ARRAY(type, name, count)
+//
+// configload() reads them once at boot and after that a read is a field
+// access. An edit only changes RAM; configloop() writes the struct
+// CONFIG_COMMIT_MS after the last edit, so a burst of them is one flash
+// write, and none when the values came back to what is stored. The whole
+// struct is one NVS blob, a write lands entirely or not at all.
+//
+// Blob: u16 version, u16 length, then the struct. Fields are only added
+// at the end; a shorter blob of the same version keeps the defaults for
+// the fields it lacks. Any other layout change bumps CONFIG_VERSION and
+// configload() converts from the old one.
+#define CONFIG_NAMESPACE "config"
+#define CONFIG_KEY "config"
+#define CONFIG_VERSION 1
+#define CONFIG_COMMIT_MS 2000
+
+#define CONFIG_STRING(name, size) char name[size];
+#define CONFIG_FIELD(type, name) type name;
+#define CONFIG_ARRAY(type, name, count) type name[count];
+struct configdata {
+#include "configlist.h"
+};
+#undef CONFIG_STRING
+#undef CONFIG_FIELD
+#undef CONFIG_ARRAY
+
+extern const configdata& config;
+
+// Before anything reads config. defaults fills in the zeroed struct on the
+// first boot without a blob, each firmware passes its configdefaults().
+void configload(void (*defaults)(configdata& c));
+// For changing config, from the loop task.
+configdata& configedit(void);
+void configloop(void);
+// Writes an edit now rather than after CONFIG_COMMIT_MS.
+bool configflush(void);
+
+// Each firmware's, from wherever earlier firmware kept these settings.
+void configdefaults(configdata& c);
+
+#endif
@@ -0,0 +1,257 @@
+#include "dlog.h"
+#include <WiFiUdp.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// One ring per core. Only tasks on that core write to it, and they keep
+// each other out by masking interrupts on their own core for the few
+// cycles a record takes, so the cores never wait on one another. The drain
+// task is the only reader.
+struct dlogring {
+  uint8_t data[DLOG_RING_SIZE];
+  std::atomic<uint32_t> head;      // bytes ever written
+  std::atomic<uint32_t> tail;      // bytes ever read
+  std::atomic<uint32_t> dropped;
+  uint32_t reported;               // drops already announced
+};
+
+// A record in the ring: length byte, format, time, arguments. Frames
+// carry 32-bit addresses, the ring holds whole pointers so host builds
+// (text only) work too.
+#define DLOG_TIME_AT (1 + sizeof(const char*))
+#define DLOG_RECORD_HEADER (DLOG_TIME_AT + 4)
+#define DLOG_UDP_PAYLOAD 1024
+
+static dlogring rings[portNUM_PROCESSORS];
+static dlogsink sink = DLOG_SERIAL_TEXT;
+static WiFiUDP udp;
+static String udphost;
+static uint16_t udpport = 0;
+static uint8_t datagram[DLOG_UDP_PAYLOAD];
+static size_t datagramlen = 0;
+
+void dlogpush(const char* fmt, const dlogargs* args){
+  uint32_t now = micros();
+  uint32_t size = DLOG_RECORD_HEADER + args->len;
+  UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+  dlogring* ring = &rings[xPortGetCoreID()];
+  uint32_t head = ring->head.load(std::memory_order_relaxed);
+  if (size > DLOG_RING_SIZE - (head - ring->tail.load(std::memory_order_acquire))) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    uint8_t header[DLOG_RECORD_HEADER];
+    header[0] = (uint8_t)args->len;
+    memcpy(header + 1, &fmt, sizeof(fmt));
+    memcpy(header + DLOG_TIME_AT, &now, 4);
+    for (uint32_t i = 0; i < DLOG_RECORD_HEADER; i++) ring->data[(head + i) & (DLOG_RING_SIZE - 1)] = header[i];
+    head += DLOG_RECORD_HEADER;
+    for (uint32_t i = 0; i < args->len; i++) ring->data[(head + i) & (DLOG_RING_SIZE - 1)] = args->data[i];
+    ring->head.store(head + args->len, std::memory_order_release);
+  }
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+uint32_t dlogdropped(){
+  uint32_t total = 0;
+  for (int i = 0; i < portNUM_PROCESSORS; i++) total += rings[i].dropped.load(std::memory_order_relaxed);
+  return total;
+}
+
+void dlogudp(const char* host, uint16_t port){
+  udphost = host;
+  udpport = port;
+}
+
+static uint8_t crc8(const uint8_t* data, size_t len){
+  uint8_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+static uint32_t get32(const uint8_t* in){
+  uint32_t value;
+  memcpy(&value, in, 4);
+  return value;
+}
+
+// printf of one record. Each conversion takes the next argument, whatever
+// length modifier the format has: the tag says what was stored.
+static size_t dlogformat(const char* fmt, const uint8_t* args, size_t len, char* out, size_t size){
+  size_t used = 0;
+  size_t at = 0;
+  auto put = [&](const char* text, size_t n) {
+    if (used + n >= size) n = size - 1 - used;
+    memcpy(out + used, text, n);
+    used += n;
+  };
+  while (*fmt && used + 1 < size) {
+    if (*fmt != '%') {
+      const char* next = strchr(fmt, '%');
+      size_t n = next ? (size_t)(next - fmt) : strlen(fmt);
+      put(fmt, n);
+      fmt += n;
+      continue;
+    }
+    if (fmt[1] == '%') {
+      put("%", 1);
+      fmt += 2;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion, without the length.
+    char spec[24];
+    size_t speclen = 0;
+    spec[speclen++] = *fmt++;
+    while (*fmt && strchr("-+ #0123456789.", *fmt) && speclen < sizeof(spec) - 4) spec[speclen++] = *fmt++;
+    while (*fmt && strchr("hljztL", *fmt)) fmt++;
+    char conversion = *fmt ? *fmt++ : 's';
+    char tag = at < len ? (char)args[at] : 0;
+    char piece[64];
+    int n = 0;
+    if (tag == 's') {
+      uint8_t slen = args[at + 1];
+      char text[DLOG_MAX_STRING + 1];
+      memcpy(text, args + at + 2, slen);
+      text[slen] = 0;
+      at += 2 + slen;
+      spec[speclen++] = 's';
+      spec[speclen] = 0;
+      n = snprintf(piece, sizeof(piece), spec, text);
+    } else if (tag == 'd') {
+      double value;
+      memcpy(&value, args + at + 1, 8);
+      at += 9;
+      spec[speclen++] = strchr("fFeEgGaA", conversion) ? conversion : 'g';
+      spec[speclen] = 0;
+      n = snprintf(piece, sizeof(piece), spec, value);
+    } else if (tag == 'i' || tag == 'I') {
+      long long value;
+      if (tag == 'i') {
+        uint32_t raw = get32(args + at + 1);
+        value = strchr("di", conversion) ? (long long)(int32_t)raw : (long long)raw;
+        at += 5;
+      } else {
+        memcpy(&value, args + at + 1, 8);
+        at += 9;
+      }
+      if (conversion == 'c') {
+        spec[speclen++] = 'c';
+        spec[speclen] = 0;
+        n = snprintf(piece, sizeof(piece), spec, (int)value);
+      } else {
+        spec[speclen++] = 'l';
+        spec[speclen++] = 'l';
+        spec[speclen++] = strchr("diouxX", conversion) ? conversion : 'x';
+        spec[speclen] = 0;
+        n = snprintf(piece, sizeof(piece), spec, value);
+      }
+    } else {
+      n = snprintf(piece, sizeof(piece), "<?>");
+    }
+    if (n > 0) put(piece, (size_t)n < sizeof(piece) ? (size_t)n : sizeof(piece) - 1);
+  }
+  out[used] = 0;
+  return used;
+}
+
+static void dlogsend(const uint8_t* frame, size_t len){
+  if (sink == DLOG_SERIAL_BINARY) {
+    Serial.write(frame, len);
+    return;
+  }
+  if (udpport == 0) return;
+  if (datagramlen + len > sizeof(datagram)) {
+    udp.beginPacket(udphost.c_str(), udpport);
+    udp.write(datagram, datagramlen);
+    udp.endPacket();
+    datagramlen = 0;
+  }
+  memcpy(datagram + datagramlen, frame, len);
+  datagramlen += len;
+}
+
+static void dlogemit(const char* fmt, uint32_t time, uint8_t core, const uint8_t* args, size_t len){
+  if (sink == DLOG_SERIAL_TEXT) {
+    char text[256];
+    if (!fmt) {
+      snprintf(text, sizeof(text), "dlog: %u records dropped\n", (unsigned)get32(args + 1));
+      Serial.print(text);
+      return;
+    }
+    size_t n = dlogformat(fmt, args, len, text, sizeof(text));
+    Serial.write((const uint8_t*)text, n);
+    return;
+  }
+  uint8_t frame[12 + DLOG_MAX_ARGS];
+  uint32_t address = (uint32_t)(uintptr_t)fmt;
+  frame[0] = DLOG_FRAME_START;
+  frame[1] = (uint8_t)(9 + len);
+  memcpy(frame + 2, &address, 4);
+  memcpy(frame + 6, &time, 4);
+  frame[10] = core;
+  memcpy(frame + 11, args, len);
+  frame[11 + len] = crc8(frame + 1, 10 + len);
+  dlogsend(frame, 12 + len);
+}
+
+// The oldest record of each core goes first, so both come out in order.
+static void dlogtask(void*){
+  for (;;) {
+    bool any = false;
+    for (;;) {
+      int pick = -1;
+      uint32_t picktime = 0;
+      for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        dlogring* ring = &rings[i];
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail == ring->head.load(std::memory_order_acquire)) continue;
+        uint32_t time = 0;
+        for (int b = 0; b < 4; b++) time |= (uint32_t)ring->data[(tail + DLOG_TIME_AT + b) & (DLOG_RING_SIZE - 1)] << (8 * b);
+        if (pick < 0 || (int32_t)(time - picktime) < 0) {
+          pick = i;
+          picktime = time;
+        }
+      }
+      if (pick < 0) break;
+      dlogring* ring = &rings[pick];
+      uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint8_t record[DLOG_RECORD_HEADER + DLOG_MAX_ARGS];
+      uint8_t len = ring->data[tail & (DLOG_RING_SIZE - 1)];
+      for (uint32_t i = 0; i < DLOG_RECORD_HEADER + len; i++) record[i] = ring->data[(tail + i) & (DLOG_RING_SIZE - 1)];
+      ring->tail.store(tail + DLOG_RECORD_HEADER + len, std::memory_order_release);
+      const char* fmt;
+      memcpy(&fmt, record + 1, sizeof(fmt));
+      dlogemit(fmt, get32(record + DLOG_TIME_AT), (uint8_t)pick, record + DLOG_RECORD_HEADER, len);
+      any = true;
+    }
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+      uint32_t dropped = rings[i].dropped.load(std::memory_order_relaxed);
+      if (dropped == rings[i].reported) continue;
+      uint8_t args[5] = {'i'};
+      uint32_t count = dropped - rings[i].reported;
+      memcpy(args + 1, &count, 4);
+      dlogemit(nullptr, micros(), (uint8_t)i, args, sizeof(args));
+      rings[i].reported = dropped;
+    }
+    if (sink == DLOG_UDP_BINARY && datagramlen > 0 && udpport != 0) {
+      udp.beginPacket(udphost.c_str(), udpport);
+      udp.write(datagram, datagramlen);
+      udp.endPacket();
+      datagramlen = 0;
+    }
+    if (!any) vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void dlogbegin(dlogsink to){
+  static bool started = false;
+  sink = to;
+  if (started) return;
+  started = true;
+  // Lowest priority above idle, on core 0 away from the Arduino loop task;
+  // WiFi and lwIP there outrank it too, logging gets the time they leave.
+  xTaskCreatePinnedToCore(dlogtask, "dlog", 4096, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+}
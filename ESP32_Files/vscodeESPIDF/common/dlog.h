@@ -0,0 +1,110 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// Deferred logging. DLOG("fmt", args...) stores the format string's address
+// and the raw arguments in the calling core's ring and returns; a low
+// priority task writes them out later, so a log line on a hot path no
+// longer waits for the UART. The format string must be a literal, it is
+// read back from flash (or, for DLOG_SERIAL_BINARY and DLOG_UDP_BINARY,
+// from the firmware's ELF by firmwareflasher's monitor). Not for ISRs.
+//
+// The text comes out exactly as the printf would have printed it, newlines
+// are the caller's. Strings are copied, up to DLOG_MAX_STRING bytes. Widths
+// and precisions have to be written out in the format, * is not supported.
+#define DLOG(fmt, ...) dlogwrite(fmt, ##__VA_ARGS__)
+
+#define DLOG_RING_SIZE 4096        // bytes per core, a power of two
+#define DLOG_MAX_ARGS 64           // bytes of arguments one record holds
+#define DLOG_MAX_STRING 32
+
+// Binary frames, little endian, keep in step with firmwareflasher's
+// logdecoder.cpp:
+//   0x1e, length of what follows up to the crc,
+//   u32 format string address (0: a drop notice, one 'i' argument),
+//   u32 micros(), u8 core,
+//   arguments, each a tag and its value:
+//     'i' 4 byte integer, 'I' 8 byte integer, 'd' 8 byte double,
+//     's' u8 length and the bytes
+//   u8 CRC-8 (polynomial 0x07) of the length byte through the arguments.
+#define DLOG_FRAME_START 0x1e
+
+enum dlogsink {
+  DLOG_SERIAL_TEXT,     // formatted by the drain task
+  DLOG_SERIAL_BINARY,   // frames on Serial among the plain text
+  DLOG_UDP_BINARY       // frames to dlogudp()'s address, up to a datagram at a time
+};
+
+#ifndef DLOG_SINK
+#define DLOG_SINK DLOG_SERIAL_BINARY
+#endif
+
+// Starts the drain task. Records logged before that wait in the ring.
+void dlogbegin(dlogsink sink);
+void dlogudp(const char* host, uint16_t port);
+// Records that did not fit in a ring since boot.
+uint32_t dlogdropped(void);
+
+struct dlogargs {
+  uint8_t data[DLOG_MAX_ARGS];
+  uint8_t len;
+};
+
+void dlogpush(const char* fmt, const dlogargs* args);
+
+inline void dlogbytes(dlogargs* args, char tag, const void* value, uint8_t size){
+  if (args->len + 1 + size > DLOG_MAX_ARGS) return;
+  args->data[args->len++] = tag;
+  memcpy(args->data + args->len, value, size);
+  args->len += size;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+dlogput(dlogargs* args, T value){
+  if (sizeof(T) <= 4) {
+    uint32_t v = std::is_signed<T>::value ? (uint32_t)(int32_t)value : (uint32_t)value;
+    dlogbytes(args, 'i', &v, 4);
+  } else {
+    uint64_t v = (uint64_t)value;
+    dlogbytes(args, 'I', &v, 8);
+  }
+}
+
+inline void dlogput(dlogargs* args, double value){
+  dlogbytes(args, 'd', &value, 8);
+}
+
+inline void dlogput(dlogargs* args, const char* value){
+  if (!value) value = "(null)";
+  if (args->len + 2 > DLOG_MAX_ARGS) return;
+  size_t room = DLOG_MAX_ARGS - args->len - 2;
+  size_t len = strnlen(value, room < DLOG_MAX_STRING ? room : DLOG_MAX_STRING);
+  args->data[args->len++] = 's';
+  args->data[args->len++] = (uint8_t)len;
+  memcpy(args->data + args->len, value, len);
+  args->len += len;
+}
+
+inline void dlogput(dlogargs* args, const String& value){
+  dlogput(args, value.c_str());
+}
+
+inline void dlogput(dlogargs* args, const void* value){
+  dlogput(args, (uintptr_t)value);
+}
+
+template <typename... Args>
+void dlogwrite(const char* fmt, const Args&... values){
+  dlogargs args;
+  args.len = 0;
+  int unused[] = {0, (dlogput(&args, values), 0)...};
+  (void)unused;
+  dlogpush(fmt, &args);
+}
+
+#endif
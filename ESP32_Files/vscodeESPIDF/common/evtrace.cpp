@@ -0,0 +1,171 @@
+#include "evtrace.h"
+#include "esp_timer.h"
+
+#define EVTRACE_ISR 0xff           // thread of an interrupt handler's event
+
+struct evtraceevent {
+  uint32_t us;                     // low bits of esp_timer, 71 minutes
+  const char* name;
+  uint32_t id;
+  char phase;
+  uint8_t thread;                  // into tasknames, or EVTRACE_ISR
+};
+
+// Written only from its own core with that core's interrupts masked, like
+// dlog's rings.
+struct evtracering {
+  evtraceevent events[EVTRACE_EVENTS];
+  std::atomic<uint32_t> head;      // events ever written
+  std::atomic<uint32_t> start;     // first one since evtraceclear()
+};
+
+static_assert((EVTRACE_EVENTS & (EVTRACE_EVENTS - 1)) == 0, "EVTRACE_EVENTS must be a power of two");
+
+static evtracering rings[portNUM_PROCESSORS];
+static std::atomic<bool> paused(false);
+static const char* isrnames[] = {"isr0", "isr1"};
+
+// Names of the tasks that recorded events. Only ever appended to, under
+// the lock; the ones below tasknamecount do not change and are read without
+// it.
+static char tasknames[EVTRACE_MAX_THREADS][EVTRACE_TASK_NAME];
+static std::atomic<uint8_t> tasknamecount(0);
+static portMUX_TYPE tasklock = portMUX_INITIALIZER_UNLOCKED;
+
+static int evtracefind(const char* name, uint8_t from, uint8_t to){
+  for (uint8_t i = from; i < to; i++) {
+    if (strncmp(tasknames[i], name, EVTRACE_TASK_NAME - 1) == 0) return i;
+  }
+  return -1;
+}
+
+// The calling task's entry, added on its first event.
+static uint8_t evtracetask(){
+  const char* name = pcTaskGetName(nullptr);
+  uint8_t count = tasknamecount.load(std::memory_order_acquire);
+  int found = evtracefind(name, 0, count);
+  if (found >= 0) return found;
+
+  portENTER_CRITICAL(&tasklock);
+  uint8_t now = tasknamecount.load(std::memory_order_relaxed);
+  found = evtracefind(name, count, now);
+  if (found < 0) {
+    found = now < EVTRACE_MAX_THREADS ? now : EVTRACE_MAX_THREADS - 1;
+    if (now < EVTRACE_MAX_THREADS) {
+      strlcpy(tasknames[now], now == EVTRACE_MAX_THREADS - 1 ? "other" : name, EVTRACE_TASK_NAME);
+      tasknamecount.store(now + 1, std::memory_order_release);
+    }
+  }
+  portEXIT_CRITICAL(&tasklock);
+  return found;
+}
+
+void IRAM_ATTR evtrace(char phase, const char* name, uint32_t id){
+  if (paused.load(std::memory_order_relaxed)) return;
+  bool isr = xPortInIsrContext();
+  uint8_t thread = isr ? EVTRACE_ISR : evtracetask();
+  UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+  evtracering* ring = &rings[xPortGetCoreID()];
+  uint32_t head = ring->head.load(std::memory_order_relaxed);
+  evtraceevent* e = &ring->events[head & (EVTRACE_EVENTS - 1)];
+  e->us = (uint32_t)esp_timer_get_time();
+  e->name = name;
+  e->id = id;
+  e->phase = phase;
+  e->thread = thread;
+  ring->head.store(head + 1, std::memory_order_release);
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+void evtraceclear(){
+  for (int i = 0; i < portNUM_PROCESSORS; i++) {
+    rings[i].start.store(rings[i].head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+}
+
+evtracesnapshot::evtracesnapshot(){
+  paused.store(true);
+  now = esp_timer_get_time();
+  events = 0;
+  for (int c = 0; c < portNUM_PROCESSORS; c++) {
+    // A writer that got past the pause check before it was set may still
+    // be filling slot head, the oldest one once the ring has wrapped.
+    uint32_t head = rings[c].head.load(std::memory_order_acquire);
+    uint32_t oldest = head > EVTRACE_EVENTS - 1 ? head - (EVTRACE_EVENTS - 1) : 0;
+    uint32_t start = rings[c].start.load(std::memory_order_relaxed);
+    first[c] = (int32_t)(start - oldest) > 0 ? start : oldest;
+    end[c] = head;
+    events += end[c] - first[c];
+  }
+  // After the heads: every event in the snapshot has its task's name.
+  taskcount = tasknamecount.load(std::memory_order_acquire);
+  threadcount = taskcount;
+  for (int c = 0; c < portNUM_PROCESSORS; c++) {
+    isrthread[c] = EVTRACE_ISR;
+    for (uint32_t i = first[c]; i != end[c]; i++) {
+      if (rings[c].events[i & (EVTRACE_EVENTS - 1)].thread == EVTRACE_ISR) {
+        isrthread[c] = threadcount++;
+        break;
+      }
+    }
+  }
+}
+
+evtracesnapshot::~evtracesnapshot(){
+  paused.store(false);
+}
+
+static size_t evtracename(Print& out, const char* name){
+  size_t len = strlen(name);
+  if (len > 255) len = 255;
+  uint8_t n = (uint8_t)len;
+  return out.write(&n, 1) + out.write((const uint8_t*)name, len);
+}
+
+size_t evtracesnapshot::printTo(Print& out) const {
+  uint8_t header[12] = {0};
+  memcpy(header, EVTRACE_MAGIC, 4);
+  header[4] = EVTRACE_VERSION;
+  header[5] = (uint8_t)threadcount;
+  memcpy(header + 8, &events, 4);
+  size_t n = out.write(header, sizeof(header));
+  for (int t = 0; t < taskcount; t++) n += evtracename(out, tasknames[t]);
+  for (int c = 0; c < portNUM_PROCESSORS; c++) {
+    if (isrthread[c] != EVTRACE_ISR) n += evtracename(out, isrnames[c & 1]);
+  }
+
+  // Oldest first across the cores, each ring is in order already.
+  uint32_t at[portNUM_PROCESSORS];
+  memcpy(at, first, sizeof(at));
+  for (;;) {
+    int pick = -1;
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+      if (at[c] == end[c]) continue;
+      uint32_t us = rings[c].events[at[c] & (EVTRACE_EVENTS - 1)].us;
+      if (pick < 0 || (int32_t)(us - rings[pick].events[at[pick] & (EVTRACE_EVENTS - 1)].us) < 0) pick = c;
+    }
+    if (pick < 0) break;
+    const evtraceevent& e = rings[pick].events[at[pick]++ & (EVTRACE_EVENTS - 1)];
+    uint64_t us = (uint64_t)now - (uint32_t)((uint32_t)now - e.us);
+    uint8_t record[14];
+    memcpy(record, &us, 8);
+    memcpy(record + 8, &e.id, 4);
+    record[12] = (uint8_t)e.phase;
+    record[13] = e.thread == EVTRACE_ISR ? isrthread[pick] : e.thread;
+    n += out.write(record, sizeof(record));
+    n += evtracename(out, e.name);
+  }
+  return n;
+}
+
+// Counts what printTo writes, for Content-Length.
+class evtracelength : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+};
+
+size_t evtracesnapshot::length() const {
+  evtracelength counter;
+  return printTo(counter);
+}
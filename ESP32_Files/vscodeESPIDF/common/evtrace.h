@@ -0,0 +1,93 @@
+#ifndef EVTRACE_H
+#define EVTRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Event tracing: where the time of an alarm went, one slice per step.
+// Each event is esp_timer time, a phase, a name and for flows an id, put
+// in the ring of the core it happened on; the ring keeps the latest
+// EVTRACE_EVENTS and overwrites the oldest. Names must be string literals,
+// only the pointer is stored. Safe from tasks and ISRs (in IRAM).
+//
+// GET /api/evtrace downloads the rings, hosthal's evtracejson turns one
+// or more downloads into Chrome/Perfetto JSON. A flow id travels in the
+// alert packet ("INTRUDER INTRUDER t=<hex>"), so the sensor's and the
+// hub's slices for one alarm are joined by arrows.
+//
+// EVTRACE_EVENTS is per core and a power of two. An event is 16 bytes, so
+// the default keeps 8 KB of DRAM for both cores' rings, enough for a few
+// alarms. A firmware that wants a longer window sets it in its project
+// CMakeLists.
+#ifndef EVTRACE_EVENTS
+#define EVTRACE_EVENTS 256
+#endif
+
+// Chrome trace event phases.
+#define EVTRACE_BEGIN 'B'
+#define EVTRACE_END 'E'
+#define EVTRACE_INSTANT 'i'
+#define EVTRACE_FLOW_START 's'     // binds to the enclosing slice
+#define EVTRACE_FLOW_STEP 't'
+#define EVTRACE_FLOW_END 'f'
+
+// Download, little endian:
+//   "SHEV", u8 version, u8 thread count, u16 0, u32 event count,
+//   per thread: u8 name length, name,
+//   per event, oldest first: u64 esp_timer us, u32 flow id, u8 phase,
+//     u8 thread, u8 name length, name.
+// Threads are tasks by name, and "isr<core>" for interrupt handlers. A
+// task's name is copied the first time it records an event, so it still
+// has one after the task is deleted.
+#define EVTRACE_MAGIC "SHEV"
+#define EVTRACE_VERSION 1
+#define EVTRACE_MAX_THREADS 16     // task names, the last one is "other"
+#define EVTRACE_TASK_NAME 16       // configMAX_TASK_NAME_LEN
+#define EVTRACE_CONTENT_TYPE "application/octet-stream"
+
+void evtrace(char phase, const char* name, uint32_t id);
+
+inline void evtracebegin(const char* name){ evtrace(EVTRACE_BEGIN, name, 0); }
+inline void evtraceend(const char* name){ evtrace(EVTRACE_END, name, 0); }
+inline void evtraceinstant(const char* name){ evtrace(EVTRACE_INSTANT, name, 0); }
+// A flow runs from the slice its start is in, through the slices of its
+// steps, to the slice its end is in; 0 is no flow.
+inline void evtraceflow(char phase, const char* name, uint32_t id){
+  if (id) evtrace(phase, name, id);
+}
+void evtraceclear(void);
+
+// A slice for the rest of the enclosing block.
+struct evtracescope {
+  explicit evtracescope(const char* name) : name(name) { evtracebegin(name); }
+  ~evtracescope() { evtraceend(name); }
+  const char* name;
+};
+#define EVTRACE_CONCAT2(a, b) a##b
+#define EVTRACE_CONCAT(a, b) EVTRACE_CONCAT2(a, b)
+#define EVTRACE_SCOPE(name) evtracescope EVTRACE_CONCAT(evtracescope_, __LINE__)(name)
+
+// The rings at one instant, ready to send. Recording pauses while one
+// exists, so the length and the bytes agree; events in that time are lost.
+class evtracesnapshot : public Printable {
+public:
+  evtracesnapshot();
+  ~evtracesnapshot();
+  size_t printTo(Print& out) const override;
+  size_t length() const;
+
+private:
+  int64_t now;
+  uint32_t first[portNUM_PROCESSORS];
+  uint32_t end[portNUM_PROCESSORS];
+  uint32_t events;
+  uint8_t taskcount;
+  // Each core's interrupt handlers come after the tasks when they
+  // recorded anything, 0xff when not.
+  uint8_t isrthread[portNUM_PROCESSORS];
+  uint8_t threadcount;
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include "journal.h"
+#include "dlog.h"
+#include "esp_timer.h"
+
+#define JOURNAL_MAGIC 0x314a4853         // "SHJ1"
+#define JOURNAL_CRC_AT 28
+#define JOURNAL_EMPTY 0xffffffffu        // firstseq of a sector without records
+
+struct journalsector {
+  bool used;                       // in the run from oldest to head
+  uint32_t number;                 // one more for each new head
+  uint32_t firstseq;
+  uint64_t firsttime;
+};
+
+static const esp_partition_t* partition = nullptr;
+static int sectors = 0;
+static journalsector sectorindex[JOURNAL_MAX_SECTORS];
+static int oldest = 0;
+static int head = 0;
+static int headslot = 1;           // next slot to program in the head sector
+static uint32_t nextseq = 0;
+static uint16_t boot = 0;
+static uint32_t corrupt = 0;
+
+enum slotstate { SLOT_ERASED, SLOT_RECORD, SLOT_CORRUPT };
+
+static uint32_t crc32(const uint8_t* data, size_t len){
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+  }
+  return ~crc;
+}
+
+static void put(uint8_t* out, uint64_t value, int size){
+  for (int i = 0; i < size; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t get(const uint8_t* in, int size){
+  uint64_t value = 0;
+  for (int i = size - 1; i >= 0; i--) value = value << 8 | in[i];
+  return value;
+}
+
+static size_t slotoffset(int sector, int slot){
+  return (size_t)sector * JOURNAL_SECTOR + (size_t)slot * JOURNAL_SLOT;
+}
+
+static bool erased(const uint8_t* slot){
+  for (int i = 0; i < JOURNAL_SLOT; i++) {
+    if (slot[i] != 0xff) return false;
+  }
+  return true;
+}
+
+static slotstate readslot(int sector, int slot, journalrecord* r){
+  uint8_t raw[JOURNAL_SLOT];
+  if (esp_partition_read(partition, slotoffset(sector, slot), raw, sizeof(raw)) != ESP_OK) return SLOT_CORRUPT;
+  if (erased(raw)) return SLOT_ERASED;
+  if (get(raw + JOURNAL_CRC_AT, 4) != crc32(raw, JOURNAL_CRC_AT)) {
+    corrupt++;
+    return SLOT_CORRUPT;
+  }
+  r->seq = (uint32_t)get(raw, 4);
+  r->ms = get(raw + 4, 6);
+  r->boot = (uint16_t)get(raw + 10, 2);
+  r->type = raw[12];
+  memcpy(r->detail, raw + 13, JOURNAL_DETAIL_LEN);
+  r->detail[JOURNAL_DETAIL_LEN] = 0;
+  return SLOT_RECORD;
+}
+
+static bool readheader(int sector, uint32_t* number){
+  uint8_t raw[JOURNAL_SLOT];
+  if (esp_partition_read(partition, slotoffset(sector, 0), raw, sizeof(raw)) != ESP_OK) return false;
+  if (get(raw, 4) != JOURNAL_MAGIC || get(raw + JOURNAL_CRC_AT, 4) != crc32(raw, JOURNAL_CRC_AT)) return false;
+  *number = (uint32_t)get(raw + 4, 4);
+  return true;
+}
+
+// Erases sector and makes it the head.
+static bool startsector(int sector, uint32_t number){
+  sectorindex[sector].used = false;
+  if (esp_partition_erase_range(partition, slotoffset(sector, 0), JOURNAL_SECTOR) != ESP_OK) return false;
+  uint8_t raw[JOURNAL_SLOT];
+  memset(raw, 0xff, sizeof(raw));
+  put(raw, JOURNAL_MAGIC, 4);
+  put(raw + 4, number, 4);
+  put(raw + JOURNAL_CRC_AT, crc32(raw, JOURNAL_CRC_AT), 4);
+  if (esp_partition_write(partition, slotoffset(sector, 0), raw, sizeof(raw)) != ESP_OK) return false;
+  sectorindex[sector] = {true, number, JOURNAL_EMPTY, 0};
+  head = sector;
+  headslot = 1;
+  return true;
+}
+
+// The first record of a sector, for the index.
+static void indexsector(int sector){
+  sectorindex[sector].firstseq = JOURNAL_EMPTY;
+  for (int slot = 1; slot <= JOURNAL_RECORDS_PER_SECTOR; slot++) {
+    journalrecord r;
+    slotstate state = readslot(sector, slot, &r);
+    if (state == SLOT_ERASED) return;
+    if (state == SLOT_RECORD) {
+      sectorindex[sector].firstseq = r.seq;
+      sectorindex[sector].firsttime = journaltime(r.boot, r.ms);
+      return;
+    }
+  }
+}
+
+// Sectors from the oldest to the head.
+static int sectorcount(){
+  return (head - oldest + sectors) % sectors + 1;
+}
+
+static int sectorat(int i){
+  return (oldest + i) % sectors;
+}
+
+// The last slot written in sector, JOURNAL_RECORDS_PER_SECTOR unless it is
+// the head.
+static int lastslot(int sector){
+  return sector == head ? headslot - 1 : JOURNAL_RECORDS_PER_SECTOR;
+}
+
+bool journalbegin(){
+  int64_t start = esp_timer_get_time();
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)JOURNAL_SUBTYPE, JOURNAL_LABEL);
+  if (!partition) {
+    DLOG("journal: no \"%s\" partition\n", JOURNAL_LABEL);
+    return false;
+  }
+  sectors = (int)(partition->size / JOURNAL_SECTOR);
+  if (sectors > JOURNAL_MAX_SECTORS) sectors = JOURNAL_MAX_SECTORS;
+  if (sectors < 2) {
+    partition = nullptr;
+    return false;
+  }
+
+  // The head has the highest number, the sectors before it count down
+  // from there; anything else is left over from a cut erase.
+  bool any = false;
+  for (int s = 0; s < sectors; s++) {
+    sectorindex[s].used = readheader(s, &sectorindex[s].number);
+    if (sectorindex[s].used && (!any || (int32_t)(sectorindex[s].number - sectorindex[head].number) > 0)) {
+      head = s;
+      any = true;
+    }
+  }
+  if (!any) {
+    oldest = 0;
+    nextseq = 0;
+    boot = 0;
+    if (!startsector(0, 0)) partition = nullptr;
+    DLOG("journal: new, %d sectors\n", sectors);
+    return partition != nullptr;
+  }
+  oldest = head;
+  for (int i = 1; i < sectors; i++) {
+    int s = (head - i + sectors) % sectors;
+    if (!sectorindex[s].used || sectorindex[s].number != sectorindex[head].number - i) break;
+    oldest = s;
+  }
+  for (int s = 0; s < sectors; s++) {
+    bool inrun = (s - oldest + sectors) % sectors < sectorcount();
+    sectorindex[s].used = sectorindex[s].used && inrun;
+    if (sectorindex[s].used) indexsector(s);
+  }
+
+  // Slots are programmed in order, so the erased ones are the tail.
+  int lo = 1, hi = JOURNAL_RECORDS_PER_SECTOR + 1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    uint8_t raw[JOURNAL_SLOT];
+    bool blank = esp_partition_read(partition, slotoffset(head, mid), raw, sizeof(raw)) == ESP_OK && erased(raw);
+    if (blank) hi = mid;
+    else lo = mid + 1;
+  }
+  headslot = lo;
+
+  // Numbering goes on from the newest record that reads back.
+  nextseq = 0;
+  boot = 0;
+  bool found = false;
+  for (int i = sectorcount() - 1; i >= 0 && !found; i--) {
+    int s = sectorat(i);
+    for (int slot = lastslot(s); slot >= 1 && !found; slot--) {
+      journalrecord r;
+      if (readslot(s, slot, &r) != SLOT_RECORD) continue;
+      nextseq = r.seq + 1;
+      boot = r.boot + 1;
+      found = true;
+    }
+  }
+  DLOG("journal: %u records in %d of %d sectors, boot %u, recovered in %u us\n", (unsigned)(nextseq - journaloldest()),
+       sectorcount(), sectors, (unsigned)boot, (unsigned)(esp_timer_get_time() - start));
+  return true;
+}
+
+bool journalappend(uint8_t type, const char* detail){
+  if (!partition) return false;
+  if (headslot > JOURNAL_RECORDS_PER_SECTOR) {
+    int next = (head + 1) % sectors;
+    if (next == oldest) oldest = (oldest + 1) % sectors;
+    if (!startsector(next, sectorindex[head].number + 1)) {
+      DLOG("journal: cannot start sector %d\n", next);
+      return false;
+    }
+  }
+  journalrecord r;
+  r.seq = nextseq;
+  r.ms = (uint64_t)esp_timer_get_time() / 1000;
+  r.boot = boot;
+  r.type = type;
+
+  uint8_t raw[JOURNAL_SLOT];
+  put(raw, r.seq, 4);
+  put(raw + 4, r.ms, 6);
+  put(raw + 10, r.boot, 2);
+  raw[12] = type;
+  if (!detail) detail = "";
+  memset(raw + 13, 0, JOURNAL_DETAIL_LEN);
+  memcpy(raw + 13, detail, strnlen(detail, JOURNAL_DETAIL_LEN));
+  put(raw + JOURNAL_CRC_AT, crc32(raw, JOURNAL_CRC_AT), 4);
+  // A failed write may have programmed part of the slot, it is not reused.
+  bool ok = esp_partition_write(partition, slotoffset(head, headslot), raw, sizeof(raw)) == ESP_OK;
+  headslot++;
+  if (!ok) return false;
+  if (sectorindex[head].firstseq == JOURNAL_EMPTY) {
+    sectorindex[head].firstseq = r.seq;
+    sectorindex[head].firsttime = journaltime(r.boot, r.ms);
+  }
+  nextseq++;
+  return true;
+}
+
+uint32_t journaloldest(){
+  if (!partition) return nextseq;
+  for (int i = 0; i < sectorcount(); i++) {
+    if (sectorindex[sectorat(i)].firstseq != JOURNAL_EMPTY) return sectorindex[sectorat(i)].firstseq;
+  }
+  return nextseq;
+}
+
+uint32_t journalnext(){
+  return nextseq;
+}
+
+uint16_t journalboot(){
+  return boot;
+}
+
+uint32_t journalcorrupt(){
+  return corrupt;
+}
+
+// The last sector, in order from the oldest, whose first record passes
+// test, -1 when none does. The index is sorted by seq and by time alike.
+template <typename Test>
+static int findsector(Test test){
+  int lo = 0, hi = sectorcount();
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    const journalsector& s = sectorindex[sectorat(mid)];
+    if (s.firstseq != JOURNAL_EMPTY && test(s)) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo - 1;
+}
+
+uint32_t journalseqafter(uint64_t time){
+  if (!partition) return nextseq;
+  int i = findsector([time](const journalsector& s) { return s.firsttime <= time; });
+  if (i < 0) return journaloldest();
+  int sector = sectorat(i);
+  uint32_t after = sectorindex[sector].firstseq + 1;
+  for (int slot = 1; slot <= lastslot(sector); slot++) {
+    journalrecord r;
+    slotstate state = readslot(sector, slot, &r);
+    if (state == SLOT_ERASED) break;
+    if (state != SLOT_RECORD) continue;
+    if (journaltime(r.boot, r.ms) > time) break;
+    after = r.seq + 1;
+  }
+  return after;
+}
+
+journalpage::journalpage(uint32_t before, int limit, const char* (*names)(uint8_t type)) : names(names){
+  count = 0;
+  more = false;
+  oldest = journaloldest();
+  next = journalnext();
+  boot = journalboot();
+  if (limit > JOURNAL_PAGE_MAX) limit = JOURNAL_PAGE_MAX;
+  if (before == 0 || before > next) before = next;
+  if (!partition || limit <= 0 || before <= oldest) return;
+  int i = findsector([before](const journalsector& s) { return s.firstseq < before; });
+  for (; i >= 0 && count < limit; i--) {
+    int sector = sectorat(i);
+    for (int slot = lastslot(sector); slot >= 1 && count < limit; slot--) {
+      journalrecord r;
+      if (readslot(sector, slot, &r) != SLOT_RECORD || r.seq >= before) continue;
+      records[count++] = r;
+    }
+  }
+  more = count > 0 && records[count - 1].seq > oldest;
+}
+
+static size_t journalstring(Print& out, const char* text){
+  size_t n = out.print('"');
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') n += out.print('\\') + out.print(*c);
+    else if ((uint8_t)*c < 0x20) n += out.printf("\\u%04x", (unsigned)(uint8_t)*c);
+    else n += out.print(*c);
+  }
+  return n + out.print('"');
+}
+
+size_t journalpage::printTo(Print& out) const {
+  size_t n = out.printf("{\"oldest\":%u,\"next\":%u,\"boot\":%u,\"records\":[", (unsigned)oldest, (unsigned)next,
+                        (unsigned)boot);
+  for (int i = 0; i < count; i++) {
+    const journalrecord& r = records[i];
+    n += out.printf("%s{\"seq\":%u,\"boot\":%u,\"ms\":%llu,\"type\":", i ? "," : "", (unsigned)r.seq,
+                    (unsigned)r.boot, (unsigned long long)r.ms);
+    n += journalstring(out, names(r.type));
+    n += out.print(",\"detail\":");
+    n += journalstring(out, r.detail);
+    n += out.print('}');
+  }
+  n += out.print(']');
+  if (more) n += out.print(",\"more\":true");
+  return n + out.print('}');
+}
+
+// Counts what printTo writes, for Content-Length.
+class journallength : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+};
+
+size_t journalpage::length() const {
+  journallength counter;
+  return printTo(counter);
+}
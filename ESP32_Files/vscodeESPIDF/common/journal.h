@@ -0,0 +1,89 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include "esp_partition.h"
+
+// Event history that survives reboots and power cuts, in the "journal"
+// data partition (subtype JOURNAL_SUBTYPE) of partitions.csv. Nothing is
+// ever rewritten in place: records are appended to the head sector and
+// when it is full the next sector round the partition is erased and
+// becomes the head, so every sector is erased once per lap and the oldest
+// JOURNAL_RECORDS_PER_SECTOR records go with it.
+//
+// Sector, 4 KB: a header slot, then JOURNAL_RECORDS_PER_SECTOR slots.
+//   header: "SHJ1", u32 lap number of the sector, 0xff..., u32 CRC-32
+//   record: u32 seq, u48 ms, u16 boot, u8 type, char detail[15], u32 CRC-32
+// Little endian, CRC-32 (IEEE) over the 28 bytes before it. Each slot is
+// programmed with a single write; one cut short fails its CRC and is
+// skipped, the slots after it are still erased.
+//
+// seq numbers records from the first one ever. boot counts the boots that
+// wrote something, ms is time since that boot; together they are the
+// record's time, which only goes forward.
+//
+// journalbegin() reads one header and one record per sector plus a binary
+// search of the head sector, a few milliseconds. It keeps a small index in
+// RAM, the first seq and time of each sector, so a page of history is read
+// from the sector it starts in and not found by scanning. Not thread safe,
+// call everything from the loop task. An append that fills the head sector
+// waits for an erase, tens of milliseconds, once every
+// JOURNAL_RECORDS_PER_SECTOR records.
+#define JOURNAL_LABEL "journal"
+#define JOURNAL_SUBTYPE 0x40
+#define JOURNAL_SECTOR 4096
+#define JOURNAL_SLOT 32
+#define JOURNAL_RECORDS_PER_SECTOR (JOURNAL_SECTOR / JOURNAL_SLOT - 1)
+#define JOURNAL_MAX_SECTORS 64           // 256 KB
+#define JOURNAL_DETAIL_LEN 15
+#define JOURNAL_PAGE_MAX 25
+
+struct journalrecord {
+  uint32_t seq;
+  uint64_t ms;
+  uint16_t boot;
+  uint8_t type;
+  char detail[JOURNAL_DETAIL_LEN + 1];
+};
+
+// The record's place in time, for comparing and for the index.
+inline uint64_t journaltime(uint16_t boot, uint64_t ms){
+  return (uint64_t)boot << 48 | (ms & 0xffffffffffffULL);
+}
+
+// Finds the partition and recovers the head, false without a partition
+// (appends are then dropped).
+bool journalbegin(void);
+bool journalappend(uint8_t type, const char* detail = "");
+// Oldest and newest seq kept, equal to journalnext() when empty.
+uint32_t journaloldest(void);
+uint32_t journalnext(void);
+uint16_t journalboot(void);
+// Slots that failed their CRC when read, since boot.
+uint32_t journalcorrupt(void);
+// One past the seq of the last record at or before time, journaloldest()
+// when there is none.
+uint32_t journalseqafter(uint64_t time);
+
+// Up to limit records before seq before, newest first, as JSON:
+//   {"oldest":S,"next":S,"boot":B,"records":[{"seq":S,"boot":B,"ms":M,
+//    "type":"name","detail":"..."},...],"more":true}
+// "more" is there when older records are left; page on with before set to
+// the last seq, 0 starts from the newest. Type names come from names.
+class journalpage : public Printable {
+public:
+  journalpage(uint32_t before, int limit, const char* (*names)(uint8_t type));
+  size_t printTo(Print& out) const override;
+  size_t length() const;
+
+private:
+  journalrecord records[JOURNAL_PAGE_MAX];
+  int count;
+  bool more;
+  uint32_t oldest;
+  uint32_t next;
+  uint16_t boot;
+  const char* (*names)(uint8_t type);
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "metrics.h"
+#include "dlog.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+std::atomic<uint32_t> metriccounters[METRIC_COUNTERS + 1];
+std::atomic<int32_t> metricgauges[METRIC_GAUGES + 1];
+metrichist metrichists[METRIC_HISTOGRAMS + 1];
+
+struct metricinfo {
+  const char* name;
+  const char* help;
+};
+
+#define METRIC_COUNTER(id, name, help) {name, help},
+#define METRIC_GAUGE(id, name, help)
+#define METRIC_HISTOGRAM(id, name, help)
+static const metricinfo counterinfo[METRIC_COUNTERS + 1] = {
+#include "metricslist.h"
+  {nullptr, nullptr}
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+#define METRIC_COUNTER(id, name, help)
+#define METRIC_GAUGE(id, name, help) {name, help},
+#define METRIC_HISTOGRAM(id, name, help)
+static const metricinfo gaugeinfo[METRIC_GAUGES + 1] = {
+#include "metricslist.h"
+  {nullptr, nullptr}
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+#define METRIC_COUNTER(id, name, help)
+#define METRIC_GAUGE(id, name, help)
+#define METRIC_HISTOGRAM(id, name, help) {name, help},
+static const metricinfo histograminfo[METRIC_HISTOGRAMS + 1] = {
+#include "metricslist.h"
+  {nullptr, nullptr}
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+metricsnapshot::metricsnapshot(){
+  for (int i = 0; i < METRIC_COUNTERS; i++) counters[i] = metriccounters[i].load(std::memory_order_relaxed);
+  for (int i = 0; i < METRIC_GAUGES; i++) gauges[i] = metricgauges[i].load(std::memory_order_relaxed);
+  for (int i = 0; i < METRIC_HISTOGRAMS; i++) {
+    for (int b = 0; b <= METRICS_BUCKETS; b++) buckets[i][b] = metrichists[i].buckets[b].load(std::memory_order_relaxed);
+    sumus[i] = metrichists[i].sumus.load(std::memory_order_relaxed);
+  }
+  uptimems = millis();
+  heapfree = ESP.getFreeHeap();
+  heapminfree = ESP.getMinFreeHeap();
+  heaplargest = ESP.getMaxAllocHeap();
+  stackfree = uxTaskGetStackHighWaterMark(nullptr);
+  dlogdrops = dlogdropped();
+}
+
+static size_t metrichead(Print& out, const char* name, const char* help, const char* type){
+  return out.printf("# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n", name, help, name, type);
+}
+
+static size_t metricline(Print& out, const char* name, const char* help, const char* type, double value){
+  return metrichead(out, name, help, type) + out.printf(METRICS_PREFIX "%s %.10g\n", name, value);
+}
+
+size_t metricsnapshot::printTo(Print& out) const {
+  size_t n = 0;
+  n += metricline(out, "uptime_seconds", "Time since boot", "gauge", uptimems / 1000.0);
+  n += metricline(out, "heap_free_bytes", "Free heap", "gauge", heapfree);
+  n += metricline(out, "heap_min_free_bytes", "Lowest free heap since boot", "gauge", heapminfree);
+  n += metricline(out, "heap_largest_free_block_bytes", "Largest allocatable block", "gauge", heaplargest);
+  n += metricline(out, "loop_stack_free_bytes", "Stack the loop task never used", "gauge", stackfree);
+  n += metricline(out, "dlog_dropped_total", "Log records that did not fit in a ring", "counter", dlogdrops);
+  for (int i = 0; i < METRIC_COUNTERS; i++) {
+    n += metricline(out, counterinfo[i].name, counterinfo[i].help, "counter", counters[i]);
+  }
+  for (int i = 0; i < METRIC_GAUGES; i++) {
+    n += metricline(out, gaugeinfo[i].name, gaugeinfo[i].help, "gauge", gauges[i]);
+  }
+  for (int i = 0; i < METRIC_HISTOGRAMS; i++) {
+    const char* name = histograminfo[i].name;
+    n += metrichead(out, name, histograminfo[i].help, "histogram");
+    uint32_t count = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+      count += buckets[i][b];
+      uint32_t bound = 1u << (METRICS_FIRST_BUCKET + b);
+      n += out.printf(METRICS_PREFIX "%s_bucket{le=\"%g\"} %u\n", name, bound / 1e6, (unsigned)count);
+    }
+    count += buckets[i][METRICS_BUCKETS];
+    n += out.printf(METRICS_PREFIX "%s_bucket{le=\"+Inf\"} %u\n", name, (unsigned)count);
+    n += out.printf(METRICS_PREFIX "%s_sum %.6f\n", name, sumus[i] / 1e6);
+    n += out.printf(METRICS_PREFIX "%s_count %u\n", name, (unsigned)count);
+  }
+  return n;
+}
+
+// Counts what printTo writes, for Content-Length.
+class metricslength : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+};
+
+size_t metricsnapshot::length() const {
+  metricslength counter;
+  return printTo(counter);
+}
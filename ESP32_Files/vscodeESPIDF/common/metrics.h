@@ -0,0 +1,112 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Runtime numbers for GET /api/metrics, in Prometheus' text format. Each
+// firmware lists its metrics in its own metricslist.h:
+//
+//   METRIC_COUNTER(id, "name", "help")     only goes up
+//   METRIC_GAUGE(id, "name", "help")       the value last set
+//   METRIC_HISTOGRAM(id, "name", "help")   durations in microseconds
+//
+// The list becomes enums and static arrays, so an update is one relaxed
+// atomic add at an index fixed at compile time: no lookup, no lock, no
+// allocation, safe from any task. Not for ISRs.
+//
+// Histograms count into power of two buckets, 2^METRICS_FIRST_BUCKET us
+// up to 2^(METRICS_FIRST_BUCKET + METRICS_BUCKETS - 1) us (8.4 s), and
+// +Inf. They are shown in seconds.
+#define METRICS_PREFIX "sentri_"
+#define METRICS_FIRST_BUCKET 4
+#define METRICS_BUCKETS 20
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+
+#define METRIC_COUNTER(id, name, help) id,
+#define METRIC_GAUGE(id, name, help)
+#define METRIC_HISTOGRAM(id, name, help)
+enum metriccounter {
+#include "metricslist.h"
+  METRIC_COUNTERS
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+#define METRIC_COUNTER(id, name, help)
+#define METRIC_GAUGE(id, name, help) id,
+#define METRIC_HISTOGRAM(id, name, help)
+enum metricgauge {
+#include "metricslist.h"
+  METRIC_GAUGES
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+#define METRIC_COUNTER(id, name, help)
+#define METRIC_GAUGE(id, name, help)
+#define METRIC_HISTOGRAM(id, name, help) id,
+enum metrichistogram {
+#include "metricslist.h"
+  METRIC_HISTOGRAMS
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+#undef METRIC_HISTOGRAM
+
+struct metrichist {
+  std::atomic<uint32_t> buckets[METRICS_BUCKETS + 1];
+  // 64 bits, 32 would wrap after 71 minutes of loop time. The ESP32 has no
+  // 64-bit atomics, this add takes a short critical section.
+  std::atomic<uint64_t> sumus;
+};
+
+// One more than the enum so a firmware without gauges or histograms still
+// has arrays.
+extern std::atomic<uint32_t> metriccounters[METRIC_COUNTERS + 1];
+extern std::atomic<int32_t> metricgauges[METRIC_GAUGES + 1];
+extern metrichist metrichists[METRIC_HISTOGRAMS + 1];
+
+inline void metricinc(metriccounter id, uint32_t n = 1){
+  metriccounters[id].fetch_add(n, std::memory_order_relaxed);
+}
+
+inline void metricset(metricgauge id, int32_t value){
+  metricgauges[id].store(value, std::memory_order_relaxed);
+}
+
+inline void metricobserve(metrichistogram id, uint32_t us){
+  // The first bucket whose bound 2^(METRICS_FIRST_BUCKET + i) is >= us.
+  int log2 = us > 1 ? 32 - __builtin_clz(us - 1) : 0;
+  int bucket = log2 - METRICS_FIRST_BUCKET;
+  if (bucket < 0) bucket = 0;
+  if (bucket > METRICS_BUCKETS) bucket = METRICS_BUCKETS;
+  metrichists[id].buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  metrichists[id].sumus.fetch_add(us, std::memory_order_relaxed);
+}
+
+// Everything at one instant, so the length and the text agree. Besides the
+// list: uptime, heap free, lowest heap free, largest free block, the
+// calling task's stack high-water mark and dlog's dropped records.
+class metricsnapshot : public Printable {
+public:
+  metricsnapshot();
+  size_t printTo(Print& out) const override;
+  size_t length() const;
+
+private:
+  uint32_t counters[METRIC_COUNTERS + 1];
+  int32_t gauges[METRIC_GAUGES + 1];
+  uint32_t buckets[METRIC_HISTOGRAMS + 1][METRICS_BUCKETS + 1];
+  uint64_t sumus[METRIC_HISTOGRAMS + 1];
+  uint32_t uptimems;
+  uint32_t heapfree;
+  uint32_t heapminfree;
+  uint32_t heaplargest;
+  uint32_t stackfree;
+  uint32_t dlogdrops;
+};
+
+#endif
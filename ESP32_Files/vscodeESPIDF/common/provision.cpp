@@ -0,0 +1,31 @@
+#include "provision.h"
+#include <Preferences.h>
+
+Provision provision;
+
+bool provisionLoad(){
+  Preferences prefs;
+  provision.valid = false;
+#define PROVISION_STRING(key)
+#define PROVISION_BYTES(type, key, count) provision.has##key = false;
+#include "provisionlist.h"
+#undef PROVISION_STRING
+#undef PROVISION_BYTES
+  // Read only open fails when the flasher never wrote the namespace.
+  if (!prefs.begin(PROVISION_NAMESPACE, true)) {
+    return false;
+  }
+#define PROVISION_STRING(key) provision.key = prefs.getString(#key, "");
+#define PROVISION_BYTES(type, key, count)                                   \
+  if (prefs.getBytesLength(#key) == sizeof(provision.key)) {                \
+    prefs.getBytes(#key, provision.key, sizeof(provision.key));             \
+    provision.has##key = true;                                              \
+  }
+#include "provisionlist.h"
+#undef PROVISION_STRING
+#undef PROVISION_BYTES
+  prefs.end();
+  provision.valid = true;
+  Serial.println("Provisioned from nvs");
+  return true;
+}
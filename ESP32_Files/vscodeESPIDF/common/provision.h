@@ -0,0 +1,27 @@
+#ifndef PROVISION_H
+#define PROVISION_H
+
+#include <Arduino.h>
+
+// Written into the nvs partition by firmwareflasher when it provisions a
+// board, keys must match firmwareflasher/provision.cpp. Each firmware
+// lists what it reads in its own provisionlist.h:
+//
+//   PROVISION_STRING(key)                String key, "" when missing
+//   PROVISION_BYTES(type, key, count)    type key[count], and bool haskey
+//                                        set when the blob is that size
+#define PROVISION_NAMESPACE "provision"
+
+#define PROVISION_STRING(key) String key;
+#define PROVISION_BYTES(type, key, count) bool has##key; type key[count];
+struct Provision {
+  bool valid;
+#include "provisionlist.h"
+};
+#undef PROVISION_STRING
+#undef PROVISION_BYTES
+
+extern Provision provision;
+bool provisionLoad(void);
+
+#endif
@@ -0,0 +1,604 @@
+#include "fleet.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t kUdpPort = 5005;
+constexpr uint16_t kHttpPort = 8080;         // the firmwares' port 80 on the host
+constexpr const char* kRelay = "192.168.0.202";
+constexpr const char* kIntrusion = "INTRUDER INTRUDER";
+constexpr const char* kReceived = "Received: INTRUDER INTRUDER ";
+constexpr int kHubStartMs = 10000;
+constexpr int kHeapSampleMs = 500;
+// WebServer's HTTP_MAX_CLOSE_WAIT, how long the sensor holds a request it
+// never answers.
+constexpr int kSilentCloseMs = 2000;
+
+double Ms(Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+bool ParseAddress(const std::string& text, in_addr* address) {
+    return inet_pton(AF_INET, text.c_str(), address) == 1;
+}
+
+std::string ModuleAddress(int i) {
+    return "127.42." + std::to_string(i / 250) + "." + std::to_string(i % 250 + 1);
+}
+
+int BindSocket(int type, const std::string& address, uint16_t port, std::string* error) {
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *error = std::string("socket: ") + strerror(errno);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ParseAddress(address, &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        *error = "bind " + address + ":" + std::to_string(port) + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// One request from source to host:8080, the status code or 0 when it
+// failed. The body of the answer lands in *body.
+int Http(const std::string& source, const std::string& host, const std::string& method, const std::string& path,
+         const std::string& form, std::string* body) {
+    std::string error;
+    int fd = BindSocket(SOCK_STREAM, source, 0, &error);
+    if (fd < 0) return 0;
+    timeval tv = {10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kHttpPort);
+    ParseAddress(host, &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return 0;
+    }
+    std::string request = method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n";
+    if (!form.empty()) {
+        request += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                   std::to_string(form.size()) + "\r\n";
+    }
+    request += "\r\n" + form;
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, n);
+    close(fd);
+    int status = 0;
+    if (std::sscanf(response.c_str(), "HTTP/1.%*d %d", &status) != 1) return 0;
+    size_t at = response.find("\r\n\r\n");
+    if (body) *body = at == std::string::npos ? "" : response.substr(at + 4);
+    return status;
+}
+
+// Entries in the "modules" array of /api/state.
+int CountModules(const std::string& state) {
+    size_t at = state.find("\"modules\":[");
+    if (at == std::string::npos) return 0;
+    at += 11;
+    size_t end = state.find(']', at);
+    if (end == std::string::npos || end == at) return 0;
+    return static_cast<int>(std::count(state.begin() + at, state.begin() + end, ',')) + 1;
+}
+
+// sentri_heap_free_bytes from the hub's /api/metrics, -1 when it did not
+// answer.
+long HeapFree(const std::string& hub) {
+    std::string metrics;
+    if (Http(hub, hub, "GET", "/api/metrics", "", &metrics) != 200) return -1;
+    const char* series = "\nsentri_heap_free_bytes ";
+    size_t at = metrics.find(series);
+    return at == std::string::npos ? -1 : std::atol(metrics.c_str() + at + std::strlen(series));
+}
+
+// utime + stime from /proc/<pid>/stat, in seconds.
+double CpuSeconds(pid_t pid) {
+    std::string path = "/proc/" + std::to_string(pid) + "/stat";
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file) return 0;
+    char line[1024];
+    size_t n = std::fread(line, 1, sizeof(line) - 1, file);
+    std::fclose(file);
+    line[n] = 0;
+    // The command name can hold spaces, the fields count from its ')'.
+    const char* rest = std::strrchr(line, ')');
+    unsigned long utime = 0, stime = 0;
+    if (!rest || std::sscanf(rest + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return 0;
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// A module's side of a fan-out request, read until the form body is in.
+struct Connection {
+    int fd;
+    std::string request;
+    bool answered = false;
+    Clock::time_point since;
+};
+
+bool RequestComplete(const std::string& request) {
+    size_t head = request.find("\r\n\r\n");
+    if (head == std::string::npos) return false;
+    size_t length = 0;
+    size_t at = request.find("Content-Length:");
+    if (at != std::string::npos && at < head) length = std::strtoul(request.c_str() + at + 15, nullptr, 10);
+    return request.size() >= head + 4 + length;
+}
+
+class Fleet {
+public:
+    explicit Fleet(const FleetOptions& options) : options_(options) {}
+
+    ~Fleet() {
+        stop_ = true;
+        // The reader ends when the hub's stdout does.
+        StopHub();
+        for (std::thread* thread : {&sink_thread_, &module_thread_}) {
+            if (thread->joinable()) thread->join();
+        }
+        for (int fd : udp_) close(fd);
+        for (int fd : listen_) close(fd);
+        for (Connection& connection : connections_) close(connection.fd);
+        if (sink_ >= 0) close(sink_);
+        if (!state_dir_.empty()) std::system(("rm -rf " + state_dir_).c_str());
+    }
+
+    bool Start(std::string* error) {
+        // Two sockets a module, more than the usual 1024 descriptors.
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+        sink_ = BindSocket(SOCK_DGRAM, options_.sink, kUdpPort, error);
+        if (sink_ < 0) return false;
+        int size = 4 << 20;
+        setsockopt(sink_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        for (int i = 0; i < options_.modules; i++) {
+            std::string address = ModuleAddress(i);
+            int udp = BindSocket(SOCK_DGRAM, address, kUdpPort, error);
+            if (udp < 0) return false;
+            udp_.push_back(udp);
+            int tcp = BindSocket(SOCK_STREAM, address, kHttpPort, error);
+            if (tcp < 0) return false;
+            listen_.push_back(tcp);
+            if (listen(tcp, 16) != 0 || fcntl(tcp, F_SETFL, O_NONBLOCK) != 0) {
+                *error = "listen " + address + ": " + strerror(errno);
+                return false;
+            }
+            fcntl(udp, F_SETFL, O_NONBLOCK);
+        }
+        if (!StartHub(error)) return false;
+        sink_thread_ = std::thread([this] { Sink(); });
+        module_thread_ = std::thread([this] { Modules(); });
+
+        auto until = Clock::now() + std::chrono::milliseconds(kHubStartMs);
+        while (Http(options_.hub, options_.hub, "GET", "/api/health", "", nullptr) != 200) {
+            if (Clock::now() > until || waitpid(hub_pid_, nullptr, WNOHANG) != 0) {
+                *error = "hub at " + options_.hub + " did not come up";
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return true;
+    }
+
+    bool Run(FleetReport* report, std::string* error) {
+        report->modules = options_.modules;
+        auto registering = Clock::now();
+        for (int i = 0; i < options_.modules; i++) {
+            std::string address = ModuleAddress(i);
+            if (Http(address, options_.hub, "POST", "/api/module", "alert=" + address, nullptr) != 200) {
+                *error = "hub turned away " + address;
+                return false;
+            }
+        }
+        report->register_s = Ms(Clock::now() - registering) / 1000;
+        std::string state;
+        Http(options_.hub, options_.hub, "GET", "/api/state", "", &state);
+        report->registered = CountModules(state);
+
+        std::thread fanouts;
+        std::vector<double> fanout_ms;
+        if (options_.fanout_every_s > 0) {
+            fanouts = std::thread([this, &fanout_ms] { Fanouts(&fanout_ms); });
+        }
+
+        std::vector<long> heap;
+        auto sample_heap = [this, &heap] {
+            long bytes = HeapFree(options_.hub);
+            if (bytes >= 0) heap.push_back(bytes);
+        };
+        std::thread heap_sampler([this, &sample_heap] {
+            auto warm = Clock::now() + std::chrono::milliseconds(static_cast<long>(options_.heap_warmup_s * 1000));
+            while (sending_ && Clock::now() < warm) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (sending_) sample_heap();
+            while (sending_) {
+                auto next = Clock::now() + std::chrono::milliseconds(kHeapSampleMs);
+                while (sending_ && Clock::now() < next) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                if (sending_) sample_heap();
+            }
+        });
+
+        double cpu = CpuSeconds(hub_pid_);
+        start_ = Clock::now();
+        Send();
+        auto drain = Clock::now() + std::chrono::milliseconds(static_cast<long>(options_.drain_s * 1000));
+        while (Clock::now() < drain) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (processed_.size() >= send_times_.size() && relayed_.size() >= processed_.size()) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        sending_ = false;
+        if (fanouts.joinable()) fanouts.join();
+        heap_sampler.join();
+        report->run_s = Ms(Clock::now() - start_) / 1000;
+        report->hub_cpu_s = CpuSeconds(hub_pid_) - cpu;
+        sample_heap();
+        report->heap_samples = static_cast<int>(heap.size());
+        if (!heap.empty()) {
+            report->heap_start = heap.front();
+            report->heap_end = heap.back();
+            report->heap_min = *std::min_element(heap.begin(), heap.end());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        report->sent = send_times_.size();
+        report->processed = processed_.size();
+        report->relayed = relayed_.size();
+        report->dropped = report->sent - std::min(report->sent, report->processed);
+        // The relay packet says nothing about which intrusion it is for, but
+        // the hub handles them one at a time, logging each before it relays
+        // it: the k-th logged one is the k-th at the sink.
+        std::vector<double> latency;
+        size_t pairs = std::min(processed_.size(), relayed_.size());
+        for (size_t k = 0; k < pairs; k++) {
+            uint64_t seq = processed_[k];
+            if (seq < send_times_.size()) latency.push_back(Ms(relayed_[k] - send_times_[seq]));
+        }
+        report->latency = Percentiles(std::move(latency));
+        report->fanouts = static_cast<int>(fanout_ms.size());
+        report->fanout = Percentiles(std::move(fanout_ms));
+        report->fanout_failed = fanout_failed_;
+        report->fanout_requests = fanout_requests_;
+        return true;
+    }
+
+private:
+    bool StartHub(std::string* error) {
+        char dir[] = "/tmp/fleetsim_XXXXXX";
+        if (!mkdtemp(dir)) {
+            *error = std::string("mkdtemp: ") + strerror(errno);
+            return false;
+        }
+        state_dir_ = dir;
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            *error = std::string("pipe: ") + strerror(errno);
+            return false;
+        }
+        std::vector<std::string> args = {options_.hub_bin, "--ip", options_.hub, "--state", state_dir_ + "/hub",
+                                         "--map", std::string(kRelay) + "=" + options_.sink};
+        hub_pid_ = fork();
+        if (hub_pid_ == 0) {
+            dup2(fds[1], 1);
+            int log = open((state_dir_ + "/hub.err").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (log >= 0) dup2(log, 2);
+            int null = open("/dev/null", O_RDONLY);
+            if (null >= 0) dup2(null, 0);
+            std::vector<char*> argv;
+            for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        close(fds[1]);
+        if (hub_pid_ < 0) {
+            close(fds[0]);
+            *error = std::string("fork: ") + strerror(errno);
+            return false;
+        }
+        hub_out_ = fds[0];
+        reader_ = std::thread([this] { Read(); });
+        return true;
+    }
+
+    void StopHub() {
+        if (hub_pid_ > 0) {
+            kill(hub_pid_, SIGKILL);
+            waitpid(hub_pid_, nullptr, 0);
+            hub_pid_ = -1;
+        }
+        if (reader_.joinable()) reader_.join();
+        if (hub_out_ >= 0) close(hub_out_);
+        hub_out_ = -1;
+    }
+
+    // The hub's serial output. Lines can run together (it prints module
+    // addresses without a newline), so the marker is searched for anywhere.
+    void Read() {
+        std::string pending;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(hub_out_, buffer, sizeof(buffer))) > 0) {
+            pending.append(buffer, n);
+            size_t end;
+            while ((end = pending.find('\n')) != std::string::npos) {
+                size_t at = pending.find(kReceived);
+                if (at < end) {
+                    uint64_t seq = std::strtoull(pending.c_str() + at + std::strlen(kReceived), nullptr, 10);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    processed_.push_back(seq);
+                }
+                pending.erase(0, end + 1);
+            }
+        }
+    }
+
+    void Sink() {
+        pollfd fd = {sink_, POLLIN, 0};
+        char buffer[256];
+        while (!stop_) {
+            if (poll(&fd, 1, 100) <= 0) continue;
+            while (recv(sink_, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+                auto now = Clock::now();
+                std::lock_guard<std::mutex> lock(mutex_);
+                relayed_.push_back(now);
+            }
+        }
+    }
+
+    // Every module's listener and UDP socket on one poll() loop. Requests
+    // are answered with 200 unless the modules are silent.
+    void Modules() {
+        std::vector<pollfd> fds;
+        char buffer[2048];
+        while (!stop_) {
+            fds.clear();
+            for (int fd : listen_) fds.push_back({fd, POLLIN, 0});
+            for (int fd : udp_) fds.push_back({fd, POLLIN, 0});
+            for (const Connection& connection : connections_) {
+                if (!connection.answered) fds.push_back({connection.fd, POLLIN, 0});
+            }
+            poll(fds.data(), fds.size(), 50);
+            auto now = Clock::now();
+            for (const pollfd& fd : fds) {
+                if (!(fd.revents & POLLIN)) continue;
+                if (fd.fd < 0) continue;
+                bool listener = std::find(listen_.begin(), listen_.end(), fd.fd) != listen_.end();
+                if (listener) {
+                    int client;
+                    while ((client = accept4(fd.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        connections_.push_back({client, "", false, now});
+                    }
+                    continue;
+                }
+                if (std::find(udp_.begin(), udp_.end(), fd.fd) != udp_.end()) {
+                    while (recv(fd.fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+                    }
+                    continue;
+                }
+                for (Connection& connection : connections_) {
+                    if (connection.fd != fd.fd) continue;
+                    ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+                    if (n > 0) connection.request.append(buffer, n);
+                    if (n > 0 && RequestComplete(connection.request)) {
+                        connection.answered = true;
+                        connection.since = now;
+                        fanout_requests_++;
+                        if (!options_.silent_modules) {
+                            static const char kOk[] =
+                                "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n"
+                                "Connection: close\r\n\r\nOK";
+                            send(connection.fd, kOk, sizeof(kOk) - 1, MSG_NOSIGNAL);
+                        }
+                    } else if (n == 0 || (n < 0 && errno != EAGAIN)) {
+                        connection.answered = true;
+                        connection.since = now - std::chrono::milliseconds(kSilentCloseMs);
+                    }
+                }
+            }
+            // Answered ones close now, silent ones after the close wait.
+            auto wait = std::chrono::milliseconds(options_.silent_modules ? kSilentCloseMs : 0);
+            connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                              [&](const Connection& connection) {
+                                                  if (!connection.answered || now - connection.since < wait)
+                                                      return false;
+                                                  close(connection.fd);
+                                                  return true;
+                                              }),
+                               connections_.end());
+        }
+    }
+
+    // Intrusion packets from the modules in turn, "INTRUDER INTRUDER <seq>"
+    // so the hub's log says which one it handled.
+    void Send() {
+        std::mt19937_64 random(options_.seed);
+        std::exponential_distribution<double> gap(options_.rate);
+        sockaddr_in hub = {};
+        hub.sin_family = AF_INET;
+        hub.sin_port = htons(kUdpPort);
+        ParseAddress(options_.hub, &hub.sin_addr);
+        double at_s = 0;
+        for (uint64_t seq = 0;; seq++) {
+            at_s = options_.poisson ? at_s + gap(random) : seq / options_.rate;
+            if (at_s >= options_.duration_s) break;
+            std::this_thread::sleep_until(start_ + std::chrono::duration_cast<Clock::duration>(
+                                                       std::chrono::duration<double>(at_s)));
+            std::string packet = std::string(kIntrusion) + " " + std::to_string(seq);
+            int fd = udp_[seq % udp_.size()];
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                send_times_.push_back(Clock::now());
+            }
+            sendto(fd, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&hub), sizeof(hub));
+        }
+    }
+
+    // Alternates the app's one-time password and disarm password calls,
+    // both of which the hub passes on to every module before answering.
+    void Fanouts(std::vector<double>* ms) {
+        auto next = Clock::now();
+        for (int n = 0; sending_; n++) {
+            next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options_.fanout_every_s));
+            while (sending_ && Clock::now() < next) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (!sending_) break;
+            auto begin = Clock::now();
+            int status = n % 2 ? Http(options_.hub, options_.hub, "POST", "/api/permanentpass", "pass=4321", nullptr)
+                               : Http(options_.hub, options_.hub, "POST", "/api/onetimepass", "otp=123456", nullptr);
+            // A hub still stuck in the fan-out when the request times out
+            // counts with the time it was given.
+            ms->push_back(Ms(Clock::now() - begin));
+            if (status != 200) fanout_failed_++;
+        }
+    }
+
+    FleetOptions options_;
+    std::string state_dir_;
+    pid_t hub_pid_ = -1;
+    int hub_out_ = -1;
+    int sink_ = -1;
+    std::vector<int> udp_;
+    std::vector<int> listen_;
+    std::vector<Connection> connections_;   // the module thread's
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> sending_{true};
+    std::atomic<uint64_t> fanout_requests_{0};
+    std::atomic<int> fanout_failed_{0};
+    std::thread reader_;
+    std::thread sink_thread_;
+    std::thread module_thread_;
+    Clock::time_point start_;
+
+    std::mutex mutex_;
+    std::vector<Clock::time_point> send_times_;   // by seq
+    std::vector<uint64_t> processed_;            // seqs in the hub's order
+    std::vector<Clock::time_point> relayed_;
+};
+
+void JsonStats(std::ostringstream& out, const char* name, const LatencyStats& stats) {
+    out << "\"" << name << "\":{\"count\":" << stats.count << ",\"p50_ms\":" << stats.p50_ms
+        << ",\"p99_ms\":" << stats.p99_ms << ",\"p999_ms\":" << stats.p999_ms << ",\"max_ms\":" << stats.max_ms
+        << "}";
+}
+
+}  // namespace
+
+LatencyStats Percentiles(std::vector<double> ms) {
+    LatencyStats stats;
+    stats.count = ms.size();
+    if (ms.empty()) return stats;
+    std::sort(ms.begin(), ms.end());
+    auto rank = [&](double p) {
+        size_t k = static_cast<size_t>(std::ceil(p * ms.size()));
+        return ms[std::min(ms.size(), std::max<size_t>(k, 1)) - 1];
+    };
+    stats.p50_ms = rank(0.5);
+    stats.p99_ms = rank(0.99);
+    stats.p999_ms = rank(0.999);
+    stats.max_ms = ms.back();
+    return stats;
+}
+
+bool RunFleet(const FleetOptions& options, FleetReport* report, std::string* error) {
+    if (options.modules < 1 || options.modules > 250 * 256) {
+        *error = "modules must be 1.." + std::to_string(250 * 256);
+        return false;
+    }
+    if (options.rate <= 0 || options.duration_s <= 0) {
+        *error = "rate and duration must be positive";
+        return false;
+    }
+    Fleet fleet(options);
+    return fleet.Start(error) && fleet.Run(report, error);
+}
+
+std::string ReportText(const FleetOptions& options, const FleetReport& report) {
+    char line[256];
+    std::string text;
+    std::snprintf(line, sizeof(line), "modules     %d registered in %.2f s, the hub lists %d\n", report.modules,
+                  report.register_s, report.registered);
+    text += line;
+    std::snprintf(line, sizeof(line), "intrusions  %llu sent at %.1f/s%s, %llu processed, %llu relayed, %llu dropped (%.2f%%)\n",
+                  static_cast<unsigned long long>(report.sent), options.rate, options.poisson ? " (poisson)" : "",
+                  static_cast<unsigned long long>(report.processed), static_cast<unsigned long long>(report.relayed),
+                  static_cast<unsigned long long>(report.dropped),
+                  report.sent ? 100.0 * report.dropped / report.sent : 0.0);
+    text += line;
+    std::snprintf(line, sizeof(line), "latency     p50 %.3f ms  p99 %.3f ms  p99.9 %.3f ms  max %.3f ms\n",
+                  report.latency.p50_ms, report.latency.p99_ms, report.latency.p999_ms, report.latency.max_ms);
+    text += line;
+    std::snprintf(line, sizeof(line), "hub cpu     %.2f s over %.2f s (%.1f%%)\n", report.hub_cpu_s, report.run_s,
+                  report.run_s > 0 ? 100 * report.hub_cpu_s / report.run_s : 0.0);
+    text += line;
+    if (options.fanout_every_s > 0) {
+        std::snprintf(line, sizeof(line),
+                      "fan-out     %d triggered, %d timed out, p50 %.1f ms  max %.1f ms, %llu module requests%s\n",
+                      report.fanouts, report.fanout_failed, report.fanout.p50_ms, report.fanout.max_ms,
+                      static_cast<unsigned long long>(report.fanout_requests),
+                      options.silent_modules ? " (silent modules)" : "");
+        text += line;
+    }
+    if (report.heap_samples > 0) {
+        std::snprintf(line, sizeof(line), "hub heap    %ld free at the start, %ld at the end, %ld lowest (%d samples)\n",
+                      report.heap_start, report.heap_end, report.heap_min, report.heap_samples);
+        text += line;
+    }
+    return text;
+}
+
+std::string ReportJson(const FleetOptions& options, const FleetReport& report) {
+    std::ostringstream out;
+    out << "{\"modules\":" << report.modules << ",\"registered\":" << report.registered
+        << ",\"register_s\":" << report.register_s << ",\"rate\":" << options.rate
+        << ",\"poisson\":" << (options.poisson ? "true" : "false") << ",\"sent\":" << report.sent
+        << ",\"processed\":" << report.processed << ",\"relayed\":" << report.relayed
+        << ",\"dropped\":" << report.dropped << ",";
+    JsonStats(out, "latency", report.latency);
+    out << ",\"run_s\":" << report.run_s << ",\"hub_cpu_s\":" << report.hub_cpu_s << ",\"fanouts\":" << report.fanouts
+        << ",\"fanout_failed\":" << report.fanout_failed << ",";
+    JsonStats(out, "fanout", report.fanout);
+    out << ",\"fanout_requests\":" << report.fanout_requests << ",\"heap_samples\":" << report.heap_samples
+        << ",\"heap_start\":" << report.heap_start << ",\"heap_end\":" << report.heap_end
+        << ",\"heap_min\":" << report.heap_min << "}\n";
+    return out.str();
+}
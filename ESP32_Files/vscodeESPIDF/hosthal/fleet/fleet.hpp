@@ -0,0 +1,72 @@
+#ifndef HOSTHAL_FLEET_HPP
+#define HOSTHAL_FLEET_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A hub_host under load from virtual sensor modules. Every module has its
+// own loopback address, registers with /api/module, sends intrusion
+// packets to UDP 5005 and answers the hub's OTP and password fan-out on
+// port 80 (8080 on the host). The hub's relay to the Raspberry Pi goes to
+// a local sink instead, which is where an intrusion counts as handled.
+struct FleetOptions {
+    std::string hub_bin;                  // hub_host to start
+    std::string hub = "127.0.41.1";
+    std::string sink = "127.0.41.254";
+    int modules = 100;
+    double rate = 50;                     // intrusion packets per second, whole fleet
+    bool poisson = false;                 // exponential gaps instead of even ones
+    double duration_s = 10;
+    double drain_s = 3;                   // to wait for stragglers after the last send
+    double fanout_every_s = 0;            // 0 never triggers the OTP/password fan-out
+    // Answer fan-out requests the way the sensor firmware does: not at all,
+    // the connection is closed after WebServer's 2 s close wait.
+    bool silent_modules = false;
+    // The hub's first alarms and fan-outs set up what it keeps (sockets,
+    // the HTTP client's first connection), the heap is only watched after.
+    double heap_warmup_s = 3;
+    unsigned seed = 1;
+};
+
+struct LatencyStats {
+    size_t count = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double p999_ms = 0;
+    double max_ms = 0;
+};
+
+struct FleetReport {
+    int modules = 0;
+    int registered = 0;                   // what /api/state lists afterwards
+    double register_s = 0;
+    uint64_t sent = 0;
+    uint64_t processed = 0;               // intrusions the hub logged
+    uint64_t relayed = 0;                 // reached the sink
+    uint64_t dropped = 0;                 // sent and not processed by the end of the drain
+    LatencyStats latency;                 // send to relay at the sink
+    double run_s = 0;                     // first send to end of drain
+    double hub_cpu_s = 0;                 // hub user + system time over run_s
+    int fanouts = 0;
+    int fanout_failed = 0;                // no answer within 10 s
+    LatencyStats fanout;                  // trigger request to the hub's answer
+    uint64_t fanout_requests = 0;         // requests the modules got
+    // The hub's free heap from /api/metrics, sampled every half second
+    // after the warm-up and once after the drain. A hub that leaks ends
+    // lower than it started.
+    int heap_samples = 0;
+    long heap_start = 0;
+    long heap_end = 0;
+    long heap_min = 0;
+};
+
+// p50/p99/p99.9/max of latencies in milliseconds, nearest rank.
+LatencyStats Percentiles(std::vector<double> ms);
+
+bool RunFleet(const FleetOptions& options, FleetReport* report, std::string* error);
+
+std::string ReportText(const FleetOptions& options, const FleetReport& report);
+std::string ReportJson(const FleetOptions& options, const FleetReport& report);
+
+#endif
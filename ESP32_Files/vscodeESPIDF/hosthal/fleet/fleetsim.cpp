@@ -0,0 +1,146 @@
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "fleet.hpp"
+
+namespace {
+
+const char* kUsage =
+    "usage: fleetsim [options]\n"
+    "  --hub-bin PATH       hub_host to start, the one next to fleetsim by default\n"
+    "  --modules N          virtual sensor modules, 100 by default\n"
+    "  --rate R             intrusion packets per second from the whole fleet, 50 by default\n"
+    "  --poisson            exponential gaps between packets instead of even ones\n"
+    "  --duration S         seconds to send for, 10 by default\n"
+    "  --drain S            seconds to wait for the hub to catch up, 3 by default\n"
+    "  --fanout-every S     trigger the OTP/password fan-out every S seconds\n"
+    "  --silent-modules     never answer the fan-out, as the sensor firmware does\n"
+    "  --seed N             for --poisson\n"
+    "  --json FILE          write the report as JSON too\n"
+    "  --max-p99-ms MS      exit 1 when p99 latency is above MS\n"
+    "  --max-drop-pct P     exit 1 when more than P percent are dropped\n"
+    "  --heap-warmup S      seconds of load before the hub's heap is watched, 3 by default\n"
+    "  --max-heap-drift B   exit 1 when the hub ends with more than B bytes less free heap\n";
+
+// The directory fleetsim runs from, where hub_host is built too.
+std::string SelfDir() {
+    char path[4096];
+    ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n <= 0) return ".";
+    std::string self(path, n);
+    return self.substr(0, self.rfind('/'));
+}
+
+bool ParseNumber(const char* text, double* value) {
+    char* end = nullptr;
+    *value = std::strtod(text, &end);
+    return end != text && !*end && *value >= 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    FleetOptions options;
+    options.hub_bin = SelfDir() + "/hub_host";
+    std::string json;
+    double max_p99_ms = -1;
+    double max_drop_pct = -1;
+    double max_heap_drift = -1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::fputs(kUsage, stdout);
+            return 0;
+        }
+        if (arg == "--poisson") {
+            options.poisson = true;
+            continue;
+        }
+        if (arg == "--silent-modules") {
+            options.silent_modules = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "%s needs a value\n%s", arg.c_str(), kUsage);
+            return 2;
+        }
+        const char* value = argv[++i];
+        double number = 0;
+        bool numeric = ParseNumber(value, &number);
+        if (arg == "--hub-bin") {
+            options.hub_bin = value;
+        } else if (arg == "--json") {
+            json = value;
+        } else if (!numeric) {
+            std::fprintf(stderr, "%s: bad value %s\n%s", arg.c_str(), value, kUsage);
+            return 2;
+        } else if (arg == "--modules") {
+            options.modules = static_cast<int>(number);
+        } else if (arg == "--rate") {
+            options.rate = number;
+        } else if (arg == "--duration") {
+            options.duration_s = number;
+        } else if (arg == "--drain") {
+            options.drain_s = number;
+        } else if (arg == "--fanout-every") {
+            options.fanout_every_s = number;
+        } else if (arg == "--seed") {
+            options.seed = static_cast<unsigned>(number);
+        } else if (arg == "--max-p99-ms") {
+            max_p99_ms = number;
+        } else if (arg == "--max-drop-pct") {
+            max_drop_pct = number;
+        } else if (arg == "--heap-warmup") {
+            options.heap_warmup_s = number;
+        } else if (arg == "--max-heap-drift") {
+            max_heap_drift = number;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n%s", arg.c_str(), kUsage);
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    FleetReport report;
+    std::string error;
+    if (!RunFleet(options, &report, &error)) {
+        std::fprintf(stderr, "fleetsim: %s\n", error.c_str());
+        return 2;
+    }
+    std::fputs(ReportText(options, report).c_str(), stdout);
+    if (!json.empty()) {
+        std::ofstream out(json);
+        out << ReportJson(options, report);
+        if (!out) {
+            std::fprintf(stderr, "fleetsim: cannot write %s\n", json.c_str());
+            return 2;
+        }
+    }
+
+    int status = 0;
+    if (max_p99_ms >= 0 && report.latency.p99_ms > max_p99_ms) {
+        std::fprintf(stderr, "fleetsim: p99 %.3f ms is over %.3f ms\n", report.latency.p99_ms, max_p99_ms);
+        status = 1;
+    }
+    double drop_pct = report.sent ? 100.0 * report.dropped / report.sent : 0;
+    if (max_drop_pct >= 0 && drop_pct > max_drop_pct) {
+        std::fprintf(stderr, "fleetsim: %.2f%% dropped is over %.2f%%\n", drop_pct, max_drop_pct);
+        status = 1;
+    }
+    if (max_heap_drift >= 0) {
+        long drift = report.heap_start - report.heap_end;
+        if (report.heap_samples < 2) {
+            std::fprintf(stderr, "fleetsim: the hub's heap could not be sampled\n");
+            status = 1;
+        } else if (drift > max_heap_drift) {
+            std::fprintf(stderr, "fleetsim: the hub lost %ld bytes of heap, over %.0f\n", drift, max_heap_drift);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,27 @@
+#ifndef HOSTHAL_ESP32SERVO_H
+#define HOSTHAL_ESP32SERVO_H
+
+#include "Arduino.h"
+
+// Keeps the last pulse width, which is all there is to observe of a servo
+// without one.
+class Servo {
+public:
+    void setPeriodHertz(int hertz) { period_hz_ = hertz; }
+    int attach(int pin, int min_us = 544, int max_us = 2400);
+    void detach() { pin_ = -1; }
+    bool attached() const { return pin_ >= 0; }
+    void write(int value);
+    void writeMicroseconds(int us);
+    int read() const;
+    int readMicroseconds() const { return us_; }
+
+private:
+    int pin_ = -1;
+    int min_us_ = 544;
+    int max_us_ = 2400;
+    int us_ = 0;
+    int period_hz_ = 50;
+};
+
+#endif
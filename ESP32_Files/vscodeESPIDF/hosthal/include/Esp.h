@@ -0,0 +1,20 @@
+#ifndef HOSTHAL_ESP_H
+#define HOSTHAL_ESP_H
+
+#include <stdint.h>
+
+// Figures of a freshly booted ESP32-S3 without PSRAM, the host has no
+// equivalent.
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getHeapSize();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    const char* getChipModel() { return "host"; }
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif
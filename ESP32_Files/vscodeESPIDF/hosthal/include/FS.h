@@ -0,0 +1,79 @@
+#ifndef HOSTHAL_FS_H
+#define HOSTHAL_FS_H
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+// A file of a host directory standing in for a flash file system.
+class File : public Stream {
+public:
+    File() = default;
+    File(FILE* file, const std::string& path);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    size_t read(uint8_t* buffer, size_t size);
+    int peek() override;
+    void flush() override;
+    // Up to the end of the file, without Stream's timeout at the end.
+    size_t readBytes(char* buffer, size_t length) override;
+    String readString() override;
+    bool seek(uint32_t pos);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    const char* name() const;
+    operator bool() const { return file_ != nullptr; }
+
+private:
+    std::shared_ptr<FILE> file_;
+    std::string path_;
+};
+
+// Holds nothing that needs constructing, firmware globals open files
+// before main() as they do on the chip.
+class FS {
+public:
+    explicit constexpr FS(const char* subdir) : subdir_(subdir) {}
+
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+
+protected:
+    std::string Root() const;
+
+    bool mounted_ = false;
+
+private:
+    std::string Path(const char* path) const;
+
+    const char* subdir_;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
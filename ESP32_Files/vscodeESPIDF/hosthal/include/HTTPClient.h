@@ -0,0 +1,63 @@
+#ifndef HOSTHAL_HTTPCLIENT_H
+#define HOSTHAL_HTTPCLIENT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "WiFi.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT (5000)
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_NO_CONTENT = 204,
+    HTTP_CODE_NOT_MODIFIED = 304,
+    HTTP_CODE_BAD_REQUEST = 400,
+    HTTP_CODE_FORBIDDEN = 403,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+    HTTP_CODE_SERVICE_UNAVAILABLE = 503,
+} t_http_codes;
+
+// Plain http:// requests over one connection each, closed afterwards. A
+// response is read until its Content-Length or until the server closes.
+class HTTPClient {
+public:
+    bool begin(const String& url);
+    bool begin(const String& host, uint16_t port, const String& uri = "/");
+    void end();
+
+    void addHeader(const String& name, const String& value);
+    void setTimeout(uint16_t timeout_ms) { timeout_ = timeout_ms; }
+    void setConnectTimeout(int32_t timeout_ms) { connect_timeout_ = timeout_ms; }
+
+    int GET();
+    int POST(const String& payload);
+    int POST(const uint8_t* payload, size_t size);
+    int sendRequest(const char* method, const uint8_t* payload, size_t size);
+
+    String getString() const { return String(body_); }
+    int getSize() const { return static_cast<int>(body_.size()); }
+    static String errorToString(int error);
+
+private:
+    String host_;
+    uint16_t port_ = 80;
+    String uri_ = "/";
+    bool ready_ = false;
+    std::vector<std::pair<String, String>> headers_;
+    uint16_t timeout_ = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+    int32_t connect_timeout_ = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+    std::string body_;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HOSTHAL_HTTP_METHOD_H
+#define HOSTHAL_HTTP_METHOD_H
+
+// http_parser's numbering, which Arduino-ESP32 reuses.
+enum http_method {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+    HTTP_CONNECT = 5,
+    HTTP_OPTIONS = 6,
+    HTTP_TRACE = 7,
+    HTTP_PATCH = 28,
+};
+
+typedef enum http_method HTTPMethod;
+#define HTTP_ANY (HTTPMethod)(255)
+
+#endif
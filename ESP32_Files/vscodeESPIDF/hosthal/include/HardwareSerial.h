@@ -0,0 +1,27 @@
+#ifndef HOSTHAL_HARDWARESERIAL_H
+#define HOSTHAL_HARDWARESERIAL_H
+
+#include "Stream.h"
+
+// UART0 is the process's stdout. Nothing is ever received, stdin belongs
+// to the pin script.
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
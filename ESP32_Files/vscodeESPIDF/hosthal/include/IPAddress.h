@@ -0,0 +1,32 @@
+#ifndef HOSTHAL_IPADDRESS_H
+#define HOSTHAL_IPADDRESS_H
+
+#include <stdint.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : bytes_{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+    // Network byte order, as in a sockaddr_in.
+    explicit IPAddress(uint32_t address);
+
+    bool fromString(const char* address);
+    bool fromString(const String& address) { return fromString(address.c_str()); }
+    String toString() const;
+
+    operator uint32_t() const;   // network byte order
+    bool operator==(const IPAddress& other) const { return static_cast<uint32_t>(*this) == static_cast<uint32_t>(other); }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    uint8_t operator[](int index) const { return bytes_[index]; }
+    uint8_t& operator[](int index) { return bytes_[index]; }
+
+    size_t printTo(Print& p) const override;
+
+private:
+    uint8_t bytes_[4];
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HOSTHAL_LITTLEFS_H
+#define HOSTHAL_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+// The littlefs/ folder of the instance's state directory. Like on the
+// chip nothing opens before begin().
+class LittleFSFS : public FS {
+public:
+    constexpr LittleFSFS() : FS("littlefs") {}
+
+    bool begin(bool format_on_fail = false, const char* base_path = "/littlefs", uint8_t max_open = 10,
+               const char* label = "spiffs");
+    bool format();
+    void end();
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
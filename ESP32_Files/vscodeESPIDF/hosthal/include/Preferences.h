@@ -0,0 +1,60 @@
+#ifndef HOSTHAL_PREFERENCES_H
+#define HOSTHAL_PREFERENCES_H
+
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+// NVS on the nvs/ folder of the instance's state directory, one folder per
+// namespace and one file per key holding the raw value. Numbers are stored
+// little endian, as the chip would.
+class Preferences {
+public:
+    bool begin(const char* name, bool read_only = false, const char* partition_label = nullptr);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putUChar(const char* key, uint8_t value) { return PutNumber(key, value, 1); }
+    size_t putUShort(const char* key, uint16_t value) { return PutNumber(key, value, 2); }
+    size_t putInt(const char* key, int32_t value) { return PutNumber(key, static_cast<uint32_t>(value), 4); }
+    size_t putUInt(const char* key, uint32_t value) { return PutNumber(key, value, 4); }
+    size_t putULong64(const char* key, uint64_t value) { return PutNumber(key, value, 8); }
+    size_t putBool(const char* key, bool value) { return PutNumber(key, value ? 1 : 0, 1); }
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t len);
+
+    uint8_t getUChar(const char* key, uint8_t default_value = 0) {
+        return static_cast<uint8_t>(GetNumber(key, default_value, 1));
+    }
+    uint16_t getUShort(const char* key, uint16_t default_value = 0) {
+        return static_cast<uint16_t>(GetNumber(key, default_value, 2));
+    }
+    int32_t getInt(const char* key, int32_t default_value = 0) {
+        return static_cast<int32_t>(GetNumber(key, static_cast<uint32_t>(default_value), 4));
+    }
+    uint32_t getUInt(const char* key, uint32_t default_value = 0) {
+        return static_cast<uint32_t>(GetNumber(key, default_value, 4));
+    }
+    uint64_t getULong64(const char* key, uint64_t default_value = 0) { return GetNumber(key, default_value, 8); }
+    bool getBool(const char* key, bool default_value = false) { return GetNumber(key, default_value, 1) != 0; }
+    String getString(const char* key, const String& default_value = String());
+    size_t getString(const char* key, char* value, size_t max_len);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t max_len);
+
+private:
+    bool Read(const char* key, std::vector<uint8_t>* value);
+    size_t Write(const char* key, const void* value, size_t len);
+    size_t PutNumber(const char* key, uint64_t value, int bytes);
+    uint64_t GetNumber(const char* key, uint64_t default_value, int bytes);
+
+    std::string dir_;
+    bool read_only_ = false;
+    bool started_ = false;
+};
+
+#endif
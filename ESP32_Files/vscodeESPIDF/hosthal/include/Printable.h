@@ -0,0 +1,14 @@
+#ifndef HOSTHAL_PRINTABLE_H
+#define HOSTHAL_PRINTABLE_H
+
+#include <stddef.h>
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif
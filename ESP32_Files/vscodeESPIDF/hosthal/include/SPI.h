@@ -0,0 +1,8 @@
+#ifndef HOSTHAL_SPI_H
+#define HOSTHAL_SPI_H
+
+// Nothing on the host sits on a SPI bus, TFT_eSPI.h stands in for the
+// display.
+#include "Arduino.h"
+
+#endif
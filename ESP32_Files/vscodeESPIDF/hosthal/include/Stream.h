@@ -0,0 +1,27 @@
+#ifndef HOSTHAL_STREAM_H
+#define HOSTHAL_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+    unsigned long getTimeout() const { return timeout_; }
+
+    // Like Arduino these wait up to the timeout for each byte.
+    virtual size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes(reinterpret_cast<char*>(buffer), length); }
+    virtual String readString();
+    String readStringUntil(char terminator);
+
+protected:
+    int timedRead();
+
+    unsigned long timeout_ = 1000;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef HOSTHAL_TFT_ESPI_H
+#define HOSTHAL_TFT_ESPI_H
+
+#include "Arduino.h"
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_ORANGE 0xFDA0
+#define TFT_WHITE 0xFFFF
+
+// A display without pixels: drawing goes nowhere, text only moves the
+// cursor. Touches come from the pin script's "touch" lines.
+class TFT_eSPI : public Print {
+public:
+    TFT_eSPI(int16_t width = 320, int16_t height = 480) : width_(width), height_(height) {}
+
+    void init(uint8_t tc = 0) { (void)tc; }
+    void begin(uint8_t tc = 0) { init(tc); }
+    void setRotation(uint8_t rotation);
+    int16_t width() const { return rotation_ & 1 ? height_ : width_; }
+    int16_t height() const { return rotation_ & 1 ? width_ : height_; }
+
+    void fillScreen(uint32_t color) { (void)color; }
+    void drawPixel(int32_t x, int32_t y, uint32_t color) { (void)x; (void)y; (void)color; }
+    void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+        (void)x0; (void)y0; (void)x1; (void)y1; (void)color;
+    }
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+        (void)x; (void)y; (void)w; (void)h; (void)color;
+    }
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+        (void)x; (void)y; (void)w; (void)h; (void)color;
+    }
+    void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color) { (void)x; (void)y; (void)r; (void)color; }
+    void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color) { (void)x; (void)y; (void)r; (void)color; }
+
+    void setCursor(int16_t x, int16_t y) { cursor_x_ = x; cursor_y_ = y; }
+    void setCursor(int16_t x, int16_t y, uint8_t font) { setCursor(x, y); font_ = font; }
+    void setTextColor(uint16_t color) { (void)color; }
+    void setTextColor(uint16_t fg, uint16_t bg, bool fill = false) { (void)fg; (void)bg; (void)fill; }
+    void setTextSize(uint8_t size) { text_size_ = size ? size : 1; }
+    void setTextFont(uint8_t font) { font_ = font; }
+    int16_t getCursorX() const { return cursor_x_; }
+    int16_t getCursorY() const { return cursor_y_; }
+
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    uint8_t getTouch(uint16_t* x, uint16_t* y, uint16_t threshold = 600);
+    void setTouch(uint16_t* data) { (void)data; }
+    // Nobody taps the corners on the host, this hands back a plausible
+    // calibration straight away.
+    void calibrateTouch(uint16_t* data, uint32_t color_fg, uint32_t color_bg, uint8_t size);
+
+private:
+    int16_t width_;
+    int16_t height_;
+    uint8_t rotation_ = 0;
+    int16_t cursor_x_ = 0;
+    int16_t cursor_y_ = 0;
+    uint8_t text_size_ = 1;
+    uint8_t font_ = 1;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef HOSTHAL_WSTRING_H
+#define HOSTHAL_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Arduino's String on std::string. Only what the firmwares and
+// ArduinoJson's Arduino adapters use.
+class String {
+public:
+    String() = default;
+    String(const char* s) : s_(s ? s : "") {}
+    String(const char* s, size_t len) : s_(s ? std::string(s, len) : std::string()) {}
+    String(const std::string& s) : s_(s) {}
+    explicit String(char c) : s_(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+
+    String& operator=(const char* s) {
+        s_ = s ? s : "";
+        return *this;
+    }
+
+    const char* c_str() const { return s_.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(s_.size()); }
+    bool isEmpty() const { return s_.empty(); }
+    bool reserve(unsigned int size) {
+        s_.reserve(size);
+        return true;
+    }
+
+    bool concat(const String& s) {
+        s_ += s.s_;
+        return true;
+    }
+    bool concat(const char* s) {
+        if (!s) return false;
+        s_ += s;
+        return true;
+    }
+    bool concat(const char* s, unsigned int len) {
+        if (!s) return false;
+        s_.append(s, len);
+        return true;
+    }
+    bool concat(char c) {
+        s_ += c;
+        return true;
+    }
+    String& operator+=(const String& s) { concat(s); return *this; }
+    String& operator+=(const char* s) { concat(s); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+
+    char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return s_[index]; }
+
+    bool equals(const String& s) const { return s_ == s.s_; }
+    bool equals(const char* s) const { return s_ == (s ? s : ""); }
+    bool equalsIgnoreCase(const String& s) const;
+    bool operator==(const String& s) const { return equals(s); }
+    bool operator==(const char* s) const { return equals(s); }
+    bool operator!=(const String& s) const { return !equals(s); }
+    bool operator!=(const char* s) const { return !equals(s); }
+    bool operator<(const String& s) const { return s_ < s.s_; }
+    int compareTo(const String& s) const { return s_.compare(s.s_); }
+
+    bool startsWith(const String& prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    bool endsWith(const String& suffix) const {
+        return s_.size() >= suffix.s_.size() && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& s, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    String substring(unsigned int begin) const { return substring(begin, length()); }
+    String substring(unsigned int begin, unsigned int end) const;
+
+    void replace(const String& find, const String& with);
+    void remove(unsigned int index, unsigned int count = static_cast<unsigned int>(-1));
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+    // Host side access for the HAL itself.
+    const std::string& str() const { return s_; }
+
+private:
+    std::string s_;
+};
+
+String operator+(const String& a, const String& b);
+String operator+(const String& a, const char* b);
+String operator+(const char* a, const String& b);
+String operator+(const String& a, char b);
+
+#endif
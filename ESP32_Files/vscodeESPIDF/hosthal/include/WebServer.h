@@ -0,0 +1,88 @@
+#ifndef HOSTHAL_WEBSERVER_H
+#define HOSTHAL_WEBSERVER_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HTTP_Method.h"
+#include "WiFi.h"
+
+#define HTTP_MAX_DATA_WAIT 5000   // ms to wait for the request
+#define HTTP_MAX_CLOSE_WAIT 2000  // ms to wait for the client to close
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+// Arduino-ESP32's WebServer as far as the sensor uses it: one client at a
+// time, query and urlencoded body arguments, and the same wait for the
+// client to close after a handler that sent nothing.
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    explicit WebServer(int port = 80) : server_(port) {}
+
+    void begin() { server_.begin(); }
+    void begin(uint16_t port) { server_.begin(port); }
+    void stop() { close(); }
+    void close();
+    void handleClient();
+
+    void on(const String& uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction fn);
+    void onNotFound(THandlerFunction fn) { not_found_ = fn; }
+
+    String uri() const { return uri_; }
+    HTTPMethod method() const { return method_; }
+    WiFiClient client() { return client_; }
+
+    String arg(const String& name) const;
+    String arg(int i) const;
+    String argName(int i) const;
+    int args() const { return static_cast<int>(args_.size()); }
+    bool hasArg(const String& name) const;
+    String header(const String& name) const;
+    bool hasHeader(const String& name) const;
+
+    void sendHeader(const String& name, const String& value, bool first = false);
+    void send(int code, const char* content_type = nullptr, const String& content = String());
+    void send(int code, const String& content_type, const String& content) {
+        send(code, content_type.c_str(), content);
+    }
+    void send(int code, const char* content_type, const char* content, size_t length);
+    // A length set beforehand goes in the header of the next send(), the
+    // body follows in sendContent() pieces.
+    void setContentLength(size_t length) { content_length_ = length; }
+    void sendContent(const char* content, size_t length);
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+
+private:
+    enum Status { kNone, kWaitRead, kWaitClose };
+
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction fn;
+    };
+
+    bool ParseRequest();
+    void Handle();
+
+    WiFiServer server_;
+    WiFiClient client_;
+    Status status_ = kNone;
+    unsigned long status_change_ = 0;
+    std::string request_;
+    std::vector<Route> routes_;
+    THandlerFunction not_found_;
+
+    HTTPMethod method_ = HTTP_GET;
+    String uri_;
+    std::vector<std::pair<String, String>> args_;
+    std::vector<std::pair<String, String>> headers_;
+    String response_headers_;
+    bool responded_ = false;
+    size_t content_length_ = CONTENT_LENGTH_NOT_SET;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef HOSTHAL_WIFICLIENT_H
+#define HOSTHAL_WIFICLIENT_H
+
+#include <memory>
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+#define WIFI_CLIENT_DEF_CONN_TIMEOUT_MS (3000)
+
+// TCP connection. Copies share the socket, which closes with the last one,
+// as in Arduino-ESP32.
+class WiFiClient : public Stream {
+public:
+    WiFiClient() = default;
+    explicit WiFiClient(int fd);
+
+    int connect(IPAddress ip, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout_ms);
+    int connect(const char* host, uint16_t port);
+    int connect(const char* host, uint16_t port, int32_t timeout_ms);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size);
+    int peek() override;
+    void flush() override {}
+    void stop();
+    uint8_t connected();
+
+    int fd() const;
+    int setNoDelay(bool nodelay);
+    IPAddress remoteIP() const;
+    uint16_t remotePort() const;
+    IPAddress localIP() const;
+
+    operator bool() { return connected(); }
+    bool operator==(const WiFiClient& other) const { return socket_ == other.socket_; }
+    bool operator!=(const WiFiClient& other) const { return !(*this == other); }
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> socket_;
+};
+
+#endif
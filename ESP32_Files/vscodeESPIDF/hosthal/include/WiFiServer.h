@@ -0,0 +1,32 @@
+#ifndef HOSTHAL_WIFISERVER_H
+#define HOSTHAL_WIFISERVER_H
+
+#include "WiFiClient.h"
+
+// Listens on the instance's own address. Ports below 1024 move up by
+// 8000, so port 80 is 8080 and needs no privileges.
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port = 80, uint8_t max_clients = 4) : port_(port), max_clients_(max_clients) {}
+    ~WiFiServer() { end(); }
+
+    void begin(uint16_t port = 0);
+    void end();
+    void close() { end(); }
+    void stop() { end(); }
+    // The next pending connection without waiting, an empty client if none.
+    WiFiClient available();
+    WiFiClient accept() { return available(); }
+    bool hasClient();
+    void setNoDelay(bool nodelay) { nodelay_ = nodelay; }
+    bool getNoDelay() const { return nodelay_; }
+    operator bool() const { return fd_ >= 0; }
+
+private:
+    uint16_t port_;
+    uint8_t max_clients_;
+    int fd_ = -1;
+    bool nodelay_ = false;
+};
+
+#endif
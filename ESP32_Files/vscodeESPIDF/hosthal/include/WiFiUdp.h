@@ -0,0 +1,53 @@
+#ifndef HOSTHAL_WIFIUDP_H
+#define HOSTHAL_WIFIUDP_H
+
+#include <string>
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiUDP : public Stream {
+public:
+    WiFiUDP() = default;
+    ~WiFiUDP() { stop(); }
+    WiFiUDP(const WiFiUDP&) = delete;
+    WiFiUDP& operator=(const WiFiUDP&) = delete;
+
+    uint8_t begin(uint16_t port);
+    uint8_t begin(IPAddress address, uint16_t port) { (void)address; return begin(port); }
+    void stop();
+
+    int beginPacket();
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacket(const char* host, uint16_t port);
+    int endPacket();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int parsePacket();
+    int available() override;
+    int read() override;
+    int read(unsigned char* buffer, size_t len);
+    int read(char* buffer, size_t len) { return read(reinterpret_cast<unsigned char*>(buffer), len); }
+    int peek() override;
+    void flush() override;
+
+    IPAddress remoteIP() const { return remote_ip_; }
+    uint16_t remotePort() const { return remote_port_; }
+
+private:
+    bool Open();
+
+    int fd_ = -1;
+    uint16_t port_ = 0;
+    IPAddress tx_ip_;
+    uint16_t tx_port_ = 0;
+    std::string tx_;
+    std::string rx_;
+    size_t rx_pos_ = 0;
+    IPAddress remote_ip_;
+    uint16_t remote_port_ = 0;
+};
+
+#endif
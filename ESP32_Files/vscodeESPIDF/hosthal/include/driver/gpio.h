@@ -0,0 +1,9 @@
+#ifndef HOSTHAL_DRIVER_GPIO_H
+#define HOSTHAL_DRIVER_GPIO_H
+
+// Pins are driven through the Arduino calls in Arduino.h.
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+#endif
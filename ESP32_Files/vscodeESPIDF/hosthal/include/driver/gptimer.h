@@ -0,0 +1,36 @@
+#ifndef HOSTHAL_DRIVER_GPTIMER_H
+#define HOSTHAL_DRIVER_GPTIMER_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// IDF 5 general purpose timer counting HAL clock microseconds. Read from a
+// pin interrupt it sees the time of the edge, not of the read.
+typedef struct HalGptimer* gptimer_handle_t;
+
+typedef enum { GPTIMER_CLK_SRC_DEFAULT = 0, GPTIMER_CLK_SRC_APB = 0, GPTIMER_CLK_SRC_XTAL = 1 } gptimer_clock_source_t;
+typedef enum { GPTIMER_COUNT_DOWN, GPTIMER_COUNT_UP } gptimer_count_direction_t;
+
+typedef struct {
+    gptimer_clock_source_t clk_src;
+    gptimer_count_direction_t direction;
+    uint32_t resolution_hz;
+    int intr_priority;
+    struct {
+        uint32_t intr_shared : 1;
+        uint32_t allow_pd : 1;
+        uint32_t backup_before_sleep : 1;
+    } flags;
+} gptimer_config_t;
+
+esp_err_t gptimer_new_timer(const gptimer_config_t* config, gptimer_handle_t* timer);
+esp_err_t gptimer_del_timer(gptimer_handle_t timer);
+esp_err_t gptimer_enable(gptimer_handle_t timer);
+esp_err_t gptimer_disable(gptimer_handle_t timer);
+esp_err_t gptimer_start(gptimer_handle_t timer);
+esp_err_t gptimer_stop(gptimer_handle_t timer);
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value);
+esp_err_t gptimer_get_raw_count(gptimer_handle_t timer, uint64_t* value);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef HOSTHAL_ESP_RANDOM_H
+#define HOSTHAL_ESP_RANDOM_H
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif
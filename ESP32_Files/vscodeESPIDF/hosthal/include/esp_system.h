@@ -0,0 +1,13 @@
+#ifndef HOSTHAL_ESP_SYSTEM_H
+#define HOSTHAL_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Starts the program again with the same arguments, like a reboot keeps
+// flash and NVS.
+void esp_restart(void) __attribute__((noreturn));
+uint32_t esp_get_free_heap_size(void);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef HOSTHAL_ESP_TIMER_H
+#define HOSTHAL_ESP_TIMER_H
+
+#include <stdint.h>
+
+// HAL clock microseconds since start, like micros() without the wrap.
+int64_t esp_timer_get_time(void);
+
+#endif
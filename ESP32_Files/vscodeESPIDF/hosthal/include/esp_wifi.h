@@ -0,0 +1,7 @@
+#ifndef HOSTHAL_ESP_WIFI_H
+#define HOSTHAL_ESP_WIFI_H
+
+// The firmwares only go through WiFi.h, see there.
+#include "esp_err.h"
+
+#endif
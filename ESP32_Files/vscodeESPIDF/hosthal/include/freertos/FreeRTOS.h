@@ -0,0 +1,42 @@
+#ifndef HOSTHAL_FREERTOS_H
+#define HOSTHAL_FREERTOS_H
+
+#include <stdint.h>
+
+// Tasks are threads and ticks are HAL clock milliseconds, the rate
+// Arduino-ESP32 configures.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+// A host thread is never preempted by an interrupt handler, nothing to
+// yield to.
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+// One core. Every thread is on it, so masking its interrupts is a process
+// wide lock, which keeps per-core data as safe as on the chip. Nests like
+// the real thing.
+#define portNUM_PROCESSORS 1
+UBaseType_t xPortSetInterruptMaskFromISR(void);
+void vPortClearInterruptMaskFromISR(UBaseType_t state);
+BaseType_t xPortGetCoreID(void);
+// True on the thread running a pin interrupt handler.
+BaseType_t xPortInIsrContext(void);
+#define portSET_INTERRUPT_MASK_FROM_ISR() xPortSetInterruptMaskFromISR()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(state) vPortClearInterruptMaskFromISR(state)
+// Spinlocks take the same process wide lock.
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux), (void)xPortSetInterruptMaskFromISR())
+#define portEXIT_CRITICAL(mux) ((void)(mux), vPortClearInterruptMaskFromISR(0))
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef HOSTHAL_FREERTOS_TASK_H
+#define HOSTHAL_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct HalTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define tskIDLE_PRIORITY 0
+
+// Stack depth and priority are accepted and ignored.
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+// Null on the thread running setup() and loop(), named "loopTask" as in
+// Arduino-ESP32.
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char* pcTaskGetName(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+// Host threads have no watermarked stack, this is always 0.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HOSTHAL_LWIP_SOCKETS_H
+#define HOSTHAL_LWIP_SOCKETS_H
+
+// lwIP's BSD socket API is the host's.
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOSTHAL_MBEDTLS_SHA1_H
+#define HOSTHAL_MBEDTLS_SHA1_H
+
+#include <stddef.h>
+
+// One shot SHA-1 under both the mbedTLS 2 (IDF 4) and 3 (IDF 5) names.
+int mbedtls_sha1(const unsigned char* input, size_t len, unsigned char output[20]);
+int mbedtls_sha1_ret(const unsigned char* input, size_t len, unsigned char output[20]);
+
+#endif
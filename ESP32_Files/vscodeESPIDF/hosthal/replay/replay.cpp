@@ -0,0 +1,278 @@
+#include "replay.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "trace.h"
+
+namespace {
+
+uint32_t Get16(const std::string& bytes, size_t at) {
+    return static_cast<uint8_t>(bytes[at]) | static_cast<uint8_t>(bytes[at + 1]) << 8;
+}
+
+uint32_t Get32(const std::string& bytes, size_t at) {
+    return Get16(bytes, at) | Get16(bytes, at + 2) << 16;
+}
+
+void Put16(std::string* out, uint32_t value) {
+    out->push_back(static_cast<char>(value & 0xff));
+    out->push_back(static_cast<char>((value >> 8) & 0xff));
+}
+
+bool ReadFile(const std::string& path, std::string* bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream out;
+    out << in.rdbuf();
+    *bytes = out.str();
+    return true;
+}
+
+bool EndsWith(const std::string& text, const std::string& tail) {
+    return text.size() >= tail.size() && text.compare(text.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+bool LoadTrace(const std::string& path, std::vector<Trace>* corpus, std::string* error) {
+    Trace trace;
+    trace.name = path;
+    std::string bytes;
+    if (!ReadFile(path, &bytes)) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    if (!ParseTrace(bytes, &trace.samples, error)) {
+        *error = path + ": " + *error;
+        return false;
+    }
+    std::string labels = path.substr(0, path.size() - 6) + ".labels";
+    std::string text;
+    if (EndsWith(path, ".trace") && ReadFile(labels, &text) && !ParseLabels(text, &trace.labels, error)) {
+        *error = labels + ": " + *error;
+        return false;
+    }
+    corpus->push_back(std::move(trace));
+    return true;
+}
+
+// Nearest rank, of sorted values.
+double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t k = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(k, 1)) - 1];
+}
+
+}  // namespace
+
+bool ParseTrace(const std::string& bytes, std::vector<Sample>* samples, std::string* error) {
+    if (bytes.size() < TRACE_HEADER_SIZE || bytes.compare(0, 4, TRACE_MAGIC) != 0) {
+        *error = "not a sensor trace";
+        return false;
+    }
+    if (static_cast<uint8_t>(bytes[4]) != TRACE_VERSION) {
+        *error = "trace version " + std::to_string(static_cast<uint8_t>(bytes[4])) + ", this reads " +
+                 std::to_string(TRACE_VERSION);
+        return false;
+    }
+    uint32_t count = Get32(bytes, 8);
+    if (bytes.size() != TRACE_HEADER_SIZE + static_cast<size_t>(count) * TRACE_RECORD_SIZE) {
+        *error = "header says " + std::to_string(count) + " readings, the file is " + std::to_string(bytes.size()) +
+                 " bytes";
+        return false;
+    }
+    samples->clear();
+    samples->reserve(count);
+    uint32_t t = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t at = TRACE_HEADER_SIZE + i * TRACE_RECORD_SIZE;
+        uint32_t dt = Get16(bytes, at);
+        // The first reading's gap is to one that is no longer in the ring.
+        if (i > 0) t += dt & TRACE_MAX_DT;
+        samples->push_back({t, static_cast<uint16_t>(Get16(bytes, at + 2)), (dt & TRACE_ARMED) != 0});
+    }
+    return true;
+}
+
+std::string EncodeTrace(const std::vector<Sample>& samples) {
+    std::string out = TRACE_MAGIC;
+    out.push_back(static_cast<char>(TRACE_VERSION));
+    out.push_back(0);
+    Put16(&out, 0);
+    Put16(&out, samples.size() & 0xffff);
+    Put16(&out, samples.size() >> 16);
+    uint32_t last = 0;
+    for (const Sample& sample : samples) {
+        uint32_t dt = std::min<uint32_t>(sample.t_ms - last, TRACE_MAX_DT);
+        last = sample.t_ms;
+        Put16(&out, dt | (sample.armed ? TRACE_ARMED : 0));
+        Put16(&out, sample.echo_us);
+    }
+    return out;
+}
+
+bool ParseLabels(const std::string& text, std::vector<Interval>* labels, std::string* error) {
+    std::istringstream in(text);
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        std::istringstream fields(line);
+        long start, end;
+        std::string rest;
+        if (!(fields >> start >> end) || (fields >> rest) || start < 0 || end < start) {
+            *error = "line " + std::to_string(number) + ": expected start_ms end_ms";
+            return false;
+        }
+        labels->push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(end)});
+    }
+    std::sort(labels->begin(), labels->end(),
+              [](const Interval& a, const Interval& b) { return a.start_ms < b.start_ms; });
+    return true;
+}
+
+bool LoadCorpus(const std::vector<std::string>& paths, std::vector<Trace>* corpus, std::string* error) {
+    for (const std::string& path : paths) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            *error = "no such file " + path;
+            return false;
+        }
+        if (!S_ISDIR(info.st_mode)) {
+            if (!LoadTrace(path, corpus, error)) return false;
+            continue;
+        }
+        DIR* dir = opendir(path.c_str());
+        if (!dir) {
+            *error = "cannot read " + path;
+            return false;
+        }
+        std::vector<std::string> names;
+        while (dirent* entry = readdir(dir)) {
+            if (EndsWith(entry->d_name, ".trace")) names.push_back(path + "/" + entry->d_name);
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (const std::string& name : names) {
+            if (!LoadTrace(name, corpus, error)) return false;
+        }
+    }
+    if (corpus->empty()) {
+        *error = "no traces";
+        return false;
+    }
+    return true;
+}
+
+Score Replay(const std::vector<Trace>& corpus, const detectparams& params, const ReplayOptions& options) {
+    Score score;
+    score.params = params;
+    std::vector<double> delays;
+    double total_ms = 0;
+    for (const Trace& trace : corpus) {
+        if (trace.samples.empty()) continue;
+        uint32_t end_ms = trace.samples.back().t_ms;
+        total_ms += end_ms;
+        size_t windows = end_ms / options.window_ms + 1;
+        std::vector<bool> labeled(windows, false), fired(windows, false);
+        for (const Interval& label : trace.labels) {
+            for (size_t w = label.start_ms / options.window_ms; w <= label.end_ms / options.window_ms && w < windows;
+                 w++) {
+                labeled[w] = true;
+            }
+        }
+        std::vector<long> first(trace.labels.size(), -1);   // first detection of each event
+        long last_false = -1;
+
+        detectstate state;
+        detectreset(&state);
+        for (const Sample& sample : trace.samples) {
+            if (options.armed_only && !sample.armed) {
+                // The sensor keeps its last reading while disarmed, only
+                // the detection is skipped.
+                detectstep(&params, &state, detectcm(sample.echo_us));
+                continue;
+            }
+            if (!detectstep(&params, &state, detectcm(sample.echo_us))) continue;
+            fired[sample.t_ms / options.window_ms] = true;
+            bool inside = false;
+            for (size_t i = 0; i < trace.labels.size(); i++) {
+                const Interval& label = trace.labels[i];
+                if (sample.t_ms < label.start_ms || sample.t_ms > label.end_ms + options.grace_ms) continue;
+                inside = true;
+                if (first[i] < 0) first[i] = sample.t_ms;
+            }
+            if (!inside) {
+                if (last_false < 0 || sample.t_ms - last_false > options.merge_ms) score.false_alarms++;
+                last_false = sample.t_ms;
+            }
+        }
+        for (size_t i = 0; i < trace.labels.size(); i++) {
+            score.events++;
+            if (first[i] < 0) continue;
+            score.detected++;
+            delays.push_back(static_cast<double>(first[i] - trace.labels[i].start_ms));
+        }
+        for (size_t w = 0; w < windows; w++) {
+            if (labeled[w]) {
+                fired[w] ? score.tp++ : score.fn++;
+            } else {
+                fired[w] ? score.fp++ : score.tn++;
+            }
+        }
+    }
+    std::sort(delays.begin(), delays.end());
+    score.delay_p50_ms = Percentile(delays, 0.5);
+    score.delay_p95_ms = Percentile(delays, 0.95);
+    score.delay_max_ms = delays.empty() ? 0 : delays.back();
+    score.hours = total_ms / 3600000.0;
+    return score;
+}
+
+std::vector<Score> Sweep(const std::vector<Trace>& corpus, const std::vector<detectparams>& grid,
+                         const ReplayOptions& options, int jobs) {
+    std::vector<Score> scores(grid.size());
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i; (i = next++) < grid.size();) scores[i] = Replay(corpus, grid[i], options);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min<int>(jobs, static_cast<int>(grid.size())); i++) threads.emplace_back(work);
+    work();
+    for (std::thread& thread : threads) thread.join();
+    return scores;
+}
+
+std::vector<RocCurve> RocCurves(const std::vector<Score>& scores) {
+    std::map<std::pair<int, float>, RocCurve> curves;
+    for (const Score& score : scores) {
+        RocCurve& curve = curves[{score.params.confirm, score.params.maxcm}];
+        curve.confirm = score.params.confirm;
+        curve.maxcm = score.params.maxcm;
+        curve.points.push_back(&score);
+    }
+    std::vector<RocCurve> out;
+    for (auto& entry : curves) {
+        RocCurve& curve = entry.second;
+        std::sort(curve.points.begin(), curve.points.end(),
+                  [](const Score* a, const Score* b) { return a->params.dropcm < b->params.dropcm; });
+        // Trapezoids from (0,0) to (1,1) through the points by FPR.
+        std::vector<std::pair<double, double>> roc = {{0, 0}, {1, 1}};
+        for (const Score* score : curve.points) roc.emplace_back(score->Fpr(), score->Tpr());
+        std::sort(roc.begin(), roc.end());
+        curve.auc = 0;
+        for (size_t i = 1; i < roc.size(); i++) {
+            curve.auc += (roc[i].first - roc[i - 1].first) * (roc[i].second + roc[i - 1].second) / 2;
+        }
+        out.push_back(std::move(curve));
+    }
+    return out;
+}
@@ -0,0 +1,79 @@
+#ifndef HOSTHAL_REPLAY_HPP
+#define HOSTHAL_REPLAY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "detect.h"
+
+// Sonar traces the sensor recorded (GET /api/trace, format in the sensor's
+// trace.h) run through its detect.cpp, scored against hand labels.
+
+struct Sample {
+    uint32_t t_ms;          // from the first reading of the trace
+    uint16_t echo_us;
+    bool armed;
+};
+
+// Someone was in front of the sensor from start_ms to end_ms.
+struct Interval {
+    uint32_t start_ms;
+    uint32_t end_ms;
+};
+
+struct Trace {
+    std::string name;
+    std::vector<Sample> samples;
+    std::vector<Interval> labels;
+};
+
+bool ParseTrace(const std::string& bytes, std::vector<Sample>* samples, std::string* error);
+std::string EncodeTrace(const std::vector<Sample>& samples);
+// "start_ms end_ms" a line, # starts a comment.
+bool ParseLabels(const std::string& text, std::vector<Interval>* labels, std::string* error);
+// A .trace file with the .labels file next to it, when there is one, or
+// every .trace file in a directory.
+bool LoadCorpus(const std::vector<std::string>& paths, std::vector<Trace>* corpus, std::string* error);
+
+struct ReplayOptions {
+    uint32_t grace_ms = 1000;     // a detection this long after an event still finds it
+    uint32_t merge_ms = 1000;     // false detections closer than this are one false alarm
+    uint32_t window_ms = 1000;    // for the ROC, time is cut into windows this long
+    bool armed_only = false;      // skip readings taken with the detector off, as the sensor does
+};
+
+struct Score {
+    detectparams params;
+    int events = 0;
+    int detected = 0;
+    double delay_p50_ms = 0;
+    double delay_p95_ms = 0;
+    double delay_max_ms = 0;
+    int false_alarms = 0;
+    double hours = 0;
+    // Windows: labeled or not, against detected in or not.
+    long tp = 0, fp = 0, fn = 0, tn = 0;
+
+    double Tpr() const { return tp + fn ? static_cast<double>(tp) / (tp + fn) : 0; }
+    double Fpr() const { return fp + tn ? static_cast<double>(fp) / (fp + tn) : 0; }
+    double FalsePerHour() const { return hours > 0 ? false_alarms / hours : 0; }
+};
+
+Score Replay(const std::vector<Trace>& corpus, const detectparams& params, const ReplayOptions& options);
+// Every parameter set over the whole corpus, on jobs threads. The scores
+// come back in the order of grid.
+std::vector<Score> Sweep(const std::vector<Trace>& corpus, const std::vector<detectparams>& grid,
+                         const ReplayOptions& options, int jobs);
+
+struct RocCurve {
+    int confirm;
+    float maxcm;
+    std::vector<const Score*> points;   // by dropcm
+    double auc;
+};
+
+// One curve per confirm/maxcm pair, dropcm moving along it.
+std::vector<RocCurve> RocCurves(const std::vector<Score>& scores);
+
+#endif
@@ -0,0 +1,178 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay.hpp"
+
+namespace {
+
+const char* kUsage =
+    "usage: tracereplay [options] TRACE|DIR...\n"
+    "  --drop LIST        dropcm values, 10 by default\n"
+    "  --confirm LIST     readings in a row, 1 by default\n"
+    "  --maxcm LIST       farthest reading to use, 0 (all) by default\n"
+    "  --grace MS         a detection this long after an event still finds it, 1000\n"
+    "  --merge MS         false detections closer than this are one alarm, 1000\n"
+    "  --window MS        ROC window, 1000\n"
+    "  --armed-only       detect only where the trace says the sensor was armed\n"
+    "  --jobs N           threads, one per core by default\n"
+    "  --csv FILE         every parameter set as a CSV row\n"
+    "LIST is comma separated values or FROM:TO:STEP ranges, e.g. 4:20:2,25\n";
+
+bool ParseList(const std::string& text, std::vector<double>* values) {
+    values->clear();
+    size_t at = 0;
+    while (at <= text.size()) {
+        size_t end = text.find(',', at);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(at, end - at);
+        double from, to, step;
+        char extra;
+        if (std::sscanf(item.c_str(), "%lf:%lf:%lf%c", &from, &to, &step, &extra) == 3) {
+            if (step <= 0 || to < from) return false;
+            // A little slack, or 0.1 steps stop short of to.
+            for (double v = from; v <= to + step * 1e-6; v += step) values->push_back(v);
+        } else if (std::sscanf(item.c_str(), "%lf%c", &from, &extra) == 1) {
+            values->push_back(from);
+        } else {
+            return false;
+        }
+        at = end + 1;
+    }
+    return !values->empty();
+}
+
+bool ParseMs(const char* text, uint32_t* value) {
+    char* end = nullptr;
+    long ms = std::strtol(text, &end, 10);
+    if (end == text || *end || ms <= 0) return false;
+    *value = static_cast<uint32_t>(ms);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<double> drops = {detectdefaults.dropcm};
+    std::vector<double> confirms = {static_cast<double>(detectdefaults.confirm)};
+    std::vector<double> maxcms = {detectdefaults.maxcm};
+    ReplayOptions options;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    std::string csv;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::fputs(kUsage, stdout);
+            return 0;
+        }
+        if (arg == "--armed-only") {
+            options.armed_only = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "%s needs a value\n%s", arg.c_str(), kUsage);
+            return 2;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (arg == "--drop") {
+            ok = ParseList(value, &drops);
+        } else if (arg == "--confirm") {
+            ok = ParseList(value, &confirms);
+            for (double confirm : confirms) ok = ok && confirm >= 1;
+        } else if (arg == "--maxcm") {
+            ok = ParseList(value, &maxcms);
+        } else if (arg == "--grace") {
+            ok = ParseMs(value, &options.grace_ms);
+        } else if (arg == "--merge") {
+            ok = ParseMs(value, &options.merge_ms);
+        } else if (arg == "--window") {
+            ok = ParseMs(value, &options.window_ms);
+        } else if (arg == "--jobs") {
+            jobs = std::atoi(value);
+            ok = jobs > 0;
+        } else if (arg == "--csv") {
+            csv = value;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n%s", arg.c_str(), kUsage);
+            return 2;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "%s: bad value %s\n%s", arg.c_str(), value, kUsage);
+            return 2;
+        }
+    }
+    if (paths.empty()) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+    if (jobs < 1) jobs = 1;
+
+    std::vector<Trace> corpus;
+    std::string error;
+    if (!LoadCorpus(paths, &corpus, &error)) {
+        std::fprintf(stderr, "tracereplay: %s\n", error.c_str());
+        return 2;
+    }
+    std::vector<detectparams> grid;
+    for (double confirm : confirms) {
+        for (double maxcm : maxcms) {
+            for (double drop : drops) {
+                grid.push_back({static_cast<float>(drop), static_cast<int>(confirm), static_cast<float>(maxcm)});
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Score> scores = Sweep(corpus, grid, options, jobs);
+    double took_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t readings = 0;
+    for (const Trace& trace : corpus) readings += trace.samples.size();
+    double hours = scores.empty() ? 0 : scores[0].hours;
+    std::printf("%zu traces, %zu readings, %.2f h, %d events; %zu parameter sets in %.3f s on %d threads "
+                "(%.0fx real time)\n\n",
+                corpus.size(), readings, hours, scores.empty() ? 0 : scores[0].events, grid.size(), took_s,
+                jobs, took_s > 0 ? hours * 3600 * grid.size() / took_s : 0.0);
+
+    std::printf("%7s %7s %7s %10s %10s %10s %9s %7s %7s\n", "drop", "confirm", "maxcm", "detected", "delay p50",
+                "delay p95", "false/h", "tpr", "fpr");
+    for (const Score& score : scores) {
+        std::printf("%7.1f %7d %7.0f %5d/%-4d %8.0fms %8.0fms %9.2f %7.3f %7.3f\n", score.params.dropcm,
+                    score.params.confirm, score.params.maxcm, score.detected, score.events, score.delay_p50_ms,
+                    score.delay_p95_ms, score.FalsePerHour(), score.Tpr(), score.Fpr());
+    }
+    std::printf("\n");
+    for (const RocCurve& curve : RocCurves(scores)) {
+        std::printf("roc confirm %d maxcm %.0f: auc %.3f\n", curve.confirm, curve.maxcm, curve.auc);
+        for (const Score* score : curve.points) {
+            std::printf("  drop %6.1f  fpr %.4f  tpr %.4f\n", score->params.dropcm, score->Fpr(), score->Tpr());
+        }
+    }
+
+    if (!csv.empty()) {
+        std::ofstream out(csv);
+        out << "drop,confirm,maxcm,events,detected,delay_p50_ms,delay_p95_ms,delay_max_ms,false_alarms,"
+               "false_per_hour,tp,fp,fn,tn,tpr,fpr\n";
+        for (const Score& score : scores) {
+            out << score.params.dropcm << "," << score.params.confirm << "," << score.params.maxcm << ","
+                << score.events << "," << score.detected << "," << score.delay_p50_ms << "," << score.delay_p95_ms
+                << "," << score.delay_max_ms << "," << score.false_alarms << "," << score.FalsePerHour() << ","
+                << score.tp << "," << score.fp << "," << score.fn << "," << score.tn << "," << score.Tpr() << ","
+                << score.Fpr() << "\n";
+        }
+        if (!out) {
+            std::fprintf(stderr, "tracereplay: cannot write %s\n", csv.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+
+#include "esp_random.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+
+namespace {
+
+uint32_t Rotate(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+// FIPS 180-4 on one 64 byte block.
+void Sha1Block(uint32_t h[5], const unsigned char* block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = static_cast<uint32_t>(block[4 * i]) << 24 | static_cast<uint32_t>(block[4 * i + 1]) << 16 |
+               static_cast<uint32_t>(block[4 * i + 2]) << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = Rotate(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = Rotate(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+}  // namespace
+
+int mbedtls_sha1(const unsigned char* input, size_t len, unsigned char output[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t full = len / 64 * 64;
+    for (size_t at = 0; at < full; at += 64) Sha1Block(h, input + at);
+    unsigned char tail[128] = {};
+    size_t rest = len - full;
+    memcpy(tail, input + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (int i = 0; i < 8; i++) tail[tail_len - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    for (size_t at = 0; at < tail_len; at += 64) Sha1Block(h, tail + at);
+    for (int i = 0; i < 20; i++) output[i] = static_cast<unsigned char>(h[i / 4] >> (24 - 8 * (i % 4)));
+    return 0;
+}
+
+int mbedtls_sha1_ret(const unsigned char* input, size_t len, unsigned char output[20]) {
+    return mbedtls_sha1(input, len, output);
+}
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = (slen + 2) / 3 * 4 + 1;
+    if (!dst || dlen < need) {
+        *olen = need;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    unsigned char* out = dst;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t v = static_cast<uint32_t>(src[i]) << 16;
+        if (i + 1 < slen) v |= static_cast<uint32_t>(src[i + 1]) << 8;
+        if (i + 2 < slen) v |= src[i + 2];
+        *out++ = kAlphabet[(v >> 18) & 63];
+        *out++ = kAlphabet[(v >> 12) & 63];
+        *out++ = i + 1 < slen ? kAlphabet[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < slen ? kAlphabet[v & 63] : '=';
+    }
+    *out = 0;
+    *olen = static_cast<size_t>(out - dst);
+    return 0;
+}
+
+uint32_t esp_random(void) {
+    static std::mutex mutex;
+    static std::random_device device;
+    std::lock_guard<std::mutex> lock(mutex);
+    return device();
+}
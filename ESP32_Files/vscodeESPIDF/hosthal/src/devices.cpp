@@ -0,0 +1,63 @@
+#include "ESP32Servo.h"
+#include "TFT_eSPI.h"
+#include "hal.hpp"
+
+void TFT_eSPI::setRotation(uint8_t rotation) {
+    rotation_ = rotation & 3;
+}
+
+size_t TFT_eSPI::write(uint8_t c) {
+    // Font 1 is 6x8 pixels, the numbered fonts are about twice that.
+    int16_t height = (font_ == 1 ? 8 : 16) * text_size_;
+    if (c == '\n') {
+        cursor_x_ = 0;
+        cursor_y_ += height;
+    } else if (c != '\r') {
+        cursor_x_ += (font_ == 1 ? 6 : 8) * text_size_;
+    }
+    return 1;
+}
+
+uint8_t TFT_eSPI::getTouch(uint16_t* x, uint16_t* y, uint16_t threshold) {
+    (void)threshold;
+    uint16_t tx, ty;
+    if (!hal::Touch(&tx, &ty)) return 0;
+    *x = tx;
+    *y = ty;
+    return 1;
+}
+
+void TFT_eSPI::calibrateTouch(uint16_t* data, uint32_t color_fg, uint32_t color_bg, uint8_t size) {
+    (void)color_fg;
+    (void)color_bg;
+    (void)size;
+    // Raw ADC corners of a typical XPT2046 panel, no rotation flags.
+    static const uint16_t kCalibration[5] = {300, 3600, 300, 3600, 0};
+    for (int i = 0; i < 5; i++) data[i] = kCalibration[i];
+}
+
+int Servo::attach(int pin, int min_us, int max_us) {
+    pin_ = pin;
+    min_us_ = min_us;
+    max_us_ = max_us;
+    return pin;
+}
+
+void Servo::write(int value) {
+    // Below 200 is an angle, as in the Arduino library.
+    if (value < 200) {
+        value = std::max(0, std::min(180, value));
+        value = min_us_ + (max_us_ - min_us_) * value / 180;
+    }
+    writeMicroseconds(value);
+}
+
+void Servo::writeMicroseconds(int us) {
+    if (!attached()) return;
+    us_ = std::max(min_us_, std::min(max_us_, us));
+}
+
+int Servo::read() const {
+    if (max_us_ == min_us_) return 0;
+    return (us_ - min_us_) * 180 / (max_us_ - min_us_);
+}
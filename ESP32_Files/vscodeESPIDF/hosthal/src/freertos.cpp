@@ -0,0 +1,298 @@
+#include <pthread.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "driver/gptimer.h"
+#include "freertos/event_groups.h"
+#include "hal.hpp"
+
+struct HalTask {
+    std::string name;
+    uint32_t stack_depth;
+};
+
+// CONFIG_ARDUINO_LOOP_STACK_SIZE, setup() and loop() run on the main thread.
+constexpr uint32_t kLoopStack = 8192;
+
+struct HalQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+};
+
+struct HalEventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+struct HalGptimer {
+    std::mutex mutex;
+    uint32_t resolution_hz;
+    bool up;
+    bool enabled = false;
+    bool running = false;
+    uint64_t count = 0;          // at started_us while running
+    uint64_t started_us = 0;
+};
+
+namespace {
+
+// False once the wait ran out. The queue lock is held on return.
+bool Wait(HalQueue* queue, std::unique_lock<std::mutex>& lock, TickType_t ticks, bool for_space) {
+    auto ready = [&] { return for_space ? queue->items.size() < queue->length : !queue->items.empty(); };
+    if (ticks == portMAX_DELAY) {
+        queue->changed.wait(lock, ready);
+        return true;
+    }
+    auto real = std::chrono::microseconds(hal::RealUs(static_cast<uint64_t>(ticks) * 1000));
+    return queue->changed.wait_for(lock, real, ready);
+}
+
+uint64_t Count(const HalGptimer* timer) {
+    if (!timer->running) return timer->count;
+    uint64_t ticks = (hal::NowUs() - timer->started_us) * timer->resolution_hz / 1000000;
+    return timer->up ? timer->count + ticks : timer->count - ticks;
+}
+
+std::recursive_mutex& InterruptMask() {
+    static std::recursive_mutex mask;
+    return mask;
+}
+
+thread_local HalTask* current_task = nullptr;
+
+}  // namespace
+
+UBaseType_t xPortSetInterruptMaskFromISR(void) {
+    InterruptMask().lock();
+    return 0;
+}
+
+void vPortClearInterruptMaskFromISR(UBaseType_t state) {
+    (void)state;
+    InterruptMask().unlock();
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return 0;
+}
+
+BaseType_t xPortInIsrContext(void) {
+    return hal::InIsr() ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle) {
+    (void)priority;
+    HalTask* task = new HalTask{name ? name : "", stack_depth};
+    std::thread([fn, arg, task] {
+        current_task = task;
+        fn(arg);
+    }).detach();
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(fn, name, stack_depth, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Only a task ending itself is supported, a thread cannot be stopped
+    // from the outside.
+    if (task) {
+        hal::Log("vTaskDelete of another task is not supported", true);
+        return;
+    }
+    // Gone as on the chip, so whatever kept the handle or the name reads
+    // freed memory here too.
+    delete current_task;
+    current_task = nullptr;
+    pthread_exit(nullptr);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return current_task;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    if (!task) task = current_task;
+    return task ? task->name.c_str() : "loopTask";
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period) {
+    TickType_t wake = *previous_wake + period;
+    TickType_t now = xTaskGetTickCount();
+    if (static_cast<int32_t>(wake - now) > 0) delay(wake - now);
+    *previous_wake = wake;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return static_cast<TickType_t>(millis());
+}
+
+// Host threads have stacks of their own size and nothing measures what a
+// task used, so it is the depth the task was given: never low.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (!task) task = current_task;
+    return task ? task->stack_depth : kLoopStack;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    HalQueue* queue = new HalQueue;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!Wait(queue, lock, wait, true)) return pdFAIL;
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!Wait(queue, lock, wait, false)) return pdFAIL;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return static_cast<UBaseType_t>(queue->items.size());
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return new HalEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [&] { return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0; };
+    bool met;
+    if (wait == portMAX_DELAY) {
+        group->changed.wait(lock, ready);
+        met = true;
+    } else {
+        auto real = std::chrono::microseconds(hal::RealUs(static_cast<uint64_t>(wait) * 1000));
+        met = group->changed.wait_for(lock, real, ready);
+    }
+    EventBits_t seen = group->bits;
+    if (met && clear_on_exit) group->bits &= ~bits;
+    return seen;
+}
+
+esp_err_t gptimer_new_timer(const gptimer_config_t* config, gptimer_handle_t* timer) {
+    if (!config || !timer || config->resolution_hz == 0) return ESP_ERR_INVALID_ARG;
+    HalGptimer* t = new HalGptimer;
+    t->resolution_hz = config->resolution_hz;
+    t->up = config->direction == GPTIMER_COUNT_UP;
+    *timer = t;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->enabled) return ESP_ERR_INVALID_STATE;
+    delete timer;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->enabled) return ESP_ERR_INVALID_STATE;
+    timer->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->enabled || timer->running) return ESP_ERR_INVALID_STATE;
+    timer->enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->enabled || timer->running) return ESP_ERR_INVALID_STATE;
+    timer->started_us = hal::NowUs();
+    timer->running = true;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->running) return ESP_ERR_INVALID_STATE;
+    timer->count = Count(timer);
+    timer->running = false;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->count = value;
+    timer->started_us = hal::NowUs();
+    return ESP_OK;
+}
+
+esp_err_t gptimer_get_raw_count(gptimer_handle_t timer, uint64_t* value) {
+    if (!timer || !value) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    *value = Count(timer);
+    return ESP_OK;
+}
@@ -0,0 +1,292 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "LittleFS.h"
+#include "Preferences.h"
+#include "hal.hpp"
+
+namespace {
+
+// NVS caps namespace and key names at 15 characters.
+constexpr size_t kMaxNvsName = 15;
+
+bool IsFile(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool IsDir(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+}  // namespace
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+File::File(FILE* file, const std::string& path) : file_(file, fclose), path_(path) {}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    return file_ ? fwrite(buffer, 1, size, file_.get()) : 0;
+}
+
+int File::available() {
+    if (!file_) return 0;
+    return static_cast<int>(size() - position());
+}
+
+int File::read() {
+    if (!file_) return -1;
+    int c = fgetc(file_.get());
+    return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return file_ ? fread(buffer, 1, size, file_.get()) : 0;
+}
+
+int File::peek() {
+    if (!file_) return -1;
+    int c = fgetc(file_.get());
+    if (c == EOF) return -1;
+    ungetc(c, file_.get());
+    return c;
+}
+
+void File::flush() {
+    if (file_) fflush(file_.get());
+}
+
+size_t File::readBytes(char* buffer, size_t length) {
+    return read(reinterpret_cast<uint8_t*>(buffer), length);
+}
+
+String File::readString() {
+    String s;
+    char buffer[512];
+    size_t n;
+    while ((n = readBytes(buffer, sizeof(buffer))) > 0) s.concat(buffer, static_cast<unsigned int>(n));
+    return s;
+}
+
+bool File::seek(uint32_t pos) {
+    return file_ && fseek(file_.get(), pos, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+    if (!file_) return 0;
+    long pos = ftell(file_.get());
+    return pos < 0 ? 0 : static_cast<size_t>(pos);
+}
+
+size_t File::size() const {
+    if (!file_) return 0;
+    struct stat st;
+    fflush(file_.get());
+    return fstat(fileno(file_.get()), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+void File::close() {
+    file_.reset();
+}
+
+const char* File::name() const {
+    size_t slash = path_.rfind('/');
+    return path_.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+std::string FS::Root() const {
+    return hal::StatePath(subdir_);
+}
+
+std::string FS::Path(const char* path) const {
+    std::string p = path ? path : "";
+    if (p.empty() || p[0] != '/') p = "/" + p;
+    return Root() + p;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    if (!mounted_ || !path || !mode) return File();
+    std::string full = Path(path);
+    bool writing = mode[0] == 'w' || mode[0] == 'a';
+    if (writing || create) hal::MakeDirs(full.substr(0, full.rfind('/')));
+    if (!writing && !IsFile(full)) return File();
+    std::string host_mode = std::string(mode) + (strchr(mode, 'b') ? "" : "b");
+    FILE* file = fopen(full.c_str(), host_mode.c_str());
+    if (!file) return File();
+    return File(file, path);
+}
+
+bool FS::exists(const char* path) {
+    if (!mounted_ || !path) return false;
+    std::string full = Path(path);
+    return IsFile(full) || IsDir(full);
+}
+
+bool FS::remove(const char* path) {
+    return mounted_ && path && unlink(Path(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return mounted_ && from && to && ::rename(Path(from).c_str(), Path(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return mounted_ && path && hal::MakeDirs(Path(path));
+}
+
+bool LittleFSFS::begin(bool format_on_fail, const char* base_path, uint8_t max_open, const char* label) {
+    (void)format_on_fail;
+    (void)base_path;
+    (void)max_open;
+    (void)label;
+    if (!hal::MakeDirs(Root())) {
+        hal::Log("cannot create " + Root());
+        return false;
+    }
+    mounted_ = true;
+    return true;
+}
+
+bool LittleFSFS::format() {
+    std::string root = Root();
+    DIR* dir = opendir(root.c_str());
+    if (!dir) return false;
+    // Flat is all the firmwares use, subdirectories survive a format.
+    while (dirent* entry = readdir(dir)) {
+        std::string path = root + "/" + entry->d_name;
+        if (IsFile(path)) unlink(path.c_str());
+    }
+    closedir(dir);
+    return true;
+}
+
+void LittleFSFS::end() {
+    mounted_ = false;
+}
+
+}  // namespace fs
+
+bool Preferences::begin(const char* name, bool read_only, const char* partition_label) {
+    (void)partition_label;
+    end();
+    if (!name || !*name || strlen(name) > kMaxNvsName) return false;
+    std::string dir = hal::StatePath("nvs/") + name;
+    // Like NVS, opening read only does not create the namespace.
+    if (read_only ? !IsDir(dir) : !hal::MakeDirs(dir)) return false;
+    dir_ = dir;
+    read_only_ = read_only;
+    started_ = true;
+    return true;
+}
+
+void Preferences::end() {
+    started_ = false;
+    dir_.clear();
+}
+
+bool Preferences::clear() {
+    if (!started_ || read_only_) return false;
+    DIR* dir = opendir(dir_.c_str());
+    if (!dir) return false;
+    while (dirent* entry = readdir(dir)) {
+        std::string path = dir_ + "/" + entry->d_name;
+        if (IsFile(path)) unlink(path.c_str());
+    }
+    closedir(dir);
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    return started_ && !read_only_ && key && unlink((dir_ + "/" + key).c_str()) == 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    return started_ && key && IsFile(dir_ + "/" + key);
+}
+
+bool Preferences::Read(const char* key, std::vector<uint8_t>* value) {
+    if (!started_ || !key) return false;
+    FILE* file = fopen((dir_ + "/" + key).c_str(), "rb");
+    if (!file) return false;
+    value->clear();
+    uint8_t buffer[512];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) value->insert(value->end(), buffer, buffer + n);
+    fclose(file);
+    return true;
+}
+
+size_t Preferences::Write(const char* key, const void* value, size_t len) {
+    if (!started_ || read_only_ || !key || strlen(key) > kMaxNvsName) return 0;
+    // Written aside and renamed, so a kill never leaves half a value.
+    std::string path = dir_ + "/" + key;
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) return 0;
+    bool ok = fwrite(value, 1, len, file) == len;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return 0;
+    }
+    return len;
+}
+
+size_t Preferences::PutNumber(const char* key, uint64_t value, int bytes) {
+    uint8_t raw[8];
+    for (int i = 0; i < bytes; i++) raw[i] = static_cast<uint8_t>(value >> (8 * i));
+    return Write(key, raw, bytes);
+}
+
+uint64_t Preferences::GetNumber(const char* key, uint64_t default_value, int bytes) {
+    std::vector<uint8_t> raw;
+    if (!Read(key, &raw) || raw.size() != static_cast<size_t>(bytes)) return default_value;
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | raw[i];
+    return value;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    return value ? Write(key, value, strlen(value)) : 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    return value ? Write(key, value, len) : 0;
+}
+
+String Preferences::getString(const char* key, const String& default_value) {
+    std::vector<uint8_t> raw;
+    if (!Read(key, &raw)) return default_value;
+    return String(reinterpret_cast<const char*>(raw.data()), raw.size());
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t max_len) {
+    std::vector<uint8_t> raw;
+    if (!value || !Read(key, &raw) || raw.size() + 1 > max_len) return 0;
+    memcpy(value, raw.data(), raw.size());
+    value[raw.size()] = 0;
+    return raw.size() + 1;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    std::vector<uint8_t> raw;
+    return Read(key, &raw) ? raw.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t max_len) {
+    std::vector<uint8_t> raw;
+    if (!buffer || !Read(key, &raw) || raw.size() > max_len) return 0;
+    memcpy(buffer, raw.data(), raw.size());
+    return raw.size();
+}
@@ -0,0 +1,356 @@
+#include <stdio.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "hal.hpp"
+
+namespace {
+
+constexpr int kPins = 64;
+// HC-SR04 timing: the echo goes up about 500 us after the trigger pulse
+// ends and stays up for the round trip at 343 m/s.
+constexpr uint64_t kSonarDelayUs = 500;
+constexpr double kSoundCmPerUs = 0.0343;
+
+struct Pin {
+    uint8_t mode = 0;
+    int out = LOW;
+    int driven = -1;              // level the script drives, -1 for none
+    void (*isr)(void) = nullptr;
+    int isr_mode = 0;
+};
+
+struct Sonar {
+    int echo;
+    int trig;
+    double cm;
+};
+
+struct Key {
+    int out;
+    int in;
+    uint64_t until_us;
+};
+
+typedef std::function<void(uint64_t)> Action;
+
+struct State {
+    std::mutex mutex;
+    std::condition_variable wake;
+    Pin pins[kPins];
+    std::vector<Sonar> sonars;
+    std::vector<Key> keys;
+    uint16_t touch_x = 0;
+    uint16_t touch_y = 0;
+    uint64_t touch_until_us = 0;
+    bool link_up = true;
+    uint64_t link_changed_us = 0;
+    std::multimap<uint64_t, Action> events;
+};
+
+State& S() {
+    static State state;
+    return state;
+}
+
+bool Valid(int pin) {
+    if (pin >= 0 && pin < kPins) return true;
+    hal::Log("no GPIO" + std::to_string(pin), true);
+    return false;
+}
+
+// Lock held. An output reads back what was written, a keypad input is
+// HIGH while its key is down and its row driven, otherwise the script or
+// the pull resistor decides.
+int Level(State& s, int pin, uint64_t now) {
+    const Pin& p = s.pins[pin];
+    if (p.mode == OUTPUT) return p.out;
+    for (const Key& key : s.keys) {
+        if (key.in == pin && now < key.until_us && s.pins[key.out].out == HIGH) return HIGH;
+    }
+    if (p.driven >= 0) return p.driven;
+    return (p.mode & PULLUP) ? HIGH : LOW;
+}
+
+bool Fires(int mode, int before, int after) {
+    switch (mode) {
+    case RISING: return before == LOW && after == HIGH;
+    case FALLING: return before == HIGH && after == LOW;
+    case CHANGE: return before != after;
+    case ONLOW: return after == LOW;
+    case ONHIGH: return after == HIGH;
+    default: return false;
+    }
+}
+
+// Runs now when due, else on the pin thread at the virtual time. Not with
+// the lock held.
+void Schedule(uint64_t at_us, Action action) {
+    State& s = S();
+    uint64_t now = hal::NowUs();
+    if (at_us <= now) {
+        action(now);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.events.emplace(at_us, std::move(action));
+    s.wake.notify_all();
+}
+
+// Changes what drives the pin from outside and runs its interrupt handler,
+// if the edge calls for it, at the edge's time.
+void Drive(int pin, int level, uint64_t at_us) {
+    State& s = S();
+    void (*isr)(void) = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        int before = Level(s, pin, at_us);
+        s.pins[pin].driven = level;
+        int after = Level(s, pin, at_us);
+        if (s.pins[pin].isr && Fires(s.pins[pin].isr_mode, before, after)) isr = s.pins[pin].isr;
+    }
+    if (isr) {
+        hal::IsrScope scope(at_us);
+        isr();
+    }
+}
+
+void EventLoop() {
+    State& s = S();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    for (;;) {
+        if (s.events.empty()) {
+            s.wake.wait(lock);
+            continue;
+        }
+        auto next = s.events.begin();
+        uint64_t now = hal::NowUs();
+        if (next->first > now) {
+            s.wake.wait_for(lock, std::chrono::microseconds(hal::RealUs(next->first - now)));
+            continue;
+        }
+        uint64_t at = next->first;
+        Action action = std::move(next->second);
+        s.events.erase(next);
+        lock.unlock();
+        action(at);
+        lock.lock();
+    }
+}
+
+bool Parse(const std::string& line, std::string* error) {
+    std::istringstream in(line);
+    std::string word;
+    if (!(in >> word) || word[0] == '#') return true;
+    uint64_t at = 0;
+    if (word == "at") {
+        double ms;
+        if (!(in >> ms >> word) || ms < 0) {
+            *error = "expected: at <ms> <command>";
+            return false;
+        }
+        at = static_cast<uint64_t>(ms * 1000);
+    }
+
+    if (word == "sonar") {
+        int echo, trig;
+        double cm;
+        if (!(in >> echo >> trig >> cm) || !Valid(echo) || !Valid(trig)) {
+            *error = "expected: sonar <echo pin> <trig pin> <cm>";
+            return false;
+        }
+        Schedule(at, [=](uint64_t) {
+            State& s = S();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.sonars.push_back({echo, trig, cm});
+            s.pins[echo].driven = LOW;
+        });
+    } else if (word == "distance") {
+        double cm;
+        if (!(in >> cm) || cm < 0) {
+            *error = "expected: distance <cm>";
+            return false;
+        }
+        Schedule(at, [=](uint64_t) {
+            State& s = S();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (Sonar& sonar : s.sonars) sonar.cm = cm;
+        });
+    } else if (word == "pin") {
+        int pin, level;
+        if (!(in >> pin >> level) || !Valid(pin)) {
+            *error = "expected: pin <pin> <0|1>";
+            return false;
+        }
+        Schedule(at, [=](uint64_t now) { Drive(pin, level ? HIGH : LOW, now); });
+    } else if (word == "key") {
+        int out, pin;
+        double ms;
+        if (!(in >> out >> pin >> ms) || !Valid(out) || !Valid(pin)) {
+            *error = "expected: key <row pin> <column pin> <ms>";
+            return false;
+        }
+        Schedule(at, [=](uint64_t now) {
+            State& s = S();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.keys.push_back({out, pin, now + static_cast<uint64_t>(ms * 1000)});
+        });
+    } else if (word == "touch") {
+        int x, y;
+        double ms;
+        if (!(in >> x >> y >> ms)) {
+            *error = "expected: touch <x> <y> <ms>";
+            return false;
+        }
+        Schedule(at, [=](uint64_t now) {
+            State& s = S();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.touch_x = static_cast<uint16_t>(x);
+            s.touch_y = static_cast<uint16_t>(y);
+            s.touch_until_us = now + static_cast<uint64_t>(ms * 1000);
+        });
+    } else if (word == "wifi") {
+        std::string state;
+        if (!(in >> state) || (state != "up" && state != "down")) {
+            *error = "expected: wifi up|down";
+            return false;
+        }
+        bool up = state == "up";
+        Schedule(at, [=](uint64_t now) {
+            State& s = S();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.link_up != up) s.link_changed_us = now;
+            s.link_up = up;
+        });
+    } else {
+        *error = "unknown command " + word;
+        return false;
+    }
+    return true;
+}
+
+void ReadStdin() {
+    char line[256];
+    while (fgets(line, sizeof(line), stdin)) {
+        std::string error;
+        if (!Parse(line, &error)) hal::Log("stdin: " + error);
+    }
+}
+
+}  // namespace
+
+namespace hal {
+
+bool StartScript(std::string* error) {
+    const std::string& path = Settings().script;
+    if (!path.empty()) {
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file) {
+            *error = "cannot read " + path;
+            return false;
+        }
+        char line[256];
+        for (int n = 1; fgets(line, sizeof(line), file); n++) {
+            std::string message;
+            if (!Parse(line, &message)) {
+                *error = path + ":" + std::to_string(n) + ": " + message;
+                fclose(file);
+                return false;
+            }
+        }
+        fclose(file);
+    }
+    std::thread(EventLoop).detach();
+    std::thread(ReadStdin).detach();
+    return true;
+}
+
+bool Touch(uint16_t* x, uint16_t* y) {
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (NowUs() >= s.touch_until_us) return false;
+    *x = s.touch_x;
+    *y = s.touch_y;
+    return true;
+}
+
+bool LinkUp() {
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.link_up;
+}
+
+uint64_t LinkChangedUs() {
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.link_changed_us;
+}
+
+}  // namespace hal
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (!Valid(pin)) return;
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.pins[pin].mode = mode;
+}
+
+int digitalRead(uint8_t pin) {
+    if (!Valid(pin)) return LOW;
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return Level(s, pin, hal::NowUs());
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (!Valid(pin)) return;
+    State& s = S();
+    uint64_t now = hal::NowUs();
+    void (*isr)(void) = nullptr;
+    std::vector<std::pair<int, uint64_t>> echoes;     // echo pin, pulse length
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        int before = Level(s, pin, now);
+        s.pins[pin].out = value ? HIGH : LOW;
+        int after = Level(s, pin, now);
+        if (before == after) return;
+        if (s.pins[pin].isr && Fires(s.pins[pin].isr_mode, before, after)) isr = s.pins[pin].isr;
+        if (after == LOW) {
+            for (const Sonar& sonar : s.sonars) {
+                if (sonar.trig == pin) echoes.emplace_back(sonar.echo, static_cast<uint64_t>(2 * sonar.cm / kSoundCmPerUs));
+            }
+        }
+    }
+    if (isr) {
+        hal::IsrScope scope(now);
+        isr();
+    }
+    for (const auto& echo : echoes) {
+        int pin = echo.first;
+        uint64_t rise = now + kSonarDelayUs;
+        Schedule(rise, [pin](uint64_t at) { Drive(pin, HIGH, at); });
+        Schedule(rise + echo.second, [pin](uint64_t at) { Drive(pin, LOW, at); });
+    }
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+    if (!Valid(pin)) return;
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.pins[pin].isr = isr;
+    s.pins[pin].isr_mode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (!Valid(pin)) return;
+    State& s = S();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.pins[pin].isr = nullptr;
+}
@@ -0,0 +1,410 @@
+#include "hal.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "esp_heap_caps.h"
+
+namespace hal {
+
+namespace {
+
+// 192.168.10.1, the hub's soft-AP address both firmwares hard-code.
+constexpr uint32_t kHubAddress = 0x010AA8C0;
+constexpr uint32_t kFreeHeap = 280 * 1024;
+constexpr uint32_t kHeapSize = 320 * 1024;
+
+size_t heap_baseline = 0;
+std::atomic<uint32_t> heap_min_free{kFreeHeap};
+
+int saved_argc = 0;
+char** saved_argv = nullptr;
+
+std::mutex watched_mutex;
+std::set<int> watched;
+
+thread_local bool in_isr = false;
+thread_local uint64_t isr_us = 0;
+
+std::chrono::steady_clock::time_point Start() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return start;
+}
+
+bool ParseAddress(const char* text, uint32_t* address) {
+    in_addr in;
+    if (inet_pton(AF_INET, text, &in) != 1) return false;
+    *address = in.s_addr;
+    return true;
+}
+
+bool IsLoopback(uint32_t address) {
+    return (ntohl(address) >> 24) == 127;
+}
+
+}  // namespace
+
+void StartHeap() {
+    mallopt(M_ARENA_MAX, 1);
+    heap_baseline = mallinfo2().uordblks;
+}
+
+uint32_t HeapFree() {
+    size_t used = mallinfo2().uordblks;
+    size_t grown = used > heap_baseline ? used - heap_baseline : 0;
+    uint32_t left = grown < kFreeHeap ? kFreeHeap - static_cast<uint32_t>(grown) : 0;
+    uint32_t low = heap_min_free.load();
+    while (left < low && !heap_min_free.compare_exchange_weak(low, left)) {
+    }
+    return left;
+}
+
+uint32_t HeapMinFree() {
+    HeapFree();
+    return heap_min_free.load();
+}
+
+uint32_t HeapLargest() {
+    return HeapFree() / 2;
+}
+
+uint32_t HeapSize() {
+    return kHeapSize;
+}
+
+Config& Settings() {
+    static Config config;
+    return config;
+}
+
+bool ParseArgs(int argc, char** argv, Config* config, std::string* error) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            *error = Usage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            *error = arg + " needs a value";
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--ip" || arg == "--hub") {
+            uint32_t address;
+            if (!ParseAddress(value, &address) || !IsLoopback(address)) {
+                *error = arg + ": " + value + " is not a 127.x.y.z address";
+                return false;
+            }
+            (arg == "--ip" ? config->self : config->hub) = address;
+        } else if (arg == "--map") {
+            std::string pair = value;
+            size_t eq = pair.find('=');
+            uint32_t from, to;
+            if (eq == std::string::npos || !ParseAddress(pair.substr(0, eq).c_str(), &from) ||
+                !ParseAddress(pair.substr(eq + 1).c_str(), &to) || !IsLoopback(to)) {
+                *error = std::string("--map: expected A.B.C.D=127.x.y.z, got ") + value;
+                return false;
+            }
+            config->map.emplace_back(from, to);
+        } else if (arg == "--state") {
+            config->state = value;
+        } else if (arg == "--clock-scale") {
+            char* end = nullptr;
+            config->clock_scale = std::strtod(value, &end);
+            if (*end || config->clock_scale <= 0) {
+                *error = std::string("--clock-scale: bad value ") + value;
+                return false;
+            }
+        } else if (arg == "--script") {
+            config->script = value;
+        } else if (arg == "--run-for") {
+            char* end = nullptr;
+            config->run_for_ms = std::strtol(value, &end, 10);
+            if (*end || config->run_for_ms < 0) {
+                *error = std::string("--run-for: bad value ") + value;
+                return false;
+            }
+        } else {
+            *error = "unknown option " + arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* Usage() {
+    return "options:\n"
+           "  --ip A.B.C.D        the instance's own address, 127.0.0.1 by default\n"
+           "  --hub A.B.C.D       the hub instance, what 192.168.10.1 reaches\n"
+           "  --map X=Y           firmware address X is instance Y, repeatable\n"
+           "  --state DIR         littlefs/, nvs/ and flash/ live here, . by default\n"
+           "  --clock-scale N     run the firmware clock N times faster than real time\n"
+           "  --script FILE       pin script to run before the one on stdin\n"
+           "  --run-for MS        exit after MS firmware milliseconds\n";
+}
+
+void SaveArgs(int argc, char** argv) {
+    saved_argc = argc;
+    saved_argv = argv;
+}
+
+void Restart() {
+    fflush(stdout);
+    fflush(stderr);
+    if (saved_argv) execv("/proc/self/exe", saved_argv);
+    Log(std::string("restart failed: ") + strerror(errno));
+    _exit(1);
+}
+
+uint64_t NowUs() {
+    if (in_isr) return isr_us;
+    auto real = std::chrono::steady_clock::now() - Start();
+    double us = std::chrono::duration<double, std::micro>(real).count();
+    return static_cast<uint64_t>(us * Settings().clock_scale);
+}
+
+uint64_t RealUs(uint64_t us) {
+    return static_cast<uint64_t>(static_cast<double>(us) / Settings().clock_scale);
+}
+
+void SleepUs(uint64_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(RealUs(us)));
+}
+
+void Idle(uint64_t us) {
+    std::vector<pollfd> fds;
+    {
+        std::lock_guard<std::mutex> lock(watched_mutex);
+        for (int fd : watched) fds.push_back({fd, POLLIN, 0});
+    }
+    uint64_t real = RealUs(us);
+    if (fds.empty()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(real));
+        return;
+    }
+    timespec timeout = {static_cast<time_t>(real / 1000000), static_cast<long>(real % 1000000) * 1000};
+    ppoll(fds.data(), fds.size(), &timeout, nullptr);
+}
+
+void WatchFd(int fd) {
+    std::lock_guard<std::mutex> lock(watched_mutex);
+    watched.insert(fd);
+}
+
+void UnwatchFd(int fd) {
+    std::lock_guard<std::mutex> lock(watched_mutex);
+    watched.erase(fd);
+}
+
+bool InIsr() {
+    return in_isr;
+}
+
+IsrScope::IsrScope(uint64_t edge_us) {
+    in_isr = true;
+    isr_us = edge_us;
+}
+
+IsrScope::~IsrScope() {
+    in_isr = false;
+}
+
+bool MapAddress(uint32_t address, uint32_t* host) {
+    const Config& config = Settings();
+    for (const auto& entry : config.map) {
+        if (entry.first == address) {
+            *host = entry.second;
+            return true;
+        }
+    }
+    if (address == kHubAddress) {
+        *host = config.hub;
+        return true;
+    }
+    if (IsLoopback(address)) {
+        *host = address;
+        return true;
+    }
+    return false;
+}
+
+uint32_t UnmapAddress(uint32_t host) {
+    const Config& config = Settings();
+    for (const auto& entry : config.map) {
+        if (entry.second == host) return entry.first;
+    }
+    if (host == config.hub && host != config.self) return kHubAddress;
+    return host;
+}
+
+uint16_t MapPort(uint16_t port) {
+    return port != 0 && port < 1024 ? port + 8000 : port;
+}
+
+std::string AddressString(uint32_t address) {
+    char text[INET_ADDRSTRLEN];
+    in_addr in;
+    in.s_addr = address;
+    return inet_ntop(AF_INET, &in, text, sizeof(text)) ? text : "?";
+}
+
+int OpenSocket(int type, uint16_t port, std::string* error) {
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *error = std::string("socket: ") + strerror(errno);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = Settings().self;
+    addr.sin_port = htons(MapPort(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        *error = "bind " + AddressString(addr.sin_addr.s_addr) + ":" + std::to_string(MapPort(port)) + ": " +
+                 strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string StatePath(const std::string& name) {
+    return Settings().state + "/" + name;
+}
+
+bool MakeDirs(const std::string& path) {
+    for (size_t at = path.find('/', 1); ; at = path.find('/', at + 1)) {
+        std::string dir = path.substr(0, at);
+        if (!dir.empty() && mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (at == std::string::npos) return true;
+    }
+}
+
+void Log(const std::string& message, bool once) {
+    static std::mutex mutex;
+    static std::set<std::string> seen;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (once && !seen.insert(message).second) return;
+    fprintf(stderr, "hal: %s\n", message.c_str());
+}
+
+}  // namespace hal
+
+HardwareSerial Serial;
+EspClass ESP;
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return hal::HeapFree();
+}
+
+uint32_t EspClass::getHeapSize() {
+    return hal::HeapSize();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return hal::HeapMinFree();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return hal::HeapLargest();
+}
+
+void EspClass::restart() {
+    hal::Restart();
+}
+
+void esp_restart(void) {
+    hal::Restart();
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return hal::HeapFree();
+}
+
+size_t heap_caps_get_free_size(uint32_t) {
+    return hal::HeapFree();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t) {
+    return hal::HeapMinFree();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t) {
+    return hal::HeapLargest();
+}
+
+size_t heap_caps_get_total_size(uint32_t) {
+    return hal::HeapSize();
+}
+
+unsigned long millis(void) {
+    return static_cast<unsigned long>(hal::NowUs() / 1000);
+}
+
+unsigned long micros(void) {
+    return static_cast<unsigned long>(hal::NowUs());
+}
+
+int64_t esp_timer_get_time(void) {
+    return static_cast<int64_t>(hal::NowUs());
+}
+
+void delay(uint32_t ms) {
+    hal::SleepUs(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    hal::SleepUs(us);
+}
+
+void yield(void) {
+    std::this_thread::yield();
+}
+
+#ifdef HOSTHAL_STRLCPY
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+extern "C" size_t strlcat(char* dst, const char* src, size_t size) {
+    size_t used = strnlen(dst, size);
+    if (used == size) return size + strlen(src);
+    return used + strlcpy(dst + used, src, size - used);
+}
+#endif
@@ -0,0 +1,94 @@
+#ifndef HOSTHAL_HAL_HPP
+#define HOSTHAL_HAL_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What the Arduino-named headers are built on: one firmware instance per
+// process, with its own loopback address, state directory and clock.
+namespace hal {
+
+struct Config {
+    uint32_t self = 0x0100007F;           // network byte order, 127.0.0.1
+    uint32_t hub = 0x0100007F;            // where 192.168.10.1 goes
+    std::vector<std::pair<uint32_t, uint32_t>> map;   // firmware address -> host address
+    std::string state = ".";
+    double clock_scale = 1;
+    std::string script;
+    long run_for_ms = 0;                  // 0 runs until killed
+    std::string partitions;               // the firmware's partitions.csv
+};
+
+// Filled in by main() before setup(), defaults until then.
+Config& Settings();
+bool ParseArgs(int argc, char** argv, Config* config, std::string* error);
+const char* Usage();
+// Kept for esp_restart().
+void SaveArgs(int argc, char** argv);
+[[noreturn]] void Restart();
+
+// The heap as the firmware sees it: what a freshly booted ESP32-S3 has
+// free, less what the process has malloc'ed since StartHeap(). glibc is
+// held to one arena so every thread's allocations count. The largest free
+// block is half the free heap, about what the chip's split DRAM gives.
+void StartHeap();
+uint32_t HeapFree();
+uint32_t HeapMinFree();
+uint32_t HeapLargest();
+uint32_t HeapSize();
+
+// Virtual microseconds since start, running clock_scale times faster than
+// real time. Inside a pin interrupt it is the time of the edge.
+uint64_t NowUs();
+void SleepUs(uint64_t us);
+// Real time to wait for a virtual duration.
+uint64_t RealUs(uint64_t us);
+// Sleeps up to us between two loop() calls, less when a watched socket
+// (UDP and listening ones) has something to read.
+void Idle(uint64_t us);
+void WatchFd(int fd);
+void UnwatchFd(int fd);
+
+bool InIsr();
+
+class IsrScope {
+public:
+    explicit IsrScope(uint64_t edge_us);
+    ~IsrScope();
+    IsrScope(const IsrScope&) = delete;
+    IsrScope& operator=(const IsrScope&) = delete;
+};
+
+// Where a firmware address is on the host, false when nothing is there.
+// 127/8 is itself, 192.168.10.1 is the hub, --map adds others.
+bool MapAddress(uint32_t address, uint32_t* host);
+// The other way, so peers show up under the addresses the firmware expects.
+uint32_t UnmapAddress(uint32_t host);
+// Ports below 1024 move up by 8000.
+uint16_t MapPort(uint16_t port);
+std::string AddressString(uint32_t address);
+// A close-on-exec socket, so esp_restart() does not leak it into the new
+// image, bound to the instance's address.
+int OpenSocket(int type, uint16_t port, std::string* error);
+
+// The station link as the pin script sets it.
+bool LinkUp();
+uint64_t LinkChangedUs();
+
+// Pin script, see hosthal/README.md. Reads the --script file and then
+// stdin, on a thread that also delivers pin interrupts.
+bool StartScript(std::string* error);
+bool Touch(uint16_t* x, uint16_t* y);
+
+// state/<name>, created on first use.
+std::string StatePath(const std::string& name);
+bool MakeDirs(const std::string& path);
+
+// "hal: ..." on stderr, once per distinct message when once is set.
+void Log(const std::string& message, bool once = false);
+
+}  // namespace hal
+
+#endif
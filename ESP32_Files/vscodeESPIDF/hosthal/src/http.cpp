@@ -0,0 +1,368 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "HTTPClient.h"
+#include "WebServer.h"
+#include "hal.hpp"
+
+namespace {
+
+constexpr size_t kMaxRequest = 16 * 1024;
+
+const char* StatusText(int code) {
+    switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+    }
+}
+
+HTTPMethod ParseMethod(const std::string& name) {
+    if (name == "GET") return HTTP_GET;
+    if (name == "POST") return HTTP_POST;
+    if (name == "PUT") return HTTP_PUT;
+    if (name == "DELETE") return HTTP_DELETE;
+    if (name == "PATCH") return HTTP_PATCH;
+    if (name == "HEAD") return HTTP_HEAD;
+    if (name == "OPTIONS") return HTTP_OPTIONS;
+    return HTTP_ANY;
+}
+
+bool SameText(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return true;
+}
+
+std::string UrlDecode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+                   isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+            out += static_cast<char>(strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+void ParseForm(const std::string& text, std::vector<std::pair<String, String>>* args) {
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t end = text.find('&', at);
+        if (end == std::string::npos) end = text.size();
+        std::string field = text.substr(at, end - at);
+        if (!field.empty()) {
+            size_t eq = field.find('=');
+            std::string name = eq == std::string::npos ? field : field.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : field.substr(eq + 1);
+            args->emplace_back(String(UrlDecode(name)), String(UrlDecode(value)));
+        }
+        at = end + 1;
+    }
+}
+
+// Header block lines after the first, "Name: value" each.
+void ParseHeaders(const std::string& head, std::vector<std::pair<String, String>>* headers) {
+    size_t at = head.find("\r\n");
+    while (at != std::string::npos && at + 2 < head.size()) {
+        size_t end = head.find("\r\n", at + 2);
+        std::string line = head.substr(at + 2, (end == std::string::npos ? head.size() : end) - at - 2);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            headers->emplace_back(String(line.substr(0, colon)),
+                                  String(value == std::string::npos ? "" : line.substr(value)));
+        }
+        at = end;
+    }
+}
+
+const String* Find(const std::vector<std::pair<String, String>>& list, const String& name, bool any_case) {
+    for (const auto& entry : list) {
+        if (any_case ? SameText(entry.first.str(), name.str()) : entry.first == name) return &entry.second;
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+void WebServer::close() {
+    client_.stop();
+    server_.end();
+    status_ = kNone;
+}
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction fn) {
+    routes_.push_back({uri, method, fn});
+}
+
+// Arduino-ESP32's state machine: wait for a whole request, answer it and
+// close, or hold a connection its handler left unanswered until the
+// client closes it.
+void WebServer::handleClient() {
+    if (status_ == kNone) {
+        client_ = server_.available();
+        if (!client_) return;
+        status_ = kWaitRead;
+        status_change_ = millis();
+        request_.clear();
+    }
+    if (status_ == kWaitRead) {
+        uint8_t buffer[1024];
+        int n;
+        while ((n = client_.read(buffer, sizeof(buffer))) > 0 && request_.size() < kMaxRequest) {
+            request_.append(reinterpret_cast<char*>(buffer), n);
+        }
+        if (ParseRequest()) {
+            Handle();
+            if (responded_) {
+                client_.stop();
+                status_ = kNone;
+            } else {
+                status_ = kWaitClose;
+                status_change_ = millis();
+            }
+        } else if (!client_.connected() || request_.size() >= kMaxRequest ||
+                   millis() - status_change_ > HTTP_MAX_DATA_WAIT) {
+            client_.stop();
+            status_ = kNone;
+        }
+        return;
+    }
+    if (!client_.connected() || millis() - status_change_ > HTTP_MAX_CLOSE_WAIT) {
+        client_.stop();
+        status_ = kNone;
+    }
+}
+
+bool WebServer::ParseRequest() {
+    size_t head_end = request_.find("\r\n\r\n");
+    if (head_end == std::string::npos) return false;
+    std::string head = request_.substr(0, head_end);
+    headers_.clear();
+    ParseHeaders(head, &headers_);
+    const String* length = Find(headers_, "Content-Length", true);
+    size_t body_len = length ? strtoul(length->c_str(), nullptr, 10) : 0;
+    if (request_.size() < head_end + 4 + body_len) return false;
+    std::string body = request_.substr(head_end + 4, body_len);
+
+    std::string line = head.substr(0, head.find("\r\n"));
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    std::string target = sp1 == std::string::npos ? "/" : line.substr(sp1 + 1, sp2 - sp1 - 1);
+    method_ = ParseMethod(line.substr(0, sp1));
+    args_.clear();
+    size_t query = target.find('?');
+    if (query != std::string::npos) {
+        ParseForm(target.substr(query + 1), &args_);
+        target.resize(query);
+    }
+    uri_ = String(UrlDecode(target));
+    const String* type = Find(headers_, "Content-Type", true);
+    if (type && type->startsWith("application/x-www-form-urlencoded")) {
+        ParseForm(body, &args_);
+    } else if (!body.empty()) {
+        args_.emplace_back(String("plain"), String(body));
+    }
+    response_headers_ = String();
+    responded_ = false;
+    content_length_ = CONTENT_LENGTH_NOT_SET;
+    return true;
+}
+
+void WebServer::Handle() {
+    for (const Route& route : routes_) {
+        if (route.uri == uri_ && (route.method == HTTP_ANY || route.method == method_)) {
+            route.fn();
+            return;
+        }
+    }
+    if (not_found_) {
+        not_found_();
+        return;
+    }
+    send(404, "text/plain", String("Not found: ") + uri_);
+}
+
+String WebServer::arg(const String& name) const {
+    const String* value = Find(args_, name, false);
+    return value ? *value : String();
+}
+
+String WebServer::arg(int i) const {
+    return i >= 0 && i < args() ? args_[i].second : String();
+}
+
+String WebServer::argName(int i) const {
+    return i >= 0 && i < args() ? args_[i].first : String();
+}
+
+bool WebServer::hasArg(const String& name) const {
+    return Find(args_, name, false) != nullptr;
+}
+
+String WebServer::header(const String& name) const {
+    const String* value = Find(headers_, name, true);
+    return value ? *value : String();
+}
+
+bool WebServer::hasHeader(const String& name) const {
+    return Find(headers_, name, true) != nullptr;
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+    String line = name + ": " + value + "\r\n";
+    response_headers_ = first ? line + response_headers_ : response_headers_ + line;
+}
+
+void WebServer::send(int code, const char* content_type, const String& content) {
+    send(code, content_type, content.c_str(), content.length());
+}
+
+void WebServer::send(int code, const char* content_type, const char* content, size_t length) {
+    String head = String("HTTP/1.1 ") + String(code) + " " + StatusText(code) + "\r\n";
+    head += String("Content-Type: ") + (content_type ? content_type : "text/html") + "\r\n";
+    if (content_length_ != CONTENT_LENGTH_NOT_SET) length = content_length_;
+    head += String("Content-Length: ") + String(static_cast<unsigned long>(length)) + "\r\n";
+    head += "Connection: close\r\n";
+    head += response_headers_;
+    head += "\r\n";
+    client_.write(head.c_str(), head.length());
+    if (content_length_ == CONTENT_LENGTH_NOT_SET && length) client_.write(content, length);
+    content_length_ = CONTENT_LENGTH_NOT_SET;
+    response_headers_ = String();
+    responded_ = true;
+}
+
+void WebServer::sendContent(const char* content, size_t length) {
+    if (length) client_.write(content, length);
+}
+
+bool HTTPClient::begin(const String& url) {
+    std::string rest = url.str();
+    ready_ = false;
+    if (rest.compare(0, 7, "http://") != 0) {
+        hal::Log("HTTPClient: only http:// URLs, not " + rest, true);
+        return false;
+    }
+    rest = rest.substr(7);
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    uri_ = String(slash == std::string::npos ? "/" : rest.substr(slash));
+    size_t colon = authority.find(':');
+    port_ = colon == std::string::npos ? 80 : static_cast<uint16_t>(atoi(authority.c_str() + colon + 1));
+    host_ = String(authority.substr(0, colon));
+    ready_ = !host_.isEmpty();
+    return ready_;
+}
+
+bool HTTPClient::begin(const String& host, uint16_t port, const String& uri) {
+    host_ = host;
+    port_ = port;
+    uri_ = uri;
+    ready_ = !host_.isEmpty();
+    return ready_;
+}
+
+void HTTPClient::end() {
+    ready_ = false;
+    headers_.clear();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+    headers_.emplace_back(name, value);
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET", nullptr, 0);
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length());
+}
+
+int HTTPClient::POST(const uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::sendRequest(const char* method, const uint8_t* payload, size_t size) {
+    body_.clear();
+    if (!ready_) return HTTPC_ERROR_NOT_CONNECTED;
+    WiFiClient client;
+    if (!client.connect(host_.c_str(), port_, connect_timeout_)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    String head = String(method) + " " + uri_ + " HTTP/1.1\r\nHost: " + host_ + "\r\n";
+    head += "User-Agent: ESP32HTTPClient\r\nConnection: close\r\n";
+    for (const auto& header : headers_) head += header.first + ": " + header.second + "\r\n";
+    if (payload || strcmp(method, "GET") != 0) {
+        head += String("Content-Length: ") + String(static_cast<unsigned long>(size)) + "\r\n";
+    }
+    head += "\r\n";
+    if (client.write(head.c_str(), head.length()) != head.length()) return HTTPC_ERROR_SEND_HEADER_FAILED;
+    if (size && client.write(payload, size) != size) return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+
+    // Read to the end of the body, or until the server closes.
+    std::string response;
+    size_t head_end = std::string::npos;
+    size_t want = std::string::npos;
+    unsigned long last = millis();
+    for (;;) {
+        uint8_t buffer[1024];
+        int n = client.read(buffer, sizeof(buffer));
+        if (n > 0) {
+            response.append(reinterpret_cast<char*>(buffer), n);
+            last = millis();
+            if (head_end == std::string::npos && (head_end = response.find("\r\n\r\n")) != std::string::npos) {
+                std::vector<std::pair<String, String>> headers;
+                ParseHeaders(response.substr(0, head_end), &headers);
+                const String* length = Find(headers, "Content-Length", true);
+                if (length) want = head_end + 4 + strtoul(length->c_str(), nullptr, 10);
+            }
+            if (want != std::string::npos && response.size() >= want) break;
+            continue;
+        }
+        if (!client.connected()) break;
+        if (millis() - last > timeout_) {
+            return response.empty() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+        }
+        delay(1);
+    }
+    if (response.compare(0, 5, "HTTP/") != 0) {
+        return response.empty() ? HTTPC_ERROR_CONNECTION_LOST : HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+    int code = atoi(response.c_str() + response.find(' ') + 1);
+    if (head_end != std::string::npos) body_ = response.substr(head_end + 4, want == std::string::npos ? std::string::npos : want - head_end - 4);
+    return code;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+    case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+    case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+    case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+    default: return String();
+    }
+}
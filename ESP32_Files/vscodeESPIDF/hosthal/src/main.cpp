@@ -0,0 +1,52 @@
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "Arduino.h"
+#include "hal.hpp"
+
+// setup() once and loop() forever, as the Arduino core's loop task does.
+int main(int argc, char** argv) {
+    hal::StartHeap();
+    hal::SaveArgs(argc, argv);
+    std::string error;
+    if (!hal::ParseArgs(argc, argv, &hal::Settings(), &error)) {
+        if (error == hal::Usage()) {
+            fputs(hal::Usage(), stdout);
+            return 0;
+        }
+        fprintf(stderr, "%s\n%s", error.c_str(), hal::Usage());
+        return 2;
+    }
+#ifdef HOST_PARTITIONS
+    hal::Settings().partitions = HOST_PARTITIONS;
+#endif
+    // A peer closing mid write is an error return on the chip, not a
+    // signal.
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    if (!hal::StartScript(&error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    long run_for = hal::Settings().run_for_ms;
+    if (run_for > 0) {
+        std::thread([run_for] {
+            delay(static_cast<uint32_t>(run_for));
+            fflush(stdout);
+            _exit(0);
+        }).detach();
+    }
+
+    setup();
+    for (;;) {
+        loop();
+        // Unlike the core's loop task this gives up a tick between rounds,
+        // or an idle firmware would spin a host core. A datagram or a
+        // connection ends the wait, so it adds no latency to either.
+        hal::Idle(1000);
+    }
+}
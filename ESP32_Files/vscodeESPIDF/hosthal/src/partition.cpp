@@ -0,0 +1,201 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "esp_partition.h"
+#include "hal.hpp"
+
+namespace {
+
+struct Partition {
+    esp_partition_t info;
+    int fd = -1;
+};
+
+std::mutex mutex;
+std::vector<std::unique_ptr<Partition>> table;
+bool loaded = false;
+
+std::string Trim(const std::string& text) {
+    size_t from = text.find_first_not_of(" \t\r");
+    if (from == std::string::npos) return "";
+    return text.substr(from, text.find_last_not_of(" \t\r") - from + 1);
+}
+
+// 0x10000, 65536, 64K or 1M.
+bool ParseSize(const std::string& text, uint32_t* value) {
+    char* end = nullptr;
+    unsigned long n = std::strtoul(text.c_str(), &end, 0);
+    if (end == text.c_str()) return false;
+    if (*end == 'K' || *end == 'k') n *= 1024, end++;
+    else if (*end == 'M' || *end == 'm') n *= 1024 * 1024, end++;
+    if (*end) return false;
+    *value = static_cast<uint32_t>(n);
+    return true;
+}
+
+bool ParseType(const std::string& text, int* type) {
+    if (text == "app") *type = ESP_PARTITION_TYPE_APP;
+    else if (text == "data") *type = ESP_PARTITION_TYPE_DATA;
+    else {
+        uint32_t n;
+        if (!ParseSize(text, &n) || n > 0xfe) return false;
+        *type = static_cast<int>(n);
+    }
+    return true;
+}
+
+bool ParseSubtype(const std::string& text, int* subtype) {
+    static const struct {
+        const char* name;
+        int value;
+    } names[] = {{"factory", ESP_PARTITION_SUBTYPE_APP_FACTORY}, {"phy", ESP_PARTITION_SUBTYPE_DATA_PHY},
+                 {"nvs", ESP_PARTITION_SUBTYPE_DATA_NVS}, {"spiffs", ESP_PARTITION_SUBTYPE_DATA_SPIFFS},
+                 {"littlefs", ESP_PARTITION_SUBTYPE_DATA_SPIFFS}};
+    for (const auto& name : names) {
+        if (text == name.name) {
+            *subtype = name.value;
+            return true;
+        }
+    }
+    uint32_t n;
+    if (!ParseSize(text, &n) || n > 0xfe) return false;
+    *subtype = static_cast<int>(n);
+    return true;
+}
+
+// The table as the build lays it out: after the partition table at
+// 0x8000, apps on 64 KB boundaries and data on 4 KB ones.
+void Load() {
+    loaded = true;
+    const std::string& path = hal::Settings().partitions;
+    if (path.empty()) return;
+    std::ifstream in(path);
+    if (!in) {
+        hal::Log("cannot read " + path, true);
+        return;
+    }
+    uint32_t next = 0x9000;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        std::vector<std::string> fields;
+        std::istringstream row(line);
+        std::string field;
+        while (std::getline(row, field, ',')) fields.push_back(Trim(field));
+        auto partition = std::make_unique<Partition>();
+        int type, subtype;
+        uint32_t size;
+        if (fields.size() < 5 || fields[0].size() >= sizeof(partition->info.label) || !ParseType(fields[1], &type) ||
+            !ParseSubtype(fields[2], &subtype) || !ParseSize(fields[4], &size)) {
+            hal::Log(path + ": cannot parse \"" + line + "\"", true);
+            continue;
+        }
+        uint32_t align = type == ESP_PARTITION_TYPE_APP ? 0x10000 : 0x1000;
+        uint32_t address = (next + align - 1) & ~(align - 1);
+        if (!fields[3].empty() && !ParseSize(fields[3], &address)) {
+            hal::Log(path + ": bad offset in \"" + line + "\"", true);
+            continue;
+        }
+        next = address + size;
+        partition->info.type = static_cast<esp_partition_type_t>(type);
+        partition->info.subtype = static_cast<esp_partition_subtype_t>(subtype);
+        partition->info.address = address;
+        partition->info.size = size;
+        std::strcpy(partition->info.label, fields[0].c_str());
+        partition->info.encrypted = false;
+        table.push_back(std::move(partition));
+    }
+}
+
+Partition* Find(const esp_partition_t* info) {
+    for (auto& partition : table) {
+        if (&partition->info == info) return partition.get();
+    }
+    return nullptr;
+}
+
+// flash/<label>.bin, erased when it is new or the table made it bigger.
+int Open(Partition* partition) {
+    if (partition->fd >= 0) return partition->fd;
+    std::string dir = hal::StatePath("flash");
+    if (!hal::MakeDirs(dir)) return -1;
+    std::string path = dir + "/" + partition->info.label + ".bin";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < static_cast<off_t>(partition->info.size)) {
+        std::vector<uint8_t> erased(partition->info.size - size, 0xff);
+        if (pwrite(fd, erased.data(), erased.size(), size) != static_cast<ssize_t>(erased.size())) {
+            close(fd);
+            return -1;
+        }
+    }
+    partition->fd = fd;
+    return fd;
+}
+
+esp_err_t Check(const esp_partition_t* info, size_t offset, size_t size, Partition** partition, int* fd) {
+    if (!info) return ESP_ERR_INVALID_ARG;
+    *partition = Find(info);
+    if (!*partition || offset > info->size || size > info->size - offset) return ESP_ERR_INVALID_ARG;
+    *fd = Open(*partition);
+    return *fd < 0 ? ESP_FAIL : ESP_OK;
+}
+
+}  // namespace
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!loaded) Load();
+    for (auto& partition : table) {
+        if (partition->info.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && partition->info.subtype != subtype) continue;
+        if (label && std::strcmp(label, partition->info.label) != 0) continue;
+        return &partition->info;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* info, size_t src_offset, void* dst, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Partition* partition;
+    int fd;
+    esp_err_t err = Check(info, src_offset, size, &partition, &fd);
+    if (err != ESP_OK) return err;
+    return pread(fd, dst, size, src_offset) == static_cast<ssize_t>(size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* info, size_t dst_offset, const void* src, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Partition* partition;
+    int fd;
+    esp_err_t err = Check(info, dst_offset, size, &partition, &fd);
+    if (err != ESP_OK) return err;
+    std::vector<uint8_t> bits(size);
+    if (pread(fd, bits.data(), size, dst_offset) != static_cast<ssize_t>(size)) return ESP_FAIL;
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; i++) bits[i] &= in[i];
+    return pwrite(fd, bits.data(), size, dst_offset) == static_cast<ssize_t>(size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* info, size_t offset, size_t size) {
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    Partition* partition;
+    int fd;
+    esp_err_t err = Check(info, offset, size, &partition, &fd);
+    if (err != ESP_OK) return err;
+    std::vector<uint8_t> erased(size, 0xff);
+    return pwrite(fd, erased.data(), size, offset) == static_cast<ssize_t>(size) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,241 @@
+#include <arpa/inet.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Arduino.h"
+
+namespace {
+
+std::string ToBase(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) base = 10;
+    std::string digits;
+    do {
+        int d = static_cast<int>(value % base);
+        digits.insert(digits.begin(), static_cast<char>(d < 10 ? '0' + d : 'a' + d - 10));
+        value /= base;
+    } while (value);
+    return digits;
+}
+
+std::string Signed(long long value, unsigned char base) {
+    if (value < 0 && base == 10) return "-" + ToBase(0ULL - static_cast<unsigned long long>(value), base);
+    return ToBase(static_cast<unsigned long long>(value), base);
+}
+
+std::string Fixed(double value, unsigned int decimals) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", static_cast<int>(decimals), value);
+    return text;
+}
+
+}  // namespace
+
+String::String(int value, unsigned char base) : s_(Signed(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s_(ToBase(value, base)) {}
+String::String(long value, unsigned char base) : s_(Signed(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s_(ToBase(value, base)) {}
+String::String(long long value, unsigned char base) : s_(Signed(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : s_(ToBase(value, base)) {}
+String::String(float value, unsigned int decimals) : s_(Fixed(value, decimals)) {}
+String::String(double value, unsigned int decimals) : s_(Fixed(value, decimals)) {}
+
+bool String::equalsIgnoreCase(const String& s) const {
+    if (s_.size() != s.s_.size()) return false;
+    for (size_t i = 0; i < s_.size(); i++) {
+        if (tolower(static_cast<unsigned char>(s_[i])) != tolower(static_cast<unsigned char>(s.s_[i]))) return false;
+    }
+    return true;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t at = s_.find(c, from);
+    return at == std::string::npos ? -1 : static_cast<int>(at);
+}
+
+int String::indexOf(const String& s, unsigned int from) const {
+    size_t at = s_.find(s.s_, from);
+    return at == std::string::npos ? -1 : static_cast<int>(at);
+}
+
+int String::lastIndexOf(char c) const {
+    size_t at = s_.rfind(c);
+    return at == std::string::npos ? -1 : static_cast<int>(at);
+}
+
+String String::substring(unsigned int begin, unsigned int end) const {
+    if (begin > end) std::swap(begin, end);
+    if (begin >= s_.size()) return String();
+    if (end > s_.size()) end = static_cast<unsigned int>(s_.size());
+    return String(s_.substr(begin, end - begin));
+}
+
+void String::replace(const String& find, const String& with) {
+    if (find.s_.empty()) return;
+    for (size_t at = s_.find(find.s_); at != std::string::npos; at = s_.find(find.s_, at + with.s_.size())) {
+        s_.replace(at, find.s_.size(), with.s_);
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index < s_.size()) s_.erase(index, count);
+}
+
+void String::toLowerCase() {
+    for (char& c : s_) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+void String::toUpperCase() {
+    for (char& c : s_) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+void String::trim() {
+    size_t begin = 0, end = s_.size();
+    while (begin < end && isspace(static_cast<unsigned char>(s_[begin]))) begin++;
+    while (end > begin && isspace(static_cast<unsigned char>(s_[end - 1]))) end--;
+    s_ = s_.substr(begin, end - begin);
+}
+
+long String::toInt() const {
+    return strtol(s_.c_str(), nullptr, 10);
+}
+
+float String::toFloat() const {
+    return strtof(s_.c_str(), nullptr);
+}
+
+double String::toDouble() const {
+    return strtod(s_.c_str(), nullptr);
+}
+
+String operator+(const String& a, const String& b) {
+    return String(a.str() + b.str());
+}
+
+String operator+(const String& a, const char* b) {
+    return String(a.str() + (b ? b : ""));
+}
+
+String operator+(const char* a, const String& b) {
+    return String((a ? a : "") + b.str());
+}
+
+String operator+(const String& a, char b) {
+    return String(a.str() + b);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (!write(*buffer++)) break;
+        n++;
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+size_t Print::vprintf(const char* format, va_list args) {
+    char small[64];
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(small, sizeof(small), format, copy);
+    va_end(copy);
+    if (len < 0) return 0;
+    if (static_cast<size_t>(len) < sizeof(small)) return write(small, len);
+    std::string big(len + 1, '\0');
+    vsnprintf(&big[0], big.size(), format, args);
+    return write(big.data(), len);
+}
+
+size_t Print::print(long value, int base) {
+    std::string s = Signed(value, static_cast<unsigned char>(base));
+    return write(s.data(), s.size());
+}
+
+size_t Print::print(unsigned long value, int base) {
+    std::string s = ToBase(value, static_cast<unsigned char>(base));
+    return write(s.data(), s.size());
+}
+
+size_t Print::print(long long value, int base) {
+    std::string s = Signed(value, static_cast<unsigned char>(base));
+    return write(s.data(), s.size());
+}
+
+size_t Print::print(unsigned long long value, int base) {
+    std::string s = ToBase(value, static_cast<unsigned char>(base));
+    return write(s.data(), s.size());
+}
+
+size_t Print::print(double value, int digits) {
+    std::string s = Fixed(value, digits);
+    return write(s.data(), s.size());
+}
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < timeout_);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = timedRead();
+        if (c < 0) break;
+        buffer[n++] = static_cast<char>(c);
+    }
+    return n;
+}
+
+String Stream::readString() {
+    String s;
+    for (int c = timedRead(); c >= 0; c = timedRead()) s += static_cast<char>(c);
+    return s;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String s;
+    for (int c = timedRead(); c >= 0 && c != terminator; c = timedRead()) s += static_cast<char>(c);
+    return s;
+}
+
+IPAddress::IPAddress(uint32_t address) {
+    memcpy(bytes_, &address, 4);
+}
+
+bool IPAddress::fromString(const char* address) {
+    in_addr in;
+    if (!address || inet_pton(AF_INET, address, &in) != 1) return false;
+    memcpy(bytes_, &in.s_addr, 4);
+    return true;
+}
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes_[0], bytes_[1], bytes_[2], bytes_[3]);
+    return String(text);
+}
+
+IPAddress::operator uint32_t() const {
+    uint32_t address;
+    memcpy(&address, bytes_, 4);
+    return address;
+}
+
+size_t IPAddress::printTo(Print& p) const {
+    return p.print(toString());
+}
@@ -0,0 +1,469 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "WiFi.h"
+#include "hal.hpp"
+
+namespace {
+
+// How long a station takes to associate and get its address.
+constexpr uint64_t kAssociateUs = 500 * 1000;
+constexpr int kSendTimeoutMs = 5000;
+constexpr size_t kMaxDatagram = 1460;
+
+struct Radio {
+    std::mutex mutex;
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    bool sta_started = false;
+    uint64_t sta_begin_us = 0;
+    std::string ssid;
+    bool ap_up = false;
+};
+
+Radio& R() {
+    static Radio radio;
+    return radio;
+}
+
+bool ResolveHost(const char* host, IPAddress* ip) {
+    if (ip->fromString(host)) return true;
+    hal::Log(std::string("no DNS on the host, cannot resolve ") + host, true);
+    return false;
+}
+
+void SetBlocking(int fd, bool blocking) {
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+}
+
+void SetSendTimeout(int fd) {
+    timeval tv = {kSendTimeoutMs / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+}  // namespace
+
+WiFiClass WiFi;
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.mode = mode;
+    if (mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA) r.sta_started = false;
+    if (mode != WIFI_MODE_AP && mode != WIFI_MODE_APSTA) r.ap_up = false;
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.mode;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid,
+                             bool connect) {
+    (void)passphrase;
+    (void)channel;
+    (void)bssid;
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.mode == WIFI_MODE_NULL || r.mode == WIFI_MODE_AP) r.mode = r.mode == WIFI_MODE_AP ? WIFI_MODE_APSTA : WIFI_MODE_STA;
+    r.ssid = ssid ? ssid : "";
+    r.sta_started = connect;
+    r.sta_begin_us = hal::NowUs();
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+    (void)eraseap;
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.sta_started = false;
+    if (wifioff) r.mode = r.ap_up ? WIFI_MODE_AP : WIFI_MODE_NULL;
+    return true;
+}
+
+bool WiFiClass::reconnect() {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.sta_started = true;
+    r.sta_begin_us = hal::NowUs();
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (!r.sta_started) return WL_DISCONNECTED;
+    if (!hal::LinkUp()) return r.sta_begin_us < hal::LinkChangedUs() ? WL_CONNECTION_LOST : WL_DISCONNECTED;
+    uint64_t since = std::max(r.sta_begin_us, hal::LinkChangedUs());
+    return hal::NowUs() - since >= kAssociateUs ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() {
+    return status() == WL_CONNECTED ? IPAddress(hal::Settings().self) : IPAddress();
+}
+
+String WiFiClass::SSID() {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return String(r.ssid);
+}
+
+int8_t WiFiClass::RSSI() {
+    return status() == WL_CONNECTED ? -50 : 0;
+}
+
+String WiFiClass::macAddress() {
+    // Locally administered, the last two bytes from the instance address.
+    uint32_t self = ntohl(hal::Settings().self);
+    char text[18];
+    snprintf(text, sizeof(text), "02:00:00:%02X:%02X:%02X", (self >> 16) & 0xFF, (self >> 8) & 0xFF, self & 0xFF);
+    return String(text);
+}
+
+bool WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) {
+    (void)local_ip;
+    (void)gateway;
+    (void)subnet;
+    return true;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase, int channel, int ssid_hidden, int max_connection) {
+    (void)channel;
+    (void)ssid_hidden;
+    (void)max_connection;
+    // WPA2 needs 8 characters, the IDF refuses shorter ones.
+    if (!ssid || !*ssid || (passphrase && *passphrase && strlen(passphrase) < 8)) return false;
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.mode == WIFI_MODE_NULL || r.mode == WIFI_MODE_STA) r.mode = r.mode == WIFI_MODE_STA ? WIFI_MODE_APSTA : WIFI_MODE_AP;
+    r.ap_up = true;
+    return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifioff) {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.ap_up = false;
+    if (wifioff) r.mode = r.sta_started ? WIFI_MODE_STA : WIFI_MODE_NULL;
+    return true;
+}
+
+IPAddress WiFiClass::softAPIP() {
+    Radio& r = R();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.ap_up ? IPAddress(hal::Settings().self) : IPAddress();
+}
+
+struct WiFiClient::Socket {
+    explicit Socket(int fd) : fd(fd) {}
+    ~Socket() {
+        if (fd >= 0) close(fd);
+    }
+    int fd;
+};
+
+WiFiClient::WiFiClient(int fd) : socket_(std::make_shared<Socket>(fd)) {
+    SetSendTimeout(fd);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip, port, WIFI_CLIENT_DEF_CONN_TIMEOUT_MS);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout_ms) {
+    stop();
+    uint32_t host;
+    if (!hal::MapAddress(ip, &host)) {
+        hal::Log("nothing at " + std::string(ip.toString().c_str()) + ", connect fails", true);
+        return 0;
+    }
+    std::string error;
+    int fd = hal::OpenSocket(SOCK_STREAM, 0, &error);
+    if (fd < 0) {
+        hal::Log(error);
+        return 0;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = host;
+    addr.sin_port = htons(hal::MapPort(port));
+    SetBlocking(fd, false);
+    int rc = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (rc != 0 && errno == EINPROGRESS) {
+        pollfd p = {fd, POLLOUT, 0};
+        int wait = static_cast<int>(hal::RealUs(static_cast<uint64_t>(timeout_ms) * 1000) / 1000);
+        if (poll(&p, 1, wait > 0 ? wait : 1) == 1) {
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+            rc = so_error == 0 ? 0 : -1;
+        }
+    }
+    if (rc != 0) {
+        close(fd);
+        return 0;
+    }
+    SetBlocking(fd, true);
+    socket_ = std::make_shared<Socket>(fd);
+    SetSendTimeout(fd);
+    return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, WIFI_CLIENT_DEF_CONN_TIMEOUT_MS);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout_ms) {
+    IPAddress ip;
+    if (!ResolveHost(host, &ip)) return 0;
+    return connect(ip, port, timeout_ms);
+}
+
+size_t WiFiClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    if (!socket_) return 0;
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(socket_->fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        sent += static_cast<size_t>(n);
+    }
+    return sent;
+}
+
+int WiFiClient::available() {
+    if (!socket_) return 0;
+    int n = 0;
+    if (ioctl(socket_->fd, FIONREAD, &n) != 0) return 0;
+    return n;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (!socket_) return -1;
+    ssize_t n = recv(socket_->fd, buffer, size, MSG_DONTWAIT);
+    return n > 0 ? static_cast<int>(n) : -1;
+}
+
+int WiFiClient::peek() {
+    if (!socket_) return -1;
+    uint8_t c;
+    return recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+    socket_.reset();
+}
+
+uint8_t WiFiClient::connected() {
+    if (!socket_) return 0;
+    uint8_t c;
+    ssize_t n = recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0) return 1;
+    if (n == 0) return 0;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+int WiFiClient::fd() const {
+    return socket_ ? socket_->fd : -1;
+}
+
+int WiFiClient::setNoDelay(bool nodelay) {
+    if (!socket_) return -1;
+    int flag = nodelay;
+    return setsockopt(socket_->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+IPAddress WiFiClient::remoteIP() const {
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (!socket_ || getpeername(socket_->fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) return IPAddress();
+    return IPAddress(hal::UnmapAddress(addr.sin_addr.s_addr));
+}
+
+uint16_t WiFiClient::remotePort() const {
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (!socket_ || getpeername(socket_->fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+IPAddress WiFiClient::localIP() const {
+    return socket_ ? IPAddress(hal::Settings().self) : IPAddress();
+}
+
+void WiFiServer::begin(uint16_t port) {
+    end();
+    if (port) port_ = port;
+    std::string error;
+    fd_ = hal::OpenSocket(SOCK_STREAM, port_, &error);
+    if (fd_ < 0) {
+        hal::Log("server: " + error);
+        return;
+    }
+    if (listen(fd_, max_clients_) != 0) {
+        hal::Log(std::string("listen: ") + strerror(errno));
+        end();
+        return;
+    }
+    SetBlocking(fd_, false);
+    hal::WatchFd(fd_);
+}
+
+void WiFiServer::end() {
+    if (fd_ < 0) return;
+    hal::UnwatchFd(fd_);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+WiFiClient WiFiServer::available() {
+    if (fd_ < 0) return WiFiClient();
+    int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return WiFiClient();
+    WiFiClient client(fd);
+    if (nodelay_) client.setNoDelay(true);
+    return client;
+}
+
+bool WiFiServer::hasClient() {
+    if (fd_ < 0) return false;
+    pollfd p = {fd_, POLLIN, 0};
+    return poll(&p, 1, 0) == 1;
+}
+
+bool WiFiUDP::Open() {
+    if (fd_ >= 0) return true;
+    std::string error;
+    fd_ = hal::OpenSocket(SOCK_DGRAM, port_, &error);
+    if (fd_ < 0) {
+        hal::Log("udp: " + error);
+        return false;
+    }
+    hal::WatchFd(fd_);
+    return true;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    stop();
+    port_ = port;
+    return Open() ? 1 : 0;
+}
+
+void WiFiUDP::stop() {
+    if (fd_ >= 0) {
+        hal::UnwatchFd(fd_);
+        ::close(fd_);
+    }
+    fd_ = -1;
+    rx_.clear();
+    rx_pos_ = 0;
+}
+
+int WiFiUDP::beginPacket() {
+    return beginPacket(remote_ip_, remote_port_);
+}
+
+// Like Arduino-ESP32, the destination becomes remoteIP().
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    tx_ip_ = ip;
+    tx_port_ = port;
+    remote_ip_ = ip;
+    remote_port_ = port;
+    tx_.clear();
+    return 1;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!ResolveHost(host, &ip)) return 0;
+    return beginPacket(ip, port);
+}
+
+int WiFiUDP::endPacket() {
+    std::string packet;
+    packet.swap(tx_);
+    uint32_t host;
+    // A datagram to nobody is not an error on the chip either.
+    if (!hal::MapAddress(tx_ip_, &host)) {
+        hal::Log("nothing at " + std::string(tx_ip_.toString().c_str()) + ", dropping UDP", true);
+        return 1;
+    }
+    if (!Open()) return 0;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = host;
+    addr.sin_port = htons(hal::MapPort(tx_port_));
+    return sendto(fd_, packet.data(), packet.size(), MSG_NOSIGNAL, reinterpret_cast<sockaddr*>(&addr),
+                  sizeof(addr)) == static_cast<ssize_t>(packet.size());
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+    size_t room = kMaxDatagram - std::min(tx_.size(), kMaxDatagram);
+    size_t n = std::min(size, room);
+    tx_.append(reinterpret_cast<const char*>(buffer), n);
+    return n;
+}
+
+int WiFiUDP::parsePacket() {
+    rx_.clear();
+    rx_pos_ = 0;
+    if (fd_ < 0) return 0;
+    char buffer[kMaxDatagram];
+    sockaddr_in from = {};
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(fd_, buffer, sizeof(buffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &len);
+    if (n <= 0) return 0;
+    rx_.assign(buffer, static_cast<size_t>(n));
+    remote_ip_ = IPAddress(hal::UnmapAddress(from.sin_addr.s_addr));
+    remote_port_ = ntohs(from.sin_port);
+    return static_cast<int>(n);
+}
+
+int WiFiUDP::available() {
+    return static_cast<int>(rx_.size() - rx_pos_);
+}
+
+int WiFiUDP::read() {
+    return rx_pos_ < rx_.size() ? static_cast<uint8_t>(rx_[rx_pos_++]) : -1;
+}
+
+int WiFiUDP::read(unsigned char* buffer, size_t len) {
+    size_t n = std::min(len, rx_.size() - rx_pos_);
+    memcpy(buffer, rx_.data() + rx_pos_, n);
+    rx_pos_ += n;
+    return static_cast<int>(n);
+}
+
+int WiFiUDP::peek() {
+    return rx_pos_ < rx_.size() ? static_cast<uint8_t>(rx_[rx_pos_]) : -1;
+}
+
+void WiFiUDP::flush() {
+    rx_pos_ = rx_.size();
+}
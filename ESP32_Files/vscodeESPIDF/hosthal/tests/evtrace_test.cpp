@@ -0,0 +1,132 @@
+// evtracejson on made-up downloads: a sensor and a hub whose clocks are
+// seconds apart, joined by one alarm's flow.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "evtrace.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static bool Has(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+// The sensor sends at 10 s of its uptime; the hub booted 3 s later, gets
+// the packet 2 ms after it was sent and moves the servo 1 ms after that.
+static std::vector<DeviceTrace> MakeTraces() {
+    DeviceTrace sensor;
+    sensor.name = "sensor";
+    sensor.threads = {"loopTask", "isr1"};
+    sensor.events = {
+        {9999000, 0, 'E', 1, "echo"},              // its begin is gone
+        {10000000, 0, 'B', 0, "alert"},
+        {10000010, 0xabc1, 's', 0, "alarm"},
+        {10000500, 0, 'E', 0, "alert"},
+        {10001000, 0, 'B', 0, "ranging"},         // never ends
+    };
+    DeviceTrace hub;
+    hub.name = "hub";
+    hub.threads = {"loopTask", "actuator"};
+    hub.events = {
+        {7002000, 0, 'B', 0, "wifi_receive"},
+        {7002010, 0xabc1, 't', 0, "alarm"},
+        {7002100, 0, 'E', 0, "wifi_receive"},
+        {7003000, 0, 'B', 1, "servo"},
+        {7003000, 0xabc1, 'f', 1, "alarm"},
+        {7004000, 0, 'i', 1, "quote \"me\""},
+        {7005000, 0, 'E', 1, "servo"},
+    };
+    return {sensor, hub};
+}
+
+static void TestRoundTrip() {
+    std::vector<DeviceTrace> traces = MakeTraces();
+    std::string bytes = EncodeEvtrace(traces[1]);
+    CHECK(bytes.compare(0, 4, "SHEV") == 0);
+    DeviceTrace parsed;
+    std::string error;
+    CHECK(ParseEvtrace(bytes, &parsed, &error));
+    CHECK(parsed.threads == traces[1].threads);
+    CHECK(parsed.events.size() == traces[1].events.size());
+    if (parsed.events.size() == traces[1].events.size()) {
+        for (size_t i = 0; i < parsed.events.size(); i++) {
+            CHECK(parsed.events[i].us == traces[1].events[i].us);
+            CHECK(parsed.events[i].id == traces[1].events[i].id);
+            CHECK(parsed.events[i].phase == traces[1].events[i].phase);
+            CHECK(parsed.events[i].thread == traces[1].events[i].thread);
+            CHECK(parsed.events[i].name == traces[1].events[i].name);
+        }
+    }
+
+    CHECK(!ParseEvtrace(bytes.substr(0, bytes.size() - 1), &parsed, &error));
+    CHECK(!ParseEvtrace(bytes + "x", &parsed, &error));
+    CHECK(!ParseEvtrace("SHTR" + bytes.substr(4), &parsed, &error));
+    std::string badthread = EncodeEvtrace({"x", {"one"}, {{0, 0, 'i', 1, "a"}}});
+    CHECK(!ParseEvtrace(badthread, &parsed, &error));
+}
+
+static void TestAlign() {
+    // The hub's step cannot come before the sensor's start, and the packet
+    // is taken to have taken no time: the step lands on the start.
+    std::vector<DeviceTrace> traces = MakeTraces();
+    std::vector<int64_t> shifts = AlignClocks(&traces);
+    CHECK(shifts.size() == 2);
+    CHECK(shifts[1] - shifts[0] == 10000010 - 7002010);
+    CHECK(traces[0].events.front().us == 0);
+    CHECK(traces[1].events[1].us == traces[0].events[2].us);
+
+    // Read the other way round the sensor's start comes first anyway.
+    std::vector<DeviceTrace> reversed = MakeTraces();
+    std::swap(reversed[0], reversed[1]);
+    shifts = AlignClocks(&reversed);
+    CHECK(shifts[0] - shifts[1] == 10000010 - 7002010);
+
+    // Without a flow in common the last events line up.
+    std::vector<DeviceTrace> apart = MakeTraces();
+    apart[1].events[1].id = 0x1234;
+    apart[1].events[4].id = 0x1234;
+    shifts = AlignClocks(&apart);
+    CHECK(apart[0].events.back().us == apart[1].events.back().us);
+}
+
+static void TestJson() {
+    std::vector<DeviceTrace> traces = MakeTraces();
+    AlignClocks(&traces);
+    std::string json = ChromeJson(traces);
+    CHECK(json.compare(0, 17, "{\"displayTimeUnit") == 0);
+    CHECK(Has(json, "\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"sensor\"}"));
+    CHECK(Has(json, "\"name\":\"process_name\",\"pid\":2,\"args\":{\"name\":\"hub\"}"));
+    CHECK(Has(json, "\"name\":\"thread_name\",\"pid\":2,\"tid\":1,\"args\":{\"name\":\"actuator\"}"));
+    // Flow start on the sensor, step and end on the hub, one id.
+    CHECK(Has(json, "{\"ph\":\"s\",\"name\":\"alarm\",\"pid\":1,\"tid\":0,\"ts\":1010,\"cat\":\"alarm\",\"id\":43969}"));
+    CHECK(Has(json, "{\"ph\":\"t\",\"name\":\"alarm\",\"pid\":2,\"tid\":0,\"ts\":1010,"));
+    CHECK(Has(json, "\"ph\":\"f\",\"name\":\"alarm\",\"pid\":2,\"tid\":1,\"ts\":2000,\"cat\":\"alarm\",\"id\":43969,\"bp\":\"e\"}"));
+    CHECK(Has(json, "\"name\":\"quote \\\"me\\\"\""));
+    // The orphaned end is gone, the open slice closes with the trace.
+    CHECK(!Has(json, "\"name\":\"echo\""));
+    CHECK(Has(json, "{\"ph\":\"E\",\"name\":\"ranging\",\"pid\":1,\"tid\":0,\"ts\":2000}"));
+    CHECK(json.compare(json.size() - 4, 4, "\n]}\n") == 0);
+}
+
+int main() {
+    TestRoundTrip();
+    TestAlign();
+    TestJson();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("evtrace_test passed\n");
+    return 0;
+}
@@ -0,0 +1,431 @@
+// Both firmwares as host processes on their own loopback addresses: the
+// sensor joins the hub, gets armed over UDP and reports an intrusion when
+// the scripted sonar distance drops, with its echoes recorded to a trace
+// and the alarm's path through both traced.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "evtrace.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static const char* kHub = "127.0.41.1";
+static const char* kSensor = "127.0.41.2";
+static const char* kClockScale = "4";
+
+struct Child {
+    pid_t pid = -1;
+    int input = -1;        // the child's stdin, -1 when not piped
+    std::string log;
+};
+
+static Child Spawn(const std::vector<std::string>& args, const std::string& log, bool pipe_stdin) {
+    Child child;
+    child.log = log;
+    int fds[2] = {-1, -1};
+    if (pipe_stdin && pipe(fds) != 0) return child;
+    child.pid = fork();
+    if (child.pid == 0) {
+        if (pipe_stdin) {
+            dup2(fds[0], 0);
+            close(fds[0]);
+            close(fds[1]);
+        }
+        int out = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(out, 1);
+        dup2(out, 2);
+        std::vector<char*> argv;
+        for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pipe_stdin) {
+        close(fds[0]);
+        child.input = fds[1];
+    }
+    return child;
+}
+
+static void Stop(Child* child) {
+    if (child->pid > 0) {
+        kill(child->pid, SIGKILL);
+        waitpid(child->pid, nullptr, 0);
+    }
+    if (child->input >= 0) close(child->input);
+    child->pid = -1;
+}
+
+static void Dump(const Child& child) {
+    FILE* file = std::fopen(child.log.c_str(), "r");
+    if (!file) return;
+    std::fprintf(stderr, "--- %s\n", child.log.c_str());
+    char line[512];
+    while (std::fgets(line, sizeof(line), file)) std::fputs(line, stderr);
+    std::fclose(file);
+}
+
+// A socket to <host>:8080 that gives up reading after 5 s, -1 when
+// nothing answers.
+static int Connect(const char* host) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8080);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Reads from fd until what came in contains needle. False on a timeout or
+// a closed connection.
+static bool ReadUntil(int fd, const std::string& needle, std::string* received) {
+    char buffer[512];
+    while (received->find(needle) == std::string::npos) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) return false;
+        received->append(buffer, n);
+    }
+    return true;
+}
+
+// Everything http://<host>:8080 answers to a raw request, head included,
+// until it closes the connection. Empty when nothing answers. after goes
+// out once the response head is in, for a connection that was upgraded.
+static std::string Exchange(const char* host, const std::string& request, std::string after = "") {
+    int fd = Connect(host);
+    if (fd < 0) return "";
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, n);
+        if (!after.empty() && response.find("\r\n\r\n") != std::string::npos) {
+            send(fd, after.data(), after.size(), MSG_NOSIGNAL);
+            after.clear();
+        }
+    }
+    close(fd);
+    return response;
+}
+
+// Body of the answer from http://<host>:8080<path>, empty when nothing
+// answers. A form goes in a urlencoded body.
+static std::string Request(const char* host, const char* method, const char* path, const std::string& form) {
+    std::string request = std::string(method) + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n";
+    if (!form.empty()) {
+        request += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                   std::to_string(form.size()) + "\r\n";
+    }
+    request += "\r\n" + form;
+    std::string response = Exchange(host, request);
+    size_t body = response.find("\r\n\r\n");
+    return body == std::string::npos ? "" : response.substr(body + 4);
+}
+
+static std::string Get(const char* host, const char* path) {
+    return Request(host, "GET", path, "");
+}
+
+static void SendUdp(const char* host, const char* message) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(5005);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    sendto(fd, message, std::strlen(message), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    close(fd);
+}
+
+static bool WaitFor(const char* what, int timeout_ms) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < until) {
+        if (Get(kHub, "/api/state").find(what) != std::string::npos) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+// The value of the sample line starting with series in a /api/metrics
+// answer, -1 when there is none.
+static double Metric(const std::string& text, const std::string& series) {
+    size_t at = text.find("\n" + series + " ");
+    return at == std::string::npos ? -1 : std::atof(text.c_str() + at + series.size() + 2);
+}
+
+static void TestArgs() {
+    std::string cmd = std::string(SENSOR_HOST) + " --ip 10.0.0.1 2>/dev/null";
+    CHECK(WEXITSTATUS(std::system(cmd.c_str())) == 2);
+    cmd = std::string(SENSOR_HOST) + " --clock-scale 0 2>/dev/null";
+    CHECK(WEXITSTATUS(std::system(cmd.c_str())) == 2);
+    cmd = std::string(HUB_HOST) + " --help >/dev/null";
+    CHECK(WEXITSTATUS(std::system(cmd.c_str())) == 0);
+}
+
+static void TestIntrusion() {
+    char dir[] = "/tmp/host_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        CHECK(false);
+        return;
+    }
+    std::string root = dir;
+    std::string hub_state = root + "/hub";
+    std::string sensor_state = root + "/sensor";
+    // Uplink settings as firmware before the NVS blob kept them.
+    std::string legacy = "mkdir -p " + hub_state + "/littlefs";
+    CHECK(std::system(legacy.c_str()) == 0);
+    std::ofstream(hub_state + "/littlefs/wifissid.txt") << "homenet";
+    std::ofstream(hub_state + "/littlefs/wifipass.txt") << "homepass";
+
+    Child hub = Spawn({HUB_HOST, "--ip", kHub, "--state", hub_state, "--clock-scale", kClockScale},
+                      root + "/hub.log", false);
+    Child sensor = Spawn({SENSOR_HOST, "--ip", kSensor, "--hub", kHub, "--state", sensor_state, "--clock-scale",
+                          kClockScale, "--script", std::string(SCRIPT_DIR) + "/sensor.txt"},
+                         root + "/sensor.log", true);
+    CHECK(hub.pid > 0 && sensor.pid > 0);
+
+    auto start = std::chrono::steady_clock::now();
+    bool joined = WaitFor(kSensor, 10000);
+    CHECK(joined);
+    std::string state = Get(kHub, "/api/state");
+    CHECK(state.find("\"module_joined\"") != std::string::npos);
+    // The hub's clock runs kClockScale times faster than ours.
+    size_t uptime = state.find("\"uptime\":");
+    long real_ms = static_cast<long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    CHECK(uptime != std::string::npos && std::atol(state.c_str() + uptime + 9) > 2 * real_ms);
+
+    // The boot phases ran, the hub was armable within a second.
+    std::string boot = Get(kHub, "/api/boot");
+    size_t armable = boot.find("\"armable_us\":");
+    CHECK(armable != std::string::npos);
+    if (armable != std::string::npos) {
+        long us = std::atol(boot.c_str() + armable + 13);
+        CHECK(us > 0 && us < 1000000);
+    }
+    size_t radio = boot.find("{\"name\":\"radio\",\"start_us\":");
+    CHECK(radio != std::string::npos);
+    // It had loopTask's stack, as when it ran in setup(). The host's tasks
+    // report all of it unused.
+    if (radio != std::string::npos) {
+        std::string phase = boot.substr(radio, boot.find('}', radio) - radio);
+        CHECK(phase.find("\"stack_free\":8192") != std::string::npos);
+    }
+
+    // The handlers so far built their JSON in the arena, the heap is ok
+    // and both of the hub's tasks are watched.
+    std::string resources = Get(kHub, "/api/resources");
+    CHECK(resources.find("\"level\":\"ok\"") != std::string::npos);
+    CHECK(resources.find("{\"name\":\"json\",\"size\":8192,\"peak\":") != std::string::npos);
+    CHECK(resources.find("\"spills\":0,\"refused\":0") != std::string::npos);
+    CHECK(resources.find("{\"name\":\"loopTask\",\"stack_free\":") != std::string::npos);
+    CHECK(resources.find("{\"name\":\"actuator\",\"stack_free\":") != std::string::npos);
+
+    // The setup page is kept gzipped only. No Accept-Encoding takes any
+    // coding, a client that refuses gzip is told so instead of getting
+    // compressed bytes, and a cached copy is revalidated either way.
+    std::string page = "GET / HTTP/1.1\r\nConnection: close\r\n";
+    std::string plain = Exchange(kHub, page + "\r\n");
+    CHECK(plain.rfind("HTTP/1.1 200 ", 0) == 0);
+    CHECK(plain.find("Content-Encoding: gzip\r\n") != std::string::npos);
+    CHECK(Exchange(kHub, page + "Accept-Encoding: gzip;q=0, identity\r\n\r\n").rfind("HTTP/1.1 406 ", 0) == 0);
+    CHECK(Exchange(kHub, page + "Accept-Encoding: identity\r\n\r\n").rfind("HTTP/1.1 406 ", 0) == 0);
+    std::string gzipped = Exchange(kHub, page + "Accept-Encoding: deflate, gzip;q=0.8\r\n\r\n");
+    CHECK(gzipped.rfind("HTTP/1.1 200 ", 0) == 0);
+    CHECK(gzipped.find("Content-Encoding: gzip\r\n") != std::string::npos);
+    size_t etag_at = gzipped.find("ETag: ");
+    CHECK(etag_at != std::string::npos);
+    if (etag_at != std::string::npos) {
+        std::string etag = gzipped.substr(etag_at + 6, gzipped.find("\r\n", etag_at) - etag_at - 6);
+        std::string cached = Exchange(kHub, page + "If-None-Match: " + etag + "\r\nAccept-Encoding: identity\r\n\r\n");
+        CHECK(cached.rfind("HTTP/1.1 304 ", 0) == 0);
+    }
+
+    // WebSocket: only version 13, and client frames have to be masked. An
+    // unmasked ping is a protocol error, the hub closes with 1002.
+    std::string upgrade = "GET /ws HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+    std::string old_version = Exchange(kHub, upgrade + "Sec-WebSocket-Version: 8\r\n\r\n");
+    CHECK(old_version.rfind("HTTP/1.1 426 ", 0) == 0);
+    CHECK(old_version.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos);
+    std::string unmasked = Exchange(kHub, upgrade + "Sec-WebSocket-Version: 13\r\n\r\n", std::string("\x89\x00", 2));
+    CHECK(unmasked.rfind("HTTP/1.1 101 ", 0) == 0);
+    CHECK(unmasked.size() >= 4 && unmasked.compare(unmasked.size() - 4, 4, std::string("\x88\x02\x03\xea", 4)) == 0);
+
+    // A subscriber gets a fresh state frame when a module joins or leaves,
+    // not only when it connects.
+    int ws = Connect(kHub);
+    CHECK(ws >= 0);
+    if (ws >= 0) {
+        std::string frames;
+        std::string subscribe = upgrade + "Sec-WebSocket-Version: 13\r\n\r\n";
+        send(ws, subscribe.data(), subscribe.size(), MSG_NOSIGNAL);
+        CHECK(ReadUntil(ws, "\"e\":\"state\"", &frames) && frames.find("\"modules\":1,") != std::string::npos);
+        frames.clear();
+        CHECK(Request(kHub, "POST", "/api/module", "alert=127.0.41.99") != "");
+        CHECK(ReadUntil(ws, "\"modules\":2,", &frames));
+        frames.clear();
+        CHECK(Request(kHub, "DELETE", "/api/module?alert=127.0.41.99", "") != "");
+        CHECK(ReadUntil(ws, "\"modules\":1,", &frames));
+        close(ws);
+    }
+
+    // Armed, but nothing moves in front of the sonar yet. The echoes go
+    // into a trace from here on.
+    CHECK(Request(kSensor, "POST", "/api/trace", "clear=1&record=1") == "recording");
+    SendUdp(kSensor, "turnonmotiondetectorespmotion");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(Get(kHub, "/api/state").find("\"intrusion\"") == std::string::npos);
+
+    const char* closer = "distance 40\n";
+    CHECK(write(sensor.input, closer, std::strlen(closer)) == static_cast<ssize_t>(std::strlen(closer)));
+    CHECK(WaitFor("\"intrusion\",\"detail\":\"127.0.41.2\"", 5000));
+
+    // Header and 4-byte records, the last one as close as the script says.
+    std::string trace = Get(kSensor, "/api/trace");
+    CHECK(trace.size() > 12 && trace.compare(0, 4, "SHTR") == 0 && (trace.size() - 12) % 4 == 0);
+    if (trace.size() >= 16) {
+        size_t last = trace.size() - 4;
+        unsigned echo_us = static_cast<uint8_t>(trace[last + 2]) | static_cast<uint8_t>(trace[last + 3]) << 8;
+        CHECK(echo_us > 2300 && echo_us < 2400);   // 40 cm
+        CHECK(static_cast<uint8_t>(trace[last + 1]) & 0x80);   // armed
+    }
+
+    // One intrusion relayed, seen on both sides. Histogram buckets are
+    // cumulative and end in the count.
+    std::string hub_metrics = Get(kHub, "/api/metrics");
+    CHECK(hub_metrics.compare(0, 7, "# HELP ") == 0);
+    CHECK(Metric(hub_metrics, "sentri_intrusions_total") >= 1);
+    CHECK(Metric(hub_metrics, "sentri_udp_received_total") >= Metric(hub_metrics, "sentri_intrusions_total"));
+    CHECK(Metric(hub_metrics, "sentri_modules") == 1);
+    CHECK(Metric(hub_metrics, "sentri_http_requests_total") > 3);
+    CHECK(Metric(hub_metrics, "sentri_resource_level") == 0);
+    CHECK(Metric(hub_metrics, "sentri_work_shed_total") == 0);
+    CHECK(Metric(hub_metrics, "sentri_heap_free_bytes") > 0);
+    CHECK(Metric(hub_metrics, "sentri_alert_handle_seconds_count") >= 1);
+    double loops = Metric(hub_metrics, "sentri_loop_seconds_count");
+    CHECK(loops > 0 && Metric(hub_metrics, "sentri_loop_seconds_bucket{le=\"+Inf\"}") == loops);
+    CHECK(Metric(hub_metrics, "sentri_loop_seconds_bucket{le=\"1.6e-05\"}") <= loops);
+    CHECK(hub_metrics.find("# TYPE sentri_loop_seconds histogram\n") != std::string::npos);
+    std::string sensor_metrics = Get(kSensor, "/api/metrics");
+    CHECK(Metric(sensor_metrics, "sentri_armed") == 1);
+    CHECK(Metric(sensor_metrics, "sentri_intrusions_total") >= 1);
+    CHECK(Metric(sensor_metrics, "sentri_udp_sent_total") >= 1);
+    CHECK(Metric(sensor_metrics, "sentri_distance_mm") > 350 && Metric(sensor_metrics, "sentri_distance_mm") < 450);
+    CHECK(Metric(sensor_metrics, "sentri_echo_wait_seconds_count") > 0);
+    CHECK(Metric(sensor_metrics, "sentri_heap_free_bytes") > 0);
+
+    // The alarm's flow starts on the sensor, passes the hub's UDP receive
+    // and ends at the servo; the two downloads line up through it.
+    std::vector<DeviceTrace> evtraces(2);
+    std::string error;
+    CHECK(ParseEvtrace(Get(kSensor, "/api/evtrace"), &evtraces[0], &error));
+    CHECK(ParseEvtrace(Get(kHub, "/api/evtrace"), &evtraces[1], &error));
+    uint32_t flow = 0;
+    for (const TraceEvent& e : evtraces[0].events) {
+        if (e.phase == 's' && e.name == "alarm") flow = e.id;
+    }
+    CHECK(flow != 0);
+    bool received = false, moved = false;
+    for (const TraceEvent& e : evtraces[1].events) {
+        if (e.id != flow) continue;
+        received = received || (e.phase == 't' && evtraces[1].threads[e.thread] == "loopTask");
+        moved = moved || (e.phase == 'f' && evtraces[1].threads[e.thread] == "actuator");
+    }
+    CHECK(received && moved);
+    // The boot phases' tasks are long gone, their names are not.
+    const std::vector<std::string>& hub_threads = evtraces[1].threads;
+    CHECK(std::find(hub_threads.begin(), hub_threads.end(), "radio") != hub_threads.end());
+    CHECK(std::find(hub_threads.begin(), hub_threads.end(), "report") != hub_threads.end());
+    AlignClocks(&evtraces);
+    CHECK(ChromeJson(evtraces).find("\"id\":" + std::to_string(flow) + ",\"bp\":\"e\"") != std::string::npos);
+    CHECK(Request(kHub, "POST", "/api/evtrace", "clear=1") != "");
+    DeviceTrace cleared;
+    CHECK(ParseEvtrace(Get(kHub, "/api/evtrace"), &cleared, &error));
+    CHECK(cleared.events.size() < evtraces[1].events.size());
+
+    // Settings are an NVS blob on each side, the hub's imported from the
+    // files. The app's SSID and password, sent one after the other, make
+    // one write.
+    CHECK(access((hub_state + "/nvs/config/config").c_str(), F_OK) == 0);
+    CHECK(access((sensor_state + "/nvs/config/config").c_str(), F_OK) == 0);
+    CHECK(access((sensor_state + "/littlefs/wifipass.txt").c_str(), F_OK) != 0);
+    CHECK(Get(kHub, "/api/creds").find("\"SSID\":\"homenet\",\"PASS\":\"homepass\"") != std::string::npos);
+    double writes = Metric(Get(kHub, "/api/metrics"), "sentri_config_writes_total");
+    CHECK(Request(kHub, "POST", "/api/newssid", "SSID=uplink") != "");
+    CHECK(Request(kHub, "POST", "/api/newpass", "pass=uplinkpass") != "");
+    CHECK(Metric(Get(kHub, "/api/metrics"), "sentri_config_writes_total") == writes);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));   // 4 s on the hub's clock
+    CHECK(Metric(Get(kHub, "/api/metrics"), "sentri_config_writes_total") == writes + 1);
+
+    // Both journals have the alarm, and the hub's outlives a restart.
+    std::string sensor_journal = Get(kSensor, "/api/journal");
+    CHECK(sensor_journal.find("\"type\":\"armed\"") != std::string::npos);
+    CHECK(sensor_journal.find("\"type\":\"intrusion\",\"detail\":\"40 cm\"") != std::string::npos);
+    std::string intrusion = "\"boot\":0,\"ms\":";
+    CHECK(Get(kHub, "/api/journal").find("\"type\":\"intrusion\",\"detail\":\"127.0.41.2\"") != std::string::npos);
+    Stop(&hub);
+    Child restarted = Spawn({HUB_HOST, "--ip", kHub, "--state", hub_state, "--clock-scale", kClockScale},
+                            root + "/hub2.log", false);
+    CHECK(WaitFor("\"wifi_connected\"", 10000));
+    std::string journal = Get(kHub, "/api/journal?limit=25");
+    CHECK(journal.find("\"boot\":1,\"records\":[") != std::string::npos);
+    size_t alarm = journal.find("\"type\":\"intrusion\",\"detail\":\"127.0.41.2\"");
+    CHECK(alarm != std::string::npos && journal.rfind(intrusion, alarm) != std::string::npos);
+    // The settings come back from the blob, nothing is written at boot.
+    CHECK(Get(kHub, "/api/creds").find("\"SSID\":\"uplink\"") != std::string::npos);
+    CHECK(Metric(Get(kHub, "/api/metrics"), "sentri_config_writes_total") == 0);
+
+    Stop(&sensor);
+    Stop(&restarted);
+    if (failures) {
+        Dump(hub);
+        Dump(restarted);
+        Dump(sensor);
+    }
+    std::string cleanup = "rm -rf " + root;
+    std::system(cleanup.c_str());
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    TestArgs();
+    TestIntrusion();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("host_test passed\n");
+    return 0;
+}
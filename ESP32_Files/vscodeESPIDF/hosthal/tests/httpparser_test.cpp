@@ -0,0 +1,193 @@
+// The hub's httpparser.cpp: known requests, Content-Length limits, random
+// and mutated input, and a benchmark that counts heap allocations per
+// parsed request. Prints requests/s and allocations per request.
+
+#include <limits.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "httpparser.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Every malloc, calloc and realloc of the process. Not with a sanitizer,
+// which brings its own.
+static size_t allocations = 0;
+
+#ifndef __SANITIZE_ADDRESS__
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static const int kFuzzRounds = 200000;
+static const int kBenchRequests = 300000;
+static const size_t kScratch = 2048;   // HUBSERVER_SCRATCH_SIZE
+
+static const char* kCorpus[] = {
+    "GET /api/state?since=1200 HTTP/1.1\r\nHost: 192.168.10.1\r\nAccept: application/json\r\n\r\n",
+    "POST /api/module HTTP/1.1\r\nHost: 192.168.10.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 22\r\n\r\nalert=192.168.10.2&k=1",
+    "GET /ws HTTP/1.1\r\nHost: hub\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+    "GET / HTTP/1.0\nIf-None-Match: \"abc\"\nAccept-Encoding: gzip, br\n\n",
+    "DELETE /api/module?alert=a%20b+c HTTP/1.1\r\n\r\n",
+};
+
+// buf holds the request and a NUL after it, as HubServer leaves it.
+static HttpParseResult Parse(std::vector<char>& buf, size_t len, HttpRequest& req) {
+    buf[len] = '\0';
+    return httpParseHead(buf.data(), len, req);
+}
+
+static bool Inside(const std::vector<char>& buf, size_t len, HttpView v) {
+    return v.len == 0 || (v.data >= buf.data() && v.data + v.len <= buf.data() + len);
+}
+
+static void TestKnown() {
+    std::vector<char> buf(kScratch + 1);
+    HttpRequest req;
+    std::string text = kCorpus[1];
+    memcpy(buf.data(), text.data(), text.size());
+    CHECK(Parse(buf, text.size(), req) == HTTP_PARSE_OK);
+    CHECK(req.method.equals("POST") && req.path.equals("/api/module"));
+    CHECK(req.contentLength == 22 && req.headLength + 22 == text.size());
+    CHECK(req.header(HDR_CONTENT_TYPE).startsWith("application/x-www-form-urlencoded"));
+
+    text = kCorpus[4];
+    memcpy(buf.data(), text.data(), text.size());
+    CHECK(Parse(buf, text.size(), req) == HTTP_PARSE_OK);
+    CHECK(req.arg("alert").equals("a b c"));
+
+    text = "GET / HTTP/1.1\r\nHost: h\r\n";
+    memcpy(buf.data(), text.data(), text.size());
+    CHECK(Parse(buf, text.size(), req) == HTTP_PARSE_INCOMPLETE);
+
+    HttpView big = { "99999999999999999999999", 23 };
+    CHECK(big.toInt() == LONG_MAX);
+}
+
+// A length that wrapped used to leave the rest of the body to be read as
+// the next request.
+static void TestContentLength() {
+    const char* good[] = {"0", "7", "123456789"};
+    const char* bad[] = {"4294967306", "1234567890", "12a", "-1", "1 2", "0x10"};
+    std::vector<char> buf(kScratch + 1);
+    HttpRequest req;
+    for (const char* value : good) {
+        std::string text = std::string("POST /x HTTP/1.1\r\nContent-Length: ") + value + "\r\n\r\n";
+        memcpy(buf.data(), text.data(), text.size());
+        CHECK(Parse(buf, text.size(), req) == HTTP_PARSE_OK);
+        CHECK(req.contentLength == std::strtoul(value, nullptr, 10));
+    }
+    for (const char* value : bad) {
+        std::string text = std::string("POST /x HTTP/1.1\r\nContent-Length: ") + value + "\r\n\r\n";
+        memcpy(buf.data(), text.data(), text.size());
+        CHECK(Parse(buf, text.size(), req) == HTTP_PARSE_ERROR);
+    }
+}
+
+// Mutated corpus entries and random bytes. A parse that succeeds has to
+// point inside the buffer and hold a length the server can check.
+static void TestFuzz() {
+    std::mt19937 rng(26);
+    std::vector<char> buf(kScratch + 1);
+    HttpRequest req;
+    const char alphabet[] = "GET /?&=%+:\r\n HTTP/1.1 Content-Length:0123456789abcXYZ\t";
+    for (int round = 0; round < kFuzzRounds; round++) {
+        std::string text;
+        if (round % 8 == 0) {
+            text.resize(rng() % 256);
+            for (char& c : text) c = static_cast<char>(rng());
+        } else {
+            text = kCorpus[rng() % (sizeof(kCorpus) / sizeof(kCorpus[0]))];
+            int edits = 1 + rng() % 6;
+            for (int e = 0; e < edits && !text.empty(); e++) {
+                size_t at = rng() % text.size();
+                switch (rng() % 4) {
+                    case 0: text[at] = static_cast<char>(rng()); break;
+                    case 1: text[at] = alphabet[rng() % (sizeof(alphabet) - 1)]; break;
+                    case 2: text.insert(at, 1, alphabet[rng() % (sizeof(alphabet) - 1)]); break;
+                    case 3: text.erase(at, 1 + rng() % 8); break;
+                }
+            }
+        }
+        if (text.size() > kScratch) text.resize(kScratch);
+        memcpy(buf.data(), text.data(), text.size());
+        if (Parse(buf, text.size(), req) != HTTP_PARSE_OK) continue;
+        CHECK(req.headLength <= text.size());
+        CHECK(Inside(buf, text.size(), req.method) && Inside(buf, text.size(), req.path));
+        CHECK(req.contentLength < 1000000000);
+        CHECK(req.argCount >= 0 && req.argCount <= HTTP_MAX_ARGS);
+        for (int i = 0; i < req.argCount; i++) {
+            CHECK(Inside(buf, text.size(), req.args[i].name) && Inside(buf, text.size(), req.args[i].value));
+        }
+        for (int h = 0; h < HDR_COUNT; h++) CHECK(Inside(buf, text.size(), req.header(static_cast<HttpHeaderId>(h))));
+    }
+}
+
+static void Bench() {
+    std::vector<std::string> requests(kCorpus, kCorpus + sizeof(kCorpus) / sizeof(kCorpus[0]));
+    std::vector<char> buf(kScratch + 1);
+    HttpRequest req;
+    size_t parsed = 0;
+    size_t before = allocations;
+#ifndef __SANITIZE_ADDRESS__
+    CHECK(before > 0);   // the fuzzer's strings: the counter is hooked up
+#endif
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchRequests; i++) {
+        const std::string& text = requests[i % requests.size()];
+        memcpy(buf.data(), text.data(), text.size());
+        if (Parse(buf, text.size(), req) == HTTP_PARSE_OK) parsed++;
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t allocated = allocations - before;
+    CHECK(parsed == static_cast<size_t>(kBenchRequests));
+    CHECK(allocated == 0);
+    std::printf("httpparser_test: %.0f requests/s, %.2f allocations per request\n", kBenchRequests / s,
+                static_cast<double>(allocated) / kBenchRequests);
+}
+
+int main() {
+    TestKnown();
+    TestContentLength();
+    TestFuzz();
+    Bench();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("httpparser_test passed\n");
+    return 0;
+}
@@ -0,0 +1,192 @@
+// The sensor's journal.cpp on a four sector partition file: appends,
+// reboots, a write and an erase cut short by power loss, and laps round
+// the partition.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "hal.hpp"
+#include "journal.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static const int kSectors = 4;
+static std::string flash;
+
+static const char* Name(uint8_t type) {
+    return type == 1 ? "one" : "other";
+}
+
+// A page as the API would send it.
+static std::string Page(uint32_t before, int limit) {
+    journalpage page(before, limit, Name);
+    String text;
+    struct : Print {
+        String* text;
+        size_t write(uint8_t c) override {
+            *text += static_cast<char>(c);
+            return 1;
+        }
+    } out;
+    out.text = &text;
+    size_t n = page.printTo(out);
+    CHECK(n == page.length());
+    return text.c_str();
+}
+
+// The seq numbers in a page, in its order.
+static std::vector<uint32_t> Seqs(const std::string& page) {
+    std::vector<uint32_t> seqs;
+    for (size_t at = page.find("{\"seq\":"); at != std::string::npos; at = page.find("{\"seq\":", at + 1)) {
+        seqs.push_back(static_cast<uint32_t>(std::strtoul(page.c_str() + at + 7, nullptr, 10)));
+    }
+    return seqs;
+}
+
+static void Poke(size_t offset, const std::vector<uint8_t>& bytes) {
+    int fd = open(flash.c_str(), O_WRONLY);
+    CHECK(fd >= 0 && pwrite(fd, bytes.data(), bytes.size(), offset) == static_cast<ssize_t>(bytes.size()));
+    close(fd);
+}
+
+static void TestAppendAndReboot() {
+    CHECK(journalbegin());
+    CHECK(journaloldest() == 0 && journalnext() == 0 && journalboot() == 0);
+    CHECK(Page(0, 10) == "{\"oldest\":0,\"next\":0,\"boot\":0,\"records\":[]}");
+    CHECK(journalappend(1, "192.168.100.200"));
+    CHECK(journalappend(2));
+    CHECK(journalappend(1, "a \"quoted\" name too long to keep"));
+    std::string page = Page(0, 10);
+    CHECK(Seqs(page) == std::vector<uint32_t>({2, 1, 0}));
+    CHECK(page.find("\"type\":\"one\",\"detail\":\"192.168.100.200\"}") != std::string::npos);
+    CHECK(page.find("\"detail\":\"a \\\"quoted\\\" name\"}") != std::string::npos);
+    CHECK(page.find("\"more\"") == std::string::npos);
+    CHECK(Seqs(Page(0, 2)) == std::vector<uint32_t>({2, 1}));
+    CHECK(Page(0, 2).find(",\"more\":true}") != std::string::npos);
+    CHECK(Seqs(Page(1, 2)) == std::vector<uint32_t>({0}));
+
+    // Numbering goes on after a reboot, under the next boot number.
+    CHECK(journalbegin());
+    CHECK(journalnext() == 3 && journalboot() == 1);
+    CHECK(journalappend(2));
+    CHECK(Page(0, 1).find("{\"seq\":3,\"boot\":1,") != std::string::npos);
+}
+
+static void TestTornWrite() {
+    // Power went while the slot after seq 3 was programmed.
+    size_t slot = JOURNAL_SLOT * 5;
+    Poke(slot, {0x04, 0x00, 0x00, 0x00, 0x12});
+    uint32_t corrupt = journalcorrupt();
+    CHECK(journalbegin());
+    CHECK(journalnext() == 4);
+    CHECK(journalappend(1));
+    CHECK(Seqs(Page(0, 10)) == std::vector<uint32_t>({4, 3, 2, 1, 0}));
+    CHECK(journalcorrupt() > corrupt);
+}
+
+static void TestLaps() {
+    // Past the end of the partition: the oldest sector goes each time a
+    // new head is started, and what is left pages through unbroken.
+    for (int i = 0; i < 4 * JOURNAL_RECORDS_PER_SECTOR; i++) CHECK(journalappend(2));
+    uint32_t next = journalnext();
+    uint32_t oldest = journaloldest();
+    CHECK(next == 5 + 4 * JOURNAL_RECORDS_PER_SECTOR);
+    CHECK(oldest > 0 && next - oldest <= static_cast<uint32_t>(kSectors * JOURNAL_RECORDS_PER_SECTOR));
+    CHECK(next - oldest > static_cast<uint32_t>((kSectors - 1) * JOURNAL_RECORDS_PER_SECTOR));
+    uint32_t expect = next;
+    int pages = 0;
+    for (uint32_t before = 0;; pages++) {
+        std::string page = Page(before, JOURNAL_PAGE_MAX);
+        for (uint32_t seq : Seqs(page)) CHECK(seq == --expect);
+        if (page.find("\"more\"") == std::string::npos) break;
+        before = expect;
+    }
+    CHECK(expect == oldest);
+    CHECK(pages > 10);
+
+    // The same after a reboot, from the index it rebuilds.
+    CHECK(journalbegin());
+    CHECK(journalnext() == next && journaloldest() == oldest);
+    CHECK(Seqs(Page(oldest + 2, 5)) == std::vector<uint32_t>({oldest + 1, oldest}));
+}
+
+static void TestTimes() {
+    uint64_t before = journaltime(journalboot(), 0);
+    CHECK(journalseqafter(before) == journalnext());
+    CHECK(journalseqafter(0) == journaloldest());
+    CHECK(journalseqafter(~0ULL) == journalnext());
+    uint32_t seq = journalnext();
+    delay(5);
+    CHECK(journalappend(1));
+    CHECK(journalseqafter(journaltime(journalboot(), ~0ULL >> 16)) == seq + 1);
+}
+
+static void TestCutErase() {
+    // Lose power right after the erase that starts a new head, before its
+    // header went on: the journal picks up where it was with that sector
+    // blank.
+    uint32_t oldest = journaloldest();
+    while (journaloldest() == oldest) CHECK(journalappend(2));
+    uint32_t next = journalnext() - 1;
+    oldest = journaloldest();
+    std::ifstream in(flash, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), {});
+    // The new head holds just the record that started it.
+    int sector = -1;
+    for (int s = 0; s < kSectors; s++) {
+        if (static_cast<uint8_t>(bytes[s * JOURNAL_SECTOR + JOURNAL_SLOT]) != 0xff &&
+            static_cast<uint8_t>(bytes[s * JOURNAL_SECTOR + 2 * JOURNAL_SLOT]) == 0xff) {
+            sector = s;
+        }
+    }
+    CHECK(sector >= 0);
+    if (sector < 0) return;
+    Poke(sector * JOURNAL_SECTOR, std::vector<uint8_t>(JOURNAL_SECTOR, 0xff));
+    CHECK(journalbegin());
+    CHECK(journalnext() == next && journaloldest() == oldest);
+    CHECK(journalappend(1));
+    CHECK(journalnext() == next + 1);
+    CHECK(Seqs(Page(0, 2)) == std::vector<uint32_t>({next, next - 1}));
+}
+
+int main() {
+    char dir[] = "/tmp/journal_test_XXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    std::string root = dir;
+    std::ofstream(root + "/partitions.csv") << "# Name, Type, SubType, Offset, Size\n"
+                                               "nvs,     data, nvs,     ,       0x6000,\n"
+                                               "journal, data, 0x40,    ,       0x4000,\n";
+    hal::Settings().state = root;
+    hal::Settings().partitions = root + "/partitions.csv";
+    flash = root + "/flash/journal.bin";
+
+    TestAppendAndReboot();
+    TestTornWrite();
+    TestLaps();
+    TestTimes();
+    TestCutErase();
+
+    std::string cleanup = "rm -rf " + root;
+    std::system(cleanup.c_str());
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("journal_test passed\n");
+    return 0;
+}
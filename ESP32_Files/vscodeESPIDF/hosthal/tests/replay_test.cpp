@@ -0,0 +1,158 @@
+// tracereplay's scoring on made-up traces: a quiet room with the odd one
+// reading echo off something closer, and people walking up to the sensor
+// at known times.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static uint16_t Echo(double cm) {
+    return static_cast<uint16_t>(cm * 2 / 0.0343);
+}
+
+// minutes of readings every 200 ms at 300 cm, +-2 cm of noise, a spike to
+// 250 cm every 97th reading, and a walk-up at each of events: 300 to 80 cm
+// over 2 s, 5 s standing there, then gone.
+static Trace MakeTrace(int minutes, const std::vector<uint32_t>& events, bool armed) {
+    Trace trace;
+    trace.name = "synthetic";
+    std::mt19937 random(7);
+    uint32_t end = minutes * 60000;
+    for (uint32_t t = 0, i = 0; t < end; t += 200, i++) {
+        double cm = 300 + static_cast<int>(random() % 5) - 2;
+        if (i % 97 == 50) cm = 250;
+        for (uint32_t start : events) {
+            if (t >= start && t < start + 2000) cm = 300 - 220.0 * (t - start) / 2000;
+            if (t >= start + 2000 && t < start + 7000) cm = 80;
+        }
+        trace.samples.push_back({t, Echo(cm), armed});
+    }
+    for (uint32_t start : events) trace.labels.push_back({start, start + 7000});
+    return trace;
+}
+
+static void TestFormat() {
+    Trace trace = MakeTrace(1, {20000}, true);
+    trace.samples[3].armed = false;
+    std::string bytes = EncodeTrace(trace.samples);
+    CHECK(bytes.size() == 12 + 4 * trace.samples.size());
+    CHECK(bytes.compare(0, 4, "SHTR") == 0);
+    std::vector<Sample> back;
+    std::string error;
+    CHECK(ParseTrace(bytes, &back, &error));
+    CHECK(back.size() == trace.samples.size());
+    bool same = back.size() == trace.samples.size();
+    for (size_t i = 0; same && i < back.size(); i++) {
+        same = back[i].t_ms == trace.samples[i].t_ms && back[i].echo_us == trace.samples[i].echo_us &&
+               back[i].armed == trace.samples[i].armed;
+    }
+    CHECK(same);
+
+    CHECK(!ParseTrace("SHTX" + bytes.substr(4), &back, &error));
+    CHECK(!ParseTrace(bytes.substr(0, bytes.size() - 2), &back, &error));
+    std::string newer = bytes;
+    newer[4] = 2;
+    CHECK(!ParseTrace(newer, &back, &error));
+
+    std::vector<Interval> labels;
+    CHECK(ParseLabels("# walk-ins\n5000 9000\n\n1000 2000  # early\n", &labels, &error));
+    CHECK(labels.size() == 2 && labels[0].start_ms == 1000 && labels[1].end_ms == 9000);
+    CHECK(!ParseLabels("5000\n", &labels, &error));
+    CHECK(!ParseLabels("9000 5000\n", &labels, &error));
+}
+
+static void TestScore() {
+    std::vector<Trace> corpus = {MakeTrace(60, {60000, 600000, 1800000, 3000000}, true)};
+    ReplayOptions options;
+
+    // The sensor as it ships: every walk-up found within a reading or two,
+    // and every spike a false alarm.
+    Score shipped = Replay(corpus, detectdefaults, options);
+    CHECK(shipped.events == 4);
+    CHECK(shipped.detected == 4);
+    CHECK(shipped.delay_max_ms <= 400);
+    CHECK(shipped.false_alarms > 100);
+    CHECK(shipped.hours > 0.99 && shipped.hours < 1.01);
+
+    // A spike is one reading, a walk-up several in a row.
+    detectparams confirm2 = {10, 2, 0};
+    Score confirmed = Replay(corpus, confirm2, options);
+    CHECK(confirmed.detected == 4);
+    CHECK(confirmed.false_alarms == 0);
+    CHECK(confirmed.delay_p50_ms > shipped.delay_p50_ms);
+
+    // Past the spike's 50 cm they are gone too, past the walk-up's 22 cm
+    // steps so is everything else.
+    detectparams drop = {60, 1, 0};
+    Score high = Replay(corpus, drop, options);
+    CHECK(high.detected == 0 && high.false_alarms == 0);
+
+    // The spike reads 250 cm, beyond maxcm it is not looked at.
+    detectparams nearonly = {10, 1, 240};
+    CHECK(Replay(corpus, nearonly, options).false_alarms == 0);
+
+    std::vector<Trace> disarmed = {MakeTrace(5, {60000}, false)};
+    options.armed_only = true;
+    Score off = Replay(disarmed, detectdefaults, options);
+    CHECK(off.detected == 0 && off.false_alarms == 0);
+}
+
+static void TestSweep() {
+    std::vector<Trace> corpus = {MakeTrace(30, {100000, 900000}, true), MakeTrace(20, {300000}, true)};
+    std::vector<detectparams> grid;
+    for (int confirm = 1; confirm <= 2; confirm++) {
+        for (float drop = 2; drop <= 60; drop += 4) grid.push_back({drop, confirm, 0});
+    }
+    ReplayOptions options;
+    std::vector<Score> serial = Sweep(corpus, grid, options, 1);
+    std::vector<Score> parallel = Sweep(corpus, grid, options, 4);
+    CHECK(serial.size() == grid.size() && parallel.size() == grid.size());
+    bool same = serial.size() == parallel.size();
+    for (size_t i = 0; same && i < serial.size(); i++) {
+        same = serial[i].params.dropcm == grid[i].dropcm && parallel[i].params.dropcm == grid[i].dropcm &&
+               serial[i].tp == parallel[i].tp && serial[i].fp == parallel[i].fp &&
+               serial[i].false_alarms == parallel[i].false_alarms && serial[i].detected == parallel[i].detected;
+    }
+    CHECK(same);
+
+    std::vector<RocCurve> curves = RocCurves(serial);
+    CHECK(curves.size() == 2);
+    for (const RocCurve& curve : curves) {
+        CHECK(curve.points.size() == 15);
+        CHECK(curve.auc >= 0 && curve.auc <= 1);
+        // A higher drop never finds more.
+        for (size_t i = 1; i < curve.points.size(); i++) {
+            CHECK(curve.points[i]->Tpr() <= curve.points[i - 1]->Tpr());
+            CHECK(curve.points[i]->Fpr() <= curve.points[i - 1]->Fpr());
+        }
+    }
+    // Confirming twice drops the spikes and keeps the walk-ups.
+    CHECK(curves.size() == 2 && curves[1].auc > curves[0].auc);
+}
+
+int main() {
+    TestFormat();
+    TestScore();
+    TestSweep();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("replay_test passed\n");
+    return 0;
+}
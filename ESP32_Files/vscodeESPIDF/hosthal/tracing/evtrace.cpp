@@ -0,0 +1,309 @@
+#include "evtrace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+// Keep in step with evtrace.h.
+const char kMagic[] = "SHEV";
+const int kVersion = 1;
+
+uint64_t GetLe(const std::string& bytes, size_t at, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) value = value << 8 | static_cast<uint8_t>(bytes[at + i]);
+    return value;
+}
+
+void PutLe(std::string* out, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+// A length byte and that many bytes at *at.
+bool GetName(const std::string& bytes, size_t* at, std::string* name) {
+    if (*at >= bytes.size()) return false;
+    size_t len = static_cast<uint8_t>(bytes[*at]);
+    if (*at + 1 + len > bytes.size()) return false;
+    *name = bytes.substr(*at + 1, len);
+    *at += 1 + len;
+    return true;
+}
+
+void PutName(std::string* out, const std::string& name) {
+    size_t len = std::min<size_t>(name.size(), 255);
+    out->push_back(static_cast<char>(len));
+    out->append(name, 0, len);
+}
+
+bool ReadFile(const std::string& path, std::string* bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream out;
+    out << in.rdbuf();
+    *bytes = out.str();
+    return true;
+}
+
+bool IsFlow(char phase) {
+    return phase == 's' || phase == 't' || phase == 'f';
+}
+
+// Where in its flow an event is.
+int FlowRank(char phase) {
+    return phase == 's' ? 0 : phase == 't' ? 1 : 2;
+}
+
+std::string Escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            out += code;
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+struct FlowPoint {
+    int rank;
+    int64_t us;
+};
+
+typedef std::map<uint32_t, std::vector<FlowPoint>> FlowIndex;
+
+void IndexFlows(const DeviceTrace& trace, int64_t shift, FlowIndex* flows) {
+    for (const TraceEvent& e : trace.events) {
+        if (IsFlow(e.phase) && e.id) (*flows)[e.id].push_back({FlowRank(e.phase), e.us + shift});
+    }
+}
+
+// The shift of trace onto the clock of flows, false when they share none.
+bool FlowShift(const DeviceTrace& trace, const FlowIndex& flows, int64_t* shift) {
+    bool lower = false, upper = false;
+    int64_t at_least = 0, at_most = 0;
+    for (const TraceEvent& e : trace.events) {
+        if (!IsFlow(e.phase) || !e.id) continue;
+        auto found = flows.find(e.id);
+        if (found == flows.end()) continue;
+        int rank = FlowRank(e.phase);
+        for (const FlowPoint& p : found->second) {
+            int64_t bound = p.us - e.us;
+            if (p.rank < rank) {
+                at_least = lower ? std::max(at_least, bound) : bound;
+                lower = true;
+            } else if (p.rank > rank) {
+                at_most = upper ? std::min(at_most, bound) : bound;
+                upper = true;
+            }
+        }
+    }
+    if (lower) *shift = at_least;
+    else if (upper) *shift = at_most;
+    return lower || upper;
+}
+
+void Emit(std::string* out, bool* first, const std::string& event) {
+    out->append(*first ? "\n" : ",\n");
+    out->append(event);
+    *first = false;
+}
+
+std::string Event(const char* phase, const std::string& name, int pid, int tid, int64_t us) {
+    return "{\"ph\":\"" + std::string(phase) + "\",\"name\":\"" + Escape(name) + "\",\"pid\":" +
+           std::to_string(pid) + ",\"tid\":" + std::to_string(tid) + ",\"ts\":" + std::to_string(us);
+}
+
+}  // namespace
+
+bool ParseEvtrace(const std::string& bytes, DeviceTrace* trace, std::string* error) {
+    if (bytes.size() < 12 || bytes.compare(0, 4, kMagic) != 0) {
+        *error = "not an event trace";
+        return false;
+    }
+    if (static_cast<uint8_t>(bytes[4]) != kVersion) {
+        *error = "event trace version " + std::to_string(static_cast<uint8_t>(bytes[4]));
+        return false;
+    }
+    size_t threads = static_cast<uint8_t>(bytes[5]);
+    uint32_t events = static_cast<uint32_t>(GetLe(bytes, 8, 4));
+    size_t at = 12;
+    trace->threads.clear();
+    trace->events.clear();
+    for (size_t i = 0; i < threads; i++) {
+        std::string name;
+        if (!GetName(bytes, &at, &name)) {
+            *error = "truncated thread names";
+            return false;
+        }
+        trace->threads.push_back(name);
+    }
+    for (uint32_t i = 0; i < events; i++) {
+        if (at + 14 > bytes.size()) {
+            *error = "truncated at event " + std::to_string(i);
+            return false;
+        }
+        TraceEvent e;
+        e.us = static_cast<int64_t>(GetLe(bytes, at, 8));
+        e.id = static_cast<uint32_t>(GetLe(bytes, at + 8, 4));
+        e.phase = bytes[at + 12];
+        e.thread = static_cast<uint8_t>(bytes[at + 13]);
+        at += 14;
+        if (!GetName(bytes, &at, &e.name)) {
+            *error = "truncated at event " + std::to_string(i);
+            return false;
+        }
+        if (e.thread >= threads) {
+            *error = "event " + std::to_string(i) + " on unknown thread " + std::to_string(e.thread);
+            return false;
+        }
+        trace->events.push_back(e);
+    }
+    if (at != bytes.size()) {
+        *error = std::to_string(bytes.size() - at) + " bytes after the last event";
+        return false;
+    }
+    return true;
+}
+
+std::string EncodeEvtrace(const DeviceTrace& trace) {
+    std::string out(kMagic, 4);
+    out.push_back(static_cast<char>(kVersion));
+    out.push_back(static_cast<char>(trace.threads.size()));
+    PutLe(&out, 0, 2);
+    PutLe(&out, trace.events.size(), 4);
+    for (const std::string& name : trace.threads) PutName(&out, name);
+    for (const TraceEvent& e : trace.events) {
+        PutLe(&out, static_cast<uint64_t>(e.us), 8);
+        PutLe(&out, e.id, 4);
+        out.push_back(e.phase);
+        out.push_back(static_cast<char>(e.thread));
+        PutName(&out, e.name);
+    }
+    return out;
+}
+
+bool LoadEvtrace(const std::string& arg, DeviceTrace* trace, std::string* error) {
+    size_t equals = arg.find('=');
+    std::string path = arg.substr(0, equals);
+    if (equals != std::string::npos) {
+        trace->name = arg.substr(equals + 1);
+    } else {
+        size_t slash = path.rfind('/');
+        trace->name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+        trace->name = trace->name.substr(0, trace->name.rfind('.'));
+    }
+    std::string bytes;
+    if (!ReadFile(path, &bytes)) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    if (!ParseEvtrace(bytes, trace, error)) {
+        *error = path + ": " + *error;
+        return false;
+    }
+    return true;
+}
+
+std::vector<int64_t> AlignClocks(std::vector<DeviceTrace>* traces) {
+    size_t count = traces->size();
+    std::vector<int64_t> shifts(count, 0);
+    std::vector<bool> aligned(count, false);
+    if (count == 0) return shifts;
+    aligned[0] = true;
+    FlowIndex flows;
+    IndexFlows((*traces)[0], 0, &flows);
+    // Each pass shifts the traces that share a flow with one shifted
+    // before, so a chain of devices gets there too.
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (size_t i = 1; i < count; i++) {
+            if (aligned[i] || !FlowShift((*traces)[i], flows, &shifts[i])) continue;
+            aligned[i] = true;
+            IndexFlows((*traces)[i], shifts[i], &flows);
+            progress = true;
+        }
+    }
+    const std::vector<TraceEvent>& reference = (*traces)[0].events;
+    for (size_t i = 1; i < count; i++) {
+        const std::vector<TraceEvent>& events = (*traces)[i].events;
+        if (aligned[i] || reference.empty() || events.empty()) continue;
+        shifts[i] = reference.back().us - events.back().us;
+    }
+
+    int64_t earliest = 0;
+    bool any = false;
+    for (size_t i = 0; i < count; i++) {
+        const std::vector<TraceEvent>& events = (*traces)[i].events;
+        if (events.empty()) continue;
+        earliest = any ? std::min(earliest, events.front().us + shifts[i]) : events.front().us + shifts[i];
+        any = true;
+    }
+    for (size_t i = 0; i < count; i++) {
+        shifts[i] -= earliest;
+        for (TraceEvent& e : (*traces)[i].events) e.us += shifts[i];
+    }
+    return shifts;
+}
+
+std::string ChromeJson(const std::vector<DeviceTrace>& traces) {
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (size_t p = 0; p < traces.size(); p++) {
+        const DeviceTrace& trace = traces[p];
+        int pid = static_cast<int>(p) + 1;
+        Emit(&out, &first, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + std::to_string(pid) +
+                               ",\"args\":{\"name\":\"" + Escape(trace.name) + "\"}}");
+        for (size_t t = 0; t < trace.threads.size(); t++) {
+            Emit(&out, &first, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + std::to_string(pid) +
+                                   ",\"tid\":" + std::to_string(t) + ",\"args\":{\"name\":\"" +
+                                   Escape(trace.threads[t]) + "\"}}");
+        }
+        std::vector<std::vector<std::string>> open(trace.threads.size());
+        for (const TraceEvent& e : trace.events) {
+            std::vector<std::string>& slices = open[e.thread];
+            switch (e.phase) {
+                case 'B':
+                    slices.push_back(e.name);
+                    Emit(&out, &first, Event("B", e.name, pid, e.thread, e.us) + "}");
+                    break;
+                case 'E':
+                    if (slices.empty()) break;
+                    slices.pop_back();
+                    Emit(&out, &first, Event("E", e.name, pid, e.thread, e.us) + "}");
+                    break;
+                case 'i':
+                    Emit(&out, &first, Event("i", e.name, pid, e.thread, e.us) + ",\"s\":\"t\"}");
+                    break;
+                case 's':
+                case 't':
+                case 'f': {
+                    std::string flow = Event(std::string(1, e.phase).c_str(), e.name, pid, e.thread, e.us) +
+                                       ",\"cat\":\"" + Escape(e.name) + "\",\"id\":" + std::to_string(e.id);
+                    // Into the slice the end is in, not the next one.
+                    if (e.phase == 'f') flow += ",\"bp\":\"e\"";
+                    Emit(&out, &first, flow + "}");
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        int64_t end = trace.events.empty() ? 0 : trace.events.back().us;
+        for (size_t t = 0; t < open.size(); t++) {
+            for (auto name = open[t].rbegin(); name != open[t].rend(); ++name) {
+                Emit(&out, &first, Event("E", *name, pid, static_cast<int>(t), end) + "}");
+            }
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
@@ -0,0 +1,46 @@
+#ifndef HOSTHAL_EVTRACE_HPP
+#define HOSTHAL_EVTRACE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Event traces the firmwares recorded (GET /api/evtrace, format in either
+// firmware's evtrace.h) as one Chrome trace event JSON file, which
+// ui.perfetto.dev and chrome://tracing open.
+
+struct TraceEvent {
+    int64_t us;             // the device's esp_timer, shifted by AlignClocks
+    uint32_t id;            // flow id, 0 for slices and instants
+    char phase;             // 'B', 'E', 'i', 's', 't' or 'f'
+    uint8_t thread;         // into DeviceTrace::threads
+    std::string name;
+};
+
+struct DeviceTrace {
+    std::string name;       // the process in the viewer
+    std::vector<std::string> threads;
+    std::vector<TraceEvent> events;   // oldest first
+};
+
+bool ParseEvtrace(const std::string& bytes, DeviceTrace* trace, std::string* error);
+std::string EncodeEvtrace(const DeviceTrace& trace);
+// FILE or FILE=NAME, the name defaulting to the file's without directory
+// and extension.
+bool LoadEvtrace(const std::string& arg, DeviceTrace* trace, std::string* error);
+
+// The devices' clocks started at their boots. The first trace keeps its
+// clock, the others are shifted onto it through the flows they share
+// with a trace already shifted: an event of a flow cannot come before the
+// one that went ahead of it (s, then t, then f), and the network is taken
+// to be as fast as that allows. A trace sharing no flow is lined up by its
+// last event, the downloads being a moment apart. Then everything moves so
+// the earliest event is at 0. The shifts come back in the order of traces.
+std::vector<int64_t> AlignClocks(std::vector<DeviceTrace>* traces);
+
+// A process per trace, a thread per thread. A slice still open at the end
+// of its trace is closed there, an end without its begin (the begin fell
+// out of the ring) is dropped.
+std::string ChromeJson(const std::vector<DeviceTrace>& traces);
+
+#endif
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "evtrace.hpp"
+
+namespace {
+
+const char* kUsage =
+    "usage: evtracejson [options] FILE[=NAME]...\n"
+    "  -o, --output FILE  where the JSON goes, standard output by default\n"
+    "FILE is a download of GET /api/evtrace, NAME its process in the viewer\n"
+    "(the file name by default). The first file's clock is the reference.\n";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string output;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::fputs(kUsage, stdout);
+            return 0;
+        }
+        if (arg == "-o" || arg == "--output") {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value\n%s", arg.c_str(), kUsage);
+                return 2;
+            }
+            output = argv[++i];
+            continue;
+        }
+        if (arg.size() > 1 && arg[0] == '-') {
+            std::fprintf(stderr, "unknown option %s\n%s", arg.c_str(), kUsage);
+            return 2;
+        }
+        args.push_back(arg);
+    }
+    if (args.empty()) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    std::vector<DeviceTrace> traces(args.size());
+    std::string error;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!LoadEvtrace(args[i], &traces[i], &error)) {
+            std::fprintf(stderr, "evtracejson: %s\n", error.c_str());
+            return 2;
+        }
+    }
+    std::vector<int64_t> shifts = AlignClocks(&traces);
+    for (size_t i = 0; i < traces.size(); i++) {
+        std::fprintf(stderr, "%s: %zu events on %zu threads, clock %+lld us\n", traces[i].name.c_str(),
+                     traces[i].events.size(), traces[i].threads.size(), static_cast<long long>(shifts[i]));
+    }
+
+    std::string json = ChromeJson(traces);
+    if (output.empty()) {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+        return 0;
+    }
+    std::ofstream out(output, std::ios::binary);
+    out << json;
+    if (!out) {
+        std::fprintf(stderr, "evtracejson: cannot write %s\n", output.c_str());
+        return 2;
+    }
+    return 0;
+}
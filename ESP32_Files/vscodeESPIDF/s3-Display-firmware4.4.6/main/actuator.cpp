@@ -0,0 +1,151 @@
+#include "actuator.h"
+#include <ESP32Servo.h>
+#include "evtrace.h"
+
+static Servo servo;
+static QueueHandle_t actuatorQueue = nullptr;
+static TaskHandle_t actuatorHandle = nullptr;
+static volatile bool busy = false;
+
+// One trapezoidal move: accelerate, cruise, decelerate. Falls back to a
+// triangle when the distance is too short to reach full speed.
+struct MotionProfile {
+    float from;
+    float to;
+    float accelTime;
+    float cruiseTime;
+    float peakVel;
+    float elapsed;
+
+    void start(float a, float b) {
+        from = a;
+        to = b;
+        elapsed = 0;
+        float dist = fabsf(b - a);
+        accelTime = ACTUATOR_MAX_VEL / ACTUATOR_MAX_ACCEL;
+        float accelDist = 0.5f * ACTUATOR_MAX_ACCEL * accelTime * accelTime;
+        if (2 * accelDist >= dist) {
+            accelTime = sqrtf(dist / ACTUATOR_MAX_ACCEL);
+            cruiseTime = 0;
+        } else {
+            cruiseTime = (dist - 2 * accelDist) / ACTUATOR_MAX_VEL;
+        }
+        peakVel = ACTUATOR_MAX_ACCEL * accelTime;
+    }
+
+    bool done() const { return elapsed >= 2 * accelTime + cruiseTime; }
+
+    float step(float dt) {
+        elapsed += dt;
+        float t = elapsed;
+        float s;
+        if (t < accelTime) {
+            s = 0.5f * ACTUATOR_MAX_ACCEL * t * t;
+        } else if (t < accelTime + cruiseTime) {
+            s = 0.5f * peakVel * accelTime + peakVel * (t - accelTime);
+        } else if (!done()) {
+            float td = t - accelTime - cruiseTime;
+            s = 0.5f * peakVel * accelTime + peakVel * cruiseTime + peakVel * td - 0.5f * ACTUATOR_MAX_ACCEL * td * td;
+        } else {
+            return to;
+        }
+        return to >= from ? from + s : from - s;
+    }
+};
+
+static void servoWriteAngle(float angle){
+    int us = ACTUATOR_MIN_US + (int)((ACTUATOR_MAX_US - ACTUATOR_MIN_US) * angle / 180.0f);
+    servo.writeMicroseconds(us);
+}
+
+static void actuatorTask(void*){
+    MotionProfile motion = {};
+    float position = 0;
+    bool moving = false;
+    int sweepLegs = 0;       // alarm legs still to run after the current move
+    TickType_t lastWake = xTaskGetTickCount();
+
+    servoWriteAngle(position);
+
+    for (;;) {
+        // Drain everything that arrived since the last frame. Redundant
+        // commands collapse here instead of queueing up motion.
+        ActuatorCommand cmd;
+        bool wasMoving = moving;
+        while (xQueueReceive(actuatorQueue, &cmd, 0) == pdTRUE) {
+            switch (cmd.type) {
+                case ACT_STOP:
+                    moving = false;
+                    sweepLegs = 0;
+                    break;
+                case ACT_MOVE:
+                    sweepLegs = 0;
+                    motion.start(position, cmd.angle);
+                    moving = true;
+                    break;
+                case ACT_ALARM:
+                    if (sweepLegs == 0) {
+                        motion.start(position, 180);
+                        moving = true;
+                        sweepLegs = 2 * ACTUATOR_ALARM_SWEEPS - 1;
+                    } else {
+                        sweepLegs += 2 * ACTUATOR_ALARM_SWEEPS;
+                        if (sweepLegs > 2 * ACTUATOR_ALARM_MAX_SWEEPS) sweepLegs = 2 * ACTUATOR_ALARM_MAX_SWEEPS;
+                    }
+                    break;
+            }
+            // A "servo" slice covers each run of moves, the flows of the
+            // commands that started or extended it end in it.
+            if (moving && !wasMoving) {
+                evtracebegin("servo");
+                wasMoving = true;
+            }
+            if (moving) evtraceflow(EVTRACE_FLOW_END, "alarm", cmd.trace);
+        }
+
+        if (moving) {
+            position = motion.step(ACTUATOR_TICK_MS / 1000.0f);
+            servoWriteAngle(position);
+            if (motion.done()) {
+                moving = false;
+                if (sweepLegs > 0) {
+                    sweepLegs--;
+                    motion.start(position, position > 90 ? 0 : 180);
+                    moving = true;
+                }
+            }
+        }
+        if (wasMoving && !moving) evtraceend("servo");
+        busy = moving;
+
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ACTUATOR_TICK_MS));
+    }
+}
+
+void actuatorInit(){
+    servo.setPeriodHertz(50);
+    servo.attach(ACTUATOR_PIN, ACTUATOR_MIN_US, ACTUATOR_MAX_US);
+    actuatorQueue = xQueueCreate(ACTUATOR_QUEUE_LEN, sizeof(ActuatorCommand));
+    xTaskCreate(actuatorTask, "actuator", 2048, nullptr, 2, &actuatorHandle);
+}
+
+TaskHandle_t actuatorTaskHandle(){
+    return actuatorHandle;
+}
+
+bool actuatorSend(ActuatorCommandType type, uint8_t angle, uint32_t trace){
+    ActuatorCommand cmd = { type, angle, trace };
+    return actuatorQueue && xQueueSend(actuatorQueue, &cmd, 0) == pdTRUE;
+}
+
+bool actuatorSendFromISR(ActuatorCommandType type, uint8_t angle, uint32_t trace){
+    ActuatorCommand cmd = { type, angle, trace };
+    BaseType_t woken = pdFALSE;
+    bool ok = actuatorQueue && xQueueSendFromISR(actuatorQueue, &cmd, &woken) == pdTRUE;
+    if (woken) portYIELD_FROM_ISR();
+    return ok;
+}
+
+bool actuatorBusy(){
+    return busy;
+}
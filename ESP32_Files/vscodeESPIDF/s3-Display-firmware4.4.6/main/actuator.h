@@ -0,0 +1,37 @@
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include <Arduino.h>
+
+#define ACTUATOR_PIN 13
+#define ACTUATOR_MIN_US 500
+#define ACTUATOR_MAX_US 2400
+#define ACTUATOR_TICK_MS 20          //one servo frame at 50 Hz
+#define ACTUATOR_QUEUE_LEN 8
+#define ACTUATOR_MAX_VEL 900.0f      //deg/s
+#define ACTUATOR_MAX_ACCEL 9000.0f   //deg/s^2
+#define ACTUATOR_ALARM_SWEEPS 1      //0-180-0 sweeps per alarm
+#define ACTUATOR_ALARM_MAX_SWEEPS 5  //cap when alarms pile up
+
+enum ActuatorCommandType : uint8_t {
+    ACT_MOVE,      // go to angle with a trapezoidal profile
+    ACT_ALARM,     // alarm sweep pattern, repeated alarms extend it
+    ACT_STOP,      // interrupt whatever is running and hold position
+};
+
+struct ActuatorCommand {
+    ActuatorCommandType type;
+    uint8_t angle;
+    uint32_t trace;          // evtrace flow that ends in this move, 0 for none
+};
+
+// The servo is driven only by its own task. Everything else hands it
+// commands through a queue, so a trigger never blocks the caller.
+void actuatorInit(void);
+bool actuatorSend(ActuatorCommandType type, uint8_t angle = 0, uint32_t trace = 0);
+bool actuatorSendFromISR(ActuatorCommandType type, uint8_t angle = 0, uint32_t trace = 0);
+bool actuatorBusy(void);
+// For the stack watermark.
+TaskHandle_t actuatorTaskHandle(void);
+
+#endif
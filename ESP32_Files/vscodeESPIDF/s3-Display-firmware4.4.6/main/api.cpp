@@ -1,115 +1,292 @@
 #include "wificonfig.h"
+#include "events.h"
+#include "hubws.h"
+#include "provision.h"
+#include "config.h"
+#include "metrics.h"
+#include "evtrace.h"
+#include "journal.h"
+#include "boot.h"
+#include "resources.h"
 
-WebServer server(80);
+HubServer server(80);
+
+void apiok(){
+    JsonDocument doc(&jsonArena);
+    doc["status"] = "ok";
+    server.send(200, doc);
+}
 
 void apihealth(){
-    server.send(200, "application/json", "{\"esp32\" : \"ok\"}");
+    JsonDocument doc(&jsonArena);
+    doc["esp32"] = "ok";
+    server.send(200, doc);
 }
 
 void apicreds(){
-    String json = "{\n  \"SSID\": \"" + wifissid + "\",\n  \"PASS\": \"" + wifipassword + "\"\n}";
-    server.send(200, "application/json", json);
+    JsonDocument doc(&jsonArena);
+    doc["SSID"] = config.ssid;
+    doc["PASS"] = config.pass;
+    server.send(200, doc);
 }
 
-String newssid;
+// The app sends the SSID and then the password, the two edits are one
+// NVS write.
 void apinewssid(){
-    newssid = server.arg("SSID");
-    Serial.println("SSID:" + newssid);
-    server.send(200, "text/plain", "OK");
+    strlcpy(configedit().ssid, server.arg("SSID").c_str(), sizeof(config.ssid));
+    Serial.printf("SSID:%s\n", config.ssid);
+    apiok();
 }
 void apinewpass(){
-    String newpass = server.arg("pass");
-    Serial.println("Password:" + newpass);
-    server.send(200, "text/plain", "OK");
-    WiFi.begin(newssid, newpass);
+    strlcpy(configedit().pass, server.arg("pass").c_str(), sizeof(config.pass));
+    Serial.printf("Password:%s\n", config.pass);
+    apiok();
+    WiFi.begin(config.ssid, config.pass);
 }
 
 void apisetmasterip(){
-    String setmasterip = server.arg("setmasterip");
-    Serial.println("Raspberry IP:" + setmasterip);
-    server.send(200, "text/plain", "OK");
+    Serial.printf("Raspberry IP:%s\n", server.arg("setmasterip").c_str());
+    apiok();
 }
 
 void apichangedpass(){
-    String encryptedpass = server.arg("pass");
-    Serial.println("Encrypted pass: " + encryptedpass);
-    server.send(200, "text/plain", "OK");
+    const char* encryptedpass = server.arg("pass").c_str();
+    Serial.printf("Encrypted pass: %s\n", encryptedpass);
+    apiok();
     WiFi.softAP("ESP32_Master_Config", encryptedpass, 11);
     delay(500);
 
 }
 
+// The URL and form are built on the stack, HTTPClient is the only thing
+// here that allocates.
 void apionetimepass(){
-    String otprec = server.arg("otp");
+    const char* otprec = server.arg("otp").c_str();
+    char url[48];
+    char form[80];
+    snprintf(form, sizeof(form), "otp=%s", otprec);
     HTTPClient http;
     for (int i = 0; i < idscount; i++) {
-        if (IDS[i].length() > 0) {
-            String url = "http://" + IDS[i] + "/api/onetimepass";
+        if (IDS[i][0]) {
+            snprintf(url, sizeof(url), "http://%s/api/onetimepass", IDS[i]);
             http.begin(url);
             http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-            http.POST("otp=" + otprec); 
+            http.POST((uint8_t*)form, strlen(form));
             http.end();
         }
     }
-    Serial.println("OTP Received: " + otprec);
-    server.send(200, "text/plain", "OK");
+    Serial.printf("OTP Received: %s\n", otprec);
+    apiok();
 }
 
-void apiwifistatus(){
-    bool connected = false;
-    if (WiFi.status() == WL_CONNECTED){
-        connected = true;
-    }else{
-        connected = false;
+void wifistatusjson(JsonObject obj){
+    bool connected = WiFi.status() == WL_CONNECTED;
+    obj["connected"] = connected;
+    if (connected){
+        IPAddress local = WiFi.localIP();
+        char ip[16];
+        snprintf(ip, sizeof(ip), "%u.%u.%u.%u", local[0], local[1], local[2], local[3]);
+        obj["ip"] = ip;
+        obj["rssi"] = WiFi.RSSI();
     }
-    String json = "{\n"
-                  "  \"connected\": " + String(connected ? "true" : "false") + "\n"
-                  "}";             
-    server.send(200, "application/json", json);
+}
+
+void apiwifistatus(){
+    JsonDocument doc(&jsonArena);
+    wifistatusjson(doc.to<JsonObject>());
+    server.send(200, doc);
 }
 
 int idscount = 0;
-String IDS[20];
+char IDS[20][IDS_ADDR_LEN];
 void apimodule(){
+    // Provisioned fleets share a pairing key, anything else is turned away.
+    if (provision.pairkey.length() > 0 && !server.arg("key").equals(provision.pairkey.c_str())){
+        server.send(403, "text/plain", "bad pairing key");
+        return;
+    }
     if (idscount < 20){
-        IDS[idscount] = server.arg("alert");
+        strlcpy(IDS[idscount], server.arg("alert").c_str(), sizeof(IDS[idscount]));
         Serial.print(IDS[idscount]);
+        hubEventRecord(EVT_MODULE_JOINED, IDS[idscount]);
         idscount++;
     }
-    server.send(200, "text/plain", "OK");
+    apiok();
+}
+
+void apimoduleremove(){
+    HttpView ip = server.arg("alert");
+    for (int i = 0; i < idscount; i++) {
+        if (ip.equals(IDS[i])) {
+            hubEventRecord(EVT_MODULE_LEFT, IDS[i]);
+            memmove(IDS[i], IDS[i + 1], (idscount - i - 1) * sizeof(IDS[i]));
+            idscount--;
+            IDS[idscount][0] = '\0';
+            break;
+        }
+    }
+    apiok();
 }
 
 void apischedule(){
-    String armstart = server.arg("start");
-    String armstop = server.arg("stop");
-    Serial.print("Scheduling time starts at " + armstart + " and stops at " + armstop);
+    Serial.printf("Scheduling time starts at %s and stops at %s",
+                  server.arg("start").c_str(), server.arg("stop").c_str());
     //times saved and actions taked elsewhere
-    server.send(200, "text/plain", "OK");
+    apiok();
 }
 
-String permanentpassrec;
+char permanentpassrec[65];
 void apipermanentpass(){
-    permanentpassrec = server.arg("pass");
+    strlcpy(permanentpassrec, server.arg("pass").c_str(), sizeof(permanentpassrec));
     Serial.println(permanentpassrec);
+    char url[48];
+    char form[72];
+    snprintf(form, sizeof(form), "pass=%s", permanentpassrec);
     HTTPClient http;
     for (int i = 0; i < idscount; i++){
-        if (IDS[i].length() > 0) {
-            String url = IDS[i];
-            http.begin("http://" + url + "/api/permanentpass");
+        if (IDS[i][0]) {
+            snprintf(url, sizeof(url), "http://%s/api/permanentpass", IDS[i]);
+            http.begin(url);
             http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-            http.POST("pass=" + permanentpassrec);
+            http.POST((uint8_t*)form, strlen(form));
             http.end();
         }
     }
-    server.send(200, "text/plain", "OK");
+    apiok();
 }
 
 void apigetpermanentpass(){
-    server.send(200, "text/plain", "pass=" + permanentpassrec);
+    char body[72];
+    snprintf(body, sizeof(body), "pass=%s", permanentpassrec);
+    server.send(200, "text/plain", body);
+}
+
+// Everything the app shows in one round trip: hub state, the module
+// registry and the recent events. "?since=<ms>" limits events to newer ones.
+void apistate(){
+    uint32_t since = (uint32_t)server.arg("since").toInt();
+
+    JsonDocument doc(&jsonArena);
+    JsonObject hub = doc["hub"].to<JsonObject>();
+    hub["armed"] = motiondetectorstate;
+    hub["page"] = homepage ? "home" : setuppage ? "setup" : "disarm";
+    hub["uptime"] = millis();
+    hub["heap"] = ESP.getFreeHeap();
+    wifistatusjson(hub["wifi"].to<JsonObject>());
+
+    JsonArray modules = doc["modules"].to<JsonArray>();
+    for (int i = 0; i < idscount; i++) {
+        if (IDS[i][0]) {
+            modules.add((const char*)IDS[i]);
+        }
+    }
+
+    JsonArray events = doc["events"].to<JsonArray>();
+    for (int i = 0; i < hubEventCount(); i++) {
+        const HubEvent& e = hubEventAt(i);
+        if (e.ms <= since) continue;
+        JsonObject ev = events.add<JsonObject>();
+        ev["t"] = e.ms;
+        ev["type"] = hubEventName(e.type);
+        if (e.detail[0]) ev["detail"] = (const char*)e.detail;
+    }
+
+    server.send(200, doc);
+}
+
+// Prometheus text format. The gauges are read here, the counters and
+// histograms are kept up to date where things happen.
+void apimetrics(){
+    metricset(M_ARMED, motiondetectorstate ? 1 : 0);
+    metricset(M_MODULES, idscount);
+    metricset(M_WS_CLIENTS, wsClientCount());
+    metricset(M_WIFI_RSSI, WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0);
+    metricsnapshot snapshot;
+    server.send(200, METRICS_CONTENT_TYPE, snapshot);
+}
+
+// The event trace, see evtrace.h for the format.
+void apievtrace(){
+    evtracesnapshot snapshot;
+    server.send(200, EVTRACE_CONTENT_TYPE, snapshot);
+}
+
+// clear=1 forgets the events so far.
+void apievtraceclear(){
+    if (server.arg("clear").equals("1")) evtraceclear();
+    apiok();
+}
+
+static const char* apieventname(uint8_t type){
+    return hubEventName((HubEventType)type);
+}
+
+// History from the journal, newest first: limit records (20) before seq
+// before, or before the time boot and ms when boot is given.
+void apijournal(){
+    uint32_t before = strtoul(server.arg("before").c_str(), nullptr, 10);
+    if (server.hasArg("boot")) {
+        before = journalseqafter(journaltime(server.arg("boot").toInt(), strtoull(server.arg("ms").c_str(), nullptr, 10)));
+    }
+    int limit = server.hasArg("limit") ? server.arg("limit").toInt() : 20;
+    journalpage page(before, limit, apieventname);
+    server.send(200, "application/json", page);
+}
+
+// When each boot phase ran, esp_timer µs; -1 for what has not happened.
+void apiboot(){
+    JsonDocument doc(&jsonArena);
+    doc["armable_us"] = bootArmableUs();
+    JsonArray phases = doc["phases"].to<JsonArray>();
+    for (int i = 0; i < BOOT_PHASES; i++) {
+        BootTiming timing = bootTiming((BootPhase)i);
+        JsonObject phase = phases.add<JsonObject>();
+        phase["name"] = bootName((BootPhase)i);
+        phase["start_us"] = timing.startUs;
+        phase["end_us"] = timing.endUs;
+        phase["stack_free"] = timing.stackFree;
+    }
+    server.send(200, doc);
+}
+
+// What the resource governor sees: the heap, the arenas and the tasks'
+// stacks, and the level admission works from.
+void apiresources(){
+    JsonDocument doc(&jsonArena);
+    ResourceHeap heap = resourceHeap();
+    doc["level"] = resourceLevelName(resourceLevel());
+    JsonObject h = doc["heap"].to<JsonObject>();
+    h["free"] = heap.freeBytes;
+    h["min_free"] = heap.minFreeBytes;
+    h["largest_block"] = heap.largestBlock;
+    h["fragmentation"] = heap.fragmentation;
+    JsonObject arena = doc["arenas"].to<JsonArray>().add<JsonObject>();
+    arena["name"] = jsonArena.name();
+    arena["size"] = jsonArena.size();
+    arena["peak"] = jsonArena.peak();
+    arena["spills"] = jsonArena.spills();
+    arena["refused"] = jsonArena.refused();
+    JsonArray tasks = doc["tasks"].to<JsonArray>();
+    for (int i = 0; i < resourceTaskCount(); i++) {
+        ResourceTask task = resourceTaskAt(i);
+        JsonObject t = tasks.add<JsonObject>();
+        t["name"] = task.name;
+        t["stack_free"] = task.stackFree;
+    }
+    server.send(200, doc);
+}
+
+void apiwebasset(){
+    const WebAsset* asset = webAssetFind(server.uri().c_str());
+    if (asset) {
+        server.sendAsset(*asset);
+    }
 }
 
 void apihandle(){
-    server.on("/api/health", HTTP_GET, apihealth);
+    // Modules fetch it from /api/getpermanentpass until the app sets one.
+    strlcpy(permanentpassrec, provision.disarm.c_str(), sizeof(permanentpassrec));
+    server.on("/api/health", HTTP_GET, apihealth, WORK_ESSENTIAL);
     server.on("/api/creds", HTTP_GET, apicreds);
     server.on("/api/newpass", HTTP_POST, apinewpass);
     server.on("/api/encryptedpass", HTTP_POST, apichangedpass);
@@ -118,8 +295,19 @@ void apihandle(){
     server.on("/api/setmasterip", HTTP_POST, apisetmasterip);
     server.on("/api/onetimepass", HTTP_POST, apionetimepass);
     server.on("/api/module", HTTP_POST, apimodule);
+    server.on("/api/module", HTTP_DELETE, apimoduleremove);
     server.on("/api/schedule", HTTP_POST, apischedule);
     server.on("/api/permanentpass", HTTP_POST, apipermanentpass);
     server.on("/api/getpermanentpass", HTTP_GET, apigetpermanentpass);
-    
+    server.on("/api/state", HTTP_GET, apistate);
+    server.on("/api/metrics", HTTP_GET, apimetrics, WORK_ESSENTIAL);
+    server.on("/api/resources", HTTP_GET, apiresources, WORK_ESSENTIAL);
+    server.on("/api/evtrace", HTTP_GET, apievtrace, WORK_BACKGROUND);
+    server.on("/api/evtrace", HTTP_POST, apievtraceclear);
+    server.on("/api/journal", HTTP_GET, apijournal, WORK_BACKGROUND);
+    server.on("/api/boot", HTTP_GET, apiboot, WORK_BACKGROUND);
+    server.on("/ws", HTTP_GET, wsHandleUpgrade, WORK_BACKGROUND);
+    for (size_t i = 0; i < webAssetCount; i++) {
+        server.on(webAssets[i].path, HTTP_GET, apiwebasset, WORK_BACKGROUND);
+    }
 }
\ No newline at end of file
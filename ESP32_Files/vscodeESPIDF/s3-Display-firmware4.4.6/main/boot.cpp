@@ -0,0 +1,73 @@
+#include "boot.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "evtrace.h"
+#include "resources.h"
+
+static EventGroupHandle_t bootDoneBits = nullptr;
+static const BootStep* bootSteps = nullptr;
+static BootTiming bootTimings[BOOT_PHASES];
+
+static void bootTask(void* arg){
+    BootPhase phase = (BootPhase)(uintptr_t)arg;
+    const BootStep& step = bootSteps[phase];
+    if (step.after) bootWait(step.after);
+    bootTimings[phase].startUs = esp_timer_get_time();
+    evtracebegin(step.name);
+    step.run();
+    evtraceend(step.name);
+    bootTimings[phase].endUs = esp_timer_get_time();
+    // The stacks in the table are guesses until these say otherwise.
+    bootTimings[phase].stackFree = uxTaskGetStackHighWaterMark(nullptr);
+    DLOG("boot: %s %lld..%lld us, %u of %u stack bytes unused\r\n", step.name,
+         (long long)bootTimings[phase].startUs, (long long)bootTimings[phase].endUs,
+         (unsigned)bootTimings[phase].stackFree, (unsigned)step.stack);
+    if (bootTimings[phase].stackFree < RESOURCE_STACK_LOW) {
+        DLOG("boot: %s came within %u bytes of its stack\r\n", step.name, (unsigned)bootTimings[phase].stackFree);
+    }
+    xEventGroupSetBits(bootDoneBits, BOOT_BIT(phase));
+    vTaskDelete(nullptr);
+}
+
+void bootRun(const BootStep* steps){
+    bootSteps = steps;
+    bootDoneBits = xEventGroupCreate();
+    for (int i = 0; i < BOOT_PHASES; i++) {
+        bootTimings[i] = { -1, -1, 0 };
+    }
+    for (int i = 0; i < BOOT_PHASES; i++) {
+        xTaskCreate(bootTask, steps[i].name, steps[i].stack, (void*)(uintptr_t)i, 1, nullptr);
+    }
+}
+
+void bootWait(uint32_t phases){
+    xEventGroupWaitBits(bootDoneBits, phases, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+bool bootDone(BootPhase phase){
+    return bootDoneBits && (xEventGroupGetBits(bootDoneBits) & BOOT_BIT(phase));
+}
+
+const char* bootName(BootPhase phase){
+    return bootSteps ? bootSteps[phase].name : "";
+}
+
+// A phase's times are written by its own task. The end is only read once
+// the phase's bit is set.
+BootTiming bootTiming(BootPhase phase){
+    BootTiming timing = bootTimings[phase];
+    if (!bootDone(phase)) timing.endUs = -1;
+    return timing;
+}
+
+int64_t bootArmableUs(){
+    if (!bootDoneBits || (xEventGroupGetBits(bootDoneBits) & BOOT_ARMABLE) != BOOT_ARMABLE) return -1;
+    int64_t armable = 0;
+    for (int i = 0; i < BOOT_PHASES; i++) {
+        if (BOOT_ARMABLE & BOOT_BIT(i)) armable = max(armable, bootTimings[i].endUs);
+    }
+    return armable;
+}
@@ -0,0 +1,56 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+
+// setup() as a graph of phases. Each phase runs in a task of its own as
+// soon as the phases it comes after are done, so the panel is calibrating
+// while the radio comes up and flash is read in parallel with NVS. Start
+// and end of every phase are kept (esp_timer, µs since the app started)
+// for /api/boot, the panel and the event trace.
+//
+// Armable is when the hub can take an arm request and relay an alarm: the
+// phases in BOOT_ARMABLE. setup() returns then; the loop leaves the panel
+// alone until BOOT_REPORT is done.
+enum BootPhase : uint8_t {
+    BOOT_SETTINGS,    // provision and config from NVS
+    BOOT_JOURNAL,     // event journal recovery
+    BOOT_RADIO,       // soft-AP, uplink, UDP
+    BOOT_HTTP,        // routes and listening socket
+    BOOT_ACTUATOR,    // servo task
+    BOOT_DISPLAY,     // panel and touch calibration
+    BOOT_REPORT,      // the timings on the panel, then the UI
+    BOOT_PHASES
+};
+
+#define BOOT_BIT(phase) (1u << (phase))
+#define BOOT_ARMABLE (BOOT_BIT(BOOT_SETTINGS) | BOOT_BIT(BOOT_JOURNAL) | BOOT_BIT(BOOT_RADIO) | \
+                      BOOT_BIT(BOOT_HTTP) | BOOT_BIT(BOOT_ACTUATOR))
+#define BOOT_ALL (BOOT_BIT(BOOT_PHASES) - 1)
+#define BOOT_STACK_LOOP 8192   // loopTask's, what the phases ran on before
+#define BOOT_STACK_SMALL 4096  // phases that only register things
+#define BOOT_REPORT_MS 1500    // how long the timings stay on the panel
+
+struct BootStep {
+    const char* name;
+    void (*run)(void);
+    uint32_t after;          // BOOT_BITs of the phases it waits for
+    uint32_t stack;          // bytes for the phase's task
+};
+
+struct BootTiming {
+    int64_t startUs;         // -1 until it started
+    int64_t endUs;           // -1 until it is done
+    uint32_t stackFree;      // bytes of its stack the phase never used, once done
+};
+
+// steps[phase] for every BootPhase, kept by the caller until done.
+void bootRun(const BootStep* steps);
+void bootWait(uint32_t phases);
+bool bootDone(BootPhase phase);
+const char* bootName(BootPhase phase);
+BootTiming bootTiming(BootPhase phase);
+// When the last BOOT_ARMABLE phase ended, -1 before that.
+int64_t bootArmableUs(void);
+
+#endif
@@ -0,0 +1,32 @@
+#include "config.h"
+#include "filesys.h"
+#include "dlog.h"
+
+#define CALIBRATION_FILE "/calibrationData"
+
+// "generic" is what earlier firmware wrote when there was nothing.
+static bool placeholder(const String& value){
+  return value.length() == 0 || value == "generic";
+}
+
+// The LittleFS files earlier firmware kept these in.
+void configdefaults(configdata& c){
+  if (!LittleFS.begin(false)) return;
+  if (LittleFS.exists("/wifissid.txt") && LittleFS.exists("/wifipass.txt")) {
+    String ssid = littlefsReadFile("/wifissid.txt");
+    String pass = littlefsReadFile("/wifipass.txt");
+    if (!placeholder(ssid)) {
+      strlcpy(c.ssid, ssid.c_str(), sizeof(c.ssid));
+      strlcpy(c.pass, pass.c_str(), sizeof(c.pass));
+    }
+  }
+  // Written 14 bytes at a time from a 10 byte array, the first 10 count.
+  File f = LittleFS.open(CALIBRATION_FILE, "r");
+  if (f) {
+    if (f.readBytes((char *)c.touchcal, sizeof(c.touchcal)) == sizeof(c.touchcal))
+      c.hastouchcal = 1;
+    f.close();
+  }
+  LittleFS.end();
+  DLOG("config: imported from LittleFS\r\n");
+}
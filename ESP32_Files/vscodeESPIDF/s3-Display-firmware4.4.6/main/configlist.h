@@ -0,0 +1,7 @@
+// The hub's settings, see config.h. No include guard, it is read once for
+// the struct and once more for the strings. The order is the blob's.
+
+CONFIG_STRING(ssid, 33)                // uplink set from the app, empty for provision's
+CONFIG_STRING(pass, 65)
+CONFIG_FIELD(uint8_t, hastouchcal)
+CONFIG_ARRAY(uint16_t, touchcal, 5)
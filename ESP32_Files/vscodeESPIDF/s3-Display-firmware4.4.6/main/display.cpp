@@ -1,4 +1,8 @@
 #include "display.h"
+#include "provision.h"
+#include "config.h"
+#include "evtrace.h"
+#include "boot.h"
 
 TFT_eSPI tft = TFT_eSPI();
 
@@ -7,6 +11,10 @@ bool homepage = true;
 bool setuppage = false;
 bool disarmauthpage = false;
 
+// From displayinit(), which runs in a boot task, for display() to store.
+static uint16_t newcalibration[5];
+static bool calibrated = false;
+
 void displayinit(){
   uint16_t calibrationData[5];
   uint8_t calDataOK = 0;
@@ -23,20 +31,13 @@ void displayinit(){
   tft.setTextColor(TFT_BLACK, TFT_WHITE);  tft.setTextSize(1);
   tft.println("calibration run");
 
-  // Initialize LittleFS
-  // if (!LittleFS.begin(true)) {  // true = format if mount fails
-  //   Serial.println("LittleFS mount failed");
-  //   return;
-  // }
-
-  // check if calibration file exists
-  if (LittleFS.exists(CALIBRATION_FILE)) {
-    File f = LittleFS.open(CALIBRATION_FILE, "r");
-    if (f) {
-      if (f.readBytes((char *)calibrationData, 14) == 14)
-        calDataOK = 1;
-      f.close();
-    }
+  // calibration from the flasher, then the one from an earlier run
+  if (provision.hastouchcal) {
+    memcpy(calibrationData, provision.touchcal, sizeof(calibrationData));
+    calDataOK = 1;
+  } else if (config.hastouchcal) {
+    memcpy(calibrationData, config.touchcal, sizeof(calibrationData));
+    calDataOK = 1;
   }
   if (calDataOK) {
     // calibration data valid
@@ -44,25 +45,63 @@ void displayinit(){
   } else {
     // data not valid. recalibrate
     tft.calibrateTouch(calibrationData, TFT_WHITE, TFT_RED, 15);
-    // store data
-    File f = LittleFS.open(CALIBRATION_FILE, "w");
-    if (f) {
-      f.write((const unsigned char *)calibrationData, 14);
-      f.close();
-    }
+    // stored by display(), config is the loop task's
+    memcpy(newcalibration, calibrationData, sizeof(newcalibration));
+    calibrated = true;
   }
 
   tft.fillScreen(TFT_BLACK);
 }
 
+// Every phase's start and end while the UI waits, for BOOT_REPORT_MS.
+void displayBootReport(){
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextSize(2);
+  tft.setCursor(0, 0);
+  tft.println("Boot, ms");
+  for (int i = 0; i < BOOT_REPORT; i++) {
+    BootTiming timing = bootTiming((BootPhase)i);
+    tft.printf("%-9s %5lld %5lld\n", bootName((BootPhase)i), (long long)timing.startUs / 1000,
+               (long long)timing.endUs / 1000);
+  }
+  tft.printf("\narmable   %5lld\n", (long long)bootArmableUs() / 1000);
+  delay(BOOT_REPORT_MS);
+  tft.fillScreen(TFT_BLACK);
+}
+
+// The loop renders the page every time round, a slice for each would push
+// an alarm out of the trace within seconds. A page is traced when it comes
+// up and then once every DISPLAY_TRACE_MS.
+static void renderpage(const char* page, void (*render)(void)){
+  static const char* tracedpage = nullptr;
+  static uint32_t tracedms = 0;
+  bool traced = page != tracedpage || millis() - tracedms >= DISPLAY_TRACE_MS;
+  if (traced) {
+    tracedpage = page;
+    tracedms = millis();
+    evtracebegin(page);
+  }
+  render();
+  if (traced) evtraceend(page);
+}
+
 void display(){
+  if (calibrated) {
+    // now rather than risk asking again
+    configdata& edit = configedit();
+    memcpy(edit.touchcal, newcalibration, sizeof(edit.touchcal));
+    edit.hastouchcal = 1;
+    configflush();
+    calibrated = false;
+  }
   if (homepage && !setuppage && !disarmauthpage){
-    displayMainMenu();
+    renderpage("page home", displayMainMenu);
   }
   if (!homepage && setuppage && !disarmauthpage){
-    displaySetupPage();
+    renderpage("page setup", displaySetupPage);
   }
   if (!homepage && !setuppage && disarmauthpage){
-    displayDisarmAuthPage();
+    renderpage("page disarm", displayDisarmAuthPage);
   }
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 #include "filesys.h"
 #include "wificonfig.h"
 
-#define CALIBRATION_FILE "/calibrationData"
+#define DISPLAY_TRACE_MS 100   // between traced renders of one page
 
 extern TFT_eSPI tft;
 extern bool motiondetectorstate;
@@ -16,6 +16,7 @@ extern bool setuppage;
 extern bool disarmauthpage;
 
 void displayinit(void);
+void displayBootReport(void);
 void display(void);
 void displayMainMenu(void);
 void displaySetupPage(void);
@@ -1,4 +1,6 @@
 #include "display.h"
+#include "events.h"
+#include "dlog.h"
 
 bool disarmauthapprove = false;
 char pass[] = "23012";
@@ -26,7 +28,7 @@ void displayDisarmAuthPage(){
     tft.setCursor(keypadcursor, 20);
     if (tft.getTouch(&x, &y)){
         if ( (x >= 70) && (x <= 180) && (y >= 60) && (y <= 130)){
-            Serial.printf("\n1");
+            DLOG("\n1");
             tft.printf("1");
             keypadcursor += 20;
             userpass[passpos] = '1';
@@ -36,7 +38,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 180) && (x <= 300) && (y >= 60) && (y <= 130)){
-            Serial.printf("\n2");
+            DLOG("\n2");
             tft.printf("2");
             keypadcursor += 20;
             userpass[passpos] = '2';
@@ -46,7 +48,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 300) && (x <= 400) && (y >= 60) && (y <= 130)){
-            Serial.printf("\n3");
+            DLOG("\n3");
             tft.printf("3");
             keypadcursor += 20;
             userpass[passpos] = '3';
@@ -57,7 +59,7 @@ void displayDisarmAuthPage(){
         }
             
         if ( (x >= 70) && (x <= 180) && (y >= 130) && (y <= 190)){
-            Serial.printf("\n4");
+            DLOG("\n4");
             tft.printf("4");
             keypadcursor += 20;
             userpass[passpos] = '4';
@@ -67,7 +69,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 180) && (x <= 300) && (y >= 130) && (y <= 190)){
-            Serial.printf("\n5");
+            DLOG("\n5");
             tft.printf("5");
             keypadcursor += 20;
             userpass[passpos] = '5';
@@ -77,7 +79,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 300) && (x <= 400) && (y >= 130) && (y <= 190)){
-            Serial.printf("\n6");
+            DLOG("\n6");
             tft.printf("6");
             keypadcursor += 20;
             userpass[passpos] = '6';
@@ -88,7 +90,7 @@ void displayDisarmAuthPage(){
         }
 
         if ( (x >= 70) && (x <= 180) && (y >= 190) && (y <= 250)){
-            Serial.printf("\n7");
+            DLOG("\n7");
             tft.printf("7");
             keypadcursor += 20;
             userpass[passpos] = '7';
@@ -98,7 +100,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 180) && (x <= 300) && (y >= 190) && (y <= 250)){
-            Serial.printf("\n8");
+            DLOG("\n8");
             tft.printf("8");
             keypadcursor += 20;
             userpass[passpos] = '8';
@@ -108,7 +110,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 300) && (x <= 400) && (y >= 190) && (y <= 250)){
-            Serial.printf("\n9");
+            DLOG("\n9");
             tft.printf("9");
             keypadcursor += 20;
             userpass[passpos] = '9';
@@ -119,7 +121,7 @@ void displayDisarmAuthPage(){
         }
 
         if ( (x >= 70) && (x <= 180) && (y >= 250) && (y <= 310)){
-            Serial.printf("\n*");
+            DLOG("\n*");
             tft.printf("*");
             keypadcursor += 20;
             userpass[passpos] = '*';
@@ -129,7 +131,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 180) && (x <= 300) && (y >= 250) && (y <= 310)){
-            Serial.printf("\n0");
+            DLOG("\n0");
             tft.printf("0");
             keypadcursor += 20;
             userpass[passpos] = '0';
@@ -139,7 +141,7 @@ void displayDisarmAuthPage(){
             }
         }
         if ( (x >= 300) && (x <= 400) && (y >= 250) && (y <= 310)){
-            Serial.printf("\n#");
+            DLOG("\n#");
             tft.printf("#");
             keypadcursor += 20;
             userpass[passpos] = '#';
@@ -196,11 +198,13 @@ void displayDisarmAuthPage(){
                 delay(1000);
                 wifi_send("idle");
                 motiondetectorstate = false;
+                hubEventRecord(EVT_DISARMED);
                 homepage = true;
                 setuppage = false;
                 disarmauthpage = false;
             }
             else if (strcmp(userpass, pass)){
+                hubEventRecord(EVT_DISARM_DENIED);
                 tft.setTextColor(TFT_RED);
                 tft.setTextSize(2);
                 tft.setCursor(200, 20);
@@ -1,4 +1,5 @@
 #include "display.h"
+#include "events.h"
 
 
 int pressnum = 0;
@@ -50,6 +51,7 @@ void displayMainMenu(){
             if (!motiondetectorstate){
                 tft.fillCircle(290, 120, 10, TFT_GREEN);
                 motiondetectorstate = true;
+                hubEventRecord(EVT_ARMED);
                 wifi_send("turnonmotiondetectorespmotion");
                 delay(1000);
                 wifi_send("idle");
@@ -0,0 +1,47 @@
+#include "events.h"
+#include "hubws.h"
+#include "journal.h"
+
+static HubEvent eventRing[HUB_EVENT_CAPACITY];
+static int eventHead = 0;
+static int eventCount = 0;
+
+void hubEventRecord(HubEventType type, const char* detail){
+    HubEvent& e = eventRing[eventHead];
+    e.ms = millis();
+    e.type = type;
+    strlcpy(e.detail, detail, sizeof(e.detail));
+
+    eventHead = (eventHead + 1) % HUB_EVENT_CAPACITY;
+    if (eventCount < HUB_EVENT_CAPACITY) eventCount++;
+
+    wsPushEvent(e);
+    // Everything but a denied disarm changes what the state frame holds.
+    // The frame is built when the queue is next pumped, after the caller
+    // has updated armed, the module list or the intrusion time.
+    if (type != EVT_DISARM_DENIED) wsPushState();
+    journalappend(type, detail);
+}
+
+int hubEventCount(){
+    return eventCount;
+}
+
+const HubEvent& hubEventAt(int i){
+    int oldest = (eventHead - eventCount + HUB_EVENT_CAPACITY) % HUB_EVENT_CAPACITY;
+    return eventRing[(oldest + i) % HUB_EVENT_CAPACITY];
+}
+
+const char* hubEventName(HubEventType type){
+    switch (type) {
+        case EVT_ARMED:         return "armed";
+        case EVT_DISARMED:      return "disarmed";
+        case EVT_DISARM_DENIED: return "disarm_denied";
+        case EVT_INTRUSION:     return "intrusion";
+        case EVT_MODULE_JOINED: return "module_joined";
+        case EVT_MODULE_LEFT:   return "module_left";
+        case EVT_WIFI_CONNECTED: return "wifi_connected";
+        case EVT_WIFI_LOST:     return "wifi_lost";
+    }
+    return "unknown";
+}
@@ -0,0 +1,36 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+
+#define HUB_EVENT_CAPACITY 32
+#define HUB_EVENT_DETAIL_LEN 24
+
+enum HubEventType : uint8_t {
+    EVT_ARMED,
+    EVT_DISARMED,
+    EVT_DISARM_DENIED,
+    EVT_INTRUSION,
+    EVT_MODULE_JOINED,
+    EVT_MODULE_LEFT,
+    EVT_WIFI_CONNECTED,
+    EVT_WIFI_LOST,
+};
+
+struct HubEvent {
+    uint32_t ms;
+    HubEventType type;
+    char detail[HUB_EVENT_DETAIL_LEN];
+};
+
+// Recent hub events kept in a fixed ring, oldest entries are overwritten.
+// Every recorded event is also pushed to the WebSocket subscribers, with a
+// fresh state snapshot when it changes the state, and appended to the
+// journal, which keeps them across reboots. The values
+// are on flash, add new types at the end.
+void hubEventRecord(HubEventType type, const char* detail = "");
+int hubEventCount(void);
+const HubEvent& hubEventAt(int i);   // 0 is the oldest kept event
+const char* hubEventName(HubEventType type);
+
+#endif
@@ -4,7 +4,6 @@
 #include "LittleFS.h"
 #include "FS.h"
 
-void littlefsinit(void);
 void littlefsWriteFile(String filename, String content);
 String littlefsReadFile(String filename);
 
@@ -0,0 +1,197 @@
+#include "httpparser.h"
+
+#include <limits.h>
+#include <string.h>
+
+static const HttpView emptyView = { "", 0 };
+
+bool HttpView::equals(const char* s) const {
+    return strlen(s) == len && memcmp(data, s, len) == 0;
+}
+
+bool HttpView::equalsIgnoreCase(const char* s) const {
+    size_t n = strlen(s);
+    if (n != len) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (httpLower(data[i]) != httpLower(s[i])) return false;
+    }
+    return true;
+}
+
+bool HttpView::startsWith(const char* s) const {
+    size_t n = strlen(s);
+    return n <= len && memcmp(data, s, n) == 0;
+}
+
+long HttpView::toInt() const {
+    long v = 0;
+    for (size_t i = 0; i < len && data[i] >= '0' && data[i] <= '9'; i++) {
+        int digit = data[i] - '0';
+        if (v > (LONG_MAX - digit) / 10) return LONG_MAX;
+        v = v * 10 + digit;
+    }
+    return v;
+}
+
+HttpHeaderId httpHeaderLookup(const char* name, size_t len) {
+    uint8_t id = httpHeaderTable.slot[httpHeaderHash(name, len, HTTP_HEADER_SEED) % HTTP_HEADER_SLOTS];
+    if (id == HDR_UNKNOWN) return HDR_UNKNOWN;
+
+    const char* known = httpHeaderNames[id];
+    for (size_t i = 0; i < len; i++) {
+        if (known[i] == '\0' || httpLower(name[i]) != known[i]) return HDR_UNKNOWN;
+    }
+    return known[len] == '\0' ? (HttpHeaderId)id : HDR_UNKNOWN;
+}
+
+void HttpRequest::reset() {
+    method = path = query = emptyView;
+    versionMinor = 1;
+    headLength = 0;
+    contentLength = 0;
+    for (int i = 0; i < HDR_COUNT; i++) headers[i] = emptyView;
+    argCount = 0;
+}
+
+HttpView HttpRequest::arg(const char* name) const {
+    for (int i = 0; i < argCount; i++) {
+        if (args[i].name.equals(name)) return args[i].value;
+    }
+    return emptyView;
+}
+
+bool HttpRequest::hasArg(const char* name) const {
+    for (int i = 0; i < argCount; i++) {
+        if (args[i].name.equals(name)) return true;
+    }
+    return false;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decodes %XX and '+' in place and NUL terminates. Output is never longer
+// than input so this is safe inside the scratch buffer.
+static HttpView urlDecodeInPlace(char* s, size_t len) {
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < len && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+            c = (char)(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]));
+            i += 2;
+        }
+        s[out++] = c;
+    }
+    s[out] = '\0';
+    return HttpView{ s, out };
+}
+
+void httpParseArgs(char* data, size_t len, HttpRequest& req) {
+    size_t pos = 0;
+    while (pos < len && req.argCount < HTTP_MAX_ARGS) {
+        char* amp = (char*)memchr(data + pos, '&', len - pos);
+        size_t end = amp ? (size_t)(amp - data) : len;
+        char* eq = (char*)memchr(data + pos, '=', end - pos);
+
+        if (eq) {
+            size_t nameLen = (size_t)(eq - (data + pos));
+            size_t valueLen = end - (size_t)(eq - data) - 1;
+            HttpArg& a = req.args[req.argCount++];
+            a.name = urlDecodeInPlace(data + pos, nameLen);
+            a.value = urlDecodeInPlace(eq + 1, valueLen);
+        }
+        pos = end + 1;
+    }
+}
+
+static bool parseContentLength(HttpView v, size_t* length) {
+    if (v.len > HTTP_MAX_LENGTH_DIGITS) return false;
+    size_t n = 0;
+    for (size_t i = 0; i < v.len; i++) {
+        if (v.data[i] < '0' || v.data[i] > '9') return false;
+        n = n * 10 + (size_t)(v.data[i] - '0');
+    }
+    *length = n;
+    return true;
+}
+
+static bool isToken(char c) {
+    return c > ' ' && c < 127 && c != ':';
+}
+
+// Finds the blank line that ends the head without touching the buffer, so
+// a partial request can be parsed again once more bytes arrive.
+static char* findHeadEnd(char* buf, size_t len) {
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (buf[i] != '\n') continue;
+        if (buf[i + 1] == '\n') return buf + i + 2;
+        if (buf[i + 1] == '\r' && i + 2 < len && buf[i + 2] == '\n') return buf + i + 3;
+    }
+    return nullptr;
+}
+
+HttpParseResult httpParseHead(char* buf, size_t len, HttpRequest& req) {
+    req.reset();
+
+    char* end = findHeadEnd(buf, len);
+    if (!end) return HTTP_PARSE_INCOMPLETE;
+    req.headLength = (size_t)(end - buf);
+
+    // Request line: METHOD SP target SP HTTP/1.x CRLF
+    char* p = buf;
+    char* lineEnd = (char*)memchr(p, '\n', end - p);
+    char* sp1 = (char*)memchr(p, ' ', lineEnd - p);
+    if (!sp1 || sp1 == p) return HTTP_PARSE_ERROR;
+    char* sp2 = (char*)memchr(sp1 + 1, ' ', lineEnd - sp1 - 1);
+    if (!sp2 || sp2 == sp1 + 1) return HTTP_PARSE_ERROR;
+    if (lineEnd - sp2 < 9 || memcmp(sp2 + 1, "HTTP/1.", 7) != 0) return HTTP_PARSE_ERROR;
+
+    req.versionMinor = (uint8_t)(sp2[8] - '0');
+    *sp1 = '\0';
+    req.method = HttpView{ p, (size_t)(sp1 - p) };
+
+    char* target = sp1 + 1;
+    size_t targetLen = (size_t)(sp2 - target);
+    *sp2 = '\0';
+    char* q = (char*)memchr(target, '?', targetLen);
+    if (q) {
+        *q = '\0';
+        req.path = HttpView{ target, (size_t)(q - target) };
+        req.query = HttpView{ q + 1, targetLen - (size_t)(q - target) - 1 };
+    } else {
+        req.path = HttpView{ target, targetLen };
+    }
+
+    // Header lines up to the blank line
+    for (p = lineEnd + 1; p < end; p = lineEnd + 1) {
+        lineEnd = (char*)memchr(p, '\n', end - p);
+        char* contentEnd = (lineEnd > p && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+        if (contentEnd == p) break;
+
+        char* colon = p;
+        while (colon < contentEnd && isToken(*colon)) colon++;
+        if (colon == p || colon == contentEnd || *colon != ':') return HTTP_PARSE_ERROR;
+
+        HttpHeaderId id = httpHeaderLookup(p, (size_t)(colon - p));
+        if (id != HDR_UNKNOWN) {
+            char* v = colon + 1;
+            char* ve = contentEnd;
+            while (v < ve && (*v == ' ' || *v == '\t')) v++;
+            while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+            *ve = '\0';
+            req.headers[id] = HttpView{ v, (size_t)(ve - v) };
+        }
+    }
+
+    if (!parseContentLength(req.headers[HDR_CONTENT_LENGTH], &req.contentLength)) return HTTP_PARSE_ERROR;
+    if (!req.query.empty()) {
+        httpParseArgs((char*)req.query.data, req.query.len, req);
+    }
+    return HTTP_PARSE_OK;
+}
@@ -0,0 +1,161 @@
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+// In-place HTTP/1.1 request parser. Everything is tokenized inside the
+// caller's scratch buffer (tokens get NUL terminated where they end), so a
+// parsed request costs no heap allocations. Kept free of Arduino headers so
+// it also builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_ARGS 16
+#define HTTP_HEADER_SLOTS 32
+#define HTTP_MAX_LENGTH_DIGITS 9   // Content-Length below 10^9, far past any scratch buffer
+
+struct HttpView {
+    const char* data;
+    size_t len;
+
+    bool empty() const { return len == 0; }
+    const char* c_str() const { return data; }
+    bool equals(const char* s) const;
+    bool equalsIgnoreCase(const char* s) const;
+    bool startsWith(const char* s) const;
+    // Leading digits, LONG_MAX when they do not fit.
+    long toInt() const;
+};
+
+// Header names the hub cares about. Anything else is skipped while parsing.
+enum HttpHeaderId : uint8_t {
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_TRANSFER_ENCODING,
+    HDR_ACCEPT,
+    HDR_UPGRADE,
+    HDR_SEC_WEBSOCKET_KEY,
+    HDR_SEC_WEBSOCKET_VERSION,
+    HDR_IF_NONE_MATCH,
+    HDR_ACCEPT_ENCODING,
+    HDR_COUNT,
+    HDR_UNKNOWN = 0xFF
+};
+
+static constexpr const char* httpHeaderNames[HDR_COUNT] = {
+    "host",
+    "connection",
+    "content-length",
+    "content-type",
+    "transfer-encoding",
+    "accept",
+    "upgrade",
+    "sec-websocket-key",
+    "sec-websocket-version",
+    "if-none-match",
+    "accept-encoding",
+};
+
+////////////////////////////// compile-time perfect hash //////////////////////////////
+
+constexpr char httpLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+constexpr uint32_t httpHeaderHash(const char* s, size_t n, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)httpLower(s[i]);
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+constexpr size_t httpStrLen(const char* s) {
+    size_t n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+constexpr bool httpSeedIsPerfect(uint32_t seed) {
+    bool used[HTTP_HEADER_SLOTS] = {};
+    for (int i = 0; i < HDR_COUNT; i++) {
+        const char* name = httpHeaderNames[i];
+        uint32_t slot = httpHeaderHash(name, httpStrLen(name), seed) % HTTP_HEADER_SLOTS;
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t httpFindSeed() {
+    uint32_t seed = 0;
+    while (!httpSeedIsPerfect(seed)) seed++;
+    return seed;
+}
+
+static constexpr uint32_t HTTP_HEADER_SEED = httpFindSeed();
+
+struct HttpHeaderTable {
+    uint8_t slot[HTTP_HEADER_SLOTS];
+};
+
+constexpr HttpHeaderTable httpBuildHeaderTable() {
+    HttpHeaderTable t = {};
+    for (int i = 0; i < HTTP_HEADER_SLOTS; i++) t.slot[i] = HDR_UNKNOWN;
+    for (int i = 0; i < HDR_COUNT; i++) {
+        const char* name = httpHeaderNames[i];
+        t.slot[httpHeaderHash(name, httpStrLen(name), HTTP_HEADER_SEED) % HTTP_HEADER_SLOTS] = (uint8_t)i;
+    }
+    return t;
+}
+
+static constexpr HttpHeaderTable httpHeaderTable = httpBuildHeaderTable();
+
+static_assert(httpSeedIsPerfect(HTTP_HEADER_SEED), "header hash is not collision free");
+
+// One hash, one table probe, one compare.
+HttpHeaderId httpHeaderLookup(const char* name, size_t len);
+
+////////////////////////////// request //////////////////////////////
+
+enum HttpParseResult {
+    HTTP_PARSE_OK,
+    HTTP_PARSE_INCOMPLETE,
+    HTTP_PARSE_ERROR
+};
+
+struct HttpArg {
+    HttpView name;
+    HttpView value;
+};
+
+struct HttpRequest {
+    HttpView method;
+    HttpView path;
+    HttpView query;
+    uint8_t versionMinor;
+    size_t headLength;      // bytes up to and including the blank line
+    size_t contentLength;
+    HttpView headers[HDR_COUNT];
+    HttpArg args[HTTP_MAX_ARGS];
+    int argCount;
+
+    void reset();
+    HttpView header(HttpHeaderId id) const { return headers[id]; }
+    HttpView arg(const char* name) const;
+    bool hasArg(const char* name) const;
+};
+
+// Parses the request line and headers in buf[0..len). Returns INCOMPLETE
+// until the blank line ending the head has arrived. A Content-Length that
+// is not just digits, or has more than HTTP_MAX_LENGTH_DIGITS, is an
+// error rather than a guess at where the body ends.
+HttpParseResult httpParseHead(char* buf, size_t len, HttpRequest& req);
+
+// Splits "a=1&b=2" into req.args, URL decoding names and values in place.
+// Used for the query string and for x-www-form-urlencoded bodies.
+void httpParseArgs(char* data, size_t len, HttpRequest& req);
+
+#endif
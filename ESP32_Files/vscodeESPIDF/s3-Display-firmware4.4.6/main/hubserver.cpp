@@ -0,0 +1,308 @@
+#include "hubserver.h"
+
+#define HUBSERVER_CHUNK_SIZE 128
+
+// ArduinoJson writes a token at a time. This gathers those writes into small
+// chunks for the socket, the full body is never held in memory.
+class ClientChunkWriter : public Print {
+public:
+    explicit ClientChunkWriter(WiFiClient& client) : _client(client), _used(0) {}
+    ~ClientChunkWriter() { push(); }
+
+    size_t write(uint8_t b) override {
+        if (_used == sizeof(_chunk)) push();
+        _chunk[_used++] = b;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        for (size_t i = 0; i < len; i++) write(data[i]);
+        return len;
+    }
+
+    void push() {
+        if (_used > 0) {
+            _client.write(_chunk, _used);
+            _used = 0;
+        }
+    }
+
+private:
+    WiFiClient& _client;
+    size_t _used;
+    uint8_t _chunk[HUBSERVER_CHUNK_SIZE];
+};
+
+HubServer::HubServer(uint16_t port)
+    : _server(port), _method(HTTP_GET), _responded(false), _status(0), _detached(false), _routeCount(0) {
+    _request.reset();
+}
+
+void HubServer::begin() {
+    _server.begin();
+    _server.setNoDelay(true);
+}
+
+void HubServer::stop() {
+    _client.stop();
+    _server.end();
+}
+
+void HubServer::on(const char* path, HTTPMethod method, Handler fn, ResourceWork work) {
+    if (_routeCount >= HUBSERVER_MAX_ROUTES) {
+        Serial.printf("HubServer: route table full, %s dropped\n", path);
+        return;
+    }
+    _routes[_routeCount++] = { path, method, fn, work };
+}
+
+static HTTPMethod methodFromView(HttpView m) {
+    if (m.equals("GET")) return HTTP_GET;
+    if (m.equals("POST")) return HTTP_POST;
+    if (m.equals("PUT")) return HTTP_PUT;
+    if (m.equals("PATCH")) return HTTP_PATCH;
+    if (m.equals("DELETE")) return HTTP_DELETE;
+    if (m.equals("OPTIONS")) return HTTP_OPTIONS;
+    if (m.equals("HEAD")) return HTTP_HEAD;
+    return HTTP_ANY;
+}
+
+// Reads the head and body of one request into _scratch. Returns false and
+// answers the client itself when the request cannot be served.
+bool HubServer::readRequest() {
+    size_t used = 0;
+    size_t needed = 0;
+    unsigned long start = millis();
+
+    while (millis() - start < HUBSERVER_READ_TIMEOUT) {
+        int avail = _client.available();
+        if (avail <= 0) {
+            if (!_client.connected()) return false;
+            delay(1);
+            continue;
+        }
+
+        // keep one byte free so the body can be NUL terminated
+        size_t room = sizeof(_scratch) - 1 - used;
+        if (room == 0) {
+            send(431, "text/plain", "Request too large");
+            return false;
+        }
+        int got = _client.read((uint8_t*)_scratch + used, (size_t)avail < room ? (size_t)avail : room);
+        if (got <= 0) continue;
+        used += got;
+
+        if (needed == 0) {
+            HttpParseResult res = httpParseHead(_scratch, used, _request);
+            if (res == HTTP_PARSE_INCOMPLETE) continue;
+            if (res == HTTP_PARSE_ERROR) {
+                send(400, "text/plain", "Bad request");
+                return false;
+            }
+            needed = _request.headLength + _request.contentLength;
+            if (needed >= sizeof(_scratch)) {
+                send(413, "text/plain", "Payload too large");
+                return false;
+            }
+        }
+        if (used >= needed) {
+            _scratch[needed] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+void HubServer::handleClient() {
+    _client = _server.available();
+    if (!_client) return;
+
+    uint32_t start = micros();
+    _responded = false;
+    _status = 0;
+    _detached = false;
+    _method = HTTP_GET;
+    if (readRequest()) {
+        _method = methodFromView(_request.method);
+
+        if (_request.contentLength > 0 &&
+            _request.header(HDR_CONTENT_TYPE).startsWith("application/x-www-form-urlencoded")) {
+            httpParseArgs(_scratch + _request.headLength, _request.contentLength, _request);
+        }
+
+        const Route* route = nullptr;
+        for (int i = 0; i < _routeCount; i++) {
+            if (_request.path.equals(_routes[i].path) &&
+                (_routes[i].method == HTTP_ANY || _routes[i].method == _method)) {
+                route = &_routes[i];
+                break;
+            }
+        }
+
+        Handler fn = route ? route->fn : nullptr;
+        const char* path = route ? route->path : nullptr;
+        if (fn && !resourceAdmit(route->work)) {
+            writeHead(503, "text/plain", 0, "Retry-After: 1\r\n");
+        } else if (fn) {
+            EVTRACE_SCOPE(path);
+            fn();
+        }
+        if (!_responded) {
+            send(fn ? 200 : 404, "text/plain", fn ? "" : "Not found");
+        }
+    }
+
+    // Requests that never completed got no answer and are not counted.
+    if (_status != 0) {
+        metricinc(M_HTTP_REQUESTS);
+        if (_status >= 400) metricinc(M_HTTP_ERRORS);
+        metricobserve(M_HTTP, micros() - start);
+    }
+
+    if (_detached) {
+        _client = WiFiClient();
+    } else {
+        _client.stop();
+    }
+}
+
+const char* httpStatusText(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 406: return "Not Acceptable";
+        case 413: return "Payload Too Large";
+        case 426: return "Upgrade Required";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "";
+    }
+}
+
+void HubServer::writeHead(int code, const char* contentType, size_t length, const char* extraHeaders) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %u\r\n"
+                     "%s"
+                     "Connection: close\r\n\r\n",
+                     code, httpStatusText(code), contentType, (unsigned)length, extraHeaders);
+    if (n > (int)sizeof(head) - 1) n = sizeof(head) - 1;
+    _client.write((const uint8_t*)head, n);
+    _responded = true;
+    _status = code;
+}
+
+void HubServer::send(int code, const char* contentType, const char* content, size_t length,
+                     const char* extraHeaders) {
+    writeHead(code, contentType, length, extraHeaders);
+    if (length > 0 && _method != HTTP_HEAD) {
+        _client.write((const uint8_t*)content, length);
+    }
+}
+
+void HubServer::send(int code, const char* contentType, const char* content) {
+    send(code, contentType, content, strlen(content));
+}
+
+void HubServer::send(int code, const char* contentType, const String& content) {
+    send(code, contentType, content.c_str(), content.length());
+}
+
+bool HubServer::wantsMsgPack() const {
+    HttpView accept = _request.header(HDR_ACCEPT);
+    return strstr(accept.c_str(), "application/msgpack") != nullptr ||
+           strstr(accept.c_str(), "application/x-msgpack") != nullptr;
+}
+
+// Counts what a Printable writes, for Content-Length.
+class LengthCounter : public Print {
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t len) override { return len; }
+};
+
+void HubServer::send(int code, const char* contentType, const Printable& body) {
+    LengthCounter counter;
+    writeHead(code, contentType, body.printTo(counter));
+    if (_method == HTTP_HEAD) return;
+
+    ClientChunkWriter out(_client);
+    body.printTo(out);
+}
+
+void HubServer::send(int code, const JsonDocument& doc) {
+    if (doc.overflowed()) {
+        writeHead(503, "text/plain", 0, "Retry-After: 1\r\n");
+        return;
+    }
+    bool msgpack = wantsMsgPack();
+    size_t length = msgpack ? measureMsgPack(doc) : measureJson(doc);
+    writeHead(code, msgpack ? "application/msgpack" : "application/json", length);
+    if (_method == HTTP_HEAD) return;
+
+    ClientChunkWriter out(_client);
+    if (msgpack) {
+        serializeMsgPack(doc, out);
+    } else {
+        serializeJson(doc, out);
+    }
+}
+
+// No Accept-Encoding means any coding will do (RFC 7231 5.3.4), otherwise
+// "gzip", "x-gzip" or "*" has to be in it without q=0.
+static bool acceptsGzip(HttpView header) {
+    if (header.len == 0) return true;
+    const char* p = header.data;
+    const char* end = header.data + header.len;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ',')) p++;
+        const char* name = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ') p++;
+        size_t n = p - name;
+        bool gzip = (n == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+                    (n == 6 && strncasecmp(name, "x-gzip", 6) == 0) || (n == 1 && *name == '*');
+        // a weight with no digit other than 0 in it is q=0
+        bool weighted = false, nonzero = false;
+        for (; p < end && *p != ','; p++) {
+            if ((*p == 'q' || *p == 'Q') && p + 1 < end && p[1] == '=') weighted = true;
+            if (weighted && *p >= '1' && *p <= '9') nonzero = true;
+        }
+        if (gzip && (!weighted || nonzero)) return true;
+    }
+    return false;
+}
+
+void HubServer::sendAsset(const WebAsset& asset) {
+    char extra[128];
+    snprintf(extra, sizeof(extra), "ETag: %s\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n", asset.etag);
+
+    if (_request.header(HDR_IF_NONE_MATCH).equals(asset.etag)) {
+        writeHead(304, asset.contentType, 0, extra);
+        return;
+    }
+
+    // Assets are kept gzipped only, a client that refuses it (gzip;q=0, or
+    // identity alone) gets 406 rather than bytes it cannot read.
+    if (!acceptsGzip(_request.header(HDR_ACCEPT_ENCODING))) {
+        send(406, "text/plain", "Needs Accept-Encoding: gzip");
+        return;
+    }
+
+    strlcat(extra, "Content-Encoding: gzip\r\n", sizeof(extra));
+    writeHead(200, asset.contentType, asset.length, extra);
+    if (_method == HTTP_HEAD) return;
+
+    // straight out of memory-mapped flash, one TCP segment at a time
+    for (size_t off = 0; off < asset.length; ) {
+        size_t chunk = asset.length - off < HUBSERVER_ASSET_CHUNK ? asset.length - off : HUBSERVER_ASSET_CHUNK;
+        size_t written = _client.write(asset.data + off, chunk);
+        if (written == 0) return;
+        off += written;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef HUBSERVER_H
+#define HUBSERVER_H
+
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include "HTTP_Method.h"
+#include "httpparser.h"
+#include "webassets.h"
+#include "metrics.h"
+#include "evtrace.h"
+#include "resources.h"
+
+#define HUBSERVER_SCRATCH_SIZE 2048
+#define HUBSERVER_MAX_ROUTES 24
+#define HUBSERVER_READ_TIMEOUT 5000 //ms to wait for the request head and body
+#define HUBSERVER_ASSET_CHUNK 1436    //one TCP segment
+
+// Small single-client HTTP server for the hub API. Requests are read into a
+// fixed scratch buffer and parsed in place by httpparser, so serving an API
+// call does not allocate on the heap.
+class HubServer {
+public:
+    typedef void (*Handler)(void);
+
+    explicit HubServer(uint16_t port);
+
+    void begin();
+    void stop();
+    void handleClient();
+    // Requests for a route whose work class resourceAdmit() turns away get
+    // 503 without running fn.
+    void on(const char* path, HTTPMethod method, Handler fn, ResourceWork work = WORK_CONTROL);
+
+    HttpView arg(const char* name) const { return _request.arg(name); }
+    bool hasArg(const char* name) const { return _request.hasArg(name); }
+    HttpView header(HttpHeaderId id) const { return _request.header(id); }
+    HttpView uri() const { return _request.path; }
+    HTTPMethod method() const { return _method; }
+    WiFiClient& client() { return _client; }
+    // Hands the connection over to the current handler (WebSocket upgrade),
+    // handleClient() will neither answer nor close it.
+    void detachClient() { _detached = true; _responded = true; _status = 101; }
+
+    void send(int code, const char* contentType, const char* content);
+    // extraHeaders are whole header lines, each ending in "\r\n".
+    void send(int code, const char* contentType, const char* content, size_t length,
+              const char* extraHeaders = "");
+    void send(int code, const char* contentType, const String& content);
+    // Serializes doc straight to the socket, as MessagePack when the client
+    // sent "Accept: application/msgpack" and as JSON otherwise. A document
+    // that ran out of memory is 503 rather than half an answer.
+    void send(int code, const JsonDocument& doc);
+    // Prints body twice, once to measure it, so it has to print the same
+    // both times.
+    void send(int code, const char* contentType, const Printable& body);
+    bool wantsMsgPack() const;
+    // Gzipped asset from flash with a strong ETag. A matching If-None-Match
+    // gets 304 without reading the asset, a client that refuses gzip gets
+    // 406. No Accept-Encoding at all counts as taking it.
+    void sendAsset(const WebAsset& asset);
+
+private:
+    struct Route {
+        const char* path;
+        HTTPMethod method;
+        Handler fn;
+        ResourceWork work;
+    };
+
+    bool readRequest();
+    void writeHead(int code, const char* contentType, size_t length, const char* extraHeaders = "");
+
+    WiFiServer _server;
+    WiFiClient _client;
+    HttpRequest _request;
+    HTTPMethod _method;
+    bool _responded;
+    int _status;
+    bool _detached;
+    char _scratch[HUBSERVER_SCRATCH_SIZE];
+    Route _routes[HUBSERVER_MAX_ROUTES];
+    int _routeCount;
+};
+
+const char* httpStatusText(int code);
+
+#endif
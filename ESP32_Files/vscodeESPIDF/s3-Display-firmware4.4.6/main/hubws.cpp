@@ -0,0 +1,269 @@
+#include "hubws.h"
+#include "wificonfig.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+#include "metrics.h"
+
+#define WS_OP_TEXT  0x1
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING  0x9
+#define WS_OP_PONG  0xA
+
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+
+static const char* WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+struct WsFrame {
+    uint8_t len;
+    uint8_t data[WS_FRAME_MAX + 2];   // 2 byte header, payload never needs the long form
+};
+
+struct WsClient {
+    WiFiClient sock;
+    bool active;
+    bool stateDirty;
+    WsFrame queue[WS_QUEUE_FRAMES];
+    uint8_t head;
+    uint8_t count;
+    uint8_t sent;                     // bytes of queue[head] already on the wire
+    uint8_t rx[WS_RX_MAX];
+    size_t rxUsed;
+    unsigned long lastRx;
+    unsigned long lastPing;
+};
+
+static WsClient wsClients[WS_MAX_CLIENTS];
+static uint32_t lastIntrusionMs = 0;
+
+static void wsDrop(WsClient& c){
+    c.sock.stop();
+    c.active = false;
+    c.count = 0;
+    c.sent = 0;
+    c.rxUsed = 0;
+}
+
+// Close frame with a status code (none when 0), then the socket goes.
+static void wsClose(WsClient& c, uint16_t status){
+    uint8_t closeFrame[4] = { 0x80 | WS_OP_CLOSE, (uint8_t)(status ? 2 : 0), (uint8_t)(status >> 8), (uint8_t)status };
+    send(c.sock.fd(), closeFrame, 2 + closeFrame[1], MSG_DONTWAIT);
+    wsDrop(c);
+}
+
+static void wsEnqueue(WsClient& c, uint8_t opcode, const void* payload, size_t len){
+    if (len > WS_FRAME_MAX) return;
+
+    if (c.count == WS_QUEUE_FRAMES) {
+        // Slow consumer: forget the backlog, keep only a frame that is half
+        // written, and let the next pump send one fresh snapshot instead.
+        c.count = c.sent ? 1 : 0;
+        c.stateDirty = true;
+        metricinc(M_WS_BACKLOGS_DROPPED);
+        return;
+    }
+
+    WsFrame& f = c.queue[(c.head + c.count) % WS_QUEUE_FRAMES];
+    f.data[0] = 0x80 | opcode;
+    f.data[1] = (uint8_t)len;
+    memcpy(f.data + 2, payload, len);
+    f.len = (uint8_t)(len + 2);
+    c.count++;
+}
+
+static int wsStateFrame(char* out, size_t size){
+    return snprintf(out, size, "{\"e\":\"state\",\"armed\":%d,\"wifi\":%d,\"modules\":%d,\"intr\":%lu}",
+                    motiondetectorstate ? 1 : 0, WiFi.status() == WL_CONNECTED ? 1 : 0,
+                    idscount, (unsigned long)lastIntrusionMs);
+}
+
+static void wsPump(WsClient& c){
+    if (c.stateDirty && c.count < WS_QUEUE_FRAMES) {
+        char payload[WS_FRAME_MAX + 1];
+        int n = wsStateFrame(payload, sizeof(payload));
+        c.stateDirty = false;
+        wsEnqueue(c, WS_OP_TEXT, payload, n);
+    }
+
+    int fd = c.sock.fd();
+    while (c.count > 0) {
+        WsFrame& f = c.queue[c.head];
+        int n = send(fd, f.data + c.sent, f.len - c.sent, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            wsDrop(c);
+            return;
+        }
+        c.sent += n;
+        if (c.sent < f.len) return;
+        c.head = (c.head + 1) % WS_QUEUE_FRAMES;
+        c.count--;
+        c.sent = 0;
+    }
+}
+
+// Client frames are only used for close and ping, anything else is read
+// and ignored. Frames that do not fit the small rx buffer close the socket,
+// unmasked ones close it with 1002 (protocol error) as RFC 6455 asks.
+static void wsRead(WsClient& c){
+    int avail = c.sock.available();
+    if (avail > 0 && c.rxUsed < sizeof(c.rx)) {
+        size_t room = sizeof(c.rx) - c.rxUsed;
+        int got = c.sock.read(c.rx + c.rxUsed, (size_t)avail < room ? (size_t)avail : room);
+        if (got > 0) {
+            c.rxUsed += got;
+            c.lastRx = millis();
+        }
+    }
+
+    while (c.active && c.rxUsed >= 2) {
+        uint8_t opcode = c.rx[0] & 0x0F;
+        bool masked = c.rx[1] & 0x80;
+        size_t len = c.rx[1] & 0x7F;
+        size_t hdr = 2;
+        if (len == 126) {
+            if (c.rxUsed < 4) return;
+            len = ((size_t)c.rx[2] << 8) | c.rx[3];
+            hdr = 4;
+        } else if (len == 127) {
+            wsDrop(c);
+            return;
+        }
+        if (!masked) {
+            wsClose(c, WS_CLOSE_PROTOCOL_ERROR);
+            return;
+        }
+        hdr += 4;
+        if (hdr + len > sizeof(c.rx)) {
+            wsDrop(c);
+            return;
+        }
+        if (c.rxUsed < hdr + len) return;
+
+        uint8_t* payload = c.rx + hdr;
+        const uint8_t* mask = c.rx + hdr - 4;
+        for (size_t i = 0; i < len; i++) payload[i] ^= mask[i & 3];
+
+        if (opcode == WS_OP_CLOSE) {
+            wsClose(c, 0);
+            return;
+        }
+        if (opcode == WS_OP_PING) {
+            metricinc(M_WS_PINGS_RECEIVED);
+            wsEnqueue(c, WS_OP_PONG, payload, len);
+        }
+
+        memmove(c.rx, c.rx + hdr + len, c.rxUsed - hdr - len);
+        c.rxUsed -= hdr + len;
+    }
+}
+
+void wsLoop(){
+    unsigned long now = millis();
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        WsClient& c = wsClients[i];
+        if (!c.active) continue;
+        if (!c.sock.connected() || now - c.lastRx > 3 * WS_PING_INTERVAL) {
+            wsDrop(c);
+            continue;
+        }
+        if (now - c.lastPing > WS_PING_INTERVAL) {
+            c.lastPing = now;
+            metricinc(M_WS_PINGS_SENT);
+            wsEnqueue(c, WS_OP_PING, nullptr, 0);
+        }
+        wsRead(c);
+        if (c.active) wsPump(c);
+    }
+}
+
+void wsPushEvent(const HubEvent& e){
+    if (e.type == EVT_INTRUSION) lastIntrusionMs = e.ms;
+
+    char detail[HUB_EVENT_DETAIL_LEN];
+    size_t n = 0;
+    for (; e.detail[n] && n < sizeof(detail) - 1; n++) {
+        char ch = e.detail[n];
+        detail[n] = (ch == '"' || ch == '\\' || ch < ' ') ? '_' : ch;
+    }
+    detail[n] = '\0';
+
+    char payload[WS_FRAME_MAX + 1];
+    int len = snprintf(payload, sizeof(payload), "{\"e\":\"%s\",\"t\":%lu,\"d\":\"%s\"}",
+                       hubEventName(e.type), (unsigned long)e.ms, detail);
+
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (wsClients[i].active) {
+            wsEnqueue(wsClients[i], WS_OP_TEXT, payload, len);
+        }
+    }
+}
+
+void wsPushState(){
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        wsClients[i].stateDirty = true;
+    }
+}
+
+int wsClientCount(){
+    int n = 0;
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (wsClients[i].active) n++;
+    }
+    return n;
+}
+
+void wsHandleUpgrade(){
+    HttpView key = server.header(HDR_SEC_WEBSOCKET_KEY);
+    if (!server.header(HDR_UPGRADE).equalsIgnoreCase("websocket") || key.empty() || key.len > 32) {
+        server.send(400, "text/plain", "Expected a WebSocket upgrade");
+        return;
+    }
+    if (!server.header(HDR_SEC_WEBSOCKET_VERSION).equals("13")) {
+        static const char body[] = "Only WebSocket version 13";
+        server.send(426, "text/plain", body, sizeof(body) - 1, "Sec-WebSocket-Version: 13\r\n");
+        return;
+    }
+
+    WsClient* slot = nullptr;
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (!wsClients[i].active) {
+            slot = &wsClients[i];
+            break;
+        }
+    }
+    if (!slot) {
+        server.send(503, "text/plain", "Too many subscribers");
+        return;
+    }
+
+    char keyGuid[72];
+    int keyGuidLen = snprintf(keyGuid, sizeof(keyGuid), "%s%s", key.c_str(), WS_GUID);
+    uint8_t digest[20];
+    mbedtls_sha1_ret((const uint8_t*)keyGuid, keyGuidLen, digest);
+    uint8_t accept[32];
+    size_t acceptLen = 0;
+    mbedtls_base64_encode(accept, sizeof(accept), &acceptLen, digest, sizeof(digest));
+
+    char head[160];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %.*s\r\n\r\n",
+                     (int)acceptLen, (const char*)accept);
+    server.client().write((const uint8_t*)head, n);
+
+    slot->sock = server.client();
+    server.detachClient();
+    slot->sock.setNoDelay(true);
+    slot->active = true;
+    slot->stateDirty = true;
+    slot->head = 0;
+    slot->count = 0;
+    slot->sent = 0;
+    slot->rxUsed = 0;
+    slot->lastRx = millis();
+    slot->lastPing = millis();
+}
@@ -0,0 +1,23 @@
+#ifndef HUBWS_H
+#define HUBWS_H
+
+#include <WiFi.h>
+#include "events.h"
+
+#define WS_MAX_CLIENTS 4
+#define WS_QUEUE_FRAMES 8
+#define WS_FRAME_MAX 96
+#define WS_RX_MAX 128
+#define WS_PING_INTERVAL 15000 //ms between keepalive pings
+
+// Push channel for the app and the setup page on GET /ws. Every subscriber
+// has its own small frame queue. A subscriber that falls behind loses its
+// queued events and gets one state snapshot instead, so a slow phone can
+// never hold up the hub or the other subscribers.
+void wsHandleUpgrade(void);   // route handler for /ws
+void wsLoop(void);            // pumps queues and reads control frames, call from loop()
+void wsPushEvent(const HubEvent& e);
+void wsPushState(void);       // queue a state snapshot for every subscriber
+int wsClientCount(void);
+
+#endif
@@ -1,23 +1,61 @@
 #include "display.h"
 #include "filesys.h"
 #include "wificonfig.h"
+#include "hubws.h"
+#include "actuator.h"
+#include "provision.h"
+#include "config.h"
+#include "dlog.h"
+#include "metrics.h"
+#include "journal.h"
+#include "boot.h"
+#include "resources.h"
 
-Servo myServo;
-void setup() {
-  Serial.begin(115200);
-  littlefsinit();
-  wifiInit();
-  displayinit();
+static void bootsettings(){
+  provisionLoad();
+  configload(configdefaults);
+}
+
+static void bootjournal(){
+  journalbegin();
+}
+
+static void boothttp(){
   apihandle();
   server.begin();
-  
-  myServo.setPeriodHertz(50);  // 50 Hz for standard servos
-  myServo.attach(13, 500, 2400);  // pin, min µs, max µs
+}
+
+// One per BootPhase, in its order. Whatever mounts LittleFS, brings up
+// WiFi or draws keeps the stack it had on loopTask; /api/boot shows what
+// each phase left unused.
+static const BootStep bootsteps[BOOT_PHASES] = {
+  { "settings", bootsettings, 0, BOOT_STACK_LOOP },
+  { "journal", bootjournal, 0, BOOT_STACK_LOOP },
+  { "radio", wifiInit, BOOT_BIT(BOOT_SETTINGS), BOOT_STACK_LOOP },
+  { "http", boothttp, BOOT_BIT(BOOT_SETTINGS) | BOOT_BIT(BOOT_RADIO), BOOT_STACK_SMALL },
+  { "actuator", actuatorInit, 0, BOOT_STACK_SMALL },
+  { "display", displayinit, BOOT_BIT(BOOT_SETTINGS), BOOT_STACK_LOOP },
+  { "report", displayBootReport, BOOT_ALL & ~BOOT_BIT(BOOT_REPORT), BOOT_STACK_LOOP },
+};
+
+void setup() {
+  Serial.begin(115200);
+  dlogbegin(DLOG_SINK);
+  bootRun(bootsteps);
+  bootWait(BOOT_ARMABLE);
+  resourceTask(xTaskGetCurrentTaskHandle());
+  resourceTask(actuatorTaskHandle());
 }
 
 void loop() {
-  display();
+  uint32_t start = micros();
+  if (bootDone(BOOT_REPORT)) display();
   wifi_receive();
   //setuppageserver();
   server.handleClient();
+  wsLoop();
+  wifistatuspoll();
+  configloop();
+  resourcePoll();
+  metricobserve(M_LOOP, micros() - start);
 }
@@ -0,0 +1,27 @@
+// The hub's metrics, see metrics.h. No include guard, it is read once per
+// enum and table. Names get METRICS_PREFIX in front.
+
+METRIC_COUNTER(M_UDP_RECEIVED, "udp_received_total", "UDP datagrams read")
+METRIC_COUNTER(M_UDP_TRUNCATED, "udp_truncated_total", "UDP datagrams longer than the receive buffer")
+METRIC_COUNTER(M_UDP_SENT, "udp_sent_total", "UDP datagrams sent, relay and fan-out")
+METRIC_COUNTER(M_UDP_SEND_FAILED, "udp_send_failed_total", "UDP datagrams the stack refused")
+METRIC_COUNTER(M_INTRUSIONS, "intrusions_total", "Intruder alerts received from modules")
+METRIC_COUNTER(M_HTTP_REQUESTS, "http_requests_total", "HTTP requests answered")
+METRIC_COUNTER(M_HTTP_ERRORS, "http_errors_total", "HTTP requests answered with 4xx or 5xx")
+METRIC_COUNTER(M_WS_PINGS_SENT, "ws_pings_sent_total", "WebSocket keepalive pings sent")
+METRIC_COUNTER(M_WS_PINGS_RECEIVED, "ws_pings_received_total", "WebSocket pings answered")
+METRIC_COUNTER(M_WS_BACKLOGS_DROPPED, "ws_backlogs_dropped_total", "Times a slow subscriber's queued frames were dropped")
+METRIC_COUNTER(M_CONFIG_WRITES, "config_writes_total", "Config blobs written to NVS")
+METRIC_COUNTER(M_WORK_SHED, "work_shed_total", "Requests turned away while the heap was low")
+METRIC_COUNTER(M_ARENA_SPILLS, "arena_spills_total", "Arena allocations that went to the heap")
+
+METRIC_GAUGE(M_ARMED, "armed", "1 while the motion detectors are on")
+METRIC_GAUGE(M_MODULES, "modules", "Modules registered")
+METRIC_GAUGE(M_WS_CLIENTS, "ws_clients", "WebSocket subscribers")
+METRIC_GAUGE(M_WIFI_RSSI, "wifi_rssi_dbm", "Station signal, 0 when not connected")
+METRIC_GAUGE(M_HEAP_FRAGMENTATION, "heap_fragmentation_percent", "Free heap outside the largest free block")
+METRIC_GAUGE(M_RESOURCE_LEVEL, "resource_level", "0 ok, 1 tight, 2 critical")
+
+METRIC_HISTOGRAM(M_LOOP, "loop_seconds", "loop() iteration time")
+METRIC_HISTOGRAM(M_ALERT, "alert_handle_seconds", "Intruder datagram to relay and actuator done")
+METRIC_HISTOGRAM(M_HTTP, "http_request_seconds", "Accepted connection to response written")
@@ -0,0 +1,9 @@
+// What the hub reads from the provision namespace, see provision.h. No
+// include guard, it is read once for the struct and twice to load it.
+
+PROVISION_STRING(ssid)                 // uplink the hub joins as a station
+PROVISION_STRING(pass)
+PROVISION_STRING(appass)               // ESP32_Master_Config, modules join with it
+PROVISION_STRING(disarm)               // keypad code pushed to modules
+PROVISION_STRING(pairkey)              // modules must present it on /api/module
+PROVISION_BYTES(uint16_t, touchcal, 5)
@@ -0,0 +1,168 @@
+#include "resources.h"
+#include "esp_heap_caps.h"
+#include "dlog.h"
+#include "metrics.h"
+
+#define ARENA_ALIGN 8
+#define ARENA_HEADER ARENA_ALIGN   // the block's size, padded so blocks stay aligned
+
+alignas(ARENA_ALIGN) static uint8_t jsonArenaBuffer[RESOURCE_JSON_ARENA];
+ResourceArena jsonArena("json", jsonArenaBuffer, sizeof(jsonArenaBuffer));
+
+struct WatchedTask {
+    TaskHandle_t handle;
+    const char* name;
+    uint32_t stackFree;
+    bool warned;
+};
+
+static volatile ResourceLevel level = RES_OK;
+static ResourceHeap heap = {};
+static WatchedTask tasks[RESOURCE_MAX_TASKS];
+static int taskCount = 0;
+static uint32_t lastPoll = 0;
+static bool polled = false;
+
+static size_t arenaRound(size_t size){
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+ResourceArena::ResourceArena(const char* name, uint8_t* buffer, size_t size)
+    : _name(name), _buffer(buffer), _size(size), _top(0), _last(size), _peak(0), _live(0),
+      _spills(0), _refused(0) {}
+
+void* ResourceArena::spill(size_t size){
+    if (resourceLevel() != RES_OK) {
+        _refused++;
+        return nullptr;
+    }
+    _spills++;
+    metricinc(M_ARENA_SPILLS);
+    return malloc(size);
+}
+
+void* ResourceArena::allocate(size_t size){
+    size_t need = ARENA_HEADER + arenaRound(size);
+    if (need > _size - _top) return spill(size);
+    *(uint32_t*)(_buffer + _top) = size;
+    _last = _top;
+    _top += need;
+    _live++;
+    if (_top > _peak) _peak = _top;
+    return _buffer + _last + ARENA_HEADER;
+}
+
+void ResourceArena::deallocate(void* ptr){
+    if (!ptr) return;
+    if (!owns(ptr)) {
+        free(ptr);
+        return;
+    }
+    size_t header = (uint8_t*)ptr - _buffer - ARENA_HEADER;
+    if (header == _last) {
+        _top = _last;
+        _last = _size;
+    }
+    if (--_live == 0) {
+        _top = 0;
+        _last = _size;
+    }
+}
+
+// ArduinoJson grows its pool list and string buffers, and shrinks them
+// when a document is done. The newest block does both in place.
+void* ResourceArena::reallocate(void* ptr, size_t size){
+    if (!ptr) return allocate(size);
+    if (!owns(ptr)) return realloc(ptr, size);
+    size_t header = (uint8_t*)ptr - _buffer - ARENA_HEADER;
+    uint32_t old = *(uint32_t*)(_buffer + header);
+    if (header == _last && ARENA_HEADER + arenaRound(size) <= _size - header) {
+        *(uint32_t*)(_buffer + header) = size;
+        _top = header + ARENA_HEADER + arenaRound(size);
+        if (_top > _peak) _peak = _top;
+        return ptr;
+    }
+    if (size <= old) {
+        *(uint32_t*)(_buffer + header) = size;
+        return ptr;
+    }
+    void* moved = allocate(size);
+    if (!moved) return nullptr;
+    memcpy(moved, ptr, old);
+    deallocate(ptr);
+    return moved;
+}
+
+void resourceTask(TaskHandle_t task){
+    if (taskCount >= RESOURCE_MAX_TASKS) return;
+    tasks[taskCount++] = { task, pcTaskGetName(task), 0, false };
+}
+
+static ResourceLevel resourceClassify(const ResourceHeap& h){
+    if (h.largestBlock < RESOURCE_CRITICAL_BLOCK || h.freeBytes < RESOURCE_CRITICAL_FREE) return RES_CRITICAL;
+    if (h.largestBlock < RESOURCE_TIGHT_BLOCK || h.freeBytes < RESOURCE_TIGHT_FREE) return RES_TIGHT;
+    return RES_OK;
+}
+
+void resourcePoll(){
+    uint32_t now = millis();
+    if (polled && now - lastPoll < RESOURCE_POLL_MS) return;
+    polled = true;
+    lastPoll = now;
+
+    heap.freeBytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    heap.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    heap.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    heap.fragmentation = heap.freeBytes ? 100 - (uint64_t)heap.largestBlock * 100 / heap.freeBytes : 100;
+
+    ResourceLevel next = resourceClassify(heap);
+    if (next != level) {
+        DLOG("resources: %s, %u free, largest block %u\r\n", resourceLevelName(next),
+             (unsigned)heap.freeBytes, (unsigned)heap.largestBlock);
+        level = next;
+    }
+    metricset(M_HEAP_FRAGMENTATION, heap.fragmentation);
+    metricset(M_RESOURCE_LEVEL, next);
+
+    for (int i = 0; i < taskCount; i++) {
+        WatchedTask& task = tasks[i];
+        task.stackFree = uxTaskGetStackHighWaterMark(task.handle);
+        // Once per task, the mark never goes back up.
+        if (task.stackFree < RESOURCE_STACK_LOW && !task.warned) {
+            DLOG("resources: %s has %u bytes of stack left\r\n", task.name, (unsigned)task.stackFree);
+            task.warned = true;
+        }
+    }
+}
+
+bool resourceAdmit(ResourceWork work){
+    ResourceLevel now = level;
+    bool admit = work == WORK_ESSENTIAL || (work == WORK_CONTROL ? now != RES_CRITICAL : now == RES_OK);
+    if (!admit) metricinc(M_WORK_SHED);
+    return admit;
+}
+
+ResourceLevel resourceLevel(){
+    return level;
+}
+
+const char* resourceLevelName(ResourceLevel l){
+    switch (l) {
+        case RES_OK: return "ok";
+        case RES_TIGHT: return "tight";
+        case RES_CRITICAL: return "critical";
+    }
+    return "";
+}
+
+ResourceHeap resourceHeap(){
+    return heap;
+}
+
+int resourceTaskCount(){
+    return taskCount;
+}
+
+ResourceTask resourceTaskAt(int i){
+    return { tasks[i].name, tasks[i].stackFree };
+}
@@ -0,0 +1,109 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The hub has no PSRAM. What keeps it up for months is the internal heap
+// staying in one piece, so the work that used to allocate per request has
+// memory of its own and the rest is watched:
+//
+// Arenas are buffers reserved at link time. A JsonDocument built on one
+// takes its pools and strings from it, and the arena is whole again when
+// the last document on it is gone: a handler leaves no holes in the heap.
+// Should a document outgrow its arena the rest comes from the heap, but
+// only while the heap is healthy.
+//
+// resourcePoll() reads the free internal heap and its largest free block
+// every RESOURCE_POLL_MS. Fragmentation is the part of the free heap that
+// is not in the largest block. The two make the level, and the tasks'
+// stack high-water marks are read at the same time.
+//
+// Admission sheds work before an allocation fails. Each HTTP route has a
+// class: background work (traces, history, web assets, new WebSocket
+// subscribers) is turned away with 503 once the heap is tight, control
+// (settings, the fan-outs to the modules) once it is critical. The alarm
+// path and the allocation-free diagnostics are never shed.
+#define RESOURCE_POLL_MS 250
+#define RESOURCE_TIGHT_BLOCK (24 * 1024)     // lwIP and an HTTPClient need a few KB each
+#define RESOURCE_TIGHT_FREE (48 * 1024)
+#define RESOURCE_CRITICAL_BLOCK (8 * 1024)
+#define RESOURCE_CRITICAL_FREE (20 * 1024)
+#define RESOURCE_STACK_LOW 512               // bytes never used, below it a task is logged
+#define RESOURCE_MAX_TASKS 8
+#define RESOURCE_JSON_ARENA (8 * 1024)       // /api/state with a full event ring
+
+enum ResourceLevel : uint8_t {
+    RES_OK,
+    RES_TIGHT,
+    RES_CRITICAL,
+};
+
+enum ResourceWork : uint8_t {
+    WORK_ESSENTIAL,      // never shed
+    WORK_CONTROL,        // shed when critical
+    WORK_BACKGROUND,     // shed unless ok
+};
+
+// Bump allocator over a fixed buffer, for ArduinoJson. Freeing the last
+// block gives its room back straight away, anything else waits until
+// every block is free. Not locked: an arena belongs to one task.
+class ResourceArena : public ArduinoJson::Allocator {
+public:
+    ResourceArena(const char* name, uint8_t* buffer, size_t size);
+
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    void* reallocate(void* ptr, size_t size) override;
+
+    const char* name() const { return _name; }
+    size_t size() const { return _size; }
+    size_t used() const { return _top; }
+    size_t peak() const { return _peak; }
+    uint32_t spills() const { return _spills; }     // allocations that went to the heap
+    uint32_t refused() const { return _refused; }   // overflows the heap was too low for
+
+private:
+    bool owns(const void* ptr) const { return ptr >= _buffer && ptr < _buffer + _size; }
+    void* spill(size_t size);
+
+    const char* _name;
+    uint8_t* _buffer;
+    size_t _size;
+    size_t _top;
+    size_t _last;        // header of the newest block, _size when there is none
+    size_t _peak;
+    uint16_t _live;
+    uint32_t _spills;
+    uint32_t _refused;
+};
+
+// The loop task's, for the HTTP handlers.
+extern ResourceArena jsonArena;
+
+struct ResourceHeap {
+    uint32_t freeBytes;
+    uint32_t minFreeBytes;
+    uint32_t largestBlock;
+    uint8_t fragmentation;   // percent
+};
+
+struct ResourceTask {
+    const char* name;
+    uint32_t stackFree;      // bytes the task never used
+};
+
+// From the loop task.
+void resourcePoll(void);
+// Before the first resourcePoll(); a task's stack is watched from then on.
+void resourceTask(TaskHandle_t task);
+bool resourceAdmit(ResourceWork work);
+ResourceLevel resourceLevel(void);
+const char* resourceLevelName(ResourceLevel level);
+ResourceHeap resourceHeap(void);
+int resourceTaskCount(void);
+ResourceTask resourceTaskAt(int i);
+
+#endif
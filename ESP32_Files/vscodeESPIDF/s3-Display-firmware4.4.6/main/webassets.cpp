@@ -0,0 +1,9 @@
+#include "webassets.h"
+#include <string.h>
+
+const WebAsset* webAssetFind(const char* path){
+    for (size_t i = 0; i < webAssetCount; i++) {
+        if (strcmp(webAssets[i].path, path) == 0) return &webAssets[i];
+    }
+    return nullptr;
+}
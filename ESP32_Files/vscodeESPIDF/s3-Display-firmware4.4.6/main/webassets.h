@@ -0,0 +1,22 @@
+#ifndef WEBASSETS_H
+#define WEBASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Setup web UI, minified and gzipped at build time by tools/webassets.py.
+// The data arrays are const so they stay in memory-mapped flash.
+struct WebAsset {
+    const char* path;
+    const char* contentType;
+    const char* etag;       // quoted, ready for the ETag header
+    const uint8_t* data;    // gzip stream
+    size_t length;
+};
+
+extern const WebAsset webAssets[];
+extern const size_t webAssetCount;
+
+const WebAsset* webAssetFind(const char* path);
+
+#endif
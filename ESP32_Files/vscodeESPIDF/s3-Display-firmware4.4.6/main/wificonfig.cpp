@@ -1,4 +1,11 @@
 #include "wificonfig.h"
+#include "events.h"
+#include "actuator.h"
+#include "provision.h"
+#include "config.h"
+#include "dlog.h"
+#include "metrics.h"
+#include "evtrace.h"
 
 
 const char* DEVICE_NAME = "ESP_DISPLAY";
@@ -7,23 +14,22 @@ const int udpPort = 5005;
 WiFiUDP udp;
 unsigned long lastSend = 0;
 char wifiReceiveBuffer[128];
-String wifissid;
-String wifipassword;
 
 void wifi_send(const char* message) {
   if (millis() - lastSend > 1000) {
     lastSend = millis();
+    EVTRACE_SCOPE("wifi_send");
 
     for (int i = 0; i < idscount; i++) {
-      if (IDS[i].length() > 0) {
-        udp.beginPacket(IDS[i].c_str(), udpPort);
+      if (IDS[i][0]) {
+        udp.beginPacket(IDS[i], udpPort);
         udp.print(message);
-        udp.endPacket();
+        metricinc(udp.endPacket() ? M_UDP_SENT : M_UDP_SEND_FAILED);
       }
     }
     
 
-    Serial.println("Sent message");
+    DLOG("Sent message\r\n");
   }
 }
 
@@ -32,27 +38,37 @@ void wifi_receive(void) {
 
   int packetSize = udp.parsePacket();
   if (packetSize <= 0) return;
+  // before beginPacket() below makes it the servo's
+  IPAddress sender = udp.remoteIP();
 
+  uint32_t start = micros();
+  EVTRACE_SCOPE("wifi_receive");
   int len = udp.read(buf, sizeof(buf) - 1);
   if (len <= 0) return;
+  metricinc(M_UDP_RECEIVED);
+  if (packetSize > len) metricinc(M_UDP_TRUNCATED);
 
   buf[len] = '\0';
 
-  Serial.print("Received: ");
-  Serial.println(buf);
+  DLOG("Received: %s\r\n", buf);
 
   // Robust command match (ignores trailing junk)
   if (strncmp(buf, "INTRUDER INTRUDER", 16) == 0) {
+    // "t=<hex>" from sensors that trace, it goes on to the servo.
+    const char* tag = strstr(buf, " t=");
+    uint32_t traceid = tag ? strtoul(tag + 3, nullptr, 16) : 0;
+    evtraceflow(EVTRACE_FLOW_STEP, "alarm", traceid);
+    metricinc(M_INTRUSIONS);
 
     udp.beginPacket("192.168.0.202", 5005);
     udp.print("INTRUDER INTRUDER\n");
-    udp.endPacket();
-    myServo.write(0);    // 0°
-    delay(200);
-    myServo.write(180);   // 90°
-    delay(200);
-    myServo.write(0);  // 180°
-    delay(200);
+    metricinc(udp.endPacket() ? M_UDP_SENT : M_UDP_SEND_FAILED);
+    actuatorSend(ACT_ALARM, 0, traceid);
+    metricobserve(M_ALERT, micros() - start);
+    // After the alarm is out, the journal write can wait on the flash.
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", sender[0], sender[1], sender[2], sender[3]);
+    hubEventRecord(EVT_INTRUSION, ip);
   }
 
 }
@@ -65,7 +81,7 @@ bool wifiapstart(){
 
   const int maxTries = 3;
   for (int i = 0; i < maxTries; i++) {
-    if (WiFi.softAP("ESP32_Master_Config","", 11)) {
+    if (WiFi.softAP("ESP32_Master_Config", provision.appass.c_str(), 11)) {
       // Wait until AP actually has an IP (ready to serve)
       unsigned long start = millis();
       while (WiFi.softAPIP()[0] == 0 && (millis() - start < 5000)) {
@@ -85,9 +101,17 @@ bool wifiapstart(){
 
 String memoryssid = "";
 String memorypass = "";
+// An uplink set from the app is newer than the flasher's.
 void getcred(){
-  memoryssid = littlefsReadFile("/wifissid.txt");
-  memorypass = littlefsReadFile("/wifipass.txt");
+  if (config.ssid[0]) {
+    memoryssid = config.ssid;
+    memorypass = config.pass;
+    return;
+  }
+  if (provision.valid && provision.ssid.length() > 0) {
+    memoryssid = provision.ssid;
+    memorypass = provision.pass;
+  }
 }
 
 void wifistastart(){
@@ -96,14 +120,28 @@ void wifistastart(){
   Serial.printf("WifiConnected");
 }
 
+// Turns station connect/disconnect edges into hub events.
+void wifistatuspoll(){
+  static bool wasConnected = false;
+  bool connected = WiFi.status() == WL_CONNECTED;
+  if (connected == wasConnected) return;
+  wasConnected = connected;
+  if (connected) {
+    IPAddress local = WiFi.localIP();
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", local[0], local[1], local[2], local[3]);
+    hubEventRecord(EVT_WIFI_CONNECTED, ip);
+  } else {
+    hubEventRecord(EVT_WIFI_LOST);
+  }
+}
+
 static bool serverStarted = false;
 void wifiInit(){
   WiFi.mode(WIFI_AP_STA);
-  wifiapstart();
   if (!wifiapstart()) {
     Serial.println("Warning: AP did not start; continuing with STA only.");
   }
-  delay(1000);
   wifistastart();
   udp.begin(udpPort);
 }
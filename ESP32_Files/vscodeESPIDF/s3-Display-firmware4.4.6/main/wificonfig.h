@@ -2,28 +2,26 @@
 #define WIFICONFIG_H
 
 #include "WiFi.h"
-#include "WebServer.h"
+#include "hubserver.h"
 #include "filesys.h"
 #include "display.h"
 #include <WiFiUdp.h>
 #include "esp_wifi.h"
 #include "HTTPClient.h"
-#include <ESP32Servo.h>
 
 
-extern WebServer server;
+extern HubServer server;
 void wifiInit(void);
 extern WiFiUDP udp;
 void setuppageserver(void);
 void wifi_send(const char* message);
 void wifi_receive(void);
-extern Servo myServo;
+void wifistatuspoll(void);
 
 void apihandle(void);
-extern String wifissid;
-extern String wifipassword;
 extern int idscount;
-extern String IDS[20];
+#define IDS_ADDR_LEN 16   //dotted quad and NUL
+extern char IDS[20][IDS_ADDR_LEN];
 
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Minifies and gzips the setup web UI into a C++ asset table.
+
+    webassets.py -o webassets_data.cpp /=path/to/page.html [/other.js=...]
+
+Each asset becomes a const array, so it stays in memory-mapped flash, and
+gets a strong ETag derived from the compressed bytes.
+"""
+import argparse
+import gzip
+import hashlib
+import mimetypes
+import re
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".json": "application/json",
+}
+
+
+# Where whitespace is content: JS template literals, and in HTML <pre> and
+# <textarea>. These are copied as they are.
+TEMPLATE_LITERAL = r"`(?:\\.|[^`\\])*`"
+VERBATIM = {
+    ".html": re.compile(r"<(pre|textarea)\b.*?</\1\s*>|" + TEMPLATE_LITERAL, re.S | re.I),
+    ".js": re.compile(TEMPLATE_LITERAL, re.S),
+    ".css": None,
+}
+
+
+def collapse(text):
+    # Whitespace next to a line break: indentation, trailing blanks, empty
+    # lines. Whitespace inside a line is left alone, so string literals
+    # and inline text keep theirs.
+    return re.sub(r"[ \t]*\r?\n\s*", "\n", text)
+
+
+def minify(data, ext):
+    if ext not in VERBATIM:
+        return data
+    text = data.decode("utf-8")
+    if ext == ".html":
+        text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    out = []
+    pos = 0
+    for m in VERBATIM[ext].finditer(text) if VERBATIM[ext] else ():
+        out.append(collapse(text[pos:m.start()]))
+        out.append(m.group(0))
+        pos = m.end()
+    out.append(collapse(text[pos:]))
+    return "".join(out).strip().encode("utf-8")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("assets", nargs="+", help="url=path pairs")
+    args = parser.parse_args()
+
+    out = ['// Generated by tools/webassets.py, do not edit.',
+           '#include "webassets.h"', '']
+    table = []
+    for i, spec in enumerate(args.assets):
+        url, path = spec.split("=", 1)
+        ext = "." + path.rsplit(".", 1)[-1].lower()
+        with open(path, "rb") as f:
+            raw = f.read()
+        packed = gzip.compress(minify(raw, ext), compresslevel=9, mtime=0)
+        etag = hashlib.sha256(packed).hexdigest()[:16]
+        ctype = CONTENT_TYPES.get(ext) or mimetypes.guess_type(path)[0] or "application/octet-stream"
+
+        out.append("static const uint8_t asset%d[] = {" % i)
+        for off in range(0, len(packed), 16):
+            out.append("    " + ", ".join("0x%02x" % b for b in packed[off:off + 16]) + ",")
+        out.append("};")
+        out.append("")
+        table.append('    { "%s", "%s", "\\"%s\\"", asset%d, sizeof(asset%d) },'
+                     % (url, ctype, etag, i, i))
+        print("webassets: %s %d -> %d bytes, etag %s" % (url, len(raw), len(packed), etag))
+
+    out.append("const WebAsset webAssets[] = {")
+    out.extend(table)
+    out.append("};")
+    out.append("const size_t webAssetCount = sizeof(webAssets) / sizeof(webAssets[0]);")
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
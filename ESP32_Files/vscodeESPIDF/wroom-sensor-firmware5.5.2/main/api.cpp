@@ -1,4 +1,9 @@
 #include "api.h"
+#include "trace.h"
+#include "metrics.h"
+#include "evtrace.h"
+#include "events.h"
+#include "config.h"
 
 WebServer server(80);
 
@@ -6,7 +11,8 @@ void sendalert(String message){
     HTTPClient http;
     http.begin("http://192.168.10.1/api/module");
     http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-    http.POST(message);
+    int code = http.POST(message);
+    if (code < 200 || code >= 300) metricinc(M_HUB_POSTS_FAILED);
     http.end();
 }
 
@@ -25,7 +31,7 @@ void mainconnectionset(){
     String espmainpass = server.arg("pass");
     Serial.println(espmainpass);
     server.send(200, "text/plain", "OK");
-    littlefsWriteFile("/wifissid.txt", espmainpass);
+    strlcpy(configedit().hubpass, espmainpass.c_str(), sizeof(config.hubpass));
     WiFi.mode(WIFI_OFF);
     delay(500);
     WiFi.mode(WIFI_STA);
@@ -34,9 +40,109 @@ void mainconnectionset(){
     setupdone = true;
 }
 
+// The recorded echo trace, see trace.h for the format. Streamed in
+// pieces, a full ring is 64 KB.
+void traceget(){
+    traceflush();
+    uint32_t count = tracecount();
+    uint8_t header[TRACE_HEADER_SIZE];
+    traceheader(header, count);
+    server.setContentLength(TRACE_HEADER_SIZE + count * TRACE_RECORD_SIZE);
+    server.send(200, "application/octet-stream", "");
+    server.sendContent((const char*)header, sizeof(header));
+    uint8_t chunk[128 * TRACE_RECORD_SIZE];
+    for (uint32_t at = 0; at < count; ) {
+        uint32_t n = traceread(at, chunk, 128);
+        if (n == 0) break;
+        server.sendContent((const char*)chunk, n * TRACE_RECORD_SIZE);
+        at += n;
+    }
+}
+
+// record=1 starts recording and record=0 stops it, clear=1 empties the ring.
+void traceset(){
+    if (server.arg("clear") == "1") traceclear();
+    if (server.hasArg("record")) tracerecording(server.arg("record") == "1");
+    server.send(200, "text/plain", traceisrecording() ? "recording" : "stopped");
+}
+
+// Hands printTo's output to sendContent a chunk at a time.
+class ContentWriter : public Print {
+public:
+    ~ContentWriter() { push(); }
+    size_t write(uint8_t b) override {
+        if (used == sizeof(chunk)) push();
+        chunk[used++] = b;
+        return 1;
+    }
+    void push() {
+        if (used > 0) server.sendContent((const char*)chunk, used);
+        used = 0;
+    }
+
+private:
+    uint8_t chunk[256];
+    size_t used = 0;
+};
+
+// A snapshot that prints the same every time, length first.
+static void sendprinted(const char* type, const Printable& body, size_t length){
+    server.setContentLength(length);
+    server.send(200, type, "");
+    ContentWriter out;
+    body.printTo(out);
+}
+
+// Prometheus text format, see metrics.h.
+void metricsget(){
+    metricset(M_ARMED, motiononflag);
+    metricsnapshot snapshot;
+    sendprinted(METRICS_CONTENT_TYPE, snapshot, snapshot.length());
+}
+
+// The event trace, see evtrace.h for the format.
+void evtraceget(){
+    evtracesnapshot snapshot;
+    sendprinted(EVTRACE_CONTENT_TYPE, snapshot, snapshot.length());
+}
+
+// clear=1 forgets the events so far.
+void evtraceset(){
+    if (server.arg("clear") == "1") evtraceclear();
+    server.send(200, "text/plain", "OK");
+}
+
+// History from the journal, newest first: limit records (20) before seq
+// before, or before the time boot and ms when boot is given.
+void journalget(){
+    uint32_t before = strtoul(server.arg("before").c_str(), nullptr, 10);
+    if (server.hasArg("boot")) {
+        before = journalseqafter(journaltime(server.arg("boot").toInt(), strtoull(server.arg("ms").c_str(), nullptr, 10)));
+    }
+    int limit = server.hasArg("limit") ? server.arg("limit").toInt() : 20;
+    journalpage page(before, limit, eventname);
+    sendprinted("application/json", page, page.length());
+}
+
+// Every route through here, so each request is counted, timed and traced.
+static void route(const char* path, HTTPMethod method, void (*handler)(void)){
+    server.on(path, method, [path, handler]() {
+        uint32_t start = micros();
+        EVTRACE_SCOPE(path);
+        handler();
+        metricinc(M_HTTP_REQUESTS);
+        metricobserve(M_HTTP, micros() - start);
+    });
+}
 
 void apirouting(){
-    server.on("/api/onetimepass", HTTP_POST, onetimepassset);
-    server.on("/api/permanentpass", HTTP_POST, permanentpassset);
-    server.on("/api/mainconnection", HTTP_POST, mainconnectionset);
+    route("/api/onetimepass", HTTP_POST, onetimepassset);
+    route("/api/permanentpass", HTTP_POST, permanentpassset);
+    route("/api/mainconnection", HTTP_POST, mainconnectionset);
+    route("/api/trace", HTTP_GET, traceget);
+    route("/api/trace", HTTP_POST, traceset);
+    route("/api/metrics", HTTP_GET, metricsget);
+    route("/api/evtrace", HTTP_GET, evtraceget);
+    route("/api/evtrace", HTTP_POST, evtraceset);
+    route("/api/journal", HTTP_GET, journalget);
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "config.h"
+#include "LittleFS.h"
+#include "api.h"
+#include "dlog.h"
+
+// "generic" is what earlier firmware wrote when there was nothing.
+static bool placeholder(const String& value){
+  return value.length() == 0 || value == "generic";
+}
+
+// setup() has mounted LittleFS by now. /api/mainconnection saved the
+// password as /wifissid.txt, so that one is the newer.
+void configdefaults(configdata& c){
+  const char* files[] = {"/wifissid.txt", "/wifipass.txt"};
+  for (const char* file : files) {
+    if (!LittleFS.exists(file)) continue;
+    String pass = littlefsReadFile(file);
+    if (placeholder(pass)) continue;
+    strlcpy(c.hubpass, pass.c_str(), sizeof(c.hubpass));
+    DLOG("config: imported %s\r\n", file);
+    break;
+  }
+}
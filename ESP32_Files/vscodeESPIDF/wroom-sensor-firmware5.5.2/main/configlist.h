@@ -0,0 +1,4 @@
+// The module's settings, see config.h. No include guard, it is read once
+// for the struct and once more for the strings. The order is the blob's.
+
+CONFIG_STRING(hubpass, 65)             // ESP32_Master_Config, set from the app
@@ -0,0 +1,27 @@
+#include "detect.h"
+
+const detectparams detectdefaults = {10.0f, 1, 0.0f};
+
+float detectcm(unsigned int echous){
+  // Sound covers 0.0343 cm/us, there and back.
+  return echous * 0.0343f / 2;
+}
+
+void detectreset(detectstate* state){
+  state->last = 0;
+  state->hits = 0;
+  state->primed = false;
+}
+
+bool detectstep(const detectparams* params, detectstate* state, float cm){
+  if (params->maxcm > 0 && cm > params->maxcm) return false;
+  if (!state->primed) {
+    state->last = cm;
+    state->primed = true;
+    return false;
+  }
+  bool drop = state->last - cm > params->dropcm;
+  state->last = cm;
+  state->hits = drop ? state->hits + 1 : 0;
+  return state->hits >= params->confirm;
+}
@@ -0,0 +1,28 @@
+#ifndef DETECT_H
+#define DETECT_H
+
+#include <stdbool.h>
+
+// Motion detection on the sonar readings, kept free of Arduino so
+// hosthal's tracereplay runs the same code over recorded traces.
+struct detectparams {
+  float dropcm;     // a reading this much closer than the last one is movement
+  int confirm;      // readings in a row that have to drop before it counts
+  float maxcm;      // readings past this are no echo and skipped, 0 keeps all
+};
+
+struct detectstate {
+  float last;
+  int hits;
+  bool primed;
+};
+
+// What the sensor has always done: a 10 cm drop between two readings.
+extern const detectparams detectdefaults;
+
+float detectcm(unsigned int echous);
+void detectreset(detectstate* state);
+// One reading, true when it counts as movement.
+bool detectstep(const detectparams* params, detectstate* state, float cm);
+
+#endif
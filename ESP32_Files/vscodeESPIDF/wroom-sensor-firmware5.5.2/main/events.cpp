@@ -0,0 +1,13 @@
+#include "events.h"
+
+const char* eventname(uint8_t type){
+  switch (type) {
+    case SEV_ARMED:         return "armed";
+    case SEV_DISARMED:      return "disarmed";
+    case SEV_INTRUSION:     return "intrusion";
+    case SEV_KEYPAD_OK:     return "keypad_ok";
+    case SEV_KEYPAD_DENIED: return "keypad_denied";
+    case SEV_JOINED:        return "joined";
+  }
+  return "unknown";
+}
@@ -0,0 +1,23 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+#include "journal.h"
+
+// What the sensor writes to the journal. The values are on flash, add new
+// ones at the end.
+enum sensoreventtype : uint8_t {
+  SEV_ARMED,
+  SEV_DISARMED,
+  SEV_INTRUSION,
+  SEV_KEYPAD_OK,
+  SEV_KEYPAD_DENIED,
+  SEV_JOINED,
+};
+
+inline void eventrecord(sensoreventtype type, const char* detail = ""){
+  journalappend(type, detail);
+}
+const char* eventname(uint8_t type);
+
+#endif
@@ -1,4 +1,6 @@
 #include "keypad.h"
+#include "dlog.h"
+#include "events.h"
 
 void keypadinit();
 void keypadpress();
@@ -24,28 +26,28 @@ void keypadpress(){
     digitalWrite(18, HIGH);
     delay(10);
     if ( digitalRead(23) == HIGH ){
-        Serial.print("1");
+        DLOG("1");
         keypadpassword[passwordcount] = '1';
         passwordcount++;
         digitalWrite(18, LOW);
         delay(50);
     }
     if ( digitalRead(25) == HIGH ){
-        Serial.print("2");
+        DLOG("2");
         keypadpassword[passwordcount] = '2';
         passwordcount++;
         digitalWrite(18, LOW);
         delay(50);
     }
     if ( digitalRead(26) == HIGH ){
-        Serial.print("3");
+        DLOG("3");
         keypadpassword[passwordcount] = '3';
         passwordcount++;
         digitalWrite(18, LOW);
         delay(50);
     }
     if ( digitalRead(27) == HIGH ){
-        Serial.print("A");
+        DLOG("A");
         keypadpassword[passwordcount] = 'A';
         passwordcount++;
         digitalWrite(18, LOW);
@@ -56,28 +58,28 @@ void keypadpress(){
     digitalWrite(19, HIGH);
     delay(10);
     if ( digitalRead(23) == HIGH ){
-        Serial.print("4");
+        DLOG("4");
         keypadpassword[passwordcount] = '4';
         passwordcount++;
         digitalWrite(19, LOW);
         delay(50);
     }
     if ( digitalRead(25) == HIGH ){
-        Serial.print("5");
+        DLOG("5");
         keypadpassword[passwordcount] = '5';
         passwordcount++;
         digitalWrite(19, LOW);
         delay(50);
     }
     if ( digitalRead(26) == HIGH ){
-        Serial.print("6");
+        DLOG("6");
         keypadpassword[passwordcount] = '6';
         passwordcount++;
         digitalWrite(19, LOW);
         delay(50);
     }
     if ( digitalRead(27) == HIGH ){
-        Serial.print("B");
+        DLOG("B");
         keypadpassword[passwordcount] = 'B';
         passwordcount++;
         digitalWrite(19, LOW);
@@ -88,28 +90,28 @@ void keypadpress(){
     digitalWrite(21, HIGH);
     delay(10);
     if ( digitalRead(23) == HIGH ){
-        Serial.print("7");
+        DLOG("7");
         keypadpassword[passwordcount] = '7';
         passwordcount++;
         digitalWrite(21, LOW);
         delay(50);
     }
     if ( digitalRead(25) == HIGH ){
-        Serial.print("8");
+        DLOG("8");
         keypadpassword[passwordcount] = '8';
         passwordcount++;
         digitalWrite(21, LOW);
         delay(50);
     }
     if ( digitalRead(26) == HIGH ){
-        Serial.print("9");
+        DLOG("9");
         keypadpassword[passwordcount] = '9';
         passwordcount++;
         digitalWrite(21, LOW);
         delay(50);
     }
     if ( digitalRead(27) == HIGH ){
-        Serial.print("C");
+        DLOG("C");
         keypadpassword[passwordcount] = 'C';
         passwordcount++;
         digitalWrite(21, LOW);
@@ -120,28 +122,28 @@ void keypadpress(){
     digitalWrite(22, HIGH);
     delay(10);
     if ( digitalRead(23) == HIGH ){
-        Serial.print("*");
+        DLOG("*");
         keypadpassword[passwordcount] = '*';
         passwordcount++;
         digitalWrite(22, LOW);
         delay(50);
     }
     if ( digitalRead(25) == HIGH ){
-        Serial.print("0");
+        DLOG("0");
         keypadpassword[passwordcount] = '0';
         passwordcount++;
         digitalWrite(22, LOW);
         delay(50);
     }
     if ( digitalRead(26) == HIGH ){
-        Serial.print("#");
+        DLOG("#");
         keypadpassword[passwordcount] = '#';
         passwordcount++;
         digitalWrite(22, LOW);
         delay(50);
     }
     if ( digitalRead(27) == HIGH ){
-        Serial.print("D");
+        DLOG("D");
         keypadpassword[passwordcount] = 'D';
         passwordcount++;
         digitalWrite(22, LOW);
@@ -152,27 +154,32 @@ void keypadpress(){
     if (passwordcount == 8) {
         keypadpassword[8] = '\0';
         if (strncmp(keypadpassword, setpassword.c_str(), strlen(keypadpassword)) == 0 && motiononflag == 1){
-            Serial.println("approved 5s cooldown");
+            DLOG("approved 5s cooldown\r\n");
+            eventrecord(SEV_KEYPAD_OK);
             motiononflag = 0;
             delay(5000);
             motiononflag = 1;
         }
         else if (strncmp(keypadpassword, setpassword.c_str(), strlen(keypadpassword)) == 0){
-            Serial.println("approved");
+            DLOG("approved\r\n");
+            eventrecord(SEV_KEYPAD_OK);
         }
         else if ( onetimepass == keypadpassword && motiononflag == 1 ){
-            Serial.println("approved via otp 5s cooldown");
+            DLOG("approved via otp 5s cooldown\r\n");
+            eventrecord(SEV_KEYPAD_OK, "otp");
             onetimepass = "GGGGGGGGG";
             motiononflag = 0;
             delay(5000);
             motiononflag = 1;
         }
         else if ( onetimepass == keypadpassword ){
-            Serial.println("approved via otp");
+            DLOG("approved via otp\r\n");
+            eventrecord(SEV_KEYPAD_OK, "otp");
             onetimepass = "GGGGGGGGG";
         }
         else {
-            Serial.println("nope ");
+            DLOG("nope \r\n");
+            eventrecord(SEV_KEYPAD_DENIED);
         }
         passwordcount = 0;
     }
@@ -4,6 +4,15 @@
 #include <stdbool.h>
 #include "api.h"
 #include "esp_system.h"
+#include "provision.h"
+#include "config.h"
+#include "detect.h"
+#include "trace.h"
+#include "dlog.h"
+#include "metrics.h"
+#include "evtrace.h"
+#include "events.h"
+#include "esp_random.h"
 //////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////
@@ -13,7 +22,7 @@
 
 //////////////////////////////////wifisetup/////////////////////////////////////
 const char* ssid = "ESP32_Master_Config";
-String password = littlefsReadFile("/wifipass.txt");
+String password;
 
 const char* DEVICE_NAME = "ESP_MOTION";   // <-- change to ESP_B on the other board
 String ipgiven = WiFi.localIP().toString();
@@ -29,8 +38,7 @@ volatile unsigned int echo_time = 0;
 volatile bool measurementFlag = false;
 float distance = 0;
 
-float lastDistance = 0;
-float nowDistance = 0;
+detectstate detector;
 int motiononflag = 0;
 
 bool setupdone = false;
@@ -67,16 +75,30 @@ void IRAM_ATTR echo()
   if (digitalRead(ECHO) == HIGH){
     timer_start();
     measurementFlag = false;
+    evtracebegin("echo");
   }
   if (digitalRead(ECHO) == LOW){
     timer_stop();
     measurementFlag = true;
+    evtraceend("echo");
   }
 }
 
 void setup() {
   Serial.begin(115200);
+  dlogbegin(DLOG_SINK);
   littlefsinit();
+  journalbegin();
+  traceinit();
+  detectreset(&detector);
+  configload(configdefaults);
+  if (provisionLoad()) {
+    Serial.printf("Provisioned as %s\n", provision.module.c_str());
+    if (provision.module.length() > 0) DEVICE_NAME = provision.module.c_str();
+    if (provision.disarm.length() > 0) setpassword = provision.disarm;
+  }
+  // A password set from the app is newer than the flasher's.
+  password = config.hubpass[0] ? String(config.hubpass) : provision.pass;
   keypadinit();
   init_timer();
   //////////////////////////////// SETTING ECHO GPIO ////////////////////////////////////////////
@@ -109,16 +131,22 @@ void setup() {
   }
   
   
-  sendalert("alert=" + WiFi.localIP().toString());
-  HTTPClient http;
-  http.begin("http://192.168.10.1/api/getpermanentpass");
-  if (http.GET() == HTTP_CODE_OK) {
-    String response = http.getString();
-    if (response.startsWith("pass=")) {
-      setpassword = response.substring(5);
+  String join = "alert=" + WiFi.localIP().toString();
+  if (provision.pairkey.length() > 0) join += "&key=" + provision.pairkey;
+  sendalert(join);
+  eventrecord(SEV_JOINED, WiFi.localIP().toString().c_str());
+  // A provisioned module already has the code, others ask the hub for it.
+  if (provision.disarm.length() == 0) {
+    HTTPClient http;
+    http.begin("http://192.168.10.1/api/getpermanentpass");
+    if (http.GET() == HTTP_CODE_OK) {
+      String response = http.getString();
+      if (response.startsWith("pass=")) {
+        setpassword = response.substring(5);
+      }
     }
+    http.end();
   }
-  http.end();
   Serial.println("\nConnected!");
   Serial.print("My IP: ");
   Serial.println(WiFi.localIP());
@@ -129,23 +157,28 @@ void setup() {
 }
 
 void loop() {
+  uint32_t start = micros();
   //measurementFlag = false;
   server.handleClient();
   keypadpress();
+  uint32_t trigger = micros();
+  evtracebegin("ranging");
   digitalWrite(TRIG, HIGH);
   delayMicroseconds(10);
   digitalWrite(TRIG, LOW);
   while (measurementFlag == false){
 
   }
-  distance = echo_time * 0.0343 / 2;
-  
-  lastDistance = nowDistance;
-  nowDistance = distance;
+  evtraceend("ranging");
+  metricobserve(M_ECHO_WAIT, micros() - trigger);
+  distance = detectcm(echo_time);
+  metricset(M_DISTANCE_MM, (int32_t)(distance * 10));
+  tracerecord(echo_time, motiononflag == 1);
+  evtracebegin("detect");
+  bool moved = detectstep(&detectdefaults, &detector, distance);
+  evtraceend("detect");
 
-  
- 
-  //Serial.printf("Distance: %.3f   Last: %.3f   Now: %.3f\n", distance, lastDistance, nowDistance);
+  //Serial.printf("Distance: %.3f\n", distance);
   delay(200);
   /////////////////////////////wifisetup////////////////////////////////////////////
   // ---- RECEIVE ----
@@ -155,8 +188,9 @@ void loop() {
     
     int len = udp.read(buf, sizeof(buf) - 1);
     buf[len] = 0;
-    Serial.print("Received: ");
-    Serial.println(buf);
+    metricinc(M_UDP_RECEIVED);
+    if (packetSize > len) metricinc(M_UDP_TRUNCATED);
+    DLOG("Received: %s\r\n", buf);
   }
 
   // ---- SEND ----
@@ -174,10 +208,15 @@ void loop() {
   
   /////////////////////////////TURN ON MOTION DETECTOR////////////////////////////////////////////
   if (motiononflag == 1){
-    if(lastDistance - nowDistance > 10){
+    if(moved){
+      metricinc(M_INTRUSIONS);
+      // The hub carries the id on, so the traces of both join up.
+      uint32_t traceid = esp_random() | 1;
+      EVTRACE_SCOPE("alert");
+      evtraceflow(EVTRACE_FLOW_START, "alarm", traceid);
       int count = 0;
       while(count < 2){
-        Serial.printf("intruder detected\n");
+        DLOG("intruder detected\n");
         if (count == 0){
           // const char* targetIP   = "192.168.1.69"; //to safirs mac
           // const int   udpPort    = 5005;
@@ -190,12 +229,16 @@ void loop() {
           const char* targetIP   = "192.168.10.1"; //to esp32 s3
           const int   udpPort    = 5005;
           udp.beginPacket(targetIP, udpPort);
-          udp.printf("INTRUDER INTRUDER");
-          udp.endPacket();
+          udp.printf("INTRUDER INTRUDER t=%08x", (unsigned)traceid);
+          metricinc(udp.endPacket() ? M_UDP_SENT : M_UDP_SEND_FAILED);
           delay(10);
         }
         count++;
       }
+      // Kept once the hub has been told, so the flash write is not in the way.
+      char detail[JOURNAL_DETAIL_LEN + 1];
+      snprintf(detail, sizeof(detail), "%.0f cm", distance);
+      eventrecord(SEV_INTRUSION, detail);
     }
   }
   /////////////////////////////TURN ON MOTION DETECTOR////////////////////////////////////////////
@@ -204,22 +247,27 @@ void loop() {
   if (strncmp(buf, "turnonmotiondetectorespmotion", strlen("turnonmotiondetectorespmotion")) == 0) {
     motiononflag = 1;
     Serial.println("Motion detector turned ON");
+    eventrecord(SEV_ARMED, udp.remoteIP().toString().c_str());
     udp.beginPacket("192.168.10.1", udpPort);
     udp.printf("MOTION DETECTOR ON\n");
-    udp.endPacket();
+    metricinc(udp.endPacket() ? M_UDP_SENT : M_UDP_SEND_FAILED);
   }
   else if (strncmp(buf, "turnoffmotiondetectorespmotion", strlen("turnoffmotiondetectorespmotion")) == 0) {
     motiononflag = 0;
     Serial.println("Motion detector turned OFF");
+    eventrecord(SEV_DISARMED, udp.remoteIP().toString().c_str());
     udp.beginPacket("192.168.10.1", udpPort);
     udp.printf("MOTION DETECTOR OFF\n");
-    udp.endPacket();
+    metricinc(udp.endPacket() ? M_UDP_SENT : M_UDP_SEND_FAILED);
   }
+  configloop();
+  metricobserve(M_LOOP, micros() - start);
   /////////////////////////////mode select////////////////////////////////////////////
 
   if ((WiFi.status() == WL_DISCONNECTED || WiFi.status() == WL_CONNECTION_LOST) && setupdone == true) {
     Serial.println("No Connection");
     delay(5000);
+    configflush();
     esp_restart();
   }
 }
@@ -0,0 +1,18 @@
+// The sensor's metrics, see metrics.h. No include guard, it is read once
+// per enum and table. Names get METRICS_PREFIX in front.
+
+METRIC_COUNTER(M_UDP_RECEIVED, "udp_received_total", "UDP datagrams read")
+METRIC_COUNTER(M_UDP_TRUNCATED, "udp_truncated_total", "UDP datagrams longer than the receive buffer")
+METRIC_COUNTER(M_UDP_SENT, "udp_sent_total", "UDP datagrams sent to the hub")
+METRIC_COUNTER(M_UDP_SEND_FAILED, "udp_send_failed_total", "UDP datagrams the stack refused")
+METRIC_COUNTER(M_INTRUSIONS, "intrusions_total", "Detections while armed")
+METRIC_COUNTER(M_HUB_POSTS_FAILED, "hub_posts_failed_total", "Alerts to the hub's HTTP API that failed")
+METRIC_COUNTER(M_HTTP_REQUESTS, "http_requests_total", "HTTP API requests handled")
+METRIC_COUNTER(M_CONFIG_WRITES, "config_writes_total", "Config blobs written to NVS")
+
+METRIC_GAUGE(M_ARMED, "armed", "1 while the motion detector is on")
+METRIC_GAUGE(M_DISTANCE_MM, "distance_mm", "Last sonar reading")
+
+METRIC_HISTOGRAM(M_LOOP, "loop_seconds", "loop() iteration time")
+METRIC_HISTOGRAM(M_ECHO_WAIT, "echo_wait_seconds", "Trigger to measured echo")
+METRIC_HISTOGRAM(M_HTTP, "http_request_seconds", "HTTP API handler time")
@@ -2,18 +2,12 @@
 #include "FS.h"
 #include "api.h"
 
-void littlefsWriteFile(String filename, String content);
-
 void littlefsinit(){
     if (!LittleFS.begin(true)) {   
     Serial.println("LittleFS mount failed");
     return;
     }
     Serial.println("LittleFS mounted");
-
-    if (LittleFS.exists("/wifipass.txt")){
-        littlefsWriteFile("/wifipass.txt", "generic");
-    }    
 }
 
 void littlefsWriteFile(String filename, String content){
@@ -0,0 +1,7 @@
+// What the module reads from the provision namespace, see provision.h. No
+// include guard, it is read once for the struct and twice to load it.
+
+PROVISION_STRING(pass)                 // password of the hub's ESP32_Master_Config
+PROVISION_STRING(module)               // ESP_MOTION_<last three MAC bytes>
+PROVISION_STRING(disarm)               // keypad code, saves asking the hub for it
+PROVISION_STRING(pairkey)              // sent with the join request to /api/module
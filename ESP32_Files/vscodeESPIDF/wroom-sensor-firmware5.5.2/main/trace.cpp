@@ -0,0 +1,134 @@
+#include "trace.h"
+#include <Arduino.h>
+#include "LittleFS.h"
+#include "FS.h"
+#include <string.h>
+
+// /trace.bin is the export header with the ring's write position after it,
+// then TRACE_CAPACITY record slots.
+#define TRACE_FILE "/trace.bin"
+#define TRACE_FILE_HEADER (TRACE_HEADER_SIZE + 4)
+
+static uint8_t staged[TRACE_STAGE * TRACE_RECORD_SIZE];
+static int stagedcount = 0;
+static uint32_t head = 0;       // next slot to write
+static uint32_t stored = 0;     // slots in use
+static bool recording = false;
+static unsigned long lastms = 0;
+
+static void put16(uint8_t* out, uint32_t value){
+  out[0] = value & 0xff;
+  out[1] = (value >> 8) & 0xff;
+}
+
+static void put32(uint8_t* out, uint32_t value){
+  put16(out, value);
+  put16(out + 2, value >> 16);
+}
+
+static uint32_t get32(const uint8_t* in){
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void traceheader(uint8_t* out, uint32_t count){
+  memcpy(out, TRACE_MAGIC, 4);
+  out[4] = TRACE_VERSION;
+  out[5] = 0;
+  put16(out + 6, 0);
+  put32(out + 8, count);
+}
+
+void traceinit(){
+  File file = LittleFS.open(TRACE_FILE);
+  uint8_t header[TRACE_FILE_HEADER];
+  if (file && file.read(header, sizeof(header)) == sizeof(header) &&
+      memcmp(header, TRACE_MAGIC, 4) == 0 && header[4] == TRACE_VERSION) {
+    stored = get32(header + 8);
+    head = get32(header + TRACE_HEADER_SIZE);
+    if (stored > TRACE_CAPACITY || head >= TRACE_CAPACITY) stored = head = 0;
+  }
+  file.close();
+}
+
+void tracerecording(bool on){
+  if (!on) traceflush();
+  if (on && !recording) lastms = millis();
+  recording = on;
+}
+
+bool traceisrecording(){
+  return recording;
+}
+
+void tracerecord(unsigned int echous, bool armed){
+  if (!recording) return;
+  unsigned long now = millis();
+  unsigned long dt = now - lastms;
+  lastms = now;
+  if (dt > TRACE_MAX_DT) dt = TRACE_MAX_DT;
+  uint8_t* record = staged + stagedcount * TRACE_RECORD_SIZE;
+  put16(record, dt | (armed ? TRACE_ARMED : 0));
+  put16(record + 2, echous > 0xffff ? 0xffff : echous);
+  if (++stagedcount == TRACE_STAGE) traceflush();
+}
+
+void traceflush(){
+  if (stagedcount == 0) return;
+  File file = LittleFS.open(TRACE_FILE, "r+");
+  if (!file) file = LittleFS.open(TRACE_FILE, "w+");
+  if (!file) {
+    Serial.println("trace: cannot open " TRACE_FILE);
+    stagedcount = 0;
+    return;
+  }
+  // At most two writes, the second when the ring wraps.
+  int done = 0;
+  while (done < stagedcount) {
+    int n = stagedcount - done;
+    if (n > (int)(TRACE_CAPACITY - head)) n = TRACE_CAPACITY - head;
+    file.seek(TRACE_FILE_HEADER + head * TRACE_RECORD_SIZE);
+    file.write(staged + done * TRACE_RECORD_SIZE, n * TRACE_RECORD_SIZE);
+    head = (head + n) % TRACE_CAPACITY;
+    done += n;
+  }
+  stored += stagedcount;
+  if (stored > TRACE_CAPACITY) stored = TRACE_CAPACITY;
+  stagedcount = 0;
+  uint8_t header[TRACE_FILE_HEADER];
+  traceheader(header, stored);
+  put32(header + TRACE_HEADER_SIZE, head);
+  file.seek(0);
+  file.write(header, sizeof(header));
+  file.close();
+}
+
+void traceclear(){
+  stagedcount = 0;
+  head = stored = 0;
+  LittleFS.remove(TRACE_FILE);
+}
+
+uint32_t tracecount(){
+  return stored;
+}
+
+uint32_t traceread(uint32_t index, uint8_t* out, uint32_t count){
+  if (index >= stored) return 0;
+  if (count > stored - index) count = stored - index;
+  File file = LittleFS.open(TRACE_FILE);
+  if (!file) return 0;
+  // Oldest first: once the ring is full that is the slot about to be
+  // overwritten.
+  uint32_t slot = (stored < TRACE_CAPACITY ? index : head + index) % TRACE_CAPACITY;
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t n = count - done;
+    if (n > TRACE_CAPACITY - slot) n = TRACE_CAPACITY - slot;
+    file.seek(TRACE_FILE_HEADER + slot * TRACE_RECORD_SIZE);
+    if (file.read(out + done * TRACE_RECORD_SIZE, n * TRACE_RECORD_SIZE) != n * TRACE_RECORD_SIZE) break;
+    slot = (slot + n) % TRACE_CAPACITY;
+    done += n;
+  }
+  file.close();
+  return done;
+}
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Raw sonar readings for tuning detect.cpp offline. While recording, every
+// echo goes into a ring on LittleFS (/trace.bin) that keeps the last
+// TRACE_CAPACITY readings, GET /api/trace exports them oldest first.
+//
+// Export format, little endian: a TRACE_HEADER_SIZE byte header of "SHTR",
+// TRACE_VERSION, a flags byte, two reserved bytes and the record count,
+// then TRACE_RECORD_SIZE byte records of
+//   uint16 milliseconds since the previous reading, TRACE_ARMED set while
+//          the motion detector was on
+//   uint16 echo time in microseconds
+// hosthal/replay reads it.
+#define TRACE_MAGIC "SHTR"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 12
+#define TRACE_RECORD_SIZE 4
+#define TRACE_ARMED 0x8000
+#define TRACE_MAX_DT 0x7fff
+// 64 KB of flash, about an hour at the sensor's five readings a second.
+#define TRACE_CAPACITY 16384
+// Readings held in RAM between flash writes, one write every ~13 s.
+#define TRACE_STAGE 64
+
+void traceinit(void);
+void tracerecording(bool on);
+bool traceisrecording(void);
+void tracerecord(unsigned int echous, bool armed);
+// Writes out what is staged, before an export or when recording stops.
+void traceflush(void);
+void traceclear(void);
+uint32_t tracecount(void);
+void traceheader(uint8_t* out, uint32_t count);
+// count records from the index-th oldest on, into out.
+uint32_t traceread(uint32_t index, uint8_t* out, uint32_t count);
+
+#endif
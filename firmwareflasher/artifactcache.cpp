@@ -0,0 +1,367 @@
+#include "artifactcache.hpp"
+
+#include "sha256.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include <curl/curl.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t kReadChunk = 64 * 1024;
+
+void GlobalInit() {
+    static std::once_flag once;
+    std::call_once(once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+std::string Trim(const std::string& s) {
+    size_t begin = 0, end = s.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(s[begin]))) begin++;
+    while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1]))) end--;
+    return s.substr(begin, end - begin);
+}
+
+bool StartsWithNoCase(const std::string& s, const char* prefix) {
+    for (size_t i = 0; prefix[i]; i++) {
+        if (i >= s.size() || std::tolower(static_cast<unsigned char>(s[i])) != prefix[i]) return false;
+    }
+    return true;
+}
+
+std::string ReadText(const fs::path& path) {
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return Trim(buffer.str());
+}
+
+// What one transfer has seen so far. Everything that arrives is written to
+// the partial file, hashed and unzipped in the same pass.
+struct Transfer {
+    fs::path part_path;
+    std::FILE* part = nullptr;
+    uint64_t resume_from = 0;
+    long status = 0;
+    std::string etag;
+    uint64_t total = 0;
+    uint64_t done = 0;
+    uint64_t network_bytes = 0;
+    bool body_started = false;
+    std::string error;
+
+    Sha256 sha;
+    bool keep_files = true;
+    std::vector<ZipEntry> files;
+    std::unique_ptr<ZipStreamReader> unzip;
+    const FetchProgressFn* progress = nullptr;
+
+    void Restart() {
+        sha = Sha256();
+        files.clear();
+        unzip = std::make_unique<ZipStreamReader>(keep_files ? CollectZipEntries(&files)
+                                                             : ZipStreamReader::Callbacks());
+        done = 0;
+    }
+
+    bool Consume(const uint8_t* data, size_t len) {
+        sha.Update(data, len);
+        done += len;
+        if (!unzip->Feed(data, len)) {
+            error = unzip->Error();
+            return false;
+        }
+        return true;
+    }
+
+    // First body byte of the final response: decide between resuming and
+    // starting over, replaying the kept bytes through the hash and unzip.
+    bool StartBody() {
+        body_started = true;
+        Restart();
+        if (status == 206 && resume_from > 0) {
+            part = std::fopen(part_path.c_str(), "r+b");
+            if (!part) return false;
+            std::vector<uint8_t> buf(kReadChunk);
+            uint64_t left = resume_from;
+            while (left > 0) {
+                size_t n = std::fread(buf.data(), 1, std::min<uint64_t>(buf.size(), left), part);
+                if (n == 0 || !Consume(buf.data(), n)) return false;
+                left -= n;
+            }
+            std::fseek(part, static_cast<long>(resume_from), SEEK_SET);
+            return true;
+        }
+        part = std::fopen(part_path.c_str(), "wb");
+        return part != nullptr;
+    }
+};
+
+size_t OnHeader(char* buffer, size_t size, size_t count, void* user) {
+    Transfer* t = static_cast<Transfer*>(user);
+    std::string line(buffer, size * count);
+    if (line.rfind("HTTP/", 0) == 0) {
+        // Each response of a redirect chain starts over.
+        std::istringstream in(line);
+        std::string version;
+        in >> version >> t->status;
+        t->etag.clear();
+        t->total = 0;
+    } else if (StartsWithNoCase(line, "etag:")) {
+        t->etag = Trim(line.substr(5));
+    } else if (StartsWithNoCase(line, "content-length:") && t->status == 200) {
+        t->total = std::stoull(Trim(line.substr(15)));
+    } else if (StartsWithNoCase(line, "content-range:")) {
+        size_t slash = line.find('/');
+        if (slash != std::string::npos && line.find('*', slash) == std::string::npos) {
+            t->total = std::stoull(Trim(line.substr(slash + 1)));
+        }
+    }
+    return size * count;
+}
+
+size_t OnBody(char* data, size_t size, size_t count, void* user) {
+    Transfer* t = static_cast<Transfer*>(user);
+    size_t len = size * count;
+    if (t->status != 200 && t->status != 206) {
+        return len;   // error page, ignored
+    }
+    if (!t->body_started && !t->StartBody()) {
+        if (t->error.empty()) t->error = "cannot write " + t->part_path.string();
+        return 0;
+    }
+    if (std::fwrite(data, 1, len, t->part) != len) {
+        t->error = "cannot write " + t->part_path.string();
+        return 0;
+    }
+    t->network_bytes += len;
+    if (!t->Consume(reinterpret_cast<const uint8_t*>(data), len)) {
+        return 0;
+    }
+    if (t->progress && *t->progress) (*t->progress)(t->done, t->total);
+    return len;
+}
+
+}  // namespace
+
+ArtifactCache::ArtifactCache(std::string root, int revalidate_seconds)
+    : root_(std::move(root)), revalidate_seconds_(revalidate_seconds) {}
+
+bool ArtifactCache::ReadRef(const std::string& key, Ref* ref) const {
+    std::ifstream in(fs::path(root_) / "refs" / key);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string name = line.substr(0, eq), value = line.substr(eq + 1);
+        if (name == "url") ref->url = value;
+        else if (name == "sha256") ref->sha256 = value;
+        else if (name == "etag") ref->etag = value;
+        else if (name == "checked") ref->checked = std::stoll(value);
+    }
+    return !ref->sha256.empty();
+}
+
+bool ArtifactCache::WriteRef(const std::string& key, const Ref& ref) const {
+    fs::path path = fs::path(root_) / "refs" / key;
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp);
+        out << "url=" << ref.url << "\n"
+            << "sha256=" << ref.sha256 << "\n"
+            << "etag=" << ref.etag << "\n"
+            << "checked=" << ref.checked << "\n";
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
+
+bool ArtifactCache::LoadObject(const std::string& sha256, FetchResult* result, std::string* error) const {
+    fs::path path = fs::path(root_) / "objects" / sha256;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        *error = "missing " + path.string();
+        return false;
+    }
+    result->files.clear();
+    ZipStreamReader unzip(keep_files_ ? CollectZipEntries(&result->files) : ZipStreamReader::Callbacks());
+    Sha256 sha;
+    std::vector<uint8_t> buf(kReadChunk);
+    while (in) {
+        in.read(reinterpret_cast<char*>(buf.data()), buf.size());
+        size_t n = static_cast<size_t>(in.gcount());
+        sha.Update(buf.data(), n);
+        if (!unzip.Feed(buf.data(), n)) {
+            *error = unzip.Error();
+            return false;
+        }
+    }
+    if (sha.HexDigest() != sha256 || !unzip.Finished()) {
+        *error = "cached " + sha256 + " is damaged";
+        return false;
+    }
+    result->sha256 = sha256;
+    result->archive = path.string();
+    return true;
+}
+
+bool ArtifactCache::Fetch(const std::string& url, const FetchProgressFn& progress, FetchResult* result,
+                          std::string* error) {
+    std::error_code ec;
+    for (const char* dir : {"objects", "refs", "partial"}) {
+        fs::create_directories(fs::path(root_) / dir, ec);
+        if (ec) {
+            *error = "cannot create " + (fs::path(root_) / dir).string();
+            return false;
+        }
+    }
+
+    const std::string key = Sha256Hex(reinterpret_cast<const uint8_t*>(url.data()), url.size()).substr(0, 32);
+    *result = FetchResult();
+    Ref ref;
+    bool cached = ReadRef(key, &ref) && fs::exists(fs::path(root_) / "objects" / ref.sha256);
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+
+    if (cached && now - ref.checked < revalidate_seconds_) {
+        std::string ignored;
+        if (LoadObject(ref.sha256, result, &ignored)) {
+            result->from_cache = true;
+            return true;
+        }
+        cached = false;   // damaged on disk, fetch it again
+    }
+    if (!cached) {
+        ref = Ref();
+    }
+    ref.url = url;
+    return Download(url, key, &ref, progress, result, error);
+}
+
+bool ArtifactCache::Download(const std::string& url, const std::string& key, Ref* ref,
+                             const FetchProgressFn& progress, FetchResult* result, std::string* error) {
+    GlobalInit();
+    Transfer t;
+    t.part_path = fs::path(root_) / "partial" / key;
+    fs::path part_etag = t.part_path;
+    part_etag += ".etag";
+    t.progress = &progress;
+    t.keep_files = keep_files_;
+
+    std::string resume_etag;
+    std::error_code ec;
+    if (fs::exists(t.part_path) && fs::exists(part_etag)) {
+        t.resume_from = fs::file_size(t.part_path, ec);
+        resume_etag = ReadText(part_etag);
+        if (ec || resume_etag.empty()) t.resume_from = 0;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        *error = "curl_easy_init failed";
+        return false;
+    }
+    curl_slist* headers = nullptr;
+    std::string range;
+    if (t.resume_from > 0) {
+        // If-Range: the server only sends the rest if the release is
+        // still the same one, otherwise the full new archive.
+        range = std::to_string(t.resume_from) + "-";
+        curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+        headers = curl_slist_append(headers, ("If-Range: " + resume_etag).c_str());
+    } else if (!ref->etag.empty()) {
+        headers = curl_slist_append(headers, ("If-None-Match: " + ref->etag).c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, OnHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &t);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, OnBody);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &t);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+    // Give up on a stalled connection; the partial file is kept.
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 30L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "firmwareflasher");
+
+    CURLcode rc = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    if (t.part) {
+        std::fclose(t.part);
+        t.part = nullptr;
+    }
+    result->network_bytes = t.network_bytes;
+
+    if (t.status == 304) {
+        ref->checked = static_cast<int64_t>(std::time(nullptr));
+        WriteRef(key, *ref);
+        result->from_cache = true;
+        result->network_bytes = 0;
+        return LoadObject(ref->sha256, result, error);
+    }
+    if (!t.error.empty()) {
+        // Corrupt content, not a network problem: do not resume from it.
+        fs::remove(t.part_path, ec);
+        fs::remove(part_etag, ec);
+        *error = t.error;
+        return false;
+    }
+    if (rc != CURLE_OK || (t.status != 200 && t.status != 206)) {
+        if (t.status == 416) {
+            // The kept bytes no longer make sense to the server.
+            fs::remove(t.part_path, ec);
+            fs::remove(part_etag, ec);
+        } else if (t.body_started && !t.etag.empty()) {
+            std::ofstream(part_etag) << t.etag << "\n";
+        }
+        *error = rc != CURLE_OK ? std::string("download failed: ") + curl_easy_strerror(rc)
+                                : "HTTP " + std::to_string(t.status) + " for " + url;
+        if (t.body_started) {
+            *error += " (" + std::to_string(t.done) + " bytes kept, next try resumes)";
+        }
+        return false;
+    }
+    if (!t.unzip->Finished()) {
+        fs::remove(t.part_path, ec);
+        fs::remove(part_etag, ec);
+        *error = "archive ended early";
+        return false;
+    }
+
+    std::string sha256 = t.sha.HexDigest();
+    fs::path object = fs::path(root_) / "objects" / sha256;
+    if (fs::exists(object)) {
+        fs::remove(t.part_path, ec);   // same bytes under another URL or tag
+    } else {
+        fs::rename(t.part_path, object, ec);
+        if (ec) {
+            *error = "cannot store " + object.string();
+            return false;
+        }
+    }
+    fs::remove(part_etag, ec);
+
+    ref->sha256 = sha256;
+    ref->etag = t.etag;
+    ref->checked = static_cast<int64_t>(std::time(nullptr));
+    WriteRef(key, *ref);
+
+    result->sha256 = sha256;
+    result->archive = object.string();
+    result->files = std::move(t.files);
+    return true;
+}
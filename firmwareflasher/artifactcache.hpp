@@ -0,0 +1,65 @@
+#ifndef FIRMWAREFLASHER_ARTIFACTCACHE_HPP
+#define FIRMWAREFLASHER_ARTIFACTCACHE_HPP
+
+#include "zipstream.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct FetchResult {
+    std::string sha256;           // of the archive, also its name in the cache
+    std::string archive;          // the verified archive on disk
+    std::vector<ZipEntry> files;  // left empty with KeepFiles(false)
+    uint64_t network_bytes = 0;   // body bytes that came over the network
+    bool from_cache = false;
+};
+
+// done and total are archive bytes, total is 0 while unknown.
+using FetchProgressFn = std::function<void(uint64_t done, uint64_t total)>;
+
+// Firmware archives kept on disk by SHA-256:
+//
+//   objects/<sha256>   verified archives
+//   refs/<key>         url -> sha256, ETag and when it was last checked
+//   partial/<key>      interrupted downloads, resumed with a Range request
+//
+// Downloads are hashed and unzipped while they arrive, so a bad archive is
+// caught the moment its last byte is in and a good one needs no second
+// pass. A repeat fetch inside revalidate_seconds never touches the
+// network; after that an If-None-Match request costs no body bytes unless
+// the release really changed.
+class ArtifactCache {
+public:
+    static constexpr int kDefaultRevalidateSeconds = 600;
+
+    explicit ArtifactCache(std::string root, int revalidate_seconds = kDefaultRevalidateSeconds);
+
+    bool Fetch(const std::string& url, const FetchProgressFn& progress, FetchResult* result, std::string* error);
+
+    // Off: archives are still verified entry by entry, but the unpacked
+    // files are not kept in memory, for flashing straight from archive.
+    void KeepFiles(bool keep) { keep_files_ = keep; }
+    const std::string& Root() const { return root_; }
+
+private:
+    struct Ref {
+        std::string url;
+        std::string sha256;
+        std::string etag;
+        int64_t checked = 0;
+    };
+
+    bool ReadRef(const std::string& key, Ref* ref) const;
+    bool WriteRef(const std::string& key, const Ref& ref) const;
+    bool LoadObject(const std::string& sha256, FetchResult* result, std::string* error) const;
+    bool Download(const std::string& url, const std::string& key, Ref* ref, const FetchProgressFn& progress,
+                  FetchResult* result, std::string* error);
+
+    std::string root_;
+    int revalidate_seconds_;
+    bool keep_files_ = true;
+};
+
+#endif
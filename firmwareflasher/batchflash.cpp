@@ -0,0 +1,66 @@
+#include "batchflash.hpp"
+
+BatchFlash::BatchFlash(FlashPlan plan, const std::vector<std::string>& ports, const FlashOptions& options,
+                       std::function<void()> on_update)
+    : plan_(std::move(plan)), cache_(plan_), options_(options), on_update_(std::move(on_update)) {
+    for (const std::string& port : ports) {
+        PortJob job;
+        job.port = port;
+        job.status.stage = "Waiting";
+        job.status.total = plan_.TotalBytes();
+        jobs_.push_back(job);
+    }
+    running_ = static_cast<int>(jobs_.size());
+    for (size_t i = 0; i < jobs_.size(); i++) {
+        workers_.emplace_back(&BatchFlash::Worker, this, i);
+    }
+}
+
+BatchFlash::~BatchFlash() {
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::vector<PortJob> BatchFlash::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_;
+}
+
+void BatchFlash::Notify(bool force) {
+    if (!on_update_) return;
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = last_update_ms_.load();
+    if (!force && now - last < kUpdateIntervalMs) return;
+    // Only one worker wins a given interval.
+    if (last_update_ms_.compare_exchange_strong(last, now) || force) {
+        on_update_();
+    }
+}
+
+void BatchFlash::Worker(size_t index) {
+    std::string port;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        port = jobs_[index].port;
+    }
+
+    std::string error;
+    bool ok = FlashBoard(port, plan_, cache_, options_, [&](const FlashStatus& status) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_[index].status = status;
+        }
+        Notify(false);
+    }, &error);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_[index].finished = true;
+        jobs_[index].ok = ok;
+        jobs_[index].error = error;
+    }
+    running_--;
+    Notify(true);
+}
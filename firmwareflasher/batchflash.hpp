@@ -0,0 +1,55 @@
+#ifndef FIRMWAREFLASHER_BATCHFLASH_HPP
+#define FIRMWAREFLASHER_BATCHFLASH_HPP
+
+#include "deflatecache.hpp"
+#include "flashplan.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PortJob {
+    std::string port;
+    FlashStatus status;
+    bool finished = false;
+    bool ok = false;
+    std::string error;
+};
+
+// Flashes one plan onto every given port at once, one worker thread per
+// port, all reading the same DeflateCache. on_update is rate limited and
+// is the only thing called from the workers, so a UI can hand it
+// ScreenInteractive::PostEvent and read Snapshot() while rendering.
+class BatchFlash {
+public:
+    static constexpr int kUpdateIntervalMs = 50;
+
+    BatchFlash(FlashPlan plan, const std::vector<std::string>& ports, const FlashOptions& options,
+               std::function<void()> on_update);
+    ~BatchFlash();
+    BatchFlash(const BatchFlash&) = delete;
+    BatchFlash& operator=(const BatchFlash&) = delete;
+
+    std::vector<PortJob> Snapshot() const;
+    bool Running() const { return running_ > 0; }
+
+private:
+    void Worker(size_t index);
+    void Notify(bool force);
+
+    FlashPlan plan_;
+    DeflateCache cache_;
+    FlashOptions options_;
+    std::function<void()> on_update_;
+    mutable std::mutex mutex_;
+    std::vector<PortJob> jobs_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> running_{0};
+    std::atomic<int64_t> last_update_ms_{0};
+};
+
+#endif
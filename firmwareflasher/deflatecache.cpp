@@ -0,0 +1,54 @@
+#include "deflatecache.hpp"
+
+#include "flashplan.hpp"
+#include "md5.hpp"
+
+#include <algorithm>
+
+#include <zlib.h>
+
+DeflatedImage::DeflatedImage(std::vector<uint8_t> image) : image_(std::move(image)) {
+    // The ROM writes whole words.
+    image_.resize((image_.size() + 3) & ~size_t(3), 0xFF);
+    md5_ = Md5Hex(image_.data(), image_.size());
+    for (size_t pos = 0; pos < image_.size(); pos += kSliceSize) {
+        DeflatedSlice slice;
+        slice.offset = static_cast<uint32_t>(pos);
+        slice.size = static_cast<uint32_t>(std::min<size_t>(kSliceSize, image_.size() - pos));
+        slices_.push_back(std::move(slice));
+    }
+}
+
+void DeflatedImage::Compress() {
+    for (size_t i = 0; i < slices_.size(); i++) {
+        DeflatedSlice& slice = slices_[i];
+        std::vector<uint8_t> out(compressBound(slice.size));
+        uLongf len = out.size();
+        compress2(out.data(), &len, image_.data() + slice.offset, slice.size, Z_BEST_COMPRESSION);
+        out.resize(len);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        slice.data = std::move(out);
+        ready_ = i + 1;
+        cv_.notify_all();
+    }
+}
+
+const DeflatedSlice& DeflatedImage::Slice(size_t index) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return ready_ > index; });
+    return slices_[index];
+}
+
+DeflateCache::DeflateCache(const FlashPlan& plan) {
+    for (const FlashFile& file : plan.files) {
+        images_.push_back(std::make_unique<DeflatedImage>(file.data));
+    }
+    worker_ = std::thread([this] {
+        for (auto& image : images_) image->Compress();
+    });
+}
+
+DeflateCache::~DeflateCache() {
+    worker_.join();
+}
@@ -0,0 +1,62 @@
+#ifndef FIRMWAREFLASHER_DEFLATECACHE_HPP
+#define FIRMWAREFLASHER_DEFLATECACHE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FlashPlan;
+
+struct DeflatedSlice {
+    uint32_t offset = 0;          // within the image
+    uint32_t size = 0;            // uncompressed bytes
+    std::vector<uint8_t> data;    // one complete zlib stream
+};
+
+// A flash image split into independently deflated slices. Slices are
+// filled in by whoever runs Compress(); readers block in Slice() only
+// until the one they need is done, so writing to a board starts as soon
+// as the first slice is ready.
+class DeflatedImage {
+public:
+    static constexpr uint32_t kSliceSize = 0x40000;
+
+    explicit DeflatedImage(std::vector<uint8_t> image);
+
+    void Compress();
+    size_t Size() const { return image_.size(); }
+    size_t SliceCount() const { return slices_.size(); }
+    const DeflatedSlice& Slice(size_t index) const;
+    const std::vector<uint8_t>& Data() const { return image_; }
+    const std::string& Md5() const { return md5_; }
+
+private:
+    std::vector<uint8_t> image_;   // padded to a whole word
+    std::vector<DeflatedSlice> slices_;
+    std::string md5_;
+    size_t ready_ = 0;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable cv_;
+};
+
+// Deflates every file of a plan once on a background thread. All boards
+// of a batch read from the same cache, so N boards cost one compression.
+class DeflateCache {
+public:
+    explicit DeflateCache(const FlashPlan& plan);
+    ~DeflateCache();
+    DeflateCache(const DeflateCache&) = delete;
+    DeflateCache& operator=(const DeflateCache&) = delete;
+
+    const DeflatedImage& Image(size_t file_index) const { return *images_[file_index]; }
+
+private:
+    std::vector<std::unique_ptr<DeflatedImage>> images_;
+    std::thread worker_;
+};
+
+#endif
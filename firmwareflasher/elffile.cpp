@@ -0,0 +1,156 @@
+#include "elffile.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+#include <cxxabi.h>
+
+namespace {
+
+constexpr uint32_t kShtSymtab = 2;
+constexpr uint32_t kShtNobits = 8;
+constexpr uint64_t kShfAlloc = 0x2;
+constexpr uint8_t kSttObject = 1;
+constexpr uint8_t kSttFunc = 2;
+constexpr uint16_t kEmXtensa = 94;
+
+// Reads fields of either ELF class and byte order, bounds checked.
+class Reader {
+public:
+    Reader(const std::vector<uint8_t>& data, bool big) : data_(data), big_(big) {}
+
+    bool Ok(uint64_t offset, uint64_t len) const {
+        return offset <= data_.size() && len <= data_.size() - offset;
+    }
+    uint64_t Get(uint64_t offset, int bytes) const {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; i++) {
+            uint64_t b = data_[offset + (big_ ? i : bytes - 1 - i)];
+            v = (v << 8) | b;
+        }
+        return v;
+    }
+    std::string String(uint64_t offset) const {
+        std::string s;
+        while (offset < data_.size() && data_[offset]) s += static_cast<char>(data_[offset++]);
+        return s;
+    }
+
+private:
+    const std::vector<uint8_t>& data_;
+    bool big_;
+};
+
+}  // namespace
+
+bool ReadElf(const std::string& path, ElfImage* elf, std::string* error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < 64 || data[0] != 0x7F || data[1] != 'E' || data[2] != 'L' || data[3] != 'F' ||
+        (data[4] != 1 && data[4] != 2)) {
+        *error = path + " is not an ELF file";
+        return false;
+    }
+    const bool is64 = data[4] == 2;
+    const int word = is64 ? 8 : 4;
+    Reader r(data, data[5] == 2);
+
+    *elf = ElfImage();
+    uint16_t machine = static_cast<uint16_t>(r.Get(18, 2));
+    elf->machine = machine == kEmXtensa ? "xtensa" : "machine " + std::to_string(machine);
+
+    uint64_t shoff = r.Get(is64 ? 40 : 32, word);
+    uint64_t shentsize = r.Get(is64 ? 58 : 46, 2);
+    uint64_t shnum = r.Get(is64 ? 60 : 48, 2);
+    uint64_t shstrndx = r.Get(is64 ? 62 : 50, 2);
+    if (shnum == 0 || shstrndx >= shnum || !r.Ok(shoff, shentsize * shnum) || shentsize < (is64 ? 64u : 40u)) {
+        *error = path + ": bad section header table";
+        return false;
+    }
+
+    struct Header {
+        uint32_t name, type, link;
+        uint64_t flags, addr, offset, size, entsize;
+    };
+    std::vector<Header> headers(shnum);
+    for (uint64_t i = 0; i < shnum; i++) {
+        uint64_t at = shoff + i * shentsize;
+        Header& h = headers[i];
+        h.name = static_cast<uint32_t>(r.Get(at, 4));
+        h.type = static_cast<uint32_t>(r.Get(at + 4, 4));
+        h.flags = r.Get(at + 8, word);
+        h.addr = r.Get(at + 8 + word, word);
+        h.offset = r.Get(at + 8 + 2 * word, word);
+        h.size = r.Get(at + 8 + 3 * word, word);
+        h.link = static_cast<uint32_t>(r.Get(at + 8 + 4 * word, 4));
+        h.entsize = r.Get(at + 16 + 5 * word, word);
+    }
+    const Header& names = headers[shstrndx];
+    for (const Header& h : headers) {
+        ElfSection section;
+        section.name = r.String(names.offset + h.name);
+        section.addr = h.addr;
+        section.size = h.size;
+        section.offset = h.offset;
+        section.alloc = (h.flags & kShfAlloc) != 0;
+        section.nobits = h.type == kShtNobits;
+        elf->sections.push_back(section);
+    }
+
+    for (const Header& h : headers) {
+        if (h.type != kShtSymtab || h.link >= shnum) continue;
+        const uint64_t entsize = is64 ? 24 : 16;
+        if (!r.Ok(h.offset, h.size) || h.entsize < entsize) {
+            *error = path + ": bad symbol table";
+            return false;
+        }
+        const Header& strings = headers[h.link];
+        for (uint64_t at = h.offset; at + h.entsize <= h.offset + h.size; at += h.entsize) {
+            // ELF64 moved st_info and st_shndx in front of the value.
+            uint8_t info = static_cast<uint8_t>(r.Get(at + (is64 ? 4 : 12), 1));
+            uint16_t shndx = static_cast<uint16_t>(r.Get(at + (is64 ? 6 : 14), 2));
+            uint64_t value = r.Get(at + (is64 ? 8 : 4), word);
+            uint64_t size = r.Get(at + (is64 ? 16 : 8), word);
+            uint8_t type = info & 0xF;
+            if ((type != kSttFunc && type != kSttObject) || size == 0 || shndx == 0 || shndx >= shnum) continue;
+            ElfSymbol symbol;
+            symbol.name = r.String(strings.offset + r.Get(at, 4));
+            symbol.value = value;
+            symbol.size = size;
+            symbol.function = type == kSttFunc;
+            symbol.section = shndx;
+            elf->symbols.push_back(symbol);
+        }
+    }
+    elf->data = std::move(data);
+    return true;
+}
+
+bool ElfString(const ElfImage& elf, uint64_t addr, std::string* text) {
+    for (const ElfSection& section : elf.sections) {
+        if (!section.alloc || section.nobits || addr < section.addr || addr - section.addr >= section.size) continue;
+        uint64_t at = section.offset + (addr - section.addr);
+        uint64_t end = std::min<uint64_t>(section.offset + section.size, elf.data.size());
+        if (at >= end) return false;
+        text->clear();
+        while (at < end && elf.data[at]) text->push_back(static_cast<char>(elf.data[at++]));
+        return true;
+    }
+    return false;
+}
+
+std::string Demangle(const std::string& name) {
+    if (name.compare(0, 2, "_Z") != 0) return name;
+    int status = 0;
+    char* out = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (status != 0 || !out) return name;
+    std::string result(out);
+    std::free(out);
+    return result;
+}
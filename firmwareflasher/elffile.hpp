@@ -0,0 +1,43 @@
+#ifndef FIRMWAREFLASHER_ELFFILE_HPP
+#define FIRMWAREFLASHER_ELFFILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ElfSection {
+    std::string name;
+    uint64_t addr = 0;
+    uint64_t size = 0;
+    uint64_t offset = 0;          // of the contents in the file
+    bool alloc = false;           // takes space on the chip, SHF_ALLOC
+    bool nobits = false;          // .bss like, nothing in the file
+};
+
+struct ElfSymbol {
+    std::string name;             // as in the symbol table, still mangled
+    uint64_t value = 0;
+    uint64_t size = 0;
+    bool function = false;        // STT_FUNC, otherwise STT_OBJECT
+    int section = -1;             // index into ElfImage::sections
+};
+
+// Section headers and sized function/object symbols of an ELF file.
+// Both classes and byte orders are read, Xtensa builds are ELF32 LE.
+struct ElfImage {
+    std::string machine;
+    std::vector<ElfSection> sections;
+    std::vector<ElfSymbol> symbols;
+    std::vector<uint8_t> data;    // the whole file, for section contents
+};
+
+bool ReadElf(const std::string& path, ElfImage* elf, std::string* error);
+
+// The NUL terminated string at a load address, from the section holding
+// it. False when no section with contents covers addr.
+bool ElfString(const ElfImage& elf, uint64_t addr, std::string* text);
+
+// Itanium ABI demangling, the name unchanged when it is not mangled.
+std::string Demangle(const std::string& name);
+
+#endif
@@ -0,0 +1,558 @@
+#include "esploader.hpp"
+
+#include "md5.hpp"
+#include "slip.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <zlib.h>
+
+namespace {
+
+constexpr uint32_t kChipDetectMagicReg = 0x40001000;
+constexpr uint32_t kEsp32Magic = 0x00f01d83;
+constexpr uint32_t kEsp32S3Magic = 0x00000009;
+constexpr uint8_t kChecksumSeed = 0xEF;
+// Low word of the factory MAC, the top two bytes sit in the next word.
+constexpr uint32_t kEsp32MacReg = 0x3FF5A004;
+constexpr uint32_t kEsp32S3MacReg = 0x60007044;
+
+constexpr int kDefaultTimeoutMs = 3000;
+constexpr int kSyncTimeoutMs = 100;
+constexpr int kProbeTimeoutMs = 300;
+// Erase and MD5 time grows with the region, same budgets as esptool.
+constexpr int kEraseMsPerMb = 30000;
+constexpr int kWriteMsPerMb = 40000;
+constexpr int kMd5MsPerMb = 8000;
+
+int TimeoutFor(uint32_t bytes, int ms_per_mb) {
+    int64_t ms = static_cast<int64_t>(ms_per_mb) * bytes / (1024 * 1024);
+    return ms < kDefaultTimeoutMs ? kDefaultTimeoutMs : static_cast<int>(ms);
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back((v >> 16) & 0xFF);
+    out.push_back((v >> 24) & 0xFF);
+}
+
+uint32_t GetU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+std::string Hex32(uint32_t v) {
+    char buf[11];
+    std::snprintf(buf, sizeof(buf), "0x%08x", v);
+    return buf;
+}
+
+uint32_t Checksum(const uint8_t* data, size_t len) {
+    uint8_t sum = kChecksumSeed;
+    for (size_t i = 0; i < len; i++) sum ^= data[i];
+    return sum;
+}
+
+void SleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+}  // namespace
+
+const char* EspChipName(EspChip chip) {
+    switch (chip) {
+        case EspChip::Esp32: return "ESP32";
+        case EspChip::Esp32S3: return "ESP32-S3";
+        default: return "unknown";
+    }
+}
+
+bool EspLoader::Fail(const std::string& what) {
+    error_ = what;
+    return false;
+}
+
+bool EspLoader::SendCommand(uint8_t op, const std::vector<uint8_t>& data, uint32_t checksum) {
+    std::vector<uint8_t> packet;
+    packet.reserve(8 + data.size());
+    packet.push_back(0x00);
+    packet.push_back(op);
+    packet.push_back(data.size() & 0xFF);
+    packet.push_back((data.size() >> 8) & 0xFF);
+    PutU32(packet, checksum);
+    packet.insert(packet.end(), data.begin(), data.end());
+
+    std::vector<uint8_t> framed;
+    SlipEncode(packet.data(), packet.size(), framed);
+    if (!port_.Write(framed.data(), framed.size())) {
+        return Fail(port_.Error());
+    }
+    tx_bytes_ += framed.size();
+    return true;
+}
+
+bool EspLoader::ReadFrame(std::vector<uint8_t>* frame, std::chrono::steady_clock::time_point deadline) {
+    uint8_t buf[256];
+    while (frames_.empty()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+        int n = port_.Read(buf, sizeof(buf), static_cast<int>(left));
+        if (n < 0) {
+            return Fail(port_.Error());
+        }
+        rx_bytes_ += n;
+        for (int i = 0; i < n; i++) {
+            if (decoder_.Feed(buf[i])) frames_.push_back(decoder_.Frame());
+        }
+    }
+    *frame = std::move(frames_.front());
+    frames_.pop_front();
+    return true;
+}
+
+bool EspLoader::ReadResponse(uint8_t op, int timeout_ms, uint32_t* value, std::vector<uint8_t>* body) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::vector<uint8_t> frame;
+    error_.clear();
+    while (ReadFrame(&frame, deadline)) {
+        // Replies to earlier commands (the ROM answers SYNC several
+        // times) are skipped until ours shows up.
+        if (frame.size() < 8 || frame[0] != 0x01 || frame[1] != op) continue;
+        if (value) *value = GetU32(&frame[4]);
+        if (body) body->assign(frame.begin() + 8, frame.end());
+        return true;
+    }
+    if (error_.empty()) {
+        Fail("timeout waiting for reply to 0x" + HexString(&op, 1));
+    }
+    return false;
+}
+
+void EspLoader::DiscardInput() {
+    port_.FlushInput();
+    decoder_.Reset();
+    frames_.clear();
+}
+
+bool EspLoader::Execute(uint8_t op, const std::vector<uint8_t>& data, uint32_t checksum, int timeout_ms,
+                        uint32_t* value, std::vector<uint8_t>* body) {
+    std::vector<uint8_t> reply;
+    if (!SendCommand(op, data, checksum) || !ReadResponse(op, timeout_ms, value, &reply)) {
+        return false;
+    }
+    if (reply.size() < status_len_) {
+        return Fail("short reply to 0x" + HexString(&op, 1));
+    }
+    const uint8_t* status = reply.data() + reply.size() - status_len_;
+    if (status[0] != 0) {
+        return Fail("command 0x" + HexString(&op, 1) + " failed, error 0x" + HexString(&status[1], 1));
+    }
+    if (body) body->assign(reply.begin(), reply.end() - status_len_);
+    return true;
+}
+
+void EspLoader::ResetIntoBootloader(bool usb_jtag) {
+    if (usb_jtag) {
+        // Native USB on the S3: the USB-Serial-JTAG peripheral decodes this
+        // DTR/RTS pattern as "reset with GPIO0 low".
+        port_.SetRts(false);
+        port_.SetDtr(false);
+        SleepMs(100);
+        port_.SetDtr(true);
+        port_.SetRts(false);
+        SleepMs(100);
+        port_.SetRts(true);
+        port_.SetDtr(false);
+        port_.SetRts(true);
+        SleepMs(100);
+        port_.SetDtr(false);
+        port_.SetRts(false);
+    } else {
+        // USB-UART bridge with the usual two transistor auto reset circuit:
+        // RTS drives EN, DTR drives GPIO0.
+        port_.SetDtr(false);
+        port_.SetRts(true);
+        SleepMs(100);
+        port_.SetDtr(true);
+        port_.SetRts(false);
+        SleepMs(50);
+        port_.SetDtr(false);
+    }
+}
+
+bool EspLoader::Sync() {
+    std::vector<uint8_t> data = {0x07, 0x07, 0x12, 0x20};
+    data.insert(data.end(), 32, 0x55);
+    std::vector<uint8_t> body;
+    if (!SendCommand(kSync, data) || !ReadResponse(kSync, kSyncTimeoutMs, nullptr, &body)) {
+        return false;
+    }
+    // The ROM ends its replies with 4 status bytes, a flasher stub with 2.
+    if (body.size() == 2 || body.size() == 4) {
+        status_len_ = body.size();
+    }
+    return true;
+}
+
+bool EspLoader::Connect(int attempts) {
+    // Whatever ran before, a reset brings back the ROM loader.
+    stub_ = false;
+    block_size_ = kRomBlockSize;
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        ResetIntoBootloader(attempt % 2 == 1);
+        DiscardInput();
+        for (int i = 0; i < 5; i++) {
+            if (!Sync()) continue;
+
+            // Let the extra SYNC replies arrive and drop them.
+            SleepMs(50);
+            DiscardInput();
+
+            uint32_t magic = 0;
+            if (!ReadReg(kChipDetectMagicReg, &magic)) {
+                return false;
+            }
+            if (magic == kEsp32Magic) {
+                chip_ = EspChip::Esp32;
+            } else if (magic == kEsp32S3Magic) {
+                chip_ = EspChip::Esp32S3;
+            } else {
+                return Fail("unsupported chip, magic " + Hex32(magic));
+            }
+            return true;
+        }
+    }
+    return Fail("no answer from the ROM bootloader on " + port_.Path() +
+                " (hold BOOT while plugging the board in if it has no auto reset)");
+}
+
+bool EspLoader::MemWrite(uint32_t addr, const std::vector<uint8_t>& image) {
+    uint32_t size = static_cast<uint32_t>(image.size());
+    std::vector<uint8_t> begin;
+    PutU32(begin, size);
+    PutU32(begin, (size + kRamBlockSize - 1) / kRamBlockSize);
+    PutU32(begin, kRamBlockSize);
+    PutU32(begin, addr);
+    if (!Execute(kMemBegin, begin, 0, kDefaultTimeoutMs)) {
+        return false;
+    }
+    uint32_t seq = 0;
+    for (uint32_t pos = 0; pos < size; pos += kRamBlockSize, seq++) {
+        uint32_t len = std::min(kRamBlockSize, size - pos);
+        std::vector<uint8_t> data;
+        PutU32(data, len);
+        PutU32(data, seq);
+        PutU32(data, 0);
+        PutU32(data, 0);
+        data.insert(data.end(), image.begin() + pos, image.begin() + pos + len);
+        if (!Execute(kMemData, data, Checksum(image.data() + pos, len), kDefaultTimeoutMs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EspLoader::RunStub(const EspStub& stub) {
+    if (stub_) return true;
+    if (!MemWrite(stub.text_start, stub.text)) return false;
+    if (!stub.data.empty() && !MemWrite(stub.data_start, stub.data)) return false;
+
+    std::vector<uint8_t> end;
+    PutU32(end, 0);              // execute
+    PutU32(end, stub.entry);
+    if (!Execute(kMemEnd, end, 0, kDefaultTimeoutMs)) {
+        return false;
+    }
+
+    // The stub greets with a bare "OHAI" frame once it runs.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kDefaultTimeoutMs);
+    std::vector<uint8_t> frame;
+    while (ReadFrame(&frame, deadline)) {
+        if (frame == std::vector<uint8_t>{'O', 'H', 'A', 'I'}) {
+            stub_ = true;
+            status_len_ = 2;
+            block_size_ = kStubBlockSize;
+            return true;
+        }
+    }
+    return Fail("flasher stub did not start");
+}
+
+bool EspLoader::ChangeBaud(int baud) {
+    std::vector<uint8_t> data;
+    PutU32(data, static_cast<uint32_t>(baud));
+    // The stub derives the new divider from the old rate, the ROM wants 0.
+    PutU32(data, stub_ ? static_cast<uint32_t>(port_.Baud()) : 0);
+    if (!Execute(kChangeBaudrate, data, 0, kDefaultTimeoutMs)) {
+        return false;
+    }
+    if (!port_.SetBaud(baud)) {
+        return Fail(port_.Error());
+    }
+    SleepMs(50);
+    DiscardInput();
+    return true;
+}
+
+bool EspLoader::ProbeLink(int round_trips, double* bytes_per_second) {
+    uint64_t before = WireBytes();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> data;
+    PutU32(data, kChipDetectMagicReg);
+    for (int i = 0; i < round_trips; i++) {
+        uint32_t magic = 0;
+        if (!Execute(kReadReg, data, 0, kProbeTimeoutMs, &magic)) return false;
+        uint32_t expected = chip_ == EspChip::Esp32 ? kEsp32Magic : kEsp32S3Magic;
+        if (magic != expected) return Fail("garbled probe reply");
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (bytes_per_second) {
+        *bytes_per_second = seconds > 0 ? (WireBytes() - before) / seconds : 0;
+    }
+    return true;
+}
+
+bool EspLoader::ReadReg(uint32_t addr, uint32_t* value) {
+    std::vector<uint8_t> data;
+    PutU32(data, addr);
+    return Execute(kReadReg, data, 0, kDefaultTimeoutMs, value);
+}
+
+bool EspLoader::ReadMac(uint8_t mac[6]) {
+    uint32_t reg = chip_ == EspChip::Esp32S3 ? kEsp32S3MacReg : kEsp32MacReg;
+    uint32_t low = 0, high = 0;
+    if (!ReadReg(reg, &low) || !ReadReg(reg + 4, &high)) return false;
+    mac[0] = (high >> 8) & 0xFF;
+    mac[1] = high & 0xFF;
+    for (int i = 0; i < 4; i++) mac[2 + i] = (low >> (24 - 8 * i)) & 0xFF;
+    return true;
+}
+
+bool EspLoader::SpiAttach() {
+    // hspi_arg 0 selects the default SPI pins; the ROM wants 4 more bytes.
+    std::vector<uint8_t> data(stub_ ? 4 : 8, 0);
+    return Execute(kSpiAttach, data, 0, kDefaultTimeoutMs);
+}
+
+bool EspLoader::SpiSetParams(uint32_t flash_size) {
+    std::vector<uint8_t> data;
+    PutU32(data, 0);             // flash id
+    PutU32(data, flash_size);
+    PutU32(data, 64 * 1024);     // block size
+    PutU32(data, 4 * 1024);      // sector size
+    PutU32(data, 256);           // page size
+    PutU32(data, 0xFFFF);        // status mask
+    return Execute(kSpiSetParams, data, 0, kDefaultTimeoutMs);
+}
+
+bool EspLoader::FlashDeflBegin(uint32_t size, uint32_t compressed_size, uint32_t offset) {
+    uint32_t blocks = (compressed_size + block_size_ - 1) / block_size_;
+    // The stub takes the image size and erases as it goes. The ROM erases
+    // the size it is given up front and wants it in whole write blocks,
+    // esptool rounds it up the same way.
+    uint32_t write_size = stub_ ? size : (size + block_size_ - 1) / block_size_ * block_size_;
+    std::vector<uint8_t> data;
+    PutU32(data, write_size);
+    PutU32(data, blocks);
+    PutU32(data, block_size_);
+    PutU32(data, offset);
+    if (chip_ == EspChip::Esp32S3 && !stub_) {
+        PutU32(data, 0);         // not encrypted
+    }
+    // The ROM erases the whole region before it answers, the stub erases
+    // as it goes.
+    return Execute(kFlashDeflBegin, data, 0, stub_ ? kDefaultTimeoutMs : TimeoutFor(write_size, kEraseMsPerMb));
+}
+
+bool EspLoader::FlashDeflData(const uint8_t* block, size_t len, uint32_t seq) {
+    std::vector<uint8_t> data;
+    data.reserve(16 + len);
+    PutU32(data, static_cast<uint32_t>(len));
+    PutU32(data, seq);
+    PutU32(data, 0);
+    PutU32(data, 0);
+    data.insert(data.end(), block, block + len);
+    // A deflated block can expand to many times its size on flash.
+    return Execute(kFlashDeflData, data, Checksum(block, len), TimeoutFor(len * 8, kWriteMsPerMb));
+}
+
+bool EspLoader::FlashDeflEnd(bool reboot) {
+    std::vector<uint8_t> data;
+    PutU32(data, reboot ? 0 : 1);
+    return Execute(kFlashDeflEnd, data, 0, kDefaultTimeoutMs);
+}
+
+bool EspLoader::FlashMd5(uint32_t offset, uint32_t size, std::string* md5_hex) {
+    std::vector<uint8_t> data;
+    PutU32(data, offset);
+    PutU32(data, size);
+    PutU32(data, 0);
+    PutU32(data, 0);
+    std::vector<uint8_t> body;
+    if (!Execute(kSpiFlashMd5, data, 0, TimeoutFor(size, kMd5MsPerMb), nullptr, &body)) {
+        return false;
+    }
+    // The ROM answers in hex, a stub with the raw 16 bytes.
+    if (body.size() == 32) {
+        md5_hex->assign(body.begin(), body.end());
+    } else if (body.size() == 16) {
+        *md5_hex = HexString(body.data(), body.size());
+    } else {
+        return Fail("unexpected SPI_FLASH_MD5 reply");
+    }
+    return true;
+}
+
+bool EspLoader::ChangedRanges(uint32_t offset, const DeflatedImage& image, std::vector<Range>* changed) {
+    const uint32_t total = static_cast<uint32_t>(image.Size());
+    changed->clear();
+    if (!diff_ || offset % kDiffFine != 0) {
+        changed->push_back({0, total});
+        return true;
+    }
+
+    std::string device_md5;
+    if (!FlashMd5(offset, total, &device_md5)) return false;
+    if (device_md5 == image.Md5()) return true;
+
+    auto add = [&](uint32_t begin, uint32_t end) {
+        if (!changed->empty() && changed->back().end == begin) {
+            changed->back().end = end;
+        } else {
+            changed->push_back({begin, end});
+        }
+    };
+    auto differs = [&](uint32_t begin, uint32_t end, bool* result) {
+        std::string md5;
+        if (!FlashMd5(offset + begin, end - begin, &md5)) return false;
+        *result = md5 != Md5Hex(image.Data().data() + begin, end - begin);
+        return true;
+    };
+
+    std::vector<Range> coarse;
+    for (uint32_t pos = 0; pos < total; pos += kDiffCoarse) {
+        uint32_t end = std::min(total, pos + kDiffCoarse);
+        bool dirty = false;
+        if (!differs(pos, end, &dirty)) return false;
+        if (dirty) coarse.push_back({pos, end});
+    }
+
+    // Mostly rewritten (or a blank chip): narrowing down would cost more
+    // round trips than the few sectors it could still save.
+    size_t coarse_blocks = (total + kDiffCoarse - 1) / kDiffCoarse;
+    if (coarse.size() * 2 > coarse_blocks) {
+        for (const Range& r : coarse) add(r.begin, r.end);
+        return true;
+    }
+
+    for (const Range& r : coarse) {
+        for (uint32_t pos = r.begin; pos < r.end; pos += kDiffFine) {
+            uint32_t end = std::min(r.end, pos + kDiffFine);
+            bool dirty = false;
+            if (!differs(pos, end, &dirty)) return false;
+            if (dirty) add(pos, end);
+        }
+    }
+    return true;
+}
+
+bool EspLoader::WriteDeflated(uint32_t addr, uint32_t size, const std::vector<uint8_t>& deflated,
+                              const std::function<void(uint32_t)>& progress) {
+    uint32_t compressed = static_cast<uint32_t>(deflated.size());
+    if (!FlashDeflBegin(size, compressed, addr)) {
+        return false;
+    }
+    uint32_t seq = 0;
+    for (uint32_t pos = 0; pos < compressed; pos += block_size_, seq++) {
+        uint32_t len = std::min(block_size_, compressed - pos);
+        if (!FlashDeflData(deflated.data() + pos, len, seq)) {
+            return false;
+        }
+        if (progress) {
+            progress(static_cast<uint32_t>(static_cast<uint64_t>(size) * (pos + len) / compressed));
+        }
+    }
+    return true;
+}
+
+bool EspLoader::FlashImage(uint32_t offset, const DeflatedImage& image, const FlashProgressFn& progress,
+                           FlashImageStats* stats) {
+    const size_t total = image.Size();
+    std::vector<Range> changed;
+    if (!ChangedRanges(offset, image, &changed)) {
+        return false;
+    }
+
+    FlashImageStats local;
+    size_t compressed_total = 0;
+    size_t next = 0;   // first range not fully written yet
+    for (size_t i = 0; i < image.SliceCount(); i++) {
+        const DeflatedSlice& slice = image.Slice(i);
+        const uint32_t slice_end = slice.offset + slice.size;
+        compressed_total += slice.data.size();
+
+        // Parts of this slice that have to go to the chip.
+        std::vector<Range> parts;
+        for (size_t r = next; r < changed.size() && changed[r].begin < slice_end; r++) {
+            uint32_t begin = std::max(changed[r].begin, slice.offset);
+            uint32_t end = std::min(changed[r].end, slice_end);
+            if (begin < end) parts.push_back({begin, end});
+        }
+        while (next < changed.size() && changed[next].end <= slice_end) next++;
+
+        size_t done = slice.offset;
+        for (const Range& part : parts) {
+            uint32_t size = part.end - part.begin;
+            auto report = [&](uint32_t written) {
+                if (progress) progress(done + written, total);
+            };
+            bool ok;
+            if (size == slice.size) {
+                ok = WriteDeflated(offset + part.begin, size, slice.data, report);
+            } else {
+                std::vector<uint8_t> deflated(compressBound(size));
+                uLongf len = deflated.size();
+                compress2(deflated.data(), &len, image.Data().data() + part.begin, size, Z_BEST_COMPRESSION);
+                deflated.resize(len);
+                ok = WriteDeflated(offset + part.begin, size, deflated, report);
+            }
+            if (!ok) return false;
+            done += size;
+            local.written += size;
+        }
+        if (progress) progress(slice_end, total);
+    }
+    local.skipped = total - local.written;
+    if (total > 0 && port_.Baud() > 0) {
+        // 10 bits per byte on the wire, at this image's compression ratio.
+        double wire_bytes = static_cast<double>(local.skipped) * compressed_total / total;
+        local.seconds_saved = wire_bytes * 10 / port_.Baud();
+    }
+    if (stats) *stats = local;
+
+    if (changed.empty()) {
+        // The whole image MD5 already matched.
+        return true;
+    }
+    std::string device_md5;
+    if (!FlashMd5(offset, static_cast<uint32_t>(total), &device_md5)) {
+        return false;
+    }
+    if (device_md5 != image.Md5()) {
+        return Fail("verify failed at " + Hex32(offset) + ": flash " + device_md5 + ", image " + image.Md5());
+    }
+    return true;
+}
+
+void EspLoader::HardReset() {
+    port_.SetDtr(false);
+    port_.SetRts(true);
+    SleepMs(100);
+    port_.SetRts(false);
+}
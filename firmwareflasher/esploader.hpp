@@ -0,0 +1,140 @@
+#ifndef FIRMWAREFLASHER_ESPLOADER_HPP
+#define FIRMWAREFLASHER_ESPLOADER_HPP
+
+#include "deflatecache.hpp"
+#include "espstub.hpp"
+#include "serialport.hpp"
+#include "slip.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class EspChip {
+    Unknown,
+    Esp32,
+    Esp32S3,
+};
+
+const char* EspChipName(EspChip chip);
+
+// Called with bytes of the uncompressed image that are on flash so far.
+using FlashProgressFn = std::function<void(size_t done, size_t total)>;
+
+struct FlashImageStats {
+    size_t written = 0;           // image bytes sent to the chip
+    size_t skipped = 0;           // image bytes that already matched
+    double seconds_saved = 0;     // wire time the skipped bytes would have cost
+};
+
+// Client for the ESP32 / ESP32-S3 ROM serial bootloader, the same protocol
+// esptool speaks. Every call blocks until the chip answered or timed out;
+// on failure Error() says why.
+class EspLoader {
+public:
+    enum Command : uint8_t {
+        kMemBegin = 0x05,
+        kMemEnd = 0x06,
+        kMemData = 0x07,
+        kSync = 0x08,
+        kWriteReg = 0x09,
+        kReadReg = 0x0a,
+        kSpiSetParams = 0x0b,
+        kSpiAttach = 0x0d,
+        kChangeBaudrate = 0x0f,
+        kFlashDeflBegin = 0x10,
+        kFlashDeflData = 0x11,
+        kFlashDeflEnd = 0x12,
+        kSpiFlashMd5 = 0x13,
+    };
+
+    static constexpr uint32_t kRomBlockSize = 0x400;
+    static constexpr uint32_t kStubBlockSize = 0x4000;
+    static constexpr uint32_t kRamBlockSize = 0x1800;
+    // Sector diffing compares 64 KiB blocks first and narrows the changed
+    // ones down to 4 KiB erase sectors.
+    static constexpr uint32_t kDiffCoarse = 0x10000;
+    static constexpr uint32_t kDiffFine = 0x1000;
+
+    explicit EspLoader(SerialPort& port) : port_(port) {}
+
+    // Resets the board into the ROM loader over DTR/RTS and syncs.
+    bool Connect(int attempts = 6);
+    bool Sync();
+    EspChip Chip() const { return chip_; }
+
+    // Uploads the stub to RAM and starts it. Flash writes then use the
+    // stub's larger blocks and it keeps up with much higher baud rates.
+    bool RunStub(const EspStub& stub);
+    bool IsStub() const { return stub_; }
+    // Largest FLASH_DEFL_DATA payload, bigger once the stub runs.
+    uint32_t BlockSize() const { return block_size_; }
+    int Baud() const { return port_.Baud(); }
+    // Asks the chip to switch rates and follows it on the host side.
+    bool ChangeBaud(int baud);
+    // A burst of register reads; fails on any timeout or garbled reply.
+    bool ProbeLink(int round_trips, double* bytes_per_second);
+    uint64_t WireBytes() const { return tx_bytes_ + rx_bytes_; }
+
+    bool ReadReg(uint32_t addr, uint32_t* value);
+    // Factory MAC from eFuse, same as esptool read_mac.
+    bool ReadMac(uint8_t mac[6]);
+    bool SpiAttach();
+    bool SpiSetParams(uint32_t flash_size);
+
+    bool FlashDeflBegin(uint32_t size, uint32_t compressed_size, uint32_t offset);
+    bool FlashDeflData(const uint8_t* data, size_t len, uint32_t seq);
+    bool FlashDeflEnd(bool reboot);
+    bool FlashMd5(uint32_t offset, uint32_t size, std::string* md5_hex);
+
+    // Writes image at offset slice by slice, each slice as soon as the
+    // cache has deflated it, then checks the flash MD5. With diffing on,
+    // only sectors whose MD5 differs from the image are erased and written.
+    bool FlashImage(uint32_t offset, const DeflatedImage& image, const FlashProgressFn& progress,
+                    FlashImageStats* stats = nullptr);
+    void SetDiff(bool on) { diff_ = on; }
+    bool Diff() const { return diff_; }
+
+    void HardReset();
+
+    const std::string& Error() const { return error_; }
+
+private:
+    bool Fail(const std::string& what);
+    bool SendCommand(uint8_t op, const std::vector<uint8_t>& data, uint32_t checksum = 0);
+    // Next SLIP frame from the port. Bytes past the end of a frame stay
+    // queued for the next call.
+    bool ReadFrame(std::vector<uint8_t>* frame, std::chrono::steady_clock::time_point deadline);
+    bool ReadResponse(uint8_t op, int timeout_ms, uint32_t* value, std::vector<uint8_t>* body);
+    void DiscardInput();
+    bool Execute(uint8_t op, const std::vector<uint8_t>& data, uint32_t checksum, int timeout_ms,
+                 uint32_t* value = nullptr, std::vector<uint8_t>* body = nullptr);
+    void ResetIntoBootloader(bool usb_jtag);
+
+    struct Range {
+        uint32_t begin;
+        uint32_t end;
+    };
+    // Image ranges that differ from flash, adjacent sectors merged.
+    bool ChangedRanges(uint32_t offset, const DeflatedImage& image, std::vector<Range>* changed);
+    bool MemWrite(uint32_t addr, const std::vector<uint8_t>& data);
+    bool WriteDeflated(uint32_t addr, uint32_t size, const std::vector<uint8_t>& deflated,
+                       const std::function<void(uint32_t)>& progress);
+
+    SerialPort& port_;
+    SlipDecoder decoder_;
+    std::deque<std::vector<uint8_t>> frames_;
+    EspChip chip_ = EspChip::Unknown;
+    size_t status_len_ = 4;
+    bool diff_ = true;
+    bool stub_ = false;
+    uint32_t block_size_ = kRomBlockSize;
+    uint64_t tx_bytes_ = 0;
+    uint64_t rx_bytes_ = 0;
+    std::string error_;
+};
+
+#endif
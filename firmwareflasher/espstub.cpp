@@ -0,0 +1,75 @@
+#include "espstub.hpp"
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+namespace {
+
+bool FindNumber(const std::string& json, const char* key, uint32_t* value) {
+    std::smatch m;
+    std::regex re(std::string("\"") + key + "\"\\s*:\\s*(\\d+)");
+    if (!std::regex_search(json, m, re)) return false;
+    *value = static_cast<uint32_t>(std::stoul(m[1]));
+    return true;
+}
+
+bool FindString(const std::string& json, const char* key, std::string* value) {
+    std::string needle = std::string("\"") + key + "\"";
+    size_t at = json.find(needle);
+    if (at == std::string::npos) return false;
+    size_t open = json.find('"', json.find(':', at + needle.size()));
+    size_t close = json.find('"', open + 1);
+    if (open == std::string::npos || close == std::string::npos) return false;
+    *value = json.substr(open + 1, close - open - 1);
+    return true;
+}
+
+}  // namespace
+
+std::vector<uint8_t> Base64Decode(const std::string& text) {
+    std::vector<uint8_t> out;
+    out.reserve(text.size() * 3 / 4);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : text) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else continue;   // padding and line breaks
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<uint8_t>(acc >> bits));
+        }
+    }
+    return out;
+}
+
+bool LoadEspStub(const std::string& path, EspStub* stub, std::string* error) {
+    std::ifstream in(path);
+    if (!in) {
+        *error = "no stub at " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string json = buffer.str();
+
+    std::string text, data;
+    if (!FindNumber(json, "entry", &stub->entry) || !FindNumber(json, "text_start", &stub->text_start) ||
+        !FindString(json, "text", &text)) {
+        *error = path + " is not a flasher stub";
+        return false;
+    }
+    stub->text = Base64Decode(text);
+    // Some stubs have no data segment.
+    if (FindString(json, "data", &data) && FindNumber(json, "data_start", &stub->data_start)) {
+        stub->data = Base64Decode(data);
+    }
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef FIRMWAREFLASHER_ESPSTUB_HPP
+#define FIRMWAREFLASHER_ESPSTUB_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RAM flasher stub as esptool ships it (stub_flasher_32.json,
+// stub_flasher_32s3.json): code and data segments plus the entry point.
+struct EspStub {
+    uint32_t entry = 0;
+    uint32_t text_start = 0;
+    std::vector<uint8_t> text;
+    uint32_t data_start = 0;
+    std::vector<uint8_t> data;
+};
+
+bool LoadEspStub(const std::string& path, EspStub* stub, std::string* error);
+
+std::vector<uint8_t> Base64Decode(const std::string& text);
+
+#endif
@@ -0,0 +1,409 @@
+#include "flashpipeline.hpp"
+
+#include "flashplan.hpp"
+#include "md5.hpp"
+#include "spscqueue.hpp"
+#include "zipstream.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kChunkSize = 16 * 1024;
+constexpr size_t kRawSlots = 16;               // 256 KiB of raw image in flight
+constexpr uint32_t kSegmentSize = EspLoader::kDiffCoarse;
+constexpr size_t kSegmentSlots = 8;
+constexpr int kSpinsBeforeSleep = 64;
+
+struct RawChunk {
+    std::vector<uint8_t> data;
+    bool last = false;            // end of the file, CRC already checked
+};
+
+struct Block {
+    std::vector<uint8_t> data;    // at most one FLASH_DEFL_DATA payload
+    bool segment_end = false;
+};
+
+// Sent by the deflate stage once a segment is fully compressed, ahead of
+// the write stage reaching its blocks.
+struct Segment {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    uint32_t compressed = 0;
+    std::string md5;
+    bool last = false;
+    std::string file_md5;         // of the whole padded image, with last
+};
+
+int64_t Nanos(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+// Written by the stage's own thread, read by anyone for a snapshot.
+struct StageCounters {
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t> starved_ns{0};
+    std::atomic<int64_t> blocked_ns{0};
+    std::atomic<int64_t> done_ns{-1};   // running time once finished
+};
+
+class Pipeline {
+public:
+    Pipeline(EspLoader& loader, const FlashPlan& plan, const FlashFile& file)
+        : loader_(loader),
+          plan_(plan),
+          file_(file),
+          block_size_(loader.BlockSize()),
+          raw_(kRawSlots),
+          // Room for a whole deflated segment plus the one being filled,
+          // the write stage holds back until a segment is complete.
+          blocks_(2 * (compressBound(kSegmentSize) + block_size_ - 1) / block_size_ + 2),
+          segments_(kSegmentSlots) {}
+
+    bool Run(const FlashProgressFn& progress, FlashImageStats* stats, PipelineStats* pipeline, std::string* error);
+
+private:
+    void Read();
+    void Deflate();
+    bool Write(const FlashProgressFn& progress, FlashImageStats* stats, PipelineStats* pipeline);
+
+    // Spins briefly, then naps, until ready() holds. False if another
+    // stage gave up meanwhile.
+    template <typename Ready>
+    bool Wait(Ready ready, std::atomic<int64_t>& waited) {
+        if (ready()) return true;
+        const auto begin = Clock::now();
+        for (int spins = 0; !ready(); spins++) {
+            if (abort_) return false;
+            if (spins < kSpinsBeforeSleep) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+        waited += Nanos(Clock::now() - begin);
+        return true;
+    }
+
+    void Fail(const std::string& what) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) error_ = what;
+        abort_ = true;
+    }
+
+    void Finish(StageCounters& stage) { stage.done_ns = Nanos(Clock::now() - start_); }
+    StageStats Snapshot(const StageCounters& stage) const;
+    PipelineStats Snapshot() const;
+
+    EspLoader& loader_;
+    const FlashPlan& plan_;
+    const FlashFile& file_;
+    const uint32_t block_size_;
+    SpscQueue<RawChunk> raw_;
+    SpscQueue<Block> blocks_;
+    SpscQueue<Segment> segments_;
+    std::atomic<bool> abort_{false};
+    std::mutex mutex_;
+    std::string error_;
+    Clock::time_point start_;
+    StageCounters read_, deflate_, write_;
+};
+
+StageStats Pipeline::Snapshot(const StageCounters& stage) const {
+    StageStats stats;
+    stats.bytes = stage.bytes;
+    int64_t ran = stage.done_ns >= 0 ? stage.done_ns.load() : Nanos(Clock::now() - start_);
+    stats.starved_seconds = stage.starved_ns / 1e9;
+    stats.blocked_seconds = stage.blocked_ns / 1e9;
+    stats.busy_seconds = std::max(0.0, ran / 1e9 - stats.starved_seconds - stats.blocked_seconds);
+    return stats;
+}
+
+PipelineStats Pipeline::Snapshot() const {
+    return PipelineStats{Snapshot(read_), Snapshot(deflate_), Snapshot(write_)};
+}
+
+void Pipeline::Read() {
+    RawChunk* chunk = nullptr;
+    auto emit = [&](const uint8_t* data, size_t len) {
+        while (len > 0) {
+            if (!chunk) {
+                if (!Wait([&] { return (chunk = raw_.Back()) != nullptr; }, read_.blocked_ns)) return false;
+                chunk->data.clear();
+                chunk->data.reserve(kChunkSize);
+                chunk->last = false;
+            }
+            size_t n = std::min(len, kChunkSize - chunk->data.size());
+            chunk->data.insert(chunk->data.end(), data, data + n);
+            data += n;
+            len -= n;
+            read_.bytes += n;
+            if (chunk->data.size() == kChunkSize) {
+                raw_.Push();
+                chunk = nullptr;
+            }
+        }
+        return true;
+    };
+
+    bool ok;
+    std::string error;
+    if (!plan_.archive.empty()) {
+        ZipDirEntry entry;
+        entry.name = file_.path;
+        entry.size = file_.size;
+        entry.local_offset = file_.entry_offset;
+        ok = ReadZipEntry(plan_.archive, entry, emit, &error);
+    } else {
+        std::ifstream in(file_.path, std::ios::binary);
+        ok = static_cast<bool>(in);
+        error = "cannot read " + file_.path;
+        std::vector<uint8_t> buf(kChunkSize);
+        while (ok && in) {
+            in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+            ok = emit(buf.data(), static_cast<size_t>(in.gcount()));
+        }
+    }
+    if (ok && !chunk) {
+        ok = Wait([&] { return (chunk = raw_.Back()) != nullptr; }, read_.blocked_ns);
+        if (ok) chunk->data.clear();
+    }
+    if (!ok) {
+        if (!abort_) Fail(error);
+        Finish(read_);
+        return;
+    }
+    chunk->last = true;
+    raw_.Push();
+    raw_.Close();
+    Finish(read_);
+}
+
+void Pipeline::Deflate() {
+    z_stream zs{};
+    deflateInit(&zs, Z_BEST_COMPRESSION);
+    Md5 file_md5, segment_md5;
+    uint32_t segment_offset = 0;
+    uint32_t segment_fill = 0;
+    size_t total = 0;
+    Block* block = nullptr;
+    uint32_t block_fill = 0;
+
+    auto next_block = [&] {
+        if (!Wait([&] { return (block = blocks_.Back()) != nullptr; }, deflate_.blocked_ns)) return false;
+        block->data.resize(block_size_);
+        block->segment_end = false;
+        block_fill = 0;
+        return true;
+    };
+    // Runs deflate over whatever is in zs.next_in, cutting the output
+    // into loader sized blocks.
+    auto squeeze = [&](int flush) {
+        int rc;
+        do {
+            if (!block && !next_block()) return false;
+            zs.next_out = block->data.data() + block_fill;
+            zs.avail_out = block_size_ - block_fill;
+            rc = deflate(&zs, flush);
+            block_fill = block_size_ - zs.avail_out;
+            if (block_fill == block_size_) {
+                blocks_.Push();
+                block = nullptr;
+            }
+        } while (flush == Z_FINISH ? rc != Z_STREAM_END : (zs.avail_in > 0 || zs.avail_out == 0));
+        return true;
+    };
+    auto end_segment = [&](bool last) {
+        Segment info;
+        info.offset = segment_offset;
+        info.size = segment_fill;
+        info.last = last;
+        if (segment_fill > 0) {
+            if (!squeeze(Z_FINISH)) return false;
+            if (!block && !next_block()) return false;
+            block->data.resize(block_fill);
+            block->segment_end = true;
+            blocks_.Push();
+            block = nullptr;
+            info.compressed = static_cast<uint32_t>(zs.total_out);
+            info.md5 = segment_md5.HexDigest();
+            deflateReset(&zs);
+        }
+        if (last) info.file_md5 = file_md5.HexDigest();
+        Segment* slot = nullptr;
+        if (!Wait([&] { return (slot = segments_.Back()) != nullptr; }, deflate_.blocked_ns)) return false;
+        *slot = std::move(info);
+        segments_.Push();
+        deflate_.bytes += segment_fill;
+        segment_offset += segment_fill;
+        segment_fill = 0;
+        segment_md5 = Md5();
+        return true;
+    };
+    auto feed = [&](const uint8_t* data, size_t len) {
+        while (len > 0) {
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(len, kSegmentSize - segment_fill));
+            segment_md5.Update(data, n);
+            file_md5.Update(data, n);
+            zs.next_in = const_cast<Bytef*>(data);
+            zs.avail_in = n;
+            if (!squeeze(Z_NO_FLUSH)) return false;
+            segment_fill += n;
+            total += n;
+            data += n;
+            len -= n;
+            if (segment_fill == kSegmentSize && !end_segment(false)) return false;
+        }
+        return true;
+    };
+
+    bool ok = true;
+    while (ok) {
+        RawChunk* chunk = nullptr;
+        ok = Wait([&] { return (chunk = raw_.Front()) != nullptr || raw_.Drained(); }, deflate_.starved_ns);
+        if (!ok || !chunk) break;
+        ok = feed(chunk->data.data(), chunk->data.size());
+        bool last = chunk->last;
+        raw_.Pop();
+        if (!ok || !last) continue;
+
+        // The ROM writes whole words, pad like DeflatedImage does.
+        static const uint8_t kPad[3] = {0xFF, 0xFF, 0xFF};
+        size_t padded = (file_.size + 3) & ~size_t(3);
+        ok = feed(kPad, (4 - total % 4) % 4);
+        if (ok && total != padded) {
+            Fail(file_.path + ": " + std::to_string(total) + " bytes, expected " + std::to_string(padded));
+            ok = false;
+        }
+        if (ok) ok = end_segment(true);
+        if (ok) segments_.Close();
+        break;
+    }
+    deflateEnd(&zs);
+    Finish(deflate_);
+}
+
+bool Pipeline::Write(const FlashProgressFn& progress, FlashImageStats* stats, PipelineStats* pipeline) {
+    const size_t padded = (file_.size + 3) & ~size_t(3);
+    const bool diff = loader_.Diff();
+    FlashImageStats local;
+    uint64_t skipped_wire = 0;
+    auto report = [&](size_t done) {
+        if (pipeline) *pipeline = Snapshot();
+        if (progress) progress(done, padded);
+    };
+
+    while (true) {
+        Segment* next = nullptr;
+        if (!Wait([&] { return (next = segments_.Front()) != nullptr || segments_.Drained(); }, write_.starved_ns) ||
+            !next) {
+            return false;
+        }
+        Segment segment = std::move(*next);
+        segments_.Pop();
+        const uint32_t addr = file_.offset + segment.offset;
+
+        bool skip = false;
+        if (diff && segment.size > 0) {
+            std::string md5;
+            if (!loader_.FlashMd5(addr, segment.size, &md5)) return false;
+            skip = md5 == segment.md5;
+        }
+        if (segment.size > 0 && !skip && !loader_.FlashDeflBegin(segment.size, segment.compressed, addr)) {
+            return false;
+        }
+        uint32_t seq = 0;
+        uint32_t sent = 0;
+        while (segment.size > 0) {
+            Block* block = nullptr;
+            if (!Wait([&] { return (block = blocks_.Front()) != nullptr; }, write_.starved_ns)) return false;
+            const uint32_t len = static_cast<uint32_t>(block->data.size());
+            if (!skip && len > 0) {
+                if (!loader_.FlashDeflData(block->data.data(), len, seq++)) return false;
+                sent += len;
+                report(segment.offset + static_cast<size_t>(static_cast<uint64_t>(segment.size) * sent /
+                                                            std::max<uint32_t>(segment.compressed, 1)));
+            }
+            bool end = block->segment_end;
+            blocks_.Pop();
+            if (end) break;
+        }
+        if (skip) {
+            local.skipped += segment.size;
+            skipped_wire += segment.compressed;
+        } else {
+            local.written += segment.size;
+        }
+        write_.bytes += segment.size;
+        report(segment.offset + segment.size);
+
+        if (segment.last) {
+            if (loader_.Baud() > 0) {
+                local.seconds_saved = static_cast<double>(skipped_wire) * 10 / loader_.Baud();
+            }
+            if (stats) *stats = local;
+            // Every segment matched already, nothing left to verify.
+            if (local.written == 0) return true;
+            std::string device_md5;
+            if (!loader_.FlashMd5(file_.offset, static_cast<uint32_t>(padded), &device_md5)) return false;
+            if (device_md5 != segment.file_md5) {
+                Fail("verify failed: flash " + device_md5 + ", image " + segment.file_md5);
+                return false;
+            }
+            return true;
+        }
+    }
+}
+
+bool Pipeline::Run(const FlashProgressFn& progress, FlashImageStats* stats, PipelineStats* pipeline,
+                   std::string* error) {
+    start_ = Clock::now();
+    std::thread reader([this] { Read(); });
+    std::thread deflater([this] { Deflate(); });
+    bool ok = Write(progress, stats, pipeline);
+    if (!ok && !abort_) {
+        Fail(loader_.Error());
+    }
+    Finish(write_);
+    abort_ = abort_ || !ok;
+    reader.join();
+    deflater.join();
+    if (pipeline) *pipeline = Snapshot();
+    if (!ok) *error = error_.empty() ? "pipeline stopped" : error_;
+    return ok;
+}
+
+}  // namespace
+
+const char* PipelineStats::Bottleneck() const {
+    // The bottleneck is the stage that is busiest, the others spend their
+    // time waiting on it.
+    const StageStats* stages[] = {&read, &deflate, &write};
+    const char* names[] = {"read", "deflate", "write"};
+    int busiest = -1;
+    double most = 0;
+    for (int i = 0; i < 3; i++) {
+        if (stages[i]->busy_seconds > most) {
+            most = stages[i]->busy_seconds;
+            busiest = i;
+        }
+    }
+    return busiest < 0 ? "" : names[busiest];
+}
+
+bool StreamFlashFile(EspLoader& loader, const FlashPlan& plan, size_t index, const FlashProgressFn& progress,
+                     FlashImageStats* stats, PipelineStats* pipeline, std::string* error) {
+    Pipeline run(loader, plan, plan.files[index]);
+    return run.Run(progress, stats, pipeline, error);
+}
@@ -0,0 +1,46 @@
+#ifndef FIRMWAREFLASHER_FLASHPIPELINE_HPP
+#define FIRMWAREFLASHER_FLASHPIPELINE_HPP
+
+#include "esploader.hpp"
+
+#include <cstdint>
+#include <string>
+
+struct FlashPlan;
+
+// Image bytes through one pipeline stage and where its time went. Every
+// stage counts uncompressed image bytes, so rates compare directly.
+struct StageStats {
+    uint64_t bytes = 0;
+    double busy_seconds = 0;
+    double starved_seconds = 0;   // waiting for the stage before it
+    double blocked_seconds = 0;   // waiting for room in the stage after it
+
+    double Rate() const { return busy_seconds > 0 ? bytes / busy_seconds : 0; }
+};
+
+struct PipelineStats {
+    StageStats read;              // archive or file -> raw bytes
+    StageStats deflate;           // raw bytes -> zlib blocks
+    StageStats write;             // zlib blocks -> serial
+
+    // The stage the other two wait on, "" before anything ran.
+    const char* Bottleneck() const;
+};
+
+// Flashes plan.files[index] straight from where it lives, the release
+// archive or the build folder, in three stages on their own threads:
+//
+//   read     inflate the zip entry (CRC checked) or read the file
+//   deflate  pad, MD5, cut into 64 KiB segments and deflate each one
+//   write    send the segments, with diffing on only those whose flash
+//            MD5 differs
+//
+// The stages hand off through bounded lock-free queues, so they overlap
+// and memory stays at the size of the queues however big the image is.
+// Nothing is written to disk. pipeline, when given, is refreshed before
+// every progress call.
+bool StreamFlashFile(EspLoader& loader, const FlashPlan& plan, size_t index, const FlashProgressFn& progress, FlashImageStats* stats, PipelineStats* pipeline,
+                     std::string* error);
+
+#endif
@@ -0,0 +1,411 @@
+#include "flashplan.hpp"
+
+#include "deflatecache.hpp"
+#include "esploader.hpp"
+#include "espstub.hpp"
+#include "flashpipeline.hpp"
+#include "serialport.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <sstream>
+
+namespace {
+
+constexpr int kRomBaud = 115200;
+constexpr uint32_t kPartitionTableOffset = 0x8000;
+// Where both firmwares' partitions.csv put it, for builds without a table.
+constexpr uint32_t kDefaultNvsOffset = 0x9000;
+constexpr uint32_t kDefaultNvsSize = 0x6000;
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+uint32_t ParseFlashSize(const std::string& text) {
+    std::smatch m;
+    if (std::regex_match(text, m, std::regex("(\\d+)MB"))) {
+        return static_cast<uint32_t>(std::stoul(m[1])) * 1024 * 1024;
+    }
+    return 0;
+}
+
+// Fills in file->size and the data or where to stream it from.
+bool IsFlasherArgs(const std::string& name) {
+    return name == "flasher_args.json" ||
+           (name.size() > 18 && name.compare(name.size() - 18, 18, "/flasher_args.json") == 0);
+}
+
+using ReadFn = std::function<bool(FlashFile* file)>;
+
+// Files are named relative to where flasher_args.json sits, read() looks
+// them up there and where only makes the error messages useful.
+bool ParseFlashPlan(const std::string& json, const std::string& where, const ReadFn& read, FlashPlan* plan,
+                    std::string* error) {
+    // flasher_args.json is flat enough that pulling out the few keys we
+    // need with a regex beats carrying a JSON library.
+    size_t files_at = json.find("\"flash_files\"");
+    size_t files_end = json.find('}', files_at);
+    if (files_at == std::string::npos || files_end == std::string::npos) {
+        *error = "flasher_args.json has no flash_files";
+        return false;
+    }
+    std::string files = json.substr(files_at, files_end - files_at);
+
+    *plan = FlashPlan();
+    std::regex entry("\"(0x[0-9a-fA-F]+)\"\\s*:\\s*\"([^\"]+)\"");
+    for (std::sregex_iterator it(files.begin(), files.end(), entry), end; it != end; ++it) {
+        FlashFile file;
+        file.offset = static_cast<uint32_t>(std::stoul((*it)[1], nullptr, 16));
+        file.name = (*it)[2];
+        if (!read(&file)) {
+            *error = "cannot read " + where + file.name;
+            return false;
+        }
+        plan->files.push_back(std::move(file));
+    }
+    if (plan->files.empty()) {
+        *error = "flasher_args.json lists no files";
+        return false;
+    }
+
+    std::smatch m;
+    if (std::regex_search(json, m, std::regex("\"chip\"\\s*:\\s*\"([a-z0-9]+)\""))) {
+        plan->chip = m[1];
+    }
+    if (std::regex_search(json, m, std::regex("\"flash_size\"\\s*:\\s*\"([0-9A-Za-z]+)\""))) {
+        if (uint32_t size = ParseFlashSize(m[1])) plan->flash_size = size;
+    }
+    return true;
+}
+
+}  // namespace
+
+size_t FlashPlan::TotalBytes() const {
+    size_t total = 0;
+    for (const FlashFile& file : files) total += file.size;
+    return total;
+}
+
+bool LoadFlashPlan(const std::string& build_dir, FlashPlan* plan, std::string* error) {
+    std::ifstream in(build_dir + "/flasher_args.json");
+    if (!in) {
+        *error = "no flasher_args.json in " + build_dir;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+
+    auto read = [&](FlashFile* file) {
+        if (!ReadFile(build_dir + "/" + file->name, &file->data)) return false;
+        file->size = file->data.size();
+        return true;
+    };
+    return ParseFlashPlan(buffer.str(), build_dir + "/", read, plan, error);
+}
+
+bool LoadFlashPlan(const std::vector<ZipEntry>& entries, FlashPlan* plan, std::string* error) {
+    // Release archives wrap the build folder in a directory of their own,
+    // paths in flasher_args.json are relative to wherever it sits.
+    const ZipEntry* args = nullptr;
+    for (const ZipEntry& entry : entries) {
+        if (IsFlasherArgs(entry.name) && (!args || entry.name.size() < args->name.size())) args = &entry;
+    }
+    if (!args) {
+        *error = "no flasher_args.json in the archive";
+        return false;
+    }
+    const std::string prefix = args->name.substr(0, args->name.size() - 17);
+
+    auto read = [&](FlashFile* file) {
+        for (const ZipEntry& entry : entries) {
+            if (entry.name == prefix + file->name) {
+                file->data = entry.data;
+                file->size = entry.data.size();
+                return true;
+            }
+        }
+        return false;
+    };
+    return ParseFlashPlan(std::string(args->data.begin(), args->data.end()), prefix, read, plan, error);
+}
+
+bool LoadFlashLayout(const std::string& path, FlashPlan* plan, std::string* error) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+        std::ifstream in(path + "/flasher_args.json");
+        if (!in) {
+            *error = "no flasher_args.json in " + path;
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        auto read = [&](FlashFile* file) {
+            file->path = path + "/" + file->name;
+            std::error_code size_ec;
+            file->size = static_cast<size_t>(std::filesystem::file_size(file->path, size_ec));
+            return !size_ec;
+        };
+        return ParseFlashPlan(buffer.str(), path + "/", read, plan, error);
+    }
+
+    std::vector<ZipDirEntry> entries;
+    if (!ReadZipDirectory(path, &entries, error)) {
+        return false;
+    }
+    const ZipDirEntry* args = nullptr;
+    for (const ZipDirEntry& entry : entries) {
+        if (IsFlasherArgs(entry.name) && (!args || entry.name.size() < args->name.size())) args = &entry;
+    }
+    if (!args) {
+        *error = "no flasher_args.json in " + path;
+        return false;
+    }
+    std::string json;
+    auto append = [&](const uint8_t* data, size_t len) {
+        json.append(reinterpret_cast<const char*>(data), len);
+        return true;
+    };
+    if (!ReadZipEntry(path, *args, append, error)) {
+        return false;
+    }
+    const std::string prefix = args->name.substr(0, args->name.size() - 17);
+    auto read = [&](FlashFile* file) {
+        for (const ZipDirEntry& entry : entries) {
+            if (entry.name == prefix + file->name) {
+                file->size = static_cast<size_t>(entry.size);
+                file->path = entry.name;
+                file->entry_offset = entry.local_offset;
+                return true;
+            }
+        }
+        return false;
+    };
+    if (!ParseFlashPlan(json, prefix, read, plan, error)) {
+        return false;
+    }
+    plan->archive = path;
+    return true;
+}
+
+bool ReadFlashFile(const FlashPlan& plan, const FlashFile& file, std::vector<uint8_t>* data, std::string* error) {
+    if (!file.data.empty()) {
+        *data = file.data;
+        return true;
+    }
+    data->clear();
+    if (plan.archive.empty()) {
+        if (!ReadFile(file.path, data)) {
+            *error = "cannot read " + file.path;
+            return false;
+        }
+        return true;
+    }
+    ZipDirEntry entry;
+    entry.name = file.path;
+    entry.size = file.size;
+    entry.local_offset = file.entry_offset;
+    auto append = [&](const uint8_t* p, size_t len) {
+        data->insert(data->end(), p, p + len);
+        return true;
+    };
+    return ReadZipEntry(plan.archive, entry, append, error);
+}
+
+bool FlashBoard(const std::string& port_path, const FlashPlan& plan, const DeflateCache& cache,
+                const FlashOptions& options, const FlashStatusFn& status, std::string* error) {
+    const auto start = std::chrono::steady_clock::now();
+    FlashStatus current;
+    current.total = plan.TotalBytes();
+
+    // Provisioning writes the board's NVS partition in the same pass, where
+    // the build's partition table puts it.
+    uint32_t nvs_offset = kDefaultNvsOffset;
+    uint32_t nvs_size = kDefaultNvsSize;
+    if (options.provision) {
+        for (const FlashFile& file : plan.files) {
+            if (file.offset != kPartitionTableOffset) continue;
+            std::vector<uint8_t> table;
+            if (!ReadFlashFile(plan, file, &table, error)) {
+                return false;
+            }
+            if (!FindNvsPartition(table, &nvs_offset, &nvs_size)) {
+                *error = "partition table has no nvs partition";
+                return false;
+            }
+        }
+        current.total += nvs_size;
+    }
+    auto report = [&](const std::string& stage, size_t done) {
+        current.stage = stage;
+        current.done = done;
+        current.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (status) status(current);
+    };
+
+    SerialPort port;
+    if (!port.Open(port_path, kRomBaud)) {
+        *error = port.Error();
+        return false;
+    }
+
+    EspLoader loader(port);
+    loader.SetDiff(options.only_changed);
+    EspStub stub;
+    bool have_stub = false;
+
+    // Reset into the ROM at 115200, start the stub and step the baud rate
+    // down from the fastest option until the link holds. A rate the bridge
+    // cannot carry leaves the chip unreachable, so every failed step costs
+    // a reset and starts over.
+    auto connect = [&](int max_baud) {
+        int tried_below = max_baud + 1;
+        while (true) {
+            report("Connecting", current.done);
+            if (!port.SetBaud(kRomBaud)) {
+                *error = port.Error();
+                return false;
+            }
+            if (!loader.Connect()) {
+                *error = loader.Error();
+                return false;
+            }
+            current.chip = EspChipName(loader.Chip());
+            if (!plan.chip.empty() && ((plan.chip == "esp32s3") != (loader.Chip() == EspChip::Esp32S3))) {
+                *error = "build is for " + plan.chip + " but the board is an " + current.chip;
+                return false;
+            }
+            if (!options.stub_dir.empty() && !have_stub) {
+                std::string name = loader.Chip() == EspChip::Esp32S3 ? "stub_flasher_32s3.json" : "stub_flasher_32.json";
+                std::string ignored;
+                have_stub = LoadEspStub(options.stub_dir + "/" + name, &stub, &ignored);
+            }
+            if (have_stub && !loader.RunStub(stub)) {
+                *error = loader.Error();
+                return false;
+            }
+
+            bool restart = false;
+            for (int baud : options.bauds) {
+                if (baud >= tried_below || baud <= kRomBaud) continue;
+                tried_below = baud;
+                BaudTrial trial{baud, false, 0};
+                if (loader.ChangeBaud(baud) && loader.ProbeLink(16, &trial.probe_rate)) {
+                    trial.ok = true;
+                    current.trials.push_back(trial);
+                    break;
+                }
+                current.trials.push_back(trial);
+                restart = true;
+                break;
+            }
+            if (restart) continue;
+
+            current.baud = port.Baud();
+            current.stub = loader.IsStub();
+            if (!loader.SpiAttach() || !loader.SpiSetParams(plan.flash_size)) {
+                *error = loader.Error();
+                return false;
+            }
+            return true;
+        }
+    };
+
+    if (!connect(options.bauds.empty() ? kRomBaud : options.bauds.front())) {
+        return false;
+    }
+
+    size_t base = 0;
+    uint64_t wire_before = loader.WireBytes();
+    auto write_start = std::chrono::steady_clock::now();
+    using WriteFn = std::function<bool(const FlashProgressFn&, FlashImageStats*, std::string*)>;
+    auto write = [&](const FlashFile& file, const WriteFn& flash) {
+        FlashImageStats stats;
+        auto progress = [&](size_t done, size_t) {
+            report(file.name, base + std::min(done, file.size));
+        };
+        std::string flash_error;
+        bool ok = flash(progress, &stats, &flash_error);
+        while (!ok && port.Baud() > kRomBaud) {
+            // Errors at a raised rate: drop to the next slower one and go
+            // again, sector diffing keeps what already made it.
+            if (!connect(port.Baud() - 1)) {
+                return false;
+            }
+            ok = flash(progress, &stats, &flash_error);
+        }
+        if (!ok) {
+            *error = file.name + ": " + flash_error;
+            return false;
+        }
+        base += file.size;
+        current.verified++;
+        current.skipped += std::min(stats.skipped, file.size);
+        current.seconds_saved += stats.seconds_saved;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+        if (seconds > 0) {
+            current.wire_rate = (loader.WireBytes() - wire_before) / seconds;
+        }
+        return true;
+    };
+
+    for (size_t i = 0; i < plan.files.size(); i++) {
+        const FlashFile& file = plan.files[i];
+        // Files without data stream through the pipeline from the archive
+        // or build folder, the rest come deflated from the cache.
+        auto flash = [&](const FlashProgressFn& progress, FlashImageStats* stats, std::string* flash_error) {
+            if (file.data.empty()) {
+                return StreamFlashFile(loader, plan, i, progress, stats, &current.pipeline, flash_error);
+            }
+            bool ok = loader.FlashImage(file.offset, cache.Image(i), progress, stats);
+            if (!ok) *flash_error = loader.Error();
+            return ok;
+        };
+        if (!write(file, flash)) {
+            return false;
+        }
+    }
+
+    if (options.provision) {
+        // Built per board, the module ID comes from the chip's own MAC.
+        uint8_t mac[6];
+        if (!loader.ReadMac(mac)) {
+            *error = loader.Error();
+            return false;
+        }
+        bool hub = loader.Chip() == EspChip::Esp32S3;
+        FlashFile nvs;
+        nvs.offset = nvs_offset;
+        nvs.name = "nvs";
+        if (!BuildProvisionImage(*options.provision, hub, mac, nvs_size, &nvs.data, error)) {
+            return false;
+        }
+        nvs.size = nvs.data.size();
+        if (!hub) current.module = ModuleId(*options.provision, mac);
+        DeflatedImage image(nvs.data);
+        image.Compress();
+        auto flash = [&](const FlashProgressFn& progress, FlashImageStats* stats, std::string* flash_error) {
+            bool ok = loader.FlashImage(nvs.offset, image, progress, stats);
+            if (!ok) *flash_error = loader.Error();
+            return ok;
+        };
+        if (!write(nvs, flash)) {
+            return false;
+        }
+    }
+
+    // The ROM answers before it leaves the loader, a board that resets
+    // first is just as done, so the reply is not required.
+    loader.FlashDeflEnd(true);
+    loader.HardReset();
+    report("Done", current.total);
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef FIRMWAREFLASHER_FLASHPLAN_HPP
+#define FIRMWAREFLASHER_FLASHPLAN_HPP
+
+#include "flashpipeline.hpp"
+#include "provision.hpp"
+#include "zipstream.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FlashFile {
+    uint32_t offset = 0;
+    std::string name;
+    size_t size = 0;
+    std::vector<uint8_t> data;    // empty when the file is streamed
+    // Where a streamed file is read from: a path on disk, or the name and
+    // local header offset of its entry in FlashPlan::archive.
+    std::string path;
+    uint64_t entry_offset = 0;
+};
+
+// Everything that goes onto one board, read from the flasher_args.json that
+// idf.py writes next to the binaries in a build folder.
+struct FlashPlan {
+    std::string chip;
+    uint32_t flash_size = 4 * 1024 * 1024;
+    std::vector<FlashFile> files;
+    std::string archive;          // zip the streamed files come out of
+
+    size_t TotalBytes() const;
+};
+
+bool LoadFlashPlan(const std::string& build_dir, FlashPlan* plan, std::string* error);
+// Same from a downloaded release, flasher_args.json may sit in a subfolder.
+bool LoadFlashPlan(const std::vector<ZipEntry>& entries, FlashPlan* plan, std::string* error);
+// Offsets and sizes only, for flashing through the streaming pipeline. path
+// is a build folder or a release archive on disk.
+bool LoadFlashLayout(const std::string& path, FlashPlan* plan, std::string* error);
+// Whole contents of one file of the plan, loaded or streamed.
+bool ReadFlashFile(const FlashPlan& plan, const FlashFile& file, std::vector<uint8_t>* data, std::string* error);
+
+struct FlashOptions {
+    bool only_changed = true;     // diff sectors against the chip first
+    // Rates to try after connecting, fastest first. 115200 is the ROM's.
+    std::vector<int> bauds = {2000000, 1500000, 921600};
+    // Folder with esptool's stub_flasher_32*.json, empty for ROM only.
+    std::string stub_dir;
+    // When set, every board also gets its own NVS partition with these
+    // settings. It replaces whatever NVS held before.
+    std::shared_ptr<const ProvisionConfig> provision;
+};
+
+struct BaudTrial {
+    int baud = 0;
+    bool ok = false;
+    double probe_rate = 0;        // wire bytes/s of the link probe
+};
+
+struct FlashStatus {
+    std::string stage;
+    std::string chip;
+    std::string module;           // ID the board was provisioned with
+    size_t done = 0;
+    size_t total = 0;
+    size_t verified = 0;          // files whose flash MD5 matched
+    size_t skipped = 0;           // bytes already on flash, not rewritten
+    double seconds_saved = 0;
+    int baud = 0;
+    bool stub = false;
+    std::vector<BaudTrial> trials;
+    double wire_rate = 0;         // serial bytes/s while writing
+    PipelineStats pipeline;       // of the file being streamed
+    double seconds = 0;           // since the port was opened
+};
+
+using FlashStatusFn = std::function<void(const FlashStatus&)>;
+
+class DeflateCache;
+
+// Connects to the board on port, writes every file of the plan from cache,
+// verifies each one and resets the board into the new firmware.
+bool FlashBoard(const std::string& port, const FlashPlan& plan, const DeflateCache& cache,
+                const FlashOptions& options, const FlashStatusFn& status, std::string* error);
+
+#endif
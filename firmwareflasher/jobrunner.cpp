@@ -0,0 +1,335 @@
+#include "jobrunner.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+extern char** environ;
+
+namespace {
+
+constexpr int kWaitMs = 100;
+constexpr size_t kReadSize = 64 * 1024;
+constexpr size_t kOutputBytes = 1024 * 1024;
+
+// Which pipes have something to read. Only ever used from the loop thread.
+#ifdef __linux__
+class Poller {
+public:
+    Poller() : epoll_(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~Poller() { close(epoll_); }
+
+    void Add(int fd) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event);
+    }
+    void Remove(int fd) { epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr); }
+    void Wait(int timeout_ms, std::vector<int>* ready) {
+        epoll_event events[32];
+        ready->clear();
+        int n = epoll_wait(epoll_, events, 32, timeout_ms);
+        for (int i = 0; i < n; i++) ready->push_back(events[i].data.fd);
+    }
+
+private:
+    int epoll_;
+};
+#else
+class Poller {
+public:
+    void Add(int fd) { fds_.push_back(pollfd{fd, POLLIN, 0}); }
+    void Remove(int fd) {
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (fds_[i].fd == fd) {
+                fds_.erase(fds_.begin() + static_cast<long>(i));
+                return;
+            }
+        }
+    }
+    void Wait(int timeout_ms, std::vector<int>* ready) {
+        ready->clear();
+        if (::poll(fds_.data(), static_cast<nfds_t>(fds_.size()), timeout_ms) <= 0) return;
+        for (const pollfd& p : fds_) {
+            if (p.revents) ready->push_back(p.fd);
+        }
+    }
+
+private:
+    std::vector<pollfd> fds_;
+};
+#endif
+
+bool SetFlags(int fd, bool nonblocking) {
+    return fcntl(fd, F_SETFD, FD_CLOEXEC) == 0 &&
+           (!nonblocking || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0);
+}
+
+}  // namespace
+
+struct JobRunner::Job {
+    int id = 0;
+    std::string name;
+    pid_t pid = -1;
+    int fd = -1;                  // read end of the output pipe, -1 at EOF
+    bool watched = false;         // fd is in the loop's poller
+    bool exited = false;          // reaped
+    bool done = false;            // exited and all output read
+    bool cancelled = false;
+    int exit_code = -1;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    std::chrono::steady_clock::time_point kill_at;
+    Scrollback output{kOutputBytes};
+};
+
+JobRunner::JobRunner(std::function<void()> on_update) : on_update_(std::move(on_update)) {
+    if (pipe(wake_) == 0) {
+        SetFlags(wake_[0], true);
+        SetFlags(wake_[1], true);
+    }
+    loop_ = std::thread(&JobRunner::Loop, this);
+}
+
+JobRunner::~JobRunner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& job : jobs_) {
+            if (!job->exited) kill(-job->pid, SIGKILL);
+        }
+    }
+    stop_ = true;
+    Wake();
+    loop_.join();
+    for (auto& job : jobs_) {
+        if (!job->exited) waitpid(job->pid, nullptr, 0);
+        if (job->fd >= 0) close(job->fd);
+    }
+    close(wake_[0]);
+    close(wake_[1]);
+}
+
+int JobRunner::Start(const std::string& name, const std::vector<std::string>& argv, std::string* error) {
+    if (argv.empty()) {
+        *error = "nothing to run";
+        return 0;
+    }
+    int out[2];
+    if (pipe(out) != 0 || !SetFlags(out[0], true) || !SetFlags(out[1], false)) {
+        *error = std::string("pipe: ") + std::strerror(errno);
+        return 0;
+    }
+
+    // stdout and stderr share the pipe so the log keeps their order; the
+    // dup2 copies lose FD_CLOEXEC, nothing else of ours leaks through.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 2);
+
+    // A group of its own, so cancelling also reaches what it spawns.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setpgroup(&attr, 0);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTERM);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    std::vector<char*> args;
+    for (const std::string& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+    args.push_back(nullptr);
+
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(out[1]);
+    if (rc != 0) {
+        close(out[0]);
+        *error = "cannot run " + argv[0] + ": " + std::strerror(rc);
+        return 0;
+    }
+
+    auto job = std::make_unique<Job>();
+    job->name = name;
+    job->pid = pid;
+    job->fd = out[0];
+    job->start = std::chrono::steady_clock::now();
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = job->id = next_id_++;
+        jobs_.push_back(std::move(job));
+    }
+    running_++;
+    Wake();
+    Notify(true);
+    return id;
+}
+
+bool JobRunner::Cancel(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& job : jobs_) {
+        if (job->id != id) continue;
+        if (job->exited || job->cancelled) return false;
+        job->cancelled = true;
+        job->kill_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(kKillGraceMs);
+        kill(-job->pid, SIGTERM);
+        return true;
+    }
+    return false;
+}
+
+void JobRunner::CancelAll() {
+    std::vector<int> ids;
+    for (const JobStatus& job : Snapshot()) {
+        if (job.running) ids.push_back(job.id);
+    }
+    for (int id : ids) Cancel(id);
+}
+
+std::vector<JobStatus> JobRunner::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<JobStatus> out;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& job : jobs_) {
+        JobStatus status;
+        status.id = job->id;
+        status.name = job->name;
+        status.running = !job->done;
+        status.cancelled = job->cancelled;
+        status.exit_code = job->exit_code;
+        status.seconds = std::chrono::duration<double>((job->done ? job->end : now) - job->start).count();
+        status.last_line = job->output.Partial();
+        if (status.last_line.empty() && job->output.Count() > 0) {
+            std::vector<LogLine> last;
+            job->output.Copy(job->output.Count() - 1, 1, &last);
+            status.last_line = last[0].text;
+        }
+        out.push_back(std::move(status));
+    }
+    return out;
+}
+
+bool JobRunner::WithOutput(int id, const std::function<void(Scrollback&)>& f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& job : jobs_) {
+        if (job->id == id) {
+            f(job->output);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobRunner::Wake() {
+    char c = 0;
+    ssize_t ignored = write(wake_[1], &c, 1);
+    (void)ignored;
+}
+
+void JobRunner::Notify(bool force) {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!force && now - last_update_ < std::chrono::milliseconds(kUpdateIntervalMs)) return;
+        last_update_ = now;
+    }
+    if (on_update_) on_update_();
+}
+
+void JobRunner::Loop() {
+    Poller poller;
+    poller.Add(wake_[0]);
+    std::vector<int> ready;
+    std::vector<uint8_t> buf(kReadSize);
+    while (!stop_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& job : jobs_) {
+                if (job->fd >= 0 && !job->watched) {
+                    poller.Add(job->fd);
+                    job->watched = true;
+                }
+            }
+        }
+        poller.Wait(kWaitMs, &ready);
+
+        bool changed = false;
+        bool output = false;
+        for (int fd : ready) {
+            if (fd == wake_[0]) {
+                while (read(fd, buf.data(), buf.size()) > 0) {
+                }
+                continue;
+            }
+            // One read per wakeup, a chatty job cannot starve the others.
+            ssize_t n = read(fd, buf.data(), buf.size());
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& job : jobs_) {
+                if (job->fd != fd) continue;
+                if (n > 0) {
+                    job->output.Append(buf.data(), static_cast<size_t>(n));
+                    output = true;
+                } else {
+                    poller.Remove(fd);
+                    close(fd);
+                    job->fd = -1;
+                    changed = true;
+                }
+                break;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& job : jobs_) {
+                if (!job->exited) {
+                    int status = 0;
+                    if (waitpid(job->pid, &status, WNOHANG) == job->pid) {
+                        job->exited = true;
+                        job->exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                    } else if (job->cancelled && now >= job->kill_at) {
+                        kill(-job->pid, SIGKILL);
+                        job->kill_at = std::chrono::steady_clock::time_point::max();
+                    }
+                }
+                // Whatever it left running in its group may hold the pipe
+                // open, a cancelled job is done once its own process is.
+                if (!job->done && job->exited && (job->fd < 0 || job->cancelled)) {
+                    if (job->fd >= 0) {
+                        poller.Remove(job->fd);
+                        close(job->fd);
+                        job->fd = -1;
+                    }
+                    job->done = true;
+                    job->end = now;
+                    running_--;
+                    changed = true;
+                }
+            }
+        }
+        if (changed || output) Notify(changed);
+    }
+}
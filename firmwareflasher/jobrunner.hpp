@@ -0,0 +1,75 @@
+#ifndef FIRMWAREFLASHER_JOBRUNNER_HPP
+#define FIRMWAREFLASHER_JOBRUNNER_HPP
+
+#include "scrollback.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+struct JobStatus {
+    int id = 0;
+    std::string name;
+    bool running = false;
+    bool cancelled = false;
+    int exit_code = -1;           // 128 + signal when killed
+    std::string last_line;        // progress meters show their latest state
+    double seconds = 0;
+};
+
+// Runs child processes without blocking whoever starts them. Each one is
+// spawned with posix_spawnp into its own process group, stdout and stderr
+// merged into a non-blocking pipe, and a single thread waits on all the
+// pipes at once (epoll on Linux, poll elsewhere). Output goes into a
+// Scrollback per job; on_update is rate limited like BatchFlash's, so a UI
+// can hand it ScreenInteractive::PostEvent.
+class JobRunner {
+public:
+    static constexpr int kUpdateIntervalMs = 50;
+    // Cancel sends SIGTERM, then SIGKILL if the group is still around.
+    static constexpr int kKillGraceMs = 2000;
+
+    explicit JobRunner(std::function<void()> on_update);
+    // Kills whatever still runs and reaps it.
+    ~JobRunner();
+    JobRunner(const JobRunner&) = delete;
+    JobRunner& operator=(const JobRunner&) = delete;
+
+    // argv[0] is looked up in PATH. Returns the job id, or 0 with error set.
+    int Start(const std::string& name, const std::vector<std::string>& argv, std::string* error);
+    bool Cancel(int id);
+    void CancelAll();
+
+    std::vector<JobStatus> Snapshot() const;
+    bool Running() const { return running_ > 0; }
+
+    // Runs f on the output of job id with the reader held off, false when
+    // there is no such job.
+    bool WithOutput(int id, const std::function<void(Scrollback&)>& f);
+
+private:
+    struct Job;
+
+    void Loop();
+    void Wake();
+    void Notify(bool force);
+
+    std::function<void()> on_update_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Job>> jobs_;
+    int next_id_ = 1;
+    int wake_[2] = {-1, -1};
+    std::thread loop_;
+    std::atomic<bool> stop_{false};
+    std::atomic<int> running_{0};
+    std::chrono::steady_clock::time_point last_update_;
+};
+
+#endif
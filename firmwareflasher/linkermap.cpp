@@ -0,0 +1,117 @@
+#include "linkermap.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+bool ParseHex(const std::string& text, uint64_t* value) {
+    if (text.compare(0, 2, "0x") != 0) return false;
+    char* end = nullptr;
+    *value = std::strtoull(text.c_str() + 2, &end, 16);
+    return end && *end == '\0' && text.size() > 2;
+}
+
+std::vector<std::string> Split(const std::string& line) {
+    std::istringstream in(line);
+    std::vector<std::string> out;
+    std::string token;
+    while (in >> token) out.push_back(token);
+    return out;
+}
+
+}  // namespace
+
+std::string ComponentOf(const std::string& object) {
+    std::string path = object;
+    size_t paren = path.find('(');
+    if (paren != std::string::npos) path = path.substr(0, paren);
+    size_t slash = path.find_last_of("/\\");
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (paren != std::string::npos && file.size() > 5 && file.compare(0, 3, "lib") == 0 &&
+        file.compare(file.size() - 2, 2, ".a") == 0) {
+        return file.substr(3, file.size() - 5);
+    }
+    return file.empty() ? "(linker)" : file;
+}
+
+const MapInput* LinkerMap::Find(uint64_t addr) const {
+    auto it = std::upper_bound(inputs.begin(), inputs.end(), addr,
+                               [](uint64_t a, const MapInput& input) { return a < input.addr; });
+    if (it == inputs.begin()) return nullptr;
+    --it;
+    return addr < it->addr + it->size ? &*it : nullptr;
+}
+
+bool ReadLinkerMap(const std::string& path, LinkerMap* map, std::string* error) {
+    std::ifstream in(path);
+    if (!in) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    *map = LinkerMap();
+    std::string line;
+    bool started = false;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 28, "Linker script and memory map") == 0) {
+            started = true;
+            break;
+        }
+    }
+    if (!started) {
+        *error = path + " is not a GNU ld map file";
+        return false;
+    }
+
+    std::string output;
+    std::string pending;          // input section whose name took a line of its own
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        std::vector<std::string> tokens = Split(line);
+        if (tokens.empty()) continue;
+
+        // Output sections start in the first column.
+        if (line[0] != ' ') {
+            output = tokens[0][0] == '.' ? tokens[0] : "";
+            pending.clear();
+            continue;
+        }
+        if (output.empty() || output == "/DISCARD/") continue;
+
+        // Wrapped input section: the name alone, placement on the next line.
+        if (line[1] != ' ' && tokens.size() == 1 && tokens[0][0] != '*') {
+            pending = tokens[0];
+            continue;
+        }
+        std::string name;
+        size_t at = 0;
+        if (line[1] != ' ') {
+            name = tokens[0];
+            at = 1;
+        } else if (!pending.empty()) {
+            name = pending;
+        } else {
+            continue;             // symbol lines and script comments
+        }
+        pending.clear();
+        if (name[0] == '*') continue;   // *fill* and input patterns
+
+        MapInput input;
+        if (tokens.size() < at + 3 || !ParseHex(tokens[at], &input.addr) || !ParseHex(tokens[at + 1], &input.size)) {
+            continue;
+        }
+        if (input.size == 0) continue;
+        input.output = output;
+        input.section = name;
+        input.object = tokens[at + 2];
+        for (size_t i = at + 3; i < tokens.size(); i++) input.object += " " + tokens[i];
+        input.component = ComponentOf(input.object);
+        map->inputs.push_back(std::move(input));
+    }
+    std::stable_sort(map->inputs.begin(), map->inputs.end(),
+                     [](const MapInput& a, const MapInput& b) { return a.addr < b.addr; });
+    return true;
+}
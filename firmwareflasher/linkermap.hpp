@@ -0,0 +1,33 @@
+#ifndef FIRMWAREFLASHER_LINKERMAP_HPP
+#define FIRMWAREFLASHER_LINKERMAP_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One input section as GNU ld placed it.
+struct MapInput {
+    std::string output;           // e.g. .iram0.text
+    std::string section;          // e.g. .iram1.5 or .text._Z4echov
+    uint64_t addr = 0;
+    uint64_t size = 0;
+    std::string object;           // esp-idf/main/libmain.a(main.cpp.obj)
+    std::string component;        // main
+};
+
+// The "Linker script and memory map" part of a GNU ld -Map file, sorted by
+// address. Fill and discarded sections are left out.
+struct LinkerMap {
+    std::vector<MapInput> inputs;
+
+    // Input section holding addr, null when none does.
+    const MapInput* Find(uint64_t addr) const;
+};
+
+bool ReadLinkerMap(const std::string& path, LinkerMap* map, std::string* error);
+
+// IDF builds each component into lib<component>.a; loose objects are named
+// after their file.
+std::string ComponentOf(const std::string& object);
+
+#endif
@@ -0,0 +1,208 @@
+#include "logdecoder.hpp"
+
+#include "memoryreport.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+// The smallest frame: start, len, address, time, core, crc.
+constexpr size_t kFrameOverhead = 3;
+constexpr size_t kFrameHeader = 9;
+constexpr size_t kMinFrame = kFrameOverhead + kFrameHeader;
+
+uint32_t Get32(const uint8_t* in) {
+    return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+uint64_t Get64(const uint8_t* in) {
+    return Get32(in) | static_cast<uint64_t>(Get32(in + 4)) << 32;
+}
+
+// The tag at args[at] and its value fit in len.
+bool ArgOk(const uint8_t* args, size_t len, size_t at) {
+    if (at >= len) return false;
+    switch (args[at]) {
+    case 'i': return at + 5 <= len;
+    case 'I':
+    case 'd': return at + 9 <= len;
+    case 's': return at + 2 <= len && at + 2 + args[at + 1] <= len;
+    default: return false;
+    }
+}
+
+// What comes out without the format: its address and each argument.
+std::string RawRecord(uint32_t address, const uint8_t* args, size_t len) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "[dlog 0x%08x]", address);
+    std::string out = text;
+    size_t at = 0;
+    while (ArgOk(args, len, at)) {
+        char tag = static_cast<char>(args[at]);
+        if (tag == 'i') {
+            std::snprintf(text, sizeof(text), " %d", static_cast<int32_t>(Get32(args + at + 1)));
+            at += 5;
+        } else if (tag == 'I') {
+            std::snprintf(text, sizeof(text), " %lld", static_cast<long long>(Get64(args + at + 1)));
+            at += 9;
+        } else if (tag == 'd') {
+            uint64_t bits = Get64(args + at + 1);
+            double value;
+            std::memcpy(&value, &bits, 8);
+            std::snprintf(text, sizeof(text), " %g", value);
+            at += 9;
+        } else {
+            out += " \"" + std::string(reinterpret_cast<const char*>(args + at + 2), args[at + 1]) + "\"";
+            at += 2 + args[at + 1];
+            continue;
+        }
+        out += text;
+    }
+    return out + "\n";
+}
+
+}  // namespace
+
+uint8_t Crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = crc & 0x80 ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
+std::string FormatRecord(const std::string& format, const uint8_t* args, size_t len) {
+    std::string out;
+    size_t at = 0;
+    const char* fmt = format.c_str();
+    while (*fmt) {
+        if (*fmt != '%') {
+            out += *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out += '%';
+            fmt += 2;
+            continue;
+        }
+        // %[flags][width][.precision][length]conversion, without the length.
+        std::string spec(1, *fmt++);
+        while (*fmt && std::strchr("-+ #0123456789.", *fmt) && spec.size() < 20) spec += *fmt++;
+        while (*fmt && std::strchr("hljztL", *fmt)) fmt++;
+        char conversion = *fmt ? *fmt++ : 's';
+        if (!ArgOk(args, len, at)) {
+            out += "<?>";
+            at = len;
+            continue;
+        }
+        char piece[128];
+        int n = 0;
+        char tag = static_cast<char>(args[at]);
+        if (tag == 's') {
+            std::string text(reinterpret_cast<const char*>(args + at + 2), args[at + 1]);
+            at += 2 + args[at + 1];
+            n = std::snprintf(piece, sizeof(piece), (spec + 's').c_str(), text.c_str());
+        } else if (tag == 'd') {
+            uint64_t bits = Get64(args + at + 1);
+            double value;
+            std::memcpy(&value, &bits, 8);
+            at += 9;
+            spec += std::strchr("fFeEgGaA", conversion) ? conversion : 'g';
+            n = std::snprintf(piece, sizeof(piece), spec.c_str(), value);
+        } else {
+            long long value;
+            if (tag == 'i') {
+                uint32_t raw = Get32(args + at + 1);
+                value = std::strchr("di", conversion) ? static_cast<long long>(static_cast<int32_t>(raw))
+                                                     : static_cast<long long>(raw);
+                at += 5;
+            } else {
+                value = static_cast<long long>(Get64(args + at + 1));
+                at += 9;
+            }
+            if (conversion == 'c') {
+                n = std::snprintf(piece, sizeof(piece), (spec + 'c').c_str(), static_cast<int>(value));
+            } else {
+                spec += "ll";
+                spec += std::strchr("diouxX", conversion) ? conversion : 'x';
+                n = std::snprintf(piece, sizeof(piece), spec.c_str(), value);
+            }
+        }
+        if (n > 0) out.append(piece, std::min<size_t>(static_cast<size_t>(n), sizeof(piece) - 1));
+    }
+    return out;
+}
+
+bool LogDecoder::LoadElf(const std::string& path, std::string* error) {
+    std::string elf = path;
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec) && !FindElf(path, &elf, error)) return false;
+    ElfImage image;
+    if (!ReadElf(elf, &image, error)) return false;
+    elf_ = std::move(image);
+    elf_path_ = elf;
+    return true;
+}
+
+void LogDecoder::Feed(const uint8_t* data, size_t len, std::string* out) {
+    pending_.append(reinterpret_cast<const char*>(data), len);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pending_.data());
+    size_t at = 0;
+    size_t text_from = 0;
+    while (at < pending_.size()) {
+        if (bytes[at] != kFrameStart) {
+            at++;
+            continue;
+        }
+        if (at + 2 > pending_.size()) break;
+        size_t frame_len = kFrameOverhead + bytes[at + 1];
+        // 0x1e in the plain text (it is not printable, but still) or a
+        // length that cannot be a frame: not ours.
+        if (bytes[at + 1] < kFrameHeader) {
+            at++;
+            continue;
+        }
+        if (at + frame_len > pending_.size()) break;
+        if (Crc8(bytes + at + 1, frame_len - 2) != bytes[at + frame_len - 1]) {
+            // Start bytes inside a frame already counted bad are the
+            // search for the next one, not more damage.
+            if (at >= bad_until_) bad_frames_++;
+            bad_until_ = std::max(bad_until_, at + frame_len);
+            at++;
+            continue;
+        }
+        out->append(pending_, text_from, at - text_from);
+        Decode(bytes + at, frame_len, out);
+        at += frame_len;
+        text_from = at;
+    }
+    // What may still become a frame waits for the next read; a start byte
+    // with a frame's worth of data behind it that did not check out has
+    // already been passed over.
+    out->append(pending_, text_from, at - text_from);
+    pending_.erase(0, at);
+    bad_until_ = bad_until_ > at ? bad_until_ - at : 0;
+}
+
+void LogDecoder::Decode(const uint8_t* frame, size_t len, std::string* out) {
+    uint32_t address = Get32(frame + 2);
+    const uint8_t* args = frame + 2 + kFrameHeader;
+    size_t args_len = len - kMinFrame;
+    records_++;
+    if (address == 0) {
+        uint32_t count = ArgOk(args, args_len, 0) && args[0] == 'i' ? Get32(args + 1) : 0;
+        *out += "dlog: " + std::to_string(count) + " records dropped\n";
+        return;
+    }
+    std::string format;
+    if (!ElfString(elf_, address, &format)) {
+        unknown_formats_++;
+        *out += RawRecord(address, args, args_len);
+        return;
+    }
+    *out += FormatRecord(format, args, args_len);
+}
@@ -0,0 +1,56 @@
+#ifndef FIRMWAREFLASHER_LOGDECODER_HPP
+#define FIRMWAREFLASHER_LOGDECODER_HPP
+
+#include "elffile.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Turns the firmwares' deferred log frames (dlog.h) back into text. The
+// frames carry the format string's address and the raw arguments; the
+// string itself is looked up in the app's ELF. Anything between frames is
+// ordinary serial output and passes through untouched.
+//
+// Frame: 0x1e, len, u32 format address, u32 micros, u8 core, tagged
+// arguments, CRC-8 (polynomial 0x07) of len through the arguments.
+class LogDecoder {
+public:
+    static constexpr uint8_t kFrameStart = 0x1e;
+
+    // A build folder or an .elf. Without one frames still decode, with the
+    // format's address in place of its text.
+    bool LoadElf(const std::string& path, std::string* error);
+    bool HasElf() const { return !elf_path_.empty(); }
+    const std::string& ElfPath() const { return elf_path_; }
+
+    // Appends the text of data to out. A frame split across reads is held
+    // back until the rest arrives.
+    void Feed(const uint8_t* data, size_t len, std::string* out);
+
+    uint64_t Records() const { return records_; }
+    uint64_t BadFrames() const { return bad_frames_; }
+    uint64_t UnknownFormats() const { return unknown_formats_; }
+
+private:
+    void Decode(const uint8_t* frame, size_t len, std::string* out);
+
+    ElfImage elf_;
+    std::string elf_path_;
+    std::string pending_;
+    size_t bad_until_ = 0;        // in pending_, the end of the last bad frame
+    // Read by the UI while the monitor's reader feeds.
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> bad_frames_{0};
+    std::atomic<uint64_t> unknown_formats_{0};
+};
+
+// printf of one record: each conversion in format takes the next tagged
+// argument, whatever its length modifier, the same way the firmware's text
+// sink formats it.
+std::string FormatRecord(const std::string& format, const uint8_t* args, size_t len);
+
+uint8_t Crc8(const uint8_t* data, size_t len);
+
+#endif
@@ -3,19 +3,37 @@
 #include <ftxui/component/component_base.hpp>
 #include <ftxui/dom/elements.hpp>
 
-#include <cstdlib>
+#include <ftxui/dom/table.hpp>
+
+#include "artifactcache.hpp"
+#include "batchflash.hpp"
+#include "jobrunner.hpp"
+#include "memorypane.hpp"
+#include "monitorpane.hpp"
+#include "serialmonitor.hpp"
+#include "serialport.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <sstream>
+#include <thread>
 
 #include <limits.h>
+#ifdef __APPLE__
 #include <mach-o/dyld.h>
+#endif
 #include <libgen.h>
 #include <unistd.h>
 #include <stdlib.h>
 
 using namespace ftxui;
 
+const char* kS3ReleaseUrl = "https://github.com/sinisterchiller/buildreleasetest/releases/download/test/s3build.zip";
+const char* kWroomReleaseUrl = "https://github.com/sinisterchiller/buildreleasetest/releases/download/test/wroombuild.zip";
+
 ButtonOption CenteredButtonOption() {
     ButtonOption option;
     option.transform = [](const EntryState& s) {
@@ -29,11 +47,19 @@ ButtonOption CenteredButtonOption() {
 
 std::string GetExecutableDir() {
     char path[PATH_MAX];
+#ifdef __APPLE__
     uint32_t size = sizeof(path);
 
     if (_NSGetExecutablePath(path, &size) != 0) {
         return ".";
     }
+#else
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        return ".";
+    }
+    path[len] = '\0';
+#endif
 
     char resolved[PATH_MAX];
     if (realpath(path, resolved) == nullptr) {
@@ -44,6 +70,118 @@ std::string GetExecutableDir() {
     return std::string(dirname(resolved));
 }
 
+std::string FormatRate(double bytes_per_second) {
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << bytes_per_second / 1024.0 << " KiB/s";
+    return out.str();
+}
+
+// Negotiated baud, loader and measured wire rate, plus rates that failed.
+std::string FormatLink(const FlashStatus& s) {
+    if (s.baud == 0) {
+        return "-";
+    }
+    std::ostringstream out;
+    out << s.baud << (s.stub ? " stub" : " ROM");
+    if (s.wire_rate > 0) {
+        out << ", " << FormatRate(s.wire_rate);
+    }
+    for (const BaudTrial& trial : s.trials) {
+        if (!trial.ok) {
+            out << ", " << trial.baud << " failed";
+        }
+    }
+    return out.str();
+}
+
+std::string FormatSkipped(size_t bytes, double seconds_saved) {
+    if (bytes == 0) {
+        return "-";
+    }
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << bytes / 1024.0 << " KiB, " << seconds_saved << " s saved";
+    return out.str();
+}
+
+// Per stage rates of the streaming pipeline, the slowest one marked.
+std::string FormatPipeline(const PipelineStats& p) {
+    const char* bottleneck = p.Bottleneck();
+    if (!*bottleneck) {
+        return "-";
+    }
+    std::ostringstream out;
+    out.precision(0);
+    out << std::fixed << "read " << p.read.Rate() / 1024.0 << ", deflate " << p.deflate.Rate() / 1024.0
+        << ", write " << p.write.Rate() / 1024.0 << " KiB/s, " << bottleneck << " bound";
+    return out.str();
+}
+
+// One row per child process: state, run time and its latest output line.
+Element JobsTable(const std::vector<JobStatus>& jobs) {
+    std::vector<std::vector<Element>> rows;
+    rows.push_back({text("Job"), text("State"), text("Time"), text("Output")});
+    for (const JobStatus& job : jobs) {
+        Element state = text("running");
+        if (!job.running && job.cancelled) {
+            state = text("cancelled") | color(Color::Yellow);
+        } else if (!job.running && job.exit_code == 0) {
+            state = text("done") | color(Color::Green);
+        } else if (!job.running) {
+            state = text("exit " + std::to_string(job.exit_code)) | color(Color::Red);
+        }
+        std::ostringstream seconds;
+        seconds.precision(1);
+        seconds << std::fixed << job.seconds << " s";
+        rows.push_back({text(job.name), state, text(seconds.str()), text(job.last_line) | size(WIDTH, LESS_THAN, 60)});
+    }
+    auto table = Table(std::move(rows));
+    table.SelectAll().Border(LIGHT);
+    table.SelectAll().SeparatorVertical(LIGHT);
+    table.SelectRow(0).Decorate(bold);
+    table.SelectRow(0).BorderBottom(LIGHT);
+    return table.Render();
+}
+
+// One row per port: progress, effective write rate and verify result.
+Element JobTable(const std::vector<PortJob>& jobs) {
+    std::vector<std::vector<Element>> rows;
+    rows.push_back({text("Port"), text("Chip"), text("Stage"), text("Progress"), text("Rate"), text("Link"), text("Skipped"), text("Pipeline"), text("Verify")});
+    for (const PortJob& job : jobs) {
+        const FlashStatus& s = job.status;
+        float ratio = s.total ? float(s.done) / float(s.total) : 0.0f;
+        double rate = s.seconds > 0 ? s.done / s.seconds : 0;
+
+        Element verify = text("-");
+        if (job.finished && job.ok) {
+            verify = text("OK") | color(Color::Green);
+        } else if (job.finished) {
+            verify = text("FAILED") | color(Color::Red);
+        } else if (s.verified > 0) {
+            verify = text(std::to_string(s.verified) + " file(s) OK");
+        }
+
+        rows.push_back({
+            text(job.port),
+            text(s.chip.empty() ? "?" : s.module.empty() ? s.chip : s.chip + " " + s.module),
+            text(job.finished && !job.ok ? job.error : s.stage),
+            hbox({gauge(ratio) | size(WIDTH, EQUAL, 20), text(" " + std::to_string(int(ratio * 100)) + "%")}),
+            text(FormatRate(rate)),
+            text(FormatLink(s)),
+            text(FormatSkipped(s.skipped, s.seconds_saved)),
+            text(FormatPipeline(s.pipeline)),
+            verify,
+        });
+    }
+    auto table = Table(std::move(rows));
+    table.SelectAll().Border(LIGHT);
+    table.SelectAll().SeparatorVertical(LIGHT);
+    table.SelectRow(0).Decorate(bold);
+    table.SelectRow(0).BorderBottom(LIGHT);
+    return table.Render();
+}
+
 int main() {
     auto screen = ScreenInteractive::Fullscreen();
 
@@ -65,6 +203,11 @@ int main() {
 
     
 
+    // Clones and builds run as child processes next to the UI, which keeps
+    // drawing while they do.
+    JobRunner jobs([&] { screen.PostEvent(Event::Custom); });
+    std::string jobmessage;
+
     auto entersetupbutton = Button(
         "Configure Setup",
         [&] {
@@ -72,17 +215,11 @@ int main() {
 
             if (selected == 0) {
                 std::string exe_dir = GetExecutableDir();
-
-                std::string cmd =
-                    "osascript "
-                    "-e 'tell application \"Terminal\" to activate' "
-                    "-e 'tell application \"Terminal\" to do script "
-                    "\"cd \\\"" + exe_dir + "\\\" && "
-                    "mkdir -p testclone && "
-                    "git clone https://github.com/ArthurSonzogni/FTXUI.git testclone/MainModule; "
-                    "echo; echo DONE; echo Press any key to close...; read -n 1\"'";
-
-                std::system(cmd.c_str());
+                jobmessage.clear();
+                jobs.Start("Clone MainModule",
+                           {"git", "clone", "--progress", "https://github.com/ArthurSonzogni/FTXUI.git",
+                            exe_dir + "/testclone/MainModule"},
+                           &jobmessage);
             }
             if (selected == 1) {
 
@@ -91,15 +228,238 @@ int main() {
         },
         CenteredButtonOption()
     );
+    auto canceljobsbutton = Button("Cancel jobs", [&] { jobs.CancelAll(); }, CenteredButtonOption());
 
     
 
+    std::vector<std::string> ports = ListSerialPorts();
+    int selectedport = 0;
+    auto portdropdown = Dropdown(&ports, &selectedport);
+    auto refreshbutton = Button("Refresh", [&] { ports = ListSerialPorts(); }, CenteredButtonOption());
+
+    std::string builddir;
+    auto builddirinput = Input(&builddir, "build folder (default: latest release)");
+
+    FlashOptions flashoptions;
+    // esptool's stub_flasher_32*.json files, copied next to the program.
+    flashoptions.stub_dir = GetExecutableDir() + "/stubs";
+    auto onlychangedcheckbox = Checkbox("Only write changed sectors", &flashoptions.only_changed);
+    // Fleet settings for zero touch setup, written to each board's NVS.
+    bool provision = false;
+    auto provisioncheckbox = Checkbox("Provision from provision.conf (resets NVS)", &provision);
+
+    std::unique_ptr<BatchFlash> batch;
+    std::string flashmessage;
+
+    // Both firmwares log at 115200, the faster rates are for builds that
+    // raise it.
+    std::vector<std::string> monitorbauds = {"115200", "921600", "2000000"};
+    int selectedmonitorbaud = 0;
+    auto monitorbauddropdown = Dropdown(&monitorbauds, &selectedmonitorbaud);
+    SerialMonitor monitor([&] { screen.PostEvent(Event::Custom); });
+    bool monitoring = false;
+    bool showingmemory = false;
+    auto monitorpane = Maybe(MonitorPane(&monitor), &monitoring);
+    auto monitorbutton = Button(
+        "Monitor",
+        [&] {
+            if (monitoring) {
+                monitor.Stop();
+                monitoring = false;
+                return;
+            }
+            if (ports.empty() || (batch && batch->Running())) {
+                return;
+            }
+            // The build's ELF holds the format strings of dlog frames.
+            // Without it they still show, by address.
+            auto decoder = std::make_shared<LogDecoder>();
+            std::string elferror;
+            if (!builddir.empty() && !decoder->LoadElf(builddir, &elferror)) {
+                flashmessage = elferror;
+            }
+            monitor.SetDecoder(decoder);
+            if (monitor.Start(ports[selectedport], std::stoi(monitorbauds[selectedmonitorbaud]), &flashmessage)) {
+                monitoring = true;
+                showingmemory = false;
+            }
+        },
+        CenteredButtonOption()
+    );
+
+    // Where the build's IRAM, DRAM and flash went, against an older build
+    // when one is given, and whether the ISR and display paths still run
+    // from IRAM.
+    std::string comparedir;
+    auto comparedirinput = Input(&comparedir, "older build folder to compare (optional)");
+    MemoryNode memorytree;
+    bool analyzing = false;
+    std::thread analyzethread;
+    auto memorypane = Maybe(MemoryPane(&memorytree), &showingmemory);
+    auto analyzebutton = Button(
+        "Analyze",
+        [&] {
+            if (showingmemory) {
+                showingmemory = false;
+                return;
+            }
+            if (analyzing) {
+                return;
+            }
+            if (builddir.empty()) {
+                flashmessage = "Analyze needs a build folder";
+                return;
+            }
+            if (analyzethread.joinable()) {
+                analyzethread.join();
+            }
+            // More patterns, one per line, for functions a build moved to IRAM.
+            std::vector<std::string> hotpaths = DefaultHotPaths();
+            std::ifstream hotpathsfile(GetExecutableDir() + "/hotpaths.txt");
+            for (std::string line; std::getline(hotpathsfile, line);) {
+                if (!line.empty() && line[0] != '#') hotpaths.push_back(line);
+            }
+            analyzing = true;
+            flashmessage = "Analyzing " + builddir;
+            analyzethread = std::thread([&, after = builddir, before = comparedir, hotpaths] {
+                MemoryReport report;
+                MemoryReport older;
+                std::string error;
+                bool ok = AnalyzeBuild(after, hotpaths, &report, &error) &&
+                          (before.empty() || AnalyzeBuild(before, hotpaths, &older, &error));
+                auto tree = std::make_shared<MemoryNode>();
+                if (ok) {
+                    *tree = BuildMemoryTree(report, before.empty() ? nullptr : &older);
+                }
+                screen.Post([&, ok, error, tree] {
+                    analyzing = false;
+                    if (!ok) {
+                        flashmessage = error;
+                        return;
+                    }
+                    flashmessage.clear();
+                    memorytree = std::move(*tree);
+                    monitor.Stop();
+                    monitoring = false;
+                    showingmemory = true;
+                });
+            });
+        },
+        CenteredButtonOption()
+    );
+
+    std::thread fetchthread;
+    bool fetching = false;
+
+    auto startbatch = [&](FlashPlan plan, const std::vector<std::string>& targets) {
+        flashmessage.clear();
+        batch.reset();
+        batch = std::make_unique<BatchFlash>(std::move(plan), targets, flashoptions, [&] { screen.PostEvent(Event::Custom); });
+    };
+
+    // Releases come through the artifact cache next to the program, so
+    // flashing a second board or flashing again later downloads nothing.
+    auto fetchrelease = [&](const std::string& url, const std::vector<std::string>& targets) {
+        if (fetchthread.joinable()) {
+            fetchthread.join();
+        }
+        fetching = true;
+        flashmessage = "Checking " + url;
+        fetchthread = std::thread([&, url, targets] {
+            ArtifactCache cache(GetExecutableDir() + "/cache");
+            // Flashing streams the files back out of the cached archive.
+            cache.KeepFiles(false);
+            auto last = std::chrono::steady_clock::now();
+            auto progress = [&](uint64_t done, uint64_t total) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - last < std::chrono::milliseconds(100)) {
+                    return;
+                }
+                last = now;
+                std::string message = "Downloading " + std::to_string(done / 1024) + " KB";
+                if (total) {
+                    message += " of " + std::to_string(total / 1024) + " KB";
+                }
+                screen.Post([&, message] { flashmessage = message; });
+            };
+            FetchResult release;
+            std::string error;
+            auto plan = std::make_shared<FlashPlan>();
+            bool ok = cache.Fetch(url, progress, &release, &error) && LoadFlashLayout(release.archive, plan.get(), &error);
+            screen.Post([&, ok, error, plan, targets] {
+                fetching = false;
+                if (!ok) {
+                    flashmessage = error;
+                    return;
+                }
+                startbatch(std::move(*plan), targets);
+            });
+        });
+    };
+
+    auto startflash = [&](const std::vector<std::string>& targets) {
+        if ((batch && batch->Running()) || fetching || targets.empty()) {
+            return;
+        }
+        // The monitor holds the port open.
+        monitor.Stop();
+        monitoring = false;
+        flashoptions.provision.reset();
+        if (provision) {
+            auto config = std::make_shared<ProvisionConfig>();
+            if (!LoadProvisionConfig(GetExecutableDir() + "/provision.conf", config.get(), &flashmessage)) {
+                return;
+            }
+            flashoptions.provision = config;
+        }
+        if (builddir.empty()) {
+            fetchrelease(selected == 0 ? kS3ReleaseUrl : kWroomReleaseUrl, targets);
+            return;
+        }
+        FlashPlan plan;
+        if (!LoadFlashLayout(builddir, &plan, &flashmessage)) {
+            return;
+        }
+        startbatch(std::move(plan), targets);
+    };
+
+    auto flashbutton = Button(
+        "Flash",
+        [&] {
+            if (!ports.empty()) {
+                startflash({ports[selectedport]});
+            }
+        },
+        CenteredButtonOption()
+    );
+    auto flashallbutton = Button("Flash all ports", [&] { startflash(ports); }, CenteredButtonOption());
+
     auto container = Container::Vertical({
         entersetupbutton,
+        canceljobsbutton,
         selectboarddropdown,
+        portdropdown,
+        refreshbutton,
+        builddirinput,
+        onlychangedcheckbox,
+        provisioncheckbox,
+        flashbutton,
+        flashallbutton,
+        monitorbauddropdown,
+        monitorbutton,
+        monitorpane,
+        comparedirinput,
+        analyzebutton,
+        memorypane,
     });
 
     auto renderer = Renderer(container, [&] {
+        std::vector<PortJob> portjobs;
+        if (batch) {
+            portjobs = batch->Snapshot();
+        }
+        std::vector<JobStatus> childjobs = jobs.Snapshot();
+
         return vbox({
             text("███████╗███████╗██████╗     ███████╗██╗      █████╗ ███████╗██╗  ██╗███████╗██████╗ ")| center,
             text("██╔════╝██╔════╝██╔══██╗    ██╔════╝██║     ██╔══██╗██╔════╝██║  ██║██╔════╝██╔══██╗")| center,
@@ -116,6 +476,22 @@ int main() {
             hbox({ filler(), text("Select Board  "), selectboarddropdown->Render(), filler() }),
             text("") | center,
             hbox({ filler(), entersetupbutton->Render()| size(WIDTH, EQUAL, 20), filler() }),
+            childjobs.empty() ? emptyElement() : hbox({ filler(), JobsTable(childjobs), text(" "), canceljobsbutton->Render() | size(WIDTH, EQUAL, 14), filler() }),
+            jobmessage.empty() ? emptyElement() : hbox({ filler(), text(jobmessage) | color(Color::Red), filler() }),
+            text("") | center,
+            hbox({ filler(), text("Port  "), portdropdown->Render(), text(" "), refreshbutton->Render() | size(WIDTH, EQUAL, 12), filler() }),
+            hbox({ filler(), text("Build  "), builddirinput->Render() | size(WIDTH, EQUAL, 50), filler() }),
+            hbox({ filler(), onlychangedcheckbox->Render(), filler() }),
+            hbox({ filler(), provisioncheckbox->Render(), filler() }),
+            hbox({ filler(), flashbutton->Render() | size(WIDTH, EQUAL, 20), text(" "), flashallbutton->Render() | size(WIDTH, EQUAL, 20), filler() }),
+            text("") | center,
+            hbox({ filler(), text("Monitor  "), monitorbauddropdown->Render(), text(" "), monitorbutton->Render() | size(WIDTH, EQUAL, 20), filler() }),
+            text("") | center,
+            hbox({ filler(), text("Compare  "), comparedirinput->Render() | size(WIDTH, EQUAL, 42), text(" "), analyzebutton->Render() | size(WIDTH, EQUAL, 12), filler() }),
+            text("") | center,
+            monitoring ? monitorpane->Render() | flex
+            : showingmemory ? memorypane->Render() | flex
+            : hbox({ filler(), portjobs.empty() ? text(flashmessage) : JobTable(portjobs), filler() }),
             
 
             filler(),
@@ -124,4 +500,13 @@ int main() {
     });
 
     screen.Loop(renderer);
+    // Workers post to the screen, finish them while it still exists.
+    if (fetchthread.joinable()) {
+        fetchthread.join();
+    }
+    if (analyzethread.joinable()) {
+        analyzethread.join();
+    }
+    batch.reset();
+    monitor.Stop();
 }
@@ -0,0 +1,28 @@
+#ifndef FIRMWAREFLASHER_MD5_HPP
+#define FIRMWAREFLASHER_MD5_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// MD5 (RFC 1321), only used to compare against SPI_FLASH_MD5 replies.
+class Md5 {
+public:
+    Md5();
+    void Update(const uint8_t* data, size_t len);
+    void Final(uint8_t digest[16]);
+    std::string HexDigest();
+
+private:
+    void Block(const uint8_t* p);
+
+    uint32_t state_[4];
+    uint64_t length_ = 0;
+    uint8_t buffer_[64];
+    size_t used_ = 0;
+};
+
+std::string Md5Hex(const uint8_t* data, size_t len);
+std::string HexString(const uint8_t* data, size_t len);
+
+#endif
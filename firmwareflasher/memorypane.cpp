@@ -0,0 +1,144 @@
+#include "memorypane.hpp"
+
+#include <ftxui/component/component.hpp>
+#include <ftxui/component/event.hpp>
+#include <ftxui/component/mouse.hpp>
+#include <ftxui/dom/elements.hpp>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace ftxui;
+
+namespace {
+
+std::string Bytes(uint64_t size) {
+    std::ostringstream out;
+    out.precision(1);
+    if (size >= 1024 * 1024) {
+        out << std::fixed << size / (1024.0 * 1024.0) << " MiB";
+    } else if (size >= 10 * 1024) {
+        out << std::fixed << size / 1024.0 << " KiB";
+    } else {
+        out << size << " B";
+    }
+    return out.str();
+}
+
+std::string Delta(const MemoryNode& node) {
+    if (node.size == node.before) return "";
+    std::string sign = node.size > node.before ? "+" : "-";
+    return sign + Bytes(node.size > node.before ? node.size - node.before : node.before - node.size);
+}
+
+class MemoryPaneBase : public ComponentBase {
+public:
+    explicit MemoryPaneBase(const MemoryNode* tree) : tree_(tree) {
+        // The top level and the hot paths are what one looks at first.
+        expanded_.insert("");
+        expanded_.insert("/Hot paths");
+    }
+
+    Element OnRender() override {
+        rows_.clear();
+        compared_ = false;
+        Flatten(*tree_, "", 0);
+        int height = std::max(1, box_.y_max - box_.y_min + 1);
+        height_ = height;
+        selected_ = std::min(selected_, rows_.size() - 1);
+        if (selected_ < top_) top_ = selected_;
+        if (selected_ >= top_ + height) top_ = selected_ + 1 - height;
+
+        Elements table;
+        for (size_t i = top_; i < rows_.size() && i < top_ + static_cast<size_t>(height); i++) {
+            const Row& row = rows_[i];
+            const char* marker = row.node->children.empty() ? "  " : expanded_.count(row.path) ? "▾ " : "▸ ";
+            Element label = text(std::string(2 * row.depth, ' ') + marker + row.node->label);
+            if (row.node->flagged) label = label | color(Color::Red);
+            Element line = hbox({
+                label | flex,
+                text(Bytes(row.node->size)) | align_right | size(WIDTH, EQUAL, 12),
+                compared_ ? text(Delta(*row.node)) | align_right | size(WIDTH, EQUAL, 12)
+                                | color(row.node->size > row.node->before ? Color::Red : Color::Green)
+                          : emptyElement(),
+            });
+            if (i == selected_) line = line | inverted;
+            table.push_back(line);
+        }
+        return vbox(std::move(table)) | flex | reflect(box_);
+    }
+
+    bool OnEvent(Event event) override {
+        if (rows_.empty()) return false;
+        if (event.is_mouse()) {
+            if (event.mouse().button == Mouse::WheelUp) return Move(-3);
+            if (event.mouse().button == Mouse::WheelDown) return Move(3);
+            return false;
+        }
+        if (event == Event::ArrowUp) return Move(-1);
+        if (event == Event::ArrowDown) return Move(1);
+        if (event == Event::PageUp) return Move(-std::max(1, height_ - 1));
+        if (event == Event::PageDown) return Move(std::max(1, height_ - 1));
+        const Row& row = rows_[selected_];
+        if (event == Event::Return || event == Event::ArrowRight) {
+            if (row.node->children.empty()) return false;
+            if (event == Event::Return && expanded_.count(row.path)) {
+                expanded_.erase(row.path);
+            } else {
+                expanded_.insert(row.path);
+            }
+            return true;
+        }
+        if (event == Event::ArrowLeft) {
+            if (expanded_.erase(row.path)) return true;
+            // Already collapsed: go up to the parent.
+            for (size_t i = selected_; i-- > 0;) {
+                if (rows_[i].depth < row.depth) {
+                    selected_ = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        return ComponentBase::OnEvent(event);
+    }
+
+    bool Focusable() const override { return true; }
+
+private:
+    struct Row {
+        const MemoryNode* node;
+        std::string path;
+        int depth;
+    };
+
+    void Flatten(const MemoryNode& node, const std::string& path, int depth) {
+        rows_.push_back({&node, path, depth});
+        compared_ = compared_ || node.before != 0;
+        if (!expanded_.count(path)) return;
+        for (const MemoryNode& child : node.children) Flatten(child, path + "/" + child.label, depth + 1);
+    }
+
+    bool Move(int delta) {
+        long selected = static_cast<long>(selected_) + delta;
+        selected_ = static_cast<size_t>(std::clamp(selected, 0L, static_cast<long>(rows_.size()) - 1));
+        return true;
+    }
+
+    const MemoryNode* tree_;
+    std::set<std::string> expanded_;
+    std::vector<Row> rows_;
+    bool compared_ = false;
+    Box box_;
+    size_t selected_ = 0;
+    size_t top_ = 0;
+    int height_ = 1;
+};
+
+}  // namespace
+
+Component MemoryPane(const MemoryNode* tree) {
+    return Make<MemoryPaneBase>(tree);
+}
@@ -0,0 +1,15 @@
+#ifndef FIRMWAREFLASHER_MEMORYPANE_HPP
+#define FIRMWAREFLASHER_MEMORYPANE_HPP
+
+#include "memoryreport.hpp"
+
+#include <ftxui/component/component_base.hpp>
+
+// tree as a collapsible table of sizes, with a change column when it was
+// built against an older build. Only the rows that fit on screen are
+// rendered. Arrows and page keys move, Enter or Right expands, Left
+// collapses. What is expanded is kept by path, so it survives tree being
+// replaced by a new analysis.
+ftxui::Component MemoryPane(const MemoryNode* tree);
+
+#endif
@@ -0,0 +1,251 @@
+#include "memoryreport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+namespace {
+
+bool Glob(const char* pattern, const char* text) {
+    // Iterative match with one star of backtracking, enough for globs.
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*text) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        } else if (star) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return !*pattern;
+}
+
+// "ns::f(int)" matches patterns as "ns::f".
+std::string BareName(const std::string& name) {
+    size_t paren = name.find('(');
+    return paren == std::string::npos ? name : name.substr(0, paren);
+}
+
+std::string FileName(const std::string& path) {
+    return std::filesystem::path(path).filename().string();
+}
+
+MemoryNode* Child(MemoryNode* node, const std::string& label) {
+    for (MemoryNode& child : node->children) {
+        if (child.label == label) return &child;
+    }
+    node->children.push_back(MemoryNode());
+    node->children.back().label = label;
+    return &node->children.back();
+}
+
+MemoryNode Tree(const MemoryReport& report) {
+    MemoryNode root;
+    root.label = FileName(report.elf_path);
+
+    MemoryNode hot;
+    hot.label = "Hot paths";
+    for (const MemorySymbol& symbol : report.symbols) {
+        if (!symbol.hot) continue;
+        MemoryRegion region = RegionOf(symbol.section);
+        MemoryNode* node = Child(&hot, symbol.name + "  " + MemoryRegionName(region));
+        node->size += symbol.size;
+        node->flagged = region != MemoryRegion::Iram;
+        hot.size += symbol.size;
+        hot.flagged = hot.flagged || node->flagged;
+    }
+    if (!hot.children.empty()) root.children.push_back(std::move(hot));
+
+    std::map<MemoryRegion, MemoryNode> regions;
+    for (const ElfSection& section : report.sections) {
+        MemoryRegion region = RegionOf(section.name);
+        MemoryNode& region_node = regions[region];
+        region_node.label = MemoryRegionName(region);
+        region_node.size += section.size;
+        MemoryNode* section_node = Child(&region_node, section.name);
+        section_node->size += section.size;
+
+        for (const MapInput& input : report.inputs) {
+            if (input.output == section.name) Child(section_node, input.component)->size += input.size;
+        }
+        const bool mapped = !section_node->children.empty();
+        for (const MemorySymbol& symbol : report.symbols) {
+            if (symbol.section != section.name) continue;
+            MemoryNode* component = Child(section_node, mapped ? symbol.component : "(no map)");
+            if (!mapped) component->size += symbol.size;
+            Child(component, symbol.name)->size += symbol.size;
+        }
+    }
+    for (auto& region : regions) {
+        root.size += region.second.size;
+        root.children.push_back(std::move(region.second));
+    }
+    return root;
+}
+
+// A node that only the older build had.
+MemoryNode Gone(const MemoryNode& before) {
+    MemoryNode node;
+    node.label = before.label;
+    node.before = before.size;
+    for (const MemoryNode& child : before.children) node.children.push_back(Gone(child));
+    return node;
+}
+
+void Merge(MemoryNode* after, const MemoryNode& before) {
+    after->before = before.size;
+    for (const MemoryNode& old : before.children) {
+        auto it = std::find_if(after->children.begin(), after->children.end(),
+                               [&](const MemoryNode& child) { return child.label == old.label; });
+        if (it == after->children.end()) {
+            after->children.push_back(Gone(old));
+        } else {
+            Merge(&*it, old);
+        }
+    }
+}
+
+uint64_t Change(const MemoryNode& node) {
+    return node.size > node.before ? node.size - node.before : node.before - node.size;
+}
+
+// Regions keep their fixed order, everything below sorts by size or, when
+// comparing, by how much it moved.
+void Sort(MemoryNode* node, int depth, bool diff) {
+    if (depth >= 1) {
+        std::stable_sort(node->children.begin(), node->children.end(), [&](const MemoryNode& a, const MemoryNode& b) {
+            if (diff && Change(a) != Change(b)) return Change(a) > Change(b);
+            return a.size > b.size;
+        });
+    }
+    for (MemoryNode& child : node->children) Sort(&child, depth + 1, diff);
+}
+
+}  // namespace
+
+const char* MemoryRegionName(MemoryRegion region) {
+    switch (region) {
+    case MemoryRegion::Iram: return "IRAM";
+    case MemoryRegion::Dram: return "DRAM";
+    case MemoryRegion::FlashCode: return "Flash code";
+    case MemoryRegion::FlashData: return "Flash rodata";
+    case MemoryRegion::Rtc: return "RTC";
+    case MemoryRegion::Psram: return "PSRAM";
+    default: return "Other";
+    }
+}
+
+MemoryRegion RegionOf(const std::string& section) {
+    auto starts = [&](const char* prefix) { return section.compare(0, std::strlen(prefix), prefix) == 0; };
+    if (starts(".iram")) return MemoryRegion::Iram;
+    if (starts(".dram") || starts(".noinit")) return MemoryRegion::Dram;
+    if (starts(".flash.text")) return MemoryRegion::FlashCode;
+    if (starts(".flash")) return MemoryRegion::FlashData;
+    if (starts(".rtc")) return MemoryRegion::Rtc;
+    if (starts(".ext_ram")) return MemoryRegion::Psram;
+    return MemoryRegion::Other;
+}
+
+bool FindElf(const std::string& dir, std::string* elf, std::string* error) {
+    std::ifstream in(dir + "/flasher_args.json");
+    if (in) {
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string json = buffer.str();
+        std::smatch m;
+        if (std::regex_search(json, m, std::regex("\"app\"\\s*:\\s*\\{[^}]*\"file\"\\s*:\\s*\"([^\"]+)\\.bin\""))) {
+            std::string path = dir + "/" + m[1].str() + ".elf";
+            if (std::filesystem::exists(path)) {
+                *elf = path;
+                return true;
+            }
+        }
+    }
+    std::error_code ec;
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() == ".elf") found.push_back(entry.path().string());
+    }
+    if (found.size() != 1) {
+        *error = found.empty() ? "no .elf in " + dir : "more than one .elf in " + dir;
+        return false;
+    }
+    *elf = found[0];
+    return true;
+}
+
+std::vector<std::string> DefaultHotPaths() {
+    return {"echo", "timer_start", "timer_stop", "TFT_eSPI::push*"};
+}
+
+bool AnalyzeBuild(const std::string& path, const std::vector<std::string>& hot_paths, MemoryReport* report,
+                  std::string* error) {
+    *report = MemoryReport();
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+        if (!FindElf(path, &report->elf_path, error)) return false;
+    } else {
+        report->elf_path = path;
+    }
+    ElfImage elf;
+    if (!ReadElf(report->elf_path, &elf, error)) {
+        return false;
+    }
+
+    std::string map_path = std::filesystem::path(report->elf_path).replace_extension(".map").string();
+    LinkerMap map;
+    if (std::filesystem::exists(map_path, ec)) {
+        if (!ReadLinkerMap(map_path, &map, error)) return false;
+        report->map_path = map_path;
+        report->inputs = map.inputs;
+    }
+
+    for (const ElfSection& section : elf.sections) {
+        if (section.alloc && section.size > 0) report->sections.push_back(section);
+    }
+    // Aliases (C1/C2 constructors, weak and strong names) share an address,
+    // count the bytes once.
+    std::stable_sort(elf.symbols.begin(), elf.symbols.end(),
+                     [](const ElfSymbol& a, const ElfSymbol& b) { return a.value < b.value; });
+    for (size_t i = 0; i < elf.symbols.size(); i++) {
+        const ElfSymbol& symbol = elf.symbols[i];
+        if (i > 0 && symbol.value == elf.symbols[i - 1].value && symbol.section == elf.symbols[i - 1].section) continue;
+        const ElfSection& section = elf.sections[static_cast<size_t>(symbol.section)];
+        if (!section.alloc) continue;
+        MemorySymbol out;
+        out.name = Demangle(symbol.name);
+        out.section = section.name;
+        out.addr = symbol.value;
+        out.size = symbol.size;
+        out.function = symbol.function;
+        const MapInput* input = map.Find(symbol.value);
+        out.component = input ? input->component : "(unattributed)";
+        if (out.function) {
+            std::string bare = BareName(out.name);
+            for (const std::string& pattern : hot_paths) {
+                if (Glob(pattern.c_str(), bare.c_str())) out.hot = true;
+            }
+        }
+        report->symbols.push_back(std::move(out));
+    }
+    return true;
+}
+
+MemoryNode BuildMemoryTree(const MemoryReport& report, const MemoryReport* before) {
+    MemoryNode root = Tree(report);
+    if (before) Merge(&root, Tree(*before));
+    Sort(&root, 0, before != nullptr);
+    return root;
+}
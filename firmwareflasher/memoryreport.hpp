@@ -0,0 +1,64 @@
+#ifndef FIRMWAREFLASHER_MEMORYREPORT_HPP
+#define FIRMWAREFLASHER_MEMORYREPORT_HPP
+
+#include "elffile.hpp"
+#include "linkermap.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class MemoryRegion { Iram, Dram, FlashCode, FlashData, Rtc, Psram, Other };
+
+const char* MemoryRegionName(MemoryRegion region);
+// From the output section names of the IDF linker scripts.
+MemoryRegion RegionOf(const std::string& section);
+
+struct MemorySymbol {
+    std::string name;             // demangled
+    std::string section;          // output section
+    std::string component;
+    uint64_t addr = 0;
+    uint64_t size = 0;
+    bool function = false;
+    bool hot = false;             // matched a hot path pattern
+};
+
+// Where one build's RAM and flash went: the ELF gives sections and
+// symbols, the linker map which component each symbol came from.
+struct MemoryReport {
+    std::string elf_path;
+    std::string map_path;         // empty when the build had none
+    std::vector<ElfSection> sections;   // allocated, non empty
+    std::vector<MapInput> inputs;
+    std::vector<MemorySymbol> symbols;
+};
+
+// The app's ELF in a build folder: named after the .bin flasher_args.json
+// lists as the app, or the only .elf there.
+bool FindElf(const std::string& dir, std::string* elf, std::string* error);
+
+// Functions that have to stay in IRAM: the sensor's echo() ISR and what it
+// calls, and TFT_eSPI's pixel pushing in the display flush loop.
+std::vector<std::string> DefaultHotPaths();
+
+// path is a build folder (the app's .elf and .map next to
+// flasher_args.json) or an .elf file. Patterns are globs on the demangled
+// name without its parameter list.
+bool AnalyzeBuild(const std::string& path, const std::vector<std::string>& hot_paths, MemoryReport* report,
+                  std::string* error);
+
+struct MemoryNode {
+    std::string label;
+    uint64_t size = 0;
+    uint64_t before = 0;          // size in the older build, when compared
+    bool flagged = false;         // a hot path outside IRAM
+    std::vector<MemoryNode> children;
+};
+
+// Hot paths first, then region > section > component > symbol. With before
+// set, every node also carries its size there, nodes that went away stay
+// in at size 0, and siblings sort by how much they changed.
+MemoryNode BuildMemoryTree(const MemoryReport& report, const MemoryReport* before);
+
+#endif
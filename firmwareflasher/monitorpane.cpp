@@ -0,0 +1,142 @@
+#include "monitorpane.hpp"
+
+#include <ftxui/component/component.hpp>
+#include <ftxui/component/event.hpp>
+#include <ftxui/component/mouse.hpp>
+#include <ftxui/dom/elements.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace ftxui;
+
+namespace {
+
+// Same colours idf.py monitor uses.
+Decorator LevelColor(LogLevel level) {
+    switch (level) {
+    case LogLevel::Error: return color(Color::Red);
+    case LogLevel::Warning: return color(Color::Yellow);
+    case LogLevel::Info: return color(Color::Green);
+    case LogLevel::Verbose: return dim;
+    default: return nothing;
+    }
+}
+
+class MonitorPaneBase : public ComponentBase {
+public:
+    explicit MonitorPaneBase(SerialMonitor* monitor) : monitor_(monitor) {
+        // Applied on Enter, a new filter rescans the whole scrollback.
+        InputOption option;
+        option.multiline = false;
+        option.on_enter = [this] { applied_ = filter_; };
+        filter_input_ = Input(&filter_, "regex, Enter applies", option);
+        Add(filter_input_);
+    }
+
+    Element OnRender() override {
+        // Rows the log got in the last frame, FTXUI only knows after layout.
+        int rows = std::max(1, box_.y_max - box_.y_min + 1);
+        size_t count = 0;
+        std::string partial;
+        monitor_->With([&](Scrollback& scrollback) {
+            if (applied_ != scrollback.Filter()) {
+                filter_error_.clear();
+                if (!scrollback.SetFilter(applied_, &filter_error_)) applied_ = scrollback.Filter();
+            }
+            count = scrollback.Count();
+            if (follow_ || count <= static_cast<size_t>(rows)) {
+                top_ = count > static_cast<size_t>(rows) ? count - rows : 0;
+            } else {
+                top_ = std::min(scrollback.IndexOf(top_seq_), count - rows);
+            }
+            scrollback.Copy(top_, rows, &lines_);
+            top_seq_ = lines_.empty() ? 0 : lines_.front().seq;
+            if (scrollback.Filter().empty()) partial = scrollback.Partial();
+            lines_in_ = scrollback.Lines();
+            bytes_in_ = scrollback.BytesIn();
+        });
+        count_ = count;
+        rows_ = rows;
+
+        Elements log;
+        for (const LogLine& line : lines_) {
+            log.push_back(text(line.text) | LevelColor(line.level));
+        }
+        if (follow_ && !partial.empty() && log.size() < static_cast<size_t>(rows)) {
+            log.push_back(text(partial) | LevelColor(ParseLogLevel(partial)));
+        }
+
+        std::ostringstream status;
+        status.precision(1);
+        status << std::fixed << monitor_->Port() << " @ " << monitor_->Baud() << "  "
+               << monitor_->Rate() / 1024.0 << " KiB/s  " << bytes_in_ / 1024 << " KiB, " << lines_in_ << " lines";
+        if (std::shared_ptr<LogDecoder> decoder = monitor_->Decoder()) {
+            status << ", " << decoder->Records() << " dlog records";
+            if (!decoder->HasElf()) status << " (no ELF)";
+            if (decoder->BadFrames()) status << ", " << decoder->BadFrames() << " bad";
+            if (decoder->UnknownFormats()) status << ", " << decoder->UnknownFormats() << " unknown";
+        }
+        if (!applied_.empty()) status << ", " << count << " match";
+        status << (follow_ ? "  following" : "  paused");
+        std::string error = monitor_->Error();
+
+        return vbox({
+            hbox({text("Filter "), filter_input_->Render() | flex}),
+            filter_error_.empty() ? text(status.str()) | dim : text(filter_error_) | color(Color::Red),
+            error.empty() ? emptyElement() : text(error) | color(Color::Red),
+            separator(),
+            vbox(std::move(log)) | flex | reflect(box_),
+        });
+    }
+
+    bool OnEvent(Event event) override {
+        if (event.is_mouse()) {
+            if (event.mouse().button == Mouse::WheelUp) return Scroll(-3);
+            if (event.mouse().button == Mouse::WheelDown) return Scroll(3);
+            return false;
+        }
+        if (event == Event::ArrowUp) return Scroll(-1);
+        if (event == Event::ArrowDown) return Scroll(1);
+        if (event == Event::PageUp) return Scroll(-std::max(1, rows_ - 1));
+        if (event == Event::PageDown) return Scroll(std::max(1, rows_ - 1));
+        return ComponentBase::OnEvent(event);
+    }
+
+    bool Focusable() const override { return true; }
+
+private:
+    bool Scroll(int delta) {
+        long top = static_cast<long>(top_) + delta;
+        long last = std::max(0L, static_cast<long>(count_) - rows_);
+        top = std::clamp(top, 0L, last);
+        follow_ = top == last;
+        monitor_->With([&](Scrollback& scrollback) {
+            if (static_cast<size_t>(top) < scrollback.Count()) top_seq_ = scrollback.SeqAt(top);
+        });
+        top_ = static_cast<size_t>(top);
+        return true;
+    }
+
+    SerialMonitor* monitor_;
+    Component filter_input_;
+    std::string filter_;
+    std::string applied_;
+    std::string filter_error_;
+    Box box_;
+    bool follow_ = true;
+    uint64_t top_seq_ = 0;        // first row when not following
+    size_t top_ = 0;
+    size_t count_ = 0;
+    int rows_ = 1;
+    size_t lines_in_ = 0;
+    uint64_t bytes_in_ = 0;
+    std::vector<LogLine> lines_;
+};
+
+}  // namespace
+
+Component MonitorPane(SerialMonitor* monitor) {
+    return Make<MonitorPaneBase>(monitor);
+}
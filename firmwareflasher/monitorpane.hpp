@@ -0,0 +1,14 @@
+#ifndef FIRMWAREFLASHER_MONITORPANE_HPP
+#define FIRMWAREFLASHER_MONITORPANE_HPP
+
+#include "serialmonitor.hpp"
+
+#include <ftxui/component/component_base.hpp>
+
+// The scrollback of monitor with a regex filter above it. Only the rows
+// that fit on screen are copied out and rendered. It follows new output
+// until scrolled up (arrows, page keys, wheel), and scrolling back to the
+// bottom follows again.
+ftxui::Component MonitorPane(SerialMonitor* monitor);
+
+#endif
@@ -0,0 +1,240 @@
+#include "nvsimage.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace {
+
+constexpr uint32_t kPageActive = 0xFFFFFFFE;
+constexpr uint32_t kPageFull = 0xFFFFFFFC;
+constexpr uint8_t kVersion2 = 0xFE;
+constexpr size_t kBitmapOffset = 32;
+constexpr size_t kFirstEntry = 64;
+constexpr size_t kEntrySize = 32;
+constexpr size_t kEntriesPerPage = 126;
+constexpr size_t kMaxKey = 15;
+constexpr uint8_t kChunkAny = 0xFF;
+
+constexpr uint8_t kTypeU8 = 0x01;
+constexpr uint8_t kTypeU32 = 0x04;
+constexpr uint8_t kTypeString = 0x21;
+constexpr uint8_t kTypeBlobData = 0x42;
+constexpr uint8_t kTypeBlobIndex = 0x48;
+
+// NVS seeds the CRC with all ones and zlib inverts on the way in, so this
+// is esp_rom_crc32_le(0xFFFFFFFF, ...) on the chip.
+uint32_t NvsCrc(const uint8_t* data, size_t len) {
+    return static_cast<uint32_t>(crc32(0xFFFFFFFF, data, static_cast<uInt>(len)));
+}
+
+void PutU16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+void PutU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+// The header CRC skips its own field at bytes 4..8.
+void Seal(uint8_t* entry) {
+    uint8_t covered[28];
+    std::memcpy(covered, entry, 4);
+    std::memcpy(covered + 4, entry + 8, 24);
+    PutU32(entry + 4, NvsCrc(covered, sizeof(covered)));
+}
+
+size_t EntriesFor(size_t bytes) {
+    return (bytes + kEntrySize - 1) / kEntrySize;
+}
+
+}  // namespace
+
+NvsImage::NvsImage(size_t partition_size)
+    : image_(partition_size / kPageSize * kPageSize, 0xFF), pages_(partition_size / kPageSize) {
+    if (pages_ >= 2) StartPage();
+}
+
+bool NvsImage::Fail(const std::string& what) {
+    error_ = what;
+    return false;
+}
+
+void NvsImage::StartPage() {
+    uint8_t* page = image_.data() + page_ * kPageSize;
+    PutU32(page, kPageActive);
+    PutU32(page + 4, static_cast<uint32_t>(page_));
+    page[8] = kVersion2;
+    PutU32(page + 28, NvsCrc(page + 4, 24));
+    entry_ = 0;
+}
+
+bool NvsImage::Reserve(size_t count) {
+    if (pages_ < 2) {
+        return Fail("NVS partition needs at least two pages");
+    }
+    if (count > kEntriesPerPage) {
+        return Fail("item does not fit in one NVS page");
+    }
+    if (entry_ + count <= kEntriesPerPage) {
+        return true;
+    }
+    // NVS keeps one page erased to move entries into, a full image would
+    // not mount.
+    if (page_ + 2 >= pages_) {
+        return Fail("NVS partition full");
+    }
+    PutU32(image_.data() + page_ * kPageSize, kPageFull);
+    page_++;
+    StartPage();
+    return true;
+}
+
+// Copies len bytes into the entries from entry_ on and marks each one
+// written in the page bitmap: two bits per entry, 0b10 is written.
+void NvsImage::Write(const uint8_t* data, size_t len) {
+    uint8_t* page = image_.data() + page_ * kPageSize;
+    std::memcpy(page + kFirstEntry + entry_ * kEntrySize, data, len);
+    for (size_t n = EntriesFor(len); n > 0; n--, entry_++) {
+        page[kBitmapOffset + entry_ / 4] &= ~(1u << (2 * (entry_ % 4)));
+    }
+}
+
+bool NvsImage::Namespace(const std::string& ns, uint8_t* index) {
+    for (size_t i = 0; i < namespaces_.size(); i++) {
+        if (namespaces_[i] == ns) {
+            *index = static_cast<uint8_t>(i + 1);
+            return true;
+        }
+    }
+    if (ns.empty() || ns.size() > kMaxKey) {
+        return Fail("bad NVS namespace '" + ns + "'");
+    }
+    if (namespaces_.size() >= 254) {
+        return Fail("too many NVS namespaces");
+    }
+    // Namespaces are u8 entries of their own in namespace 0, the value is
+    // the index the keys in them carry.
+    Entry entry;
+    std::memset(entry, 0xFF, sizeof(entry));
+    entry[0] = 0;
+    entry[1] = kTypeU8;
+    entry[2] = 1;
+    entry[3] = kChunkAny;
+    std::memset(entry + 8, 0, 16);
+    std::memcpy(entry + 8, ns.data(), ns.size());
+    entry[24] = static_cast<uint8_t>(namespaces_.size() + 1);
+    if (!Reserve(1)) {
+        return false;
+    }
+    Seal(entry);
+    Write(entry, sizeof(entry));
+    namespaces_.push_back(ns);
+    *index = entry[24];
+    return true;
+}
+
+bool NvsImage::Head(const std::string& ns, const std::string& key, uint8_t type, Entry entry) {
+    if (key.empty() || key.size() > kMaxKey) {
+        return Fail("bad NVS key '" + key + "'");
+    }
+    uint8_t index = 0;
+    if (!Namespace(ns, &index)) {
+        return false;
+    }
+    std::memset(entry, 0xFF, sizeof(Entry));
+    entry[0] = index;
+    entry[1] = type;
+    entry[2] = 1;
+    entry[3] = kChunkAny;
+    std::memset(entry + 8, 0, 16);
+    std::memcpy(entry + 8, key.data(), key.size());
+    return true;
+}
+
+bool NvsImage::Primitive(const std::string& ns, const std::string& key, uint8_t type, uint64_t value,
+                         size_t width) {
+    Entry entry;
+    if (!Head(ns, key, type, entry) || !Reserve(1)) {
+        return false;
+    }
+    for (size_t i = 0; i < width; i++) entry[24 + i] = (value >> (8 * i)) & 0xFF;
+    Seal(entry);
+    Write(entry, sizeof(entry));
+    return true;
+}
+
+bool NvsImage::SetU8(const std::string& ns, const std::string& key, uint8_t value) {
+    return Primitive(ns, key, kTypeU8, value, 1);
+}
+
+bool NvsImage::SetU32(const std::string& ns, const std::string& key, uint32_t value) {
+    return Primitive(ns, key, kTypeU32, value, 4);
+}
+
+// Strings keep their NUL and, unlike blobs, never span pages.
+bool NvsImage::SetString(const std::string& ns, const std::string& key, const std::string& value) {
+    Entry entry;
+    if (!Head(ns, key, kTypeString, entry)) {
+        return false;
+    }
+    std::vector<uint8_t> data(value.begin(), value.end());
+    data.push_back(0);
+    size_t span = 1 + EntriesFor(data.size());
+    if (!Reserve(span)) {
+        return false;
+    }
+    entry[2] = static_cast<uint8_t>(span);
+    PutU16(entry + 24, static_cast<uint16_t>(data.size()));
+    PutU32(entry + 28, NvsCrc(data.data(), data.size()));
+    Seal(entry);
+    Write(entry, sizeof(entry));
+    Write(data.data(), data.size());
+    return true;
+}
+
+// Blobs go in as numbered chunks, each filling what is left of a page,
+// followed by an index entry with the total size and chunk count.
+bool NvsImage::SetBlob(const std::string& ns, const std::string& key, const std::vector<uint8_t>& value) {
+    Entry entry;
+    if (!Head(ns, key, kTypeBlobData, entry)) {
+        return false;
+    }
+    size_t offset = 0;
+    uint8_t chunks = 0;
+    do {
+        // A chunk header, at least one data entry and the index after it.
+        if (!Reserve(value.empty() ? 2 : 3)) {
+            return false;
+        }
+        size_t room = (kEntriesPerPage - entry_ - 2) * kEntrySize;
+        size_t len = std::min(room, value.size() - offset);
+        if (chunks == 0xFF) {
+            return Fail("blob too large for NVS");
+        }
+        Entry chunk;
+        std::memcpy(chunk, entry, sizeof(Entry));
+        chunk[2] = static_cast<uint8_t>(1 + EntriesFor(len));
+        chunk[3] = chunks;
+        PutU16(chunk + 24, static_cast<uint16_t>(len));
+        PutU32(chunk + 28, NvsCrc(value.data() + offset, len));
+        Seal(chunk);
+        Write(chunk, sizeof(chunk));
+        Write(value.data() + offset, len);
+        offset += len;
+        chunks++;
+    } while (offset < value.size());
+
+    if (!Reserve(1)) {
+        return false;
+    }
+    entry[1] = kTypeBlobIndex;
+    PutU32(entry + 24, static_cast<uint32_t>(value.size()));
+    entry[28] = chunks;
+    entry[29] = 0;
+    Seal(entry);
+    Write(entry, sizeof(entry));
+    return true;
+}
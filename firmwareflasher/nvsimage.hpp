@@ -0,0 +1,47 @@
+#ifndef FIRMWAREFLASHER_NVSIMAGE_HPP
+#define FIRMWAREFLASHER_NVSIMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An NVS partition (format version 2, what IDF 4.x and 5.x read) built on
+// the host the way IDF's nvs_partition_gen.py lays it out. Entries go in
+// the order they are set, the image is ready to flash at any point.
+class NvsImage {
+public:
+    static constexpr size_t kPageSize = 4096;
+
+    explicit NvsImage(size_t partition_size);
+
+    bool SetU8(const std::string& ns, const std::string& key, uint8_t value);
+    bool SetU32(const std::string& ns, const std::string& key, uint32_t value);
+    bool SetString(const std::string& ns, const std::string& key, const std::string& value);
+    bool SetBlob(const std::string& ns, const std::string& key, const std::vector<uint8_t>& value);
+
+    const std::vector<uint8_t>& Data() const { return image_; }
+    const std::string& Error() const { return error_; }
+
+private:
+    using Entry = uint8_t[32];
+
+    bool Namespace(const std::string& ns, uint8_t* index);
+    bool Head(const std::string& ns, const std::string& key, uint8_t type, Entry entry);
+    bool Primitive(const std::string& ns, const std::string& key, uint8_t type, uint64_t value, size_t width);
+    // Room for count more entries on the current page, starting the next
+    // page when there is not.
+    bool Reserve(size_t count);
+    void StartPage();
+    void Write(const uint8_t* data, size_t len);
+    bool Fail(const std::string& what);
+
+    std::vector<uint8_t> image_;
+    std::vector<std::string> namespaces_;
+    size_t pages_ = 0;
+    size_t page_ = 0;
+    size_t entry_ = 0;            // next free entry on page_
+    std::string error_;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "provision.hpp"
+
+#include "nvsimage.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+// Must match PROVISION_NAMESPACE in both firmwares' provision.h.
+constexpr const char* kNamespace = "provision";
+
+constexpr uint16_t kPartitionMagic = 0x50AA;
+constexpr uint8_t kTypeData = 0x01;
+constexpr uint8_t kSubtypeNvs = 0x02;
+
+std::string Trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+// WPA2 wants 8 to 63 characters, empty leaves the network open.
+bool ValidPassphrase(const std::string& pass) {
+    return pass.empty() || (pass.size() >= 8 && pass.size() <= 63);
+}
+
+// The key travels unescaped in a form body.
+bool ValidPairKey(const std::string& key) {
+    for (char c : key) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+std::string NewPairKey() {
+    std::random_device random;
+    std::string key;
+    char hex[9];
+    for (int i = 0; i < 4; i++) {
+        std::snprintf(hex, sizeof(hex), "%08x", static_cast<unsigned>(random()));
+        key += hex;
+    }
+    return key;
+}
+
+}  // namespace
+
+bool LoadProvisionConfig(const std::string& path, ProvisionConfig* config, std::string* error) {
+    std::ifstream in(path);
+    if (!in) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    *config = ProvisionConfig();
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        line = Trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            *error = path + ":" + std::to_string(number) + ": expected key=value";
+            return false;
+        }
+        std::string key = Trim(line.substr(0, eq));
+        std::string value = Trim(line.substr(eq + 1));
+        if (key == "wifi_ssid") {
+            config->wifi_ssid = value;
+        } else if (key == "wifi_pass") {
+            config->wifi_pass = value;
+        } else if (key == "ap_pass") {
+            config->ap_pass = value;
+        } else if (key == "disarm") {
+            config->disarm = value;
+        } else if (key == "pair_key") {
+            config->pair_key = value;
+        } else if (key == "module_prefix") {
+            config->module_prefix = value;
+        } else if (key == "touch_cal") {
+            std::istringstream values(value);
+            std::string item;
+            config->touch_cal.clear();
+            while (std::getline(values, item, ',')) {
+                item = Trim(item);
+                char* end = nullptr;
+                unsigned long v = std::strtoul(item.c_str(), &end, 0);
+                if (item.empty() || *end || v > 0xFFFF) {
+                    *error = path + ":" + std::to_string(number) + ": bad touch_cal value '" + item + "'";
+                    return false;
+                }
+                config->touch_cal.push_back(static_cast<uint16_t>(v));
+            }
+        } else {
+            *error = path + ":" + std::to_string(number) + ": unknown key " + key;
+            return false;
+        }
+    }
+
+    if (!ValidPassphrase(config->wifi_pass) || !ValidPassphrase(config->ap_pass)) {
+        *error = path + ": WiFi passwords need 8 to 63 characters";
+        return false;
+    }
+    if (!config->touch_cal.empty() && config->touch_cal.size() != 5) {
+        *error = path + ": touch_cal takes the 5 values calibrateTouch() returns";
+        return false;
+    }
+    if (!ValidPairKey(config->pair_key)) {
+        *error = path + ": pair_key may only hold letters and digits";
+        return false;
+    }
+    if (config->pair_key.empty()) {
+        config->pair_key = NewPairKey();
+        std::ofstream out(path, std::ios::app);
+        out << "\npair_key=" << config->pair_key << "\n";
+        if (!out) {
+            *error = "cannot save the new pair_key to " + path;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string ModuleId(const ProvisionConfig& config, const uint8_t mac[6]) {
+    char suffix[8];
+    std::snprintf(suffix, sizeof(suffix), "%02X%02X%02X", mac[3], mac[4], mac[5]);
+    return config.module_prefix + "_" + suffix;
+}
+
+bool BuildProvisionImage(const ProvisionConfig& config, bool hub, const uint8_t mac[6], size_t partition_size,
+                         std::vector<uint8_t>* image, std::string* error) {
+    NvsImage nvs(partition_size);
+    // Empty values are left out, the firmware keeps its defaults for them.
+    auto set = [&](const char* key, const std::string& value) {
+        return value.empty() || nvs.SetString(kNamespace, key, value);
+    };
+    bool ok = set("disarm", config.disarm) && set("pairkey", config.pair_key);
+    if (hub) {
+        ok = ok && set("ssid", config.wifi_ssid) && set("pass", config.wifi_pass) && set("appass", config.ap_pass);
+        if (ok && !config.touch_cal.empty()) {
+            std::vector<uint8_t> cal;
+            for (uint16_t v : config.touch_cal) {
+                cal.push_back(v & 0xFF);
+                cal.push_back(v >> 8);
+            }
+            ok = nvs.SetBlob(kNamespace, "touchcal", cal);
+        }
+    } else {
+        // Modules join the hub's access point.
+        ok = ok && set("pass", config.ap_pass) && set("module", ModuleId(config, mac));
+    }
+    // The namespace alone tells the firmware it was provisioned.
+    ok = ok && nvs.SetU8(kNamespace, "version", 1);
+    if (!ok) {
+        *error = nvs.Error();
+        return false;
+    }
+    *image = nvs.Data();
+    return true;
+}
+
+bool FindNvsPartition(const std::vector<uint8_t>& table, uint32_t* offset, uint32_t* size) {
+    for (size_t at = 0; at + 32 <= table.size(); at += 32) {
+        const uint8_t* p = table.data() + at;
+        if ((p[0] | p[1] << 8) != kPartitionMagic) {
+            break;   // 0xFFFF past the end, or the MD5 record
+        }
+        if (p[2] == kTypeData && p[3] == kSubtypeNvs) {
+            *offset = p[4] | p[5] << 8 | p[6] << 16 | static_cast<uint32_t>(p[7]) << 24;
+            *size = p[8] | p[9] << 8 | p[10] << 16 | static_cast<uint32_t>(p[11]) << 24;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#ifndef FIRMWAREFLASHER_PROVISION_HPP
+#define FIRMWAREFLASHER_PROVISION_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a fleet needs to come up working on first boot. Read from a
+// key=value file, written into each board's NVS partition in the same pass
+// as the firmware; both firmwares read it back from the "provision"
+// namespace with Preferences.
+struct ProvisionConfig {
+    std::string wifi_ssid;        // network the hub joins
+    std::string wifi_pass;
+    std::string ap_pass;          // hub's ESP32_Master_Config, modules join it
+    std::string disarm;           // keypad code
+    std::string pair_key;         // modules present it when they join
+    std::vector<uint16_t> touch_cal;   // calibrateTouch() result of a panel of the same kind
+    std::string module_prefix = "ESP_MOTION";
+};
+
+// A missing pair_key is generated and appended to the file, so the hub and
+// modules flashed in later batches still agree on it.
+bool LoadProvisionConfig(const std::string& path, ProvisionConfig* config, std::string* error);
+
+// Module IDs come from the MAC, reflashing a board keeps its name.
+std::string ModuleId(const ProvisionConfig& config, const uint8_t mac[6]);
+
+// The NVS partition for one board, the hub's or a module's.
+bool BuildProvisionImage(const ProvisionConfig& config, bool hub, const uint8_t mac[6], size_t partition_size,
+                         std::vector<uint8_t>* image, std::string* error);
+
+// Offset and size of the nvs data partition in a partition-table.bin.
+bool FindNvsPartition(const std::vector<uint8_t>& table, uint32_t* offset, uint32_t* size);
+
+#endif
@@ -0,0 +1,150 @@
+#include "scrollback.hpp"
+
+#include <algorithm>
+
+namespace {
+
+LogLevel LevelFromLetter(char c) {
+    switch (c) {
+    case 'E': return LogLevel::Error;
+    case 'W': return LogLevel::Warning;
+    case 'I': return LogLevel::Info;
+    case 'D': return LogLevel::Debug;
+    case 'V': return LogLevel::Verbose;
+    default: return LogLevel::None;
+    }
+}
+
+}  // namespace
+
+LogLevel ParseLogLevel(const std::string& line) {
+    if (line.size() >= 3 && line[1] == ' ' && line[2] == '(') {
+        return LevelFromLetter(line[0]);
+    }
+    if (!line.empty() && line[0] == '[') {
+        size_t close = line.find(']');
+        if (close != std::string::npos && close + 3 < line.size() && line[close + 1] == '[' &&
+            line[close + 3] == ']') {
+            return LevelFromLetter(line[close + 2]);
+        }
+    }
+    return LogLevel::None;
+}
+
+Scrollback::Scrollback(size_t max_bytes, size_t max_lines)
+    : text_(std::max(max_bytes, kMaxLineLength)), max_lines_(std::max<size_t>(max_lines, 1)) {}
+
+void Scrollback::Append(const uint8_t* data, size_t len) {
+    bytes_in_ += len;
+    for (size_t i = 0; i < len; i++) {
+        char c = static_cast<char>(data[i]);
+        // IDF colours its log lines, the level letter carries the same.
+        if (escape_ == 1) {
+            escape_ = c == '[' ? 2 : 0;
+            continue;
+        }
+        if (escape_ == 2) {
+            if (c >= 0x40 && c <= 0x7E) escape_ = 0;
+            continue;
+        }
+        if (c == '\x1b') {
+            escape_ = 1;
+        } else if (c == '\n') {
+            // The newline of a line that was just wrapped ends nothing.
+            if (!wrapped_ || !partial_.empty()) EndLine();
+            wrapped_ = false;
+            return_ = false;
+        } else if (c == '\r') {
+            return_ = true;
+        } else {
+            // A bare carriage return starts the line over, the way progress
+            // meters redraw themselves on a terminal.
+            if (return_) partial_.clear();
+            return_ = false;
+            partial_ += c;
+            wrapped_ = false;
+            if (partial_.size() == kMaxLineLength) {
+                EndLine();
+                wrapped_ = true;
+            }
+        }
+    }
+}
+
+void Scrollback::EndLine() {
+    Line line{text_end_, static_cast<uint32_t>(partial_.size()), ParseLogLevel(partial_)};
+    uint64_t seq = first_seq_ + lines_.size();
+    for (char c : partial_) {
+        text_[text_end_++ % text_.size()] = c;
+    }
+    lines_.push_back(line);
+    if (!filter_ || std::regex_search(partial_, *filter_)) {
+        matches_.push_back(seq);
+    }
+    partial_.clear();
+
+    while (lines_.size() > max_lines_ || text_end_ - lines_.front().start > text_.size()) {
+        if (!matches_.empty() && matches_.front() == first_seq_) matches_.pop_front();
+        lines_.pop_front();
+        first_seq_++;
+    }
+}
+
+void Scrollback::Clear() {
+    first_seq_ += lines_.size();
+    lines_.clear();
+    matches_.clear();
+    partial_.clear();
+    return_ = false;
+}
+
+std::string Scrollback::Text(const Line& line) const {
+    std::string text(line.len, '\0');
+    size_t at = line.start % text_.size();
+    size_t first = std::min<size_t>(line.len, text_.size() - at);
+    std::copy_n(text_.begin() + at, first, text.begin());
+    std::copy_n(text_.begin(), line.len - first, text.begin() + first);
+    return text;
+}
+
+bool Scrollback::SetFilter(const std::string& pattern, std::string* error) {
+    std::unique_ptr<std::regex> filter;
+    if (!pattern.empty()) {
+        try {
+            filter = std::make_unique<std::regex>(
+                pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            *error = e.what();
+            return false;
+        }
+    }
+    pattern_ = pattern;
+    filter_ = std::move(filter);
+    matches_.clear();
+    for (size_t i = 0; i < lines_.size(); i++) {
+        if (!filter_ || std::regex_search(Text(lines_[i]), *filter_)) {
+            matches_.push_back(first_seq_ + i);
+        }
+    }
+    return true;
+}
+
+size_t Scrollback::Count() const {
+    return matches_.size();
+}
+
+uint64_t Scrollback::SeqAt(size_t index) const {
+    return matches_[index];
+}
+
+size_t Scrollback::IndexOf(uint64_t seq) const {
+    return static_cast<size_t>(std::lower_bound(matches_.begin(), matches_.end(), seq) - matches_.begin());
+}
+
+void Scrollback::Copy(size_t first, size_t count, std::vector<LogLine>* out) const {
+    out->clear();
+    for (size_t i = first; i < matches_.size() && i < first + count; i++) {
+        const Line& line = lines_[matches_[i] - first_seq_];
+        out->push_back(LogLine{matches_[i], line.level, Text(line)});
+    }
+}
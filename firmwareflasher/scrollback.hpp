@@ -0,0 +1,82 @@
+#ifndef FIRMWAREFLASHER_SCROLLBACK_HPP
+#define FIRMWAREFLASHER_SCROLLBACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+enum class LogLevel : uint8_t { None, Error, Warning, Info, Debug, Verbose };
+
+struct LogLine {
+    uint64_t seq = 0;             // counts every line ever received
+    LogLevel level = LogLevel::None;
+    std::string text;
+};
+
+// Serial or process output split into lines, held in a fixed size text ring that
+// drops the oldest lines once full. Everything per line (ANSI colour codes
+// stripped, the log level, whether it passes the filter) is worked out
+// once as the line arrives, so reading a window of it costs the same
+// whatever the scrollback holds. Not thread safe, SerialMonitor locks it.
+class Scrollback {
+public:
+    // Longer lines are wrapped, like a terminal would.
+    static constexpr size_t kMaxLineLength = 1024;
+
+    explicit Scrollback(size_t max_bytes = 16 * 1024 * 1024, size_t max_lines = 1024 * 1024);
+
+    void Append(const uint8_t* data, size_t len);
+    void Clear();
+
+    // ECMAScript regex, case insensitive. Empty shows every line. Changing
+    // it is the one thing that rescans what is held.
+    bool SetFilter(const std::string& pattern, std::string* error);
+    const std::string& Filter() const { return pattern_; }
+
+    // Lines that pass the filter, oldest first.
+    size_t Count() const;
+    uint64_t SeqAt(size_t index) const;
+    // Index of the first line at or after seq, Count() when there is none.
+    size_t IndexOf(uint64_t seq) const;
+    void Copy(size_t first, size_t count, std::vector<LogLine>* out) const;
+    // The line still being received.
+    const std::string& Partial() const { return partial_; }
+
+    size_t Lines() const { return lines_.size(); }
+    uint64_t BytesIn() const { return bytes_in_; }
+    uint64_t Evicted() const { return first_seq_; }
+
+private:
+    struct Line {
+        uint64_t start;           // absolute position in the text ring
+        uint32_t len;
+        LogLevel level;
+    };
+
+    void EndLine();
+    std::string Text(const Line& line) const;
+
+    std::vector<char> text_;
+    uint64_t text_end_ = 0;
+    size_t max_lines_;
+    std::deque<Line> lines_;
+    uint64_t first_seq_ = 0;      // of lines_.front()
+    std::string partial_;
+    bool wrapped_ = false;
+    bool return_ = false;         // '\r' seen, not yet followed by '\n'
+    int escape_ = 0;              // inside an ANSI sequence: 1 after ESC, 2 after '['
+    uint64_t bytes_in_ = 0;
+
+    std::string pattern_;
+    std::unique_ptr<std::regex> filter_;
+    std::deque<uint64_t> matches_;   // seqs of the lines that pass
+};
+
+// ESP-IDF "E (123) tag: ..." and Arduino "[   123][E][file.cpp:1] ..." lines.
+LogLevel ParseLogLevel(const std::string& line);
+
+#endif
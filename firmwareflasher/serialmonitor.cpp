@@ -0,0 +1,95 @@
+#include "serialmonitor.hpp"
+
+#include <string>
+#include <vector>
+
+SerialMonitor::SerialMonitor(std::function<void()> on_update, size_t max_bytes)
+    : scrollback_(max_bytes), on_update_(std::move(on_update)) {}
+
+SerialMonitor::~SerialMonitor() {
+    Stop();
+}
+
+bool SerialMonitor::Start(const std::string& port, int baud, std::string* error) {
+    Stop();
+    if (!port_.Open(port, baud)) {
+        *error = port_.Error();
+        return false;
+    }
+    // Both lines asserted hold an ESP in reset on the usual auto program
+    // circuit.
+    port_.SetDtr(false);
+    port_.SetRts(false);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_.clear();
+    }
+    rate_ = 0;
+    stop_ = false;
+    running_ = true;
+    reader_ = std::thread(&SerialMonitor::Reader, this);
+    return true;
+}
+
+void SerialMonitor::Stop() {
+    stop_ = true;
+    if (reader_.joinable()) {
+        reader_.join();
+    }
+    port_.Close();
+    running_ = false;
+}
+
+std::string SerialMonitor::Error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+void SerialMonitor::Notify() {
+    last_update_ = std::chrono::steady_clock::now();
+    if (on_update_) on_update_();
+}
+
+void SerialMonitor::Reader() {
+    std::vector<uint8_t> buf(kReadSize);
+    auto window_start = std::chrono::steady_clock::now();
+    uint64_t window_bytes = 0;
+    bool pending = false;
+    std::string text;
+    while (!stop_) {
+        int n = port_.Read(buf.data(), buf.size(), kUpdateIntervalMs);
+        if (n < 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = port_.Error();
+            break;
+        }
+        if (n > 0) {
+            if (decoder_) {
+                text.clear();
+                decoder_->Feed(buf.data(), static_cast<size_t>(n), &text);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decoder_) {
+                scrollback_.Append(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+            } else {
+                scrollback_.Append(buf.data(), static_cast<size_t>(n));
+            }
+            window_bytes += static_cast<uint64_t>(n);
+            pending = true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - window_start).count();
+        if (seconds >= 1.0) {
+            rate_ = window_bytes / seconds;
+            window_bytes = 0;
+            window_start = now;
+        }
+        // Quiet ports still get one last update for the tail of a burst.
+        if (pending && (n == 0 || now - last_update_ >= std::chrono::milliseconds(kUpdateIntervalMs))) {
+            Notify();
+            pending = false;
+        }
+    }
+    running_ = false;
+    Notify();
+}
@@ -0,0 +1,68 @@
+#ifndef FIRMWAREFLASHER_SERIALMONITOR_HPP
+#define FIRMWAREFLASHER_SERIALMONITOR_HPP
+
+#include "logdecoder.hpp"
+#include "scrollback.hpp"
+#include "serialport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Reads a board's serial output into a Scrollback on a thread of its own.
+// The reader only ever waits on the port, never on the UI: it takes the
+// lock just long enough to append what one read returned, and on_update
+// is rate limited the same way BatchFlash's is.
+class SerialMonitor {
+public:
+    static constexpr int kUpdateIntervalMs = 50;
+    static constexpr size_t kReadSize = 64 * 1024;
+
+    explicit SerialMonitor(std::function<void()> on_update, size_t max_bytes = 16 * 1024 * 1024);
+    ~SerialMonitor();
+    SerialMonitor(const SerialMonitor&) = delete;
+    SerialMonitor& operator=(const SerialMonitor&) = delete;
+
+    // Opens the port without resetting the board, DTR and RTS released.
+    bool Start(const std::string& port, int baud, std::string* error);
+    void Stop();
+    // Decodes dlog frames in what is read; null shows the bytes as they
+    // come. Only while stopped, the reader owns it while running.
+    void SetDecoder(std::shared_ptr<LogDecoder> decoder) { decoder_ = std::move(decoder); }
+    std::shared_ptr<LogDecoder> Decoder() const { return decoder_; }
+    bool Running() const { return running_; }
+    const std::string& Port() const { return port_.Path(); }
+    int Baud() const { return port_.Baud(); }
+    // Set when the port failed while reading, e.g. the board was unplugged.
+    std::string Error() const;
+    double Rate() const { return rate_; }   // bytes/s over the last second
+
+    // Runs f on the scrollback with the reader held off.
+    template <typename F>
+    auto With(F f) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return f(scrollback_);
+    }
+
+private:
+    void Reader();
+    void Notify();
+
+    SerialPort port_;
+    Scrollback scrollback_;
+    std::shared_ptr<LogDecoder> decoder_;
+    std::function<void()> on_update_;
+    mutable std::mutex mutex_;
+    std::string error_;
+    std::thread reader_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stop_{false};
+    std::atomic<double> rate_{0};
+    std::chrono::steady_clock::time_point last_update_;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "serialport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <IOKit/serial/ioss.h>
+#endif
+
+SerialPort::~SerialPort() {
+    Close();
+}
+
+bool SerialPort::Fail(const std::string& what) {
+    error_ = what + ": " + std::strerror(errno);
+    return false;
+}
+
+bool SerialPort::Open(const std::string& path, int baud) {
+    Close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0) {
+        return Fail("open " + path);
+    }
+    path_ = path;
+
+    termios tio{};
+    if (tcgetattr(fd_, &tio) != 0) {
+        Fail("tcgetattr");
+        Close();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+        Fail("tcsetattr");
+        Close();
+        return false;
+    }
+    if (!SetBaud(baud)) {
+        Close();
+        return false;
+    }
+    FlushInput();
+    return true;
+}
+
+void SerialPort::Close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+static speed_t BaudConstant(int baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef __linux__
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+#endif
+        default: return 0;
+    }
+}
+
+bool SerialPort::SetBaud(int baud) {
+    termios tio{};
+    if (tcgetattr(fd_, &tio) != 0) {
+        return Fail("tcgetattr");
+    }
+    speed_t speed = BaudConstant(baud);
+#ifdef __APPLE__
+    if (speed == 0) {
+        // Rates above 230400 go through IOSSIOSPEED after the termios setup.
+        speed_t custom = baud;
+        if (ioctl(fd_, IOSSIOSPEED, &custom) != 0) {
+            return Fail("IOSSIOSPEED");
+        }
+        baud_ = baud;
+        return true;
+    }
+#endif
+    if (speed == 0) {
+        errno = EINVAL;
+        return Fail("baud " + std::to_string(baud));
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd_, TCSADRAIN, &tio) != 0) {
+        return Fail("tcsetattr");
+    }
+    baud_ = baud;
+    return true;
+}
+
+bool SerialPort::Write(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                pollfd pfd{fd_, POLLOUT, 0};
+                ::poll(&pfd, 1, 100);
+                continue;
+            }
+            return Fail("write");
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+int SerialPort::Read(uint8_t* buf, size_t len, int timeout_ms) {
+    pollfd pfd{fd_, POLLIN, 0};
+    int ready = ::poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) return 0;
+        Fail("poll");
+        return -1;
+    }
+    if (ready == 0) return 0;
+    ssize_t n = ::read(fd_, buf, len);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        Fail("read");
+        return -1;
+    }
+    return static_cast<int>(n);
+}
+
+void SerialPort::FlushInput() {
+    tcflush(fd_, TCIFLUSH);
+}
+
+void SerialPort::SetDtr(bool on) {
+    int bits = TIOCM_DTR;
+    ioctl(fd_, on ? TIOCMBIS : TIOCMBIC, &bits);
+}
+
+void SerialPort::SetRts(bool on) {
+    int bits = TIOCM_RTS;
+    ioctl(fd_, on ? TIOCMBIS : TIOCMBIC, &bits);
+}
+
+std::vector<std::string> ListSerialPorts() {
+    std::vector<std::string> ports;
+    DIR* dir = opendir("/dev");
+    if (!dir) return ports;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+#ifdef __APPLE__
+        bool match = name.rfind("cu.usb", 0) == 0 || name.rfind("cu.wchusb", 0) == 0 ||
+                     name.rfind("cu.SLAB", 0) == 0;
+#else
+        bool match = name.rfind("ttyUSB", 0) == 0 || name.rfind("ttyACM", 0) == 0;
+#endif
+        if (match) {
+            ports.push_back("/dev/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(ports.begin(), ports.end());
+    return ports;
+}
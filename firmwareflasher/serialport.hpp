@@ -0,0 +1,48 @@
+#ifndef FIRMWAREFLASHER_SERIALPORT_HPP
+#define FIRMWAREFLASHER_SERIALPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Raw 8N1 serial port on top of termios. Works on USB-serial bridges and on
+// pseudo terminals, where the modem line calls are simply ignored.
+class SerialPort {
+public:
+    SerialPort() = default;
+    ~SerialPort();
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    bool Open(const std::string& path, int baud);
+    void Close();
+    bool IsOpen() const { return fd_ >= 0; }
+    const std::string& Path() const { return path_; }
+    int Baud() const { return baud_; }
+
+    bool SetBaud(int baud);
+    bool Write(const uint8_t* data, size_t len);
+    // Bytes read, 0 on timeout, -1 on error.
+    int Read(uint8_t* buf, size_t len, int timeout_ms);
+    void FlushInput();
+
+    void SetDtr(bool on);
+    void SetRts(bool on);
+
+    const std::string& Error() const { return error_; }
+
+private:
+    bool Fail(const std::string& what);
+
+    int fd_ = -1;
+    int baud_ = 0;
+    std::string path_;
+    std::string error_;
+};
+
+// Serial devices an ESP board could be on (/dev/cu.* on macOS,
+// /dev/ttyUSB* and /dev/ttyACM* on Linux).
+std::vector<std::string> ListSerialPorts();
+
+#endif
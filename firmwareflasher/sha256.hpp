@@ -0,0 +1,27 @@
+#ifndef FIRMWAREFLASHER_SHA256_HPP
+#define FIRMWAREFLASHER_SHA256_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// SHA-256 (FIPS 180-4), the key of the artifact cache.
+class Sha256 {
+public:
+    Sha256();
+    void Update(const uint8_t* data, size_t len);
+    void Final(uint8_t digest[32]);
+    std::string HexDigest();
+
+private:
+    void Block(const uint8_t* p);
+
+    uint32_t state_[8];
+    uint64_t length_ = 0;
+    uint8_t buffer_[64];
+    size_t used_ = 0;
+};
+
+std::string Sha256Hex(const uint8_t* data, size_t len);
+
+#endif
@@ -0,0 +1,66 @@
+#include "slip.hpp"
+
+namespace {
+constexpr uint8_t kEnd = 0xC0;
+constexpr uint8_t kEsc = 0xDB;
+constexpr uint8_t kEscEnd = 0xDC;
+constexpr uint8_t kEscEsc = 0xDD;
+}  // namespace
+
+void SlipEncode(const uint8_t* data, size_t len, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + len + len / 16 + 2);
+    out.push_back(kEnd);
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == kEnd) {
+            out.push_back(kEsc);
+            out.push_back(kEscEnd);
+        } else if (data[i] == kEsc) {
+            out.push_back(kEsc);
+            out.push_back(kEscEsc);
+        } else {
+            out.push_back(data[i]);
+        }
+    }
+    out.push_back(kEnd);
+}
+
+void SlipDecoder::Reset() {
+    frame_.clear();
+    in_frame_ = false;
+    escape_ = false;
+    complete_ = false;
+}
+
+bool SlipDecoder::Feed(uint8_t byte) {
+    if (complete_) {
+        frame_.clear();
+        complete_ = false;
+    }
+    if (!in_frame_) {
+        if (byte == kEnd) {
+            in_frame_ = true;
+            frame_.clear();
+        }
+        return false;
+    }
+    if (byte == kEnd) {
+        if (frame_.empty()) {
+            // Back to back delimiters, this one opens the frame.
+            return false;
+        }
+        in_frame_ = false;
+        complete_ = true;
+        return true;
+    }
+    if (escape_) {
+        escape_ = false;
+        frame_.push_back(byte == kEscEnd ? kEnd : byte == kEscEsc ? kEsc : byte);
+        return false;
+    }
+    if (byte == kEsc) {
+        escape_ = true;
+        return false;
+    }
+    frame_.push_back(byte);
+    return false;
+}
@@ -0,0 +1,27 @@
+#ifndef FIRMWAREFLASHER_SLIP_HPP
+#define FIRMWAREFLASHER_SLIP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// SLIP framing (RFC 1055) as used by the ESP ROM bootloader: every packet is
+// wrapped in 0xC0 and 0xC0/0xDB inside it are escaped.
+void SlipEncode(const uint8_t* data, size_t len, std::vector<uint8_t>& out);
+
+class SlipDecoder {
+public:
+    // Returns true when byte completes a frame, which is then in Frame().
+    // Anything outside a frame (boot log text) is dropped.
+    bool Feed(uint8_t byte);
+    const std::vector<uint8_t>& Frame() const { return frame_; }
+    void Reset();
+
+private:
+    std::vector<uint8_t> frame_;
+    bool in_frame_ = false;
+    bool escape_ = false;
+    bool complete_ = false;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef FIRMWAREFLASHER_SPSCQUEUE_HPP
+#define FIRMWAREFLASHER_SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring. The producer fills Back()
+// in place and publishes it with Push(), the consumer reads Front() in
+// place and hands the slot back with Pop(). Slots keep their buffers, so
+// once every slot was used once nothing allocates, and the two indices are
+// the only state the threads share.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t Capacity() const { return slots_.size(); }
+
+    // Producer side. Back() is null while the ring is full.
+    T* Back() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) return nullptr;
+        return &slots_[tail & mask_];
+    }
+    void Push() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // No more Push() calls will follow.
+    void Close() { closed_.store(true, std::memory_order_release); }
+
+    // Consumer side. Front() is null while the ring is empty.
+    T* Front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+        return &slots_[head & mask_];
+    }
+    void Pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // True once the producer closed the queue and everything was popped.
+    bool Drained() {
+        return closed_.load(std::memory_order_acquire) &&
+               head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    // Own cache lines, so the two sides do not keep stealing them.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::atomic<bool> closed_{false};
+};
+
+#endif
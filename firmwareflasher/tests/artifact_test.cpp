@@ -0,0 +1,282 @@
+// Fetches release archives from HttpStandIn through ArtifactCache.
+
+#include "artifactcache.hpp"
+#include "flashplan.hpp"
+#include "httpstandin.hpp"
+#include "sha256.hpp"
+#include "testzip.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+namespace fs = std::filesystem;
+
+// A build folder as idf.py leaves it, wrapped in a top level directory.
+static std::vector<ZipEntry> MakeRelease(uint32_t seed) {
+    std::mt19937 rng(seed);
+    auto blob = [&](size_t size) {
+        std::vector<uint8_t> data(size);
+        for (uint8_t& b : data) b = static_cast<uint8_t>(rng() % 24);
+        return data;
+    };
+    const std::string args =
+        "{\n"
+        "  \"flash_files\" : {\n"
+        "    \"0x0\" : \"bootloader/bootloader.bin\",\n"
+        "    \"0x8000\" : \"partition_table/partition-table.bin\",\n"
+        "    \"0x10000\" : \"hub.bin\"\n"
+        "  },\n"
+        "  \"extra_esptool_args\" : { \"chip\" : \"esp32s3\" },\n"
+        "  \"flash_settings\" : { \"flash_size\" : \"8MB\" }\n"
+        "}\n";
+    return {
+        {"build/flasher_args.json", std::vector<uint8_t>(args.begin(), args.end())},
+        {"build/bootloader/bootloader.bin", blob(21 * 1024)},
+        {"build/partition_table/partition-table.bin", blob(3072)},
+        {"build/hub.bin", blob(300 * 1024)},
+    };
+}
+
+static bool SameFiles(const std::vector<ZipEntry>& a, const std::vector<ZipEntry>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].name != b[i].name || a[i].data != b[i].data) return false;
+    }
+    return true;
+}
+
+static std::string FreshDir(const std::string& name) {
+    fs::path dir = fs::temp_directory_path() / ("artifact_test_" + std::to_string(::getpid()) + "_" + name);
+    fs::remove_all(dir);
+    return dir.string();
+}
+
+static bool Empty(const fs::path& dir) { return !fs::exists(dir) || fs::is_empty(dir); }
+
+static void TestFetchAndRevalidate() {
+    HttpStandIn server;
+    CHECK(server.Start());
+    std::vector<ZipEntry> release = MakeRelease(1);
+    std::vector<uint8_t> zip = MakeZip(release);
+    server.SetBody(zip, "\"v1\"");
+    const std::string root = FreshDir("fetch");
+    const std::string url = server.Url("/redirect/s3build.zip");
+
+    FetchResult result;
+    std::string error;
+    uint64_t last_done = 0, last_total = 0;
+    ArtifactCache cache(root);
+    CHECK(cache.Fetch(url, [&](uint64_t done, uint64_t total) { last_done = done; last_total = total; }, &result,
+                      &error));
+    CHECK(error.empty());
+    CHECK(!result.from_cache);
+    CHECK(result.network_bytes == zip.size());
+    CHECK(result.sha256 == Sha256Hex(zip.data(), zip.size()));
+    CHECK(SameFiles(result.files, release));
+    CHECK(last_done == zip.size() && last_total == zip.size());
+    CHECK(fs::exists(fs::path(root) / "objects" / result.sha256));
+    CHECK(Empty(fs::path(root) / "partial"));
+
+    // Inside the revalidation window nothing goes over the network.
+    int requests = server.Requests();
+    FetchResult again;
+    CHECK(cache.Fetch(url, nullptr, &again, &error));
+    CHECK(again.from_cache);
+    CHECK(again.network_bytes == 0);
+    CHECK(server.Requests() == requests);
+    CHECK(SameFiles(again.files, release));
+
+    // After it, an unchanged release costs a 304 and no body bytes.
+    ArtifactCache eager(root, 0);
+    size_t sent = server.BodyBytesSent();
+    FetchResult revalidated;
+    CHECK(eager.Fetch(url, nullptr, &revalidated, &error));
+    CHECK(server.LastStatus() == 304);
+    CHECK(server.BodyBytesSent() == sent);
+    CHECK(revalidated.from_cache);
+    CHECK(revalidated.sha256 == result.sha256);
+    CHECK(SameFiles(revalidated.files, release));
+
+    // A new release under the same URL is downloaded again.
+    std::vector<ZipEntry> next = MakeRelease(2);
+    std::vector<uint8_t> next_zip = MakeZip(next);
+    server.SetBody(next_zip, "\"v2\"");
+    FetchResult updated;
+    CHECK(eager.Fetch(url, nullptr, &updated, &error));
+    CHECK(!updated.from_cache);
+    CHECK(updated.network_bytes == next_zip.size());
+    CHECK(updated.sha256 != result.sha256);
+    CHECK(SameFiles(updated.files, next));
+
+    server.Stop();
+    fs::remove_all(root);
+}
+
+static void TestResume() {
+    HttpStandIn server;
+    CHECK(server.Start());
+    std::vector<ZipEntry> release = MakeRelease(3);
+    std::vector<uint8_t> zip = MakeZip(release);
+    server.SetBody(zip, "\"r1\"");
+    const std::string root = FreshDir("resume");
+    const std::string url = server.Url("/wroombuild.zip");
+    ArtifactCache cache(root);
+
+    FetchResult result;
+    std::string error;
+    server.DropAfter(zip.size() / 2);
+    CHECK(!cache.Fetch(url, nullptr, &result, &error));
+    CHECK(!error.empty());
+    CHECK(result.network_bytes == zip.size() / 2);
+    CHECK(!Empty(fs::path(root) / "partial"));
+
+    // The second try only asks for the rest.
+    error.clear();
+    size_t sent = server.BodyBytesSent();
+    CHECK(cache.Fetch(url, nullptr, &result, &error));
+    CHECK(error.empty());
+    CHECK(server.LastStatus() == 206);
+    CHECK(server.BodyBytesSent() - sent == zip.size() - zip.size() / 2);
+    CHECK(result.network_bytes == zip.size() - zip.size() / 2);
+    CHECK(result.sha256 == Sha256Hex(zip.data(), zip.size()));
+    CHECK(SameFiles(result.files, release));
+    CHECK(Empty(fs::path(root) / "partial"));
+
+    // Interrupted, then the release changed: If-Range gets the whole new one.
+    const std::string other = server.Url("/s3build.zip");
+    server.DropAfter(zip.size() / 3);
+    CHECK(!cache.Fetch(other, nullptr, &result, &error));
+    std::vector<ZipEntry> next = MakeRelease(4);
+    std::vector<uint8_t> next_zip = MakeZip(next);
+    server.SetBody(next_zip, "\"r2\"");
+    error.clear();
+    CHECK(cache.Fetch(other, nullptr, &result, &error));
+    CHECK(error.empty());
+    CHECK(server.LastStatus() == 200);
+    CHECK(result.sha256 == Sha256Hex(next_zip.data(), next_zip.size()));
+    CHECK(SameFiles(result.files, next));
+
+    server.Stop();
+    fs::remove_all(root);
+}
+
+static void TestCorruptArchive() {
+    HttpStandIn server;
+    CHECK(server.Start());
+    std::vector<uint8_t> zip = MakeZip(MakeRelease(5));
+    zip[zip.size() / 2] ^= 0x5a;
+    server.SetBody(zip, "\"bad\"");
+    const std::string root = FreshDir("corrupt");
+    ArtifactCache cache(root);
+
+    FetchResult result;
+    std::string error;
+    CHECK(!cache.Fetch(server.Url("/s3build.zip"), nullptr, &result, &error));
+    CHECK(!error.empty());
+    CHECK(Empty(fs::path(root) / "objects"));
+    CHECK(Empty(fs::path(root) / "partial"));
+
+    // Truncated on the server side, with a length that matches: the last
+    // entry never completes.
+    std::vector<uint8_t> good = MakeZip(MakeRelease(5));
+    good.resize(good.size() * 3 / 5);
+    server.SetBody(good, "\"short\"");
+    error.clear();
+    CHECK(!cache.Fetch(server.Url("/s3build.zip"), nullptr, &result, &error));
+    CHECK(!error.empty());
+    CHECK(Empty(fs::path(root) / "objects"));
+
+    server.Stop();
+    fs::remove_all(root);
+}
+
+static void TestPlanFromArchive() {
+    std::vector<ZipEntry> release = MakeRelease(6);
+    FlashPlan plan;
+    std::string error;
+    CHECK(LoadFlashPlan(release, &plan, &error));
+    CHECK(plan.chip == "esp32s3");
+    CHECK(plan.flash_size == 8 * 1024 * 1024);
+    CHECK(plan.files.size() == 3);
+    if (plan.files.size() == 3) {
+        CHECK(plan.files[0].offset == 0x0 && plan.files[0].data == release[1].data);
+        CHECK(plan.files[1].offset == 0x8000 && plan.files[1].data == release[2].data);
+        CHECK(plan.files[2].offset == 0x10000 && plan.files[2].data == release[3].data);
+    }
+
+    release.pop_back();
+    CHECK(!LoadFlashPlan(release, &plan, &error));
+    CHECK(error == "cannot read build/hub.bin");
+}
+
+// Flashing streams out of the cached archive, nothing is kept unpacked.
+static void TestLayoutFromCache() {
+    HttpStandIn server;
+    CHECK(server.Start());
+    std::vector<ZipEntry> release = MakeRelease(7);
+    server.SetBody(MakeZip(release), "\"l1\"");
+    const std::string root = FreshDir("layout");
+    ArtifactCache cache(root);
+    cache.KeepFiles(false);
+
+    FetchResult result;
+    std::string error;
+    CHECK(cache.Fetch(server.Url("/s3build.zip"), nullptr, &result, &error));
+    CHECK(result.files.empty());
+    CHECK(fs::exists(result.archive));
+
+    FlashPlan plan;
+    CHECK(LoadFlashLayout(result.archive, &plan, &error));
+    CHECK(plan.archive == result.archive);
+    CHECK(plan.chip == "esp32s3");
+    CHECK(plan.files.size() == 3);
+    CHECK(plan.TotalBytes() == release[1].data.size() + release[2].data.size() + release[3].data.size());
+    if (plan.files.size() == 3) {
+        const FlashFile& app = plan.files[2];
+        CHECK(app.data.empty() && app.size == release[3].data.size());
+        CHECK(app.path == "build/hub.bin");
+        std::vector<uint8_t> data;
+        ZipDirEntry entry;
+        entry.name = app.path;
+        entry.local_offset = app.entry_offset;
+        CHECK(ReadZipEntry(result.archive, entry, [&](const uint8_t* p, size_t len) {
+            data.insert(data.end(), p, p + len);
+            return true;
+        }, &error));
+        CHECK(data == release[3].data);
+    }
+
+    server.Stop();
+    fs::remove_all(root);
+}
+
+int main() {
+    TestFetchAndRevalidate();
+    TestResume();
+    TestCorruptArchive();
+    TestPlanFromArchive();
+    TestLayoutFromCache();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("artifact_test passed\n");
+    return 0;
+}
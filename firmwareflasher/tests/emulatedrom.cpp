@@ -0,0 +1,284 @@
+#include "emulatedrom.hpp"
+
+#include "md5.hpp"
+#include "slip.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+uint32_t GetU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((v >> (8 * i)) & 0xFF);
+}
+
+}  // namespace
+
+EmulatedRom::EmulatedRom(size_t flash_size) : flash_(flash_size, 0xFF) {}
+
+EmulatedRom::~EmulatedRom() {
+    Stop();
+}
+
+bool EmulatedRom::Start() {
+    master_ = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0) {
+        return false;
+    }
+    slave_path_ = ptsname(master_);
+    termios tio{};
+    tcgetattr(master_, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master_, TCSANOW, &tio);
+    running_ = true;
+    thread_ = std::thread(&EmulatedRom::Run, this);
+    return true;
+}
+
+void EmulatedRom::Stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    if (master_ >= 0) {
+        close(master_);
+        master_ = -1;
+    }
+    if (inflate_) {
+        inflateEnd(static_cast<z_stream*>(inflate_));
+        delete static_cast<z_stream*>(inflate_);
+        inflate_ = nullptr;
+    }
+}
+
+void EmulatedRom::Run() {
+    SlipDecoder decoder;
+    uint8_t buf[4096];
+    while (running_) {
+        pollfd pfd{master_, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) continue;
+        // EIO until the loader has the slave side open.
+        ssize_t n = read(master_, buf, sizeof(buf));
+        if (n <= 0) {
+            usleep(1000);
+            continue;
+        }
+        int host = HostBaud();
+        if (host == 115200 && chip_baud_ != 115200) {
+            // Only a reset gets a real chip back to the ROM default.
+            chip_baud_ = 115200;
+            stub_ = false;
+            decoder.Reset();
+        }
+        if (host != chip_baud_ || chip_baud_ > max_baud_) {
+            continue;   // framing errors, nothing decodes
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (decoder.Feed(buf[i])) Handle(decoder.Frame());
+        }
+    }
+}
+
+int EmulatedRom::HostBaud() const {
+    termios tio{};
+    tcgetattr(master_, &tio);
+    switch (cfgetospeed(&tio)) {
+        case B921600: return 921600;
+        case B1500000: return 1500000;
+        case B2000000: return 2000000;
+        default: return 115200;
+    }
+}
+
+void EmulatedRom::Reply(uint8_t op, uint32_t value, const std::vector<uint8_t>& body, uint8_t error) {
+    std::vector<uint8_t> packet = {0x01, op, 0, 0};
+    PutU32(packet, value);
+    packet.insert(packet.end(), body.begin(), body.end());
+    packet.push_back(error ? 1 : 0);
+    packet.push_back(error);
+    if (!stub_) {
+        packet.push_back(0);
+        packet.push_back(0);
+    }
+    uint16_t size = static_cast<uint16_t>(packet.size() - 8);
+    packet[2] = size & 0xFF;
+    packet[3] = size >> 8;
+    Send(packet);
+}
+
+void EmulatedRom::Send(const std::vector<uint8_t>& packet) {
+    std::vector<uint8_t> framed;
+    SlipEncode(packet.data(), packet.size(), framed);
+    const uint8_t* p = framed.data();
+    size_t left = framed.size();
+    while (left > 0) {
+        ssize_t n = write(master_, p, left);
+        if (n <= 0) {
+            usleep(1000);
+            continue;
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+void EmulatedRom::Handle(const std::vector<uint8_t>& frame) {
+    if (frame.size() < 8 || frame[0] != 0x00) return;
+    uint8_t op = frame[1];
+    size_t len = frame[2] | (frame[3] << 8);
+    uint32_t checksum = GetU32(&frame[4]);
+    if (frame.size() != 8 + len) {
+        Reply(op, 0, {}, 0xC1);
+        return;
+    }
+    const uint8_t* data = frame.data() + 8;
+
+    switch (op) {
+        case 0x08:   // SYNC, answered several times like the real ROM
+            for (int i = 0; i < 4; i++) Reply(op, 0x20120707, {});
+            break;
+        case 0x0a: {  // READ_REG: ESP32-S3 chip detect magic and MAC eFuses
+            uint32_t addr = GetU32(data);
+            uint32_t value = 0;
+            if (addr == 0x40001000) value = 0x9;
+            if (addr == 0x60007044) value = 0x56abcdef;   // MAC 12:34:56:ab:cd:ef
+            if (addr == 0x60007048) value = 0x1234;
+            Reply(op, value, {});
+            break;
+        }
+        case 0x05:   // MEM_BEGIN
+            mem_left_ = GetU32(data);
+            mem_seq_ = 0;
+            Reply(op, 0, {});
+            break;
+        case 0x07: {  // MEM_DATA
+            uint32_t block_len = GetU32(data);
+            if (len != 16 + block_len) {
+                Reply(op, 0, {}, 0xC3);
+                break;
+            }
+            uint8_t sum = 0xEF;
+            for (uint32_t i = 0; i < block_len; i++) sum ^= data[16 + i];
+            if (sum != checksum || GetU32(data + 4) != mem_seq_ || block_len > mem_left_) {
+                Reply(op, 0, {}, 0xC3);
+                break;
+            }
+            mem_left_ -= block_len;
+            mem_seq_++;
+            Reply(op, 0, {});
+            break;
+        }
+        case 0x06:   // MEM_END: "run" the uploaded stub
+            if (mem_left_ != 0) {
+                Reply(op, 0, {}, 0xC5);
+                break;
+            }
+            Reply(op, 0, {});
+            stub_ = true;
+            Send({'O', 'H', 'A', 'I'});
+            break;
+        case 0x0f:   // CHANGE_BAUDRATE, answered at the old rate
+            if (GetU32(data + 4) != (stub_ ? static_cast<uint32_t>(chip_baud_) : 0)) {
+                Reply(op, 0, {}, 0xC6);
+                break;
+            }
+            Reply(op, 0, {});
+            chip_baud_ = static_cast<int>(GetU32(data));
+            break;
+        case 0x0b:   // SPI_SET_PARAMS
+            Reply(op, 0, {});
+            break;
+        case 0x0d:   // SPI_ATTACH, the stub takes the short form
+            Reply(op, 0, {}, len == (stub_ ? 4u : 8u) ? 0 : 0xC0);
+            break;
+        case 0x10: {  // FLASH_DEFL_BEGIN
+            // The S3 ROM takes a fifth word for encryption, the stub not.
+            if (len != (stub_ ? 16u : 20u)) {
+                Reply(op, 0, {}, 0xC0);
+                break;
+            }
+            uint32_t size = GetU32(data);
+            uint32_t offset = GetU32(data + 12);
+            // The ROM is given whole 0x400 write blocks to erase.
+            if (offset % 4096 != 0 || offset + size > flash_.size() || (!stub_ && size % 0x400 != 0)) {
+                Reply(op, 0, {}, 0xC2);
+                break;
+            }
+            uint32_t erase_end = (offset + size + 4095) & ~4095u;
+            std::memset(flash_.data() + offset, 0xFF, erase_end - offset);
+            if (inflate_) {
+                inflateEnd(static_cast<z_stream*>(inflate_));
+                delete static_cast<z_stream*>(inflate_);
+            }
+            z_stream* zs = new z_stream();
+            inflateInit(zs);
+            inflate_ = zs;
+            write_pos_ = offset;
+            write_end_ = offset + size;
+            next_seq_ = 0;
+            defl_begins_++;
+            Reply(op, 0, {});
+            break;
+        }
+        case 0x11: {  // FLASH_DEFL_DATA
+            uint32_t block_len = GetU32(data);
+            uint32_t seq = GetU32(data + 4);
+            const uint8_t* block = data + 16;
+            if (!inflate_ || len != 16 + block_len) {
+                Reply(op, 0, {}, 0xC3);
+                break;
+            }
+            uint8_t sum = 0xEF;
+            for (uint32_t i = 0; i < block_len; i++) sum ^= block[i];
+            if (sum != checksum || seq != next_seq_) {
+                Reply(op, 0, {}, 0xC3);
+                break;
+            }
+            z_stream* zs = static_cast<z_stream*>(inflate_);
+            zs->next_in = const_cast<uint8_t*>(block);
+            zs->avail_in = block_len;
+            zs->next_out = flash_.data() + write_pos_;
+            zs->avail_out = write_end_ - write_pos_;
+            int rc = inflate(zs, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END) {
+                Reply(op, 0, {}, 0xC4);
+                break;
+            }
+            uint32_t written = (write_end_ - write_pos_) - zs->avail_out;
+            if (corrupt_ && written > 0) flash_[write_pos_] ^= 0x01;
+            write_pos_ += written;
+            next_seq_++;
+            Reply(op, 0, {});
+            break;
+        }
+        case 0x12:   // FLASH_DEFL_END
+            Reply(op, 0, {});
+            break;
+        case 0x13: {  // SPI_FLASH_MD5: hex from the ROM, raw bytes from the stub
+            uint32_t addr = GetU32(data);
+            uint32_t size = GetU32(data + 4);
+            Md5 md5;
+            md5.Update(flash_.data() + addr, size);
+            if (stub_) {
+                std::vector<uint8_t> digest(16);
+                md5.Final(digest.data());
+                Reply(op, 0, digest);
+            } else {
+                std::string hex = md5.HexDigest();
+                Reply(op, 0, std::vector<uint8_t>(hex.begin(), hex.end()));
+            }
+            break;
+        }
+        default:
+            Reply(op, 0, {}, 0x05);
+            break;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef FIRMWAREFLASHER_TESTS_EMULATEDROM_HPP
+#define FIRMWAREFLASHER_TESTS_EMULATEDROM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ESP32-S3 ROM bootloader stand-in on the master side of a pseudo terminal.
+// The loader under test opens SlavePath() like a real serial device.
+class EmulatedRom {
+public:
+    explicit EmulatedRom(size_t flash_size = 4 * 1024 * 1024);
+    ~EmulatedRom();
+
+    bool Start();
+    void Stop();
+    const std::string& SlavePath() const { return slave_path_; }
+
+    // Only read once Stop() has joined the emulator thread.
+    std::vector<uint8_t>& Flash() { return flash_; }
+    // Flips a byte after each write so the MD5 verify has to catch it.
+    void CorruptWrites(bool on) { corrupt_ = on; }
+    int DeflBegins() const { return defl_begins_; }
+    // Highest rate the emulated USB bridge carries. Above it the link is
+    // garbage in both directions until the host resets the chip, which
+    // shows up here as the host going back to 115200.
+    void SetMaxBaud(int baud) { max_baud_ = baud; }
+    int ChipBaud() const { return chip_baud_; }
+    bool StubRunning() const { return stub_; }
+
+private:
+    void Run();
+    void Handle(const std::vector<uint8_t>& frame);
+    void Reply(uint8_t op, uint32_t value, const std::vector<uint8_t>& body, uint8_t error = 0);
+    void Send(const std::vector<uint8_t>& packet);
+    int HostBaud() const;
+
+    int master_ = -1;
+    std::string slave_path_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::vector<uint8_t> flash_;
+    std::atomic<bool> corrupt_{false};
+    std::atomic<int> defl_begins_{0};
+    std::atomic<int> max_baud_{2000000};
+    std::atomic<int> chip_baud_{115200};
+    std::atomic<bool> stub_{false};
+
+    // State of the running MEM_BEGIN.
+    uint32_t mem_left_ = 0;
+    uint32_t mem_seq_ = 0;
+
+    // State of the running FLASH_DEFL_BEGIN.
+    void* inflate_ = nullptr;
+    uint32_t write_pos_ = 0;
+    uint32_t write_end_ = 0;
+    uint32_t next_seq_ = 0;
+};
+
+#endif
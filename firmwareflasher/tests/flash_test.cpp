@@ -0,0 +1,423 @@
+// Runs the whole flash flow against EmulatedRom over a pty, no board needed.
+
+#include "batchflash.hpp"
+#include "emulatedrom.hpp"
+#include "esploader.hpp"
+#include "espstub.hpp"
+#include "flashplan.hpp"
+#include "serialport.hpp"
+#include "spscqueue.hpp"
+#include "testzip.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Firmware-like data: runs of code-ish bytes with some zero padding.
+static std::vector<uint8_t> MakeImage(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> image(size);
+    for (size_t i = 0; i < size; i++) {
+        image[i] = (i / 4096) % 3 == 0 ? 0 : static_cast<uint8_t>(rng() % 48);
+    }
+    return image;
+}
+
+static void TestFlashImage() {
+    EmulatedRom rom;
+    CHECK(rom.Start());
+    SerialPort port;
+    CHECK(port.Open(rom.SlavePath(), 115200));
+
+    EspLoader loader(port);
+    CHECK(loader.Connect());
+    CHECK(loader.Chip() == EspChip::Esp32S3);
+    CHECK(loader.SpiAttach());
+    CHECK(loader.SpiSetParams(4 * 1024 * 1024));
+
+    std::vector<uint8_t> image = MakeImage(DeflatedImage::kSliceSize * 2 + 1234, 1);
+    DeflatedImage deflated(image);
+    std::thread compressor([&] { deflated.Compress(); });
+    size_t last_done = 0;
+    bool monotonic = true;
+    bool ok = loader.FlashImage(0x10000, deflated, [&](size_t done, size_t) {
+        monotonic = monotonic && done >= last_done;
+        last_done = done;
+    });
+    compressor.join();
+    if (!ok) std::fprintf(stderr, "FlashImage: %s\n", loader.Error().c_str());
+    CHECK(ok);
+    CHECK(monotonic);
+    CHECK(rom.DeflBegins() == 3);
+
+    rom.CorruptWrites(true);
+    DeflatedImage small(MakeImage(8192, 2));
+    small.Compress();
+    CHECK(!loader.FlashImage(0x100000, small, nullptr));
+    CHECK(loader.Error().find("verify failed") != std::string::npos);
+
+    rom.Stop();
+    CHECK(std::memcmp(rom.Flash().data() + 0x10000, image.data(), image.size()) == 0);
+    // Padding to a whole word is left erased.
+    CHECK(rom.Flash()[0x10000 + image.size()] == 0xFF);
+}
+
+static void TestDiffFlash() {
+    EmulatedRom rom;
+    CHECK(rom.Start());
+    SerialPort port;
+    CHECK(port.Open(rom.SlavePath(), 115200));
+    EspLoader loader(port);
+    CHECK(loader.Connect());
+
+    std::vector<uint8_t> image = MakeImage(0x200000, 6);
+    DeflatedImage first(image);
+    first.Compress();
+    FlashImageStats stats;
+    CHECK(loader.FlashImage(0x10000, first, nullptr, &stats));
+    CHECK(stats.written == image.size() && stats.skipped == 0);
+
+    // Unchanged: one MD5 round trip, nothing written.
+    int begins = rom.DeflBegins();
+    CHECK(loader.FlashImage(0x10000, first, nullptr, &stats));
+    CHECK(stats.written == 0 && stats.skipped == image.size());
+    CHECK(rom.DeflBegins() == begins);
+
+    // A small code change touches two neighbouring sectors and one far away.
+    image[0x3000] ^= 0xFF;
+    image[0x4800] ^= 0xFF;
+    image[0x150010] ^= 0xFF;
+    DeflatedImage second(image);
+    second.Compress();
+    CHECK(loader.FlashImage(0x10000, second, nullptr, &stats));
+    CHECK(stats.written == 3 * EspLoader::kDiffFine);
+    CHECK(stats.skipped == image.size() - 3 * EspLoader::kDiffFine);
+    CHECK(stats.seconds_saved > 0);
+    // The two neighbours go out as one write.
+    CHECK(rom.DeflBegins() == begins + 2);
+
+    rom.Stop();
+    CHECK(std::memcmp(rom.Flash().data() + 0x10000, image.data(), image.size()) == 0);
+}
+
+static std::string WriteBuildDir(std::vector<uint8_t>* boot, std::vector<uint8_t>* table,
+                                 std::vector<uint8_t>* app) {
+    char dir_template[] = "/tmp/flashtestXXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    *boot = MakeImage(20000, 3);
+    *table = MakeImage(3072, 4);
+    *app = MakeImage(700000, 5);
+    auto write = [&](const std::string& name, const std::vector<uint8_t>& data) {
+        std::ofstream(dir + "/" + name, std::ios::binary)
+            .write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    write("bootloader.bin", *boot);
+    write("partition-table.bin", *table);
+    write("app.bin", *app);
+    std::ofstream(dir + "/flasher_args.json") << R"({
+    "write_flash_args" : [ "--flash_mode", "dio", "--flash_size", "4MB" ],
+    "flash_settings" : { "flash_mode": "dio", "flash_size": "4MB", "flash_freq": "80m" },
+    "flash_files" : {
+        "0x0" : "bootloader.bin",
+        "0x8000" : "partition-table.bin",
+        "0x10000" : "app.bin"
+    },
+    "extra_esptool_args" : { "after" : "hard_reset", "before" : "default_reset", "chip" : "esp32s3" }
+})";
+    return dir;
+}
+
+static bool SameFlash(EmulatedRom& rom, const std::vector<uint8_t>& boot, const std::vector<uint8_t>& table,
+                      const std::vector<uint8_t>& app) {
+    return std::memcmp(rom.Flash().data(), boot.data(), boot.size()) == 0 &&
+           std::memcmp(rom.Flash().data() + 0x8000, table.data(), table.size()) == 0 &&
+           std::memcmp(rom.Flash().data() + 0x10000, app.data(), app.size()) == 0;
+}
+
+static void TestFlashBoard() {
+    std::vector<uint8_t> boot, table, app;
+    std::string dir = WriteBuildDir(&boot, &table, &app);
+
+    FlashPlan plan;
+    std::string error;
+    CHECK(LoadFlashPlan(dir, &plan, &error));
+    CHECK(plan.files.size() == 3);
+    CHECK(plan.chip == "esp32s3");
+    CHECK(plan.flash_size == 4 * 1024 * 1024);
+
+    EmulatedRom rom;
+    CHECK(rom.Start());
+    FlashStatus last;
+    DeflateCache cache(plan);
+    bool ok = FlashBoard(rom.SlavePath(), plan, cache, FlashOptions(), [&](const FlashStatus& s) { last = s; }, &error);
+    if (!ok) std::fprintf(stderr, "FlashBoard: %s\n", error.c_str());
+    CHECK(ok);
+    CHECK(last.stage == "Done" && last.done == last.total);
+    CHECK(last.verified == 3);
+    rom.Stop();
+    CHECK(SameFlash(rom, boot, table, app));
+
+    std::system(("rm -rf " + dir).c_str());
+}
+
+static std::string Base64Encode(const std::vector<uint8_t>& data) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t n = data[i] << 16;
+        if (i + 1 < data.size()) n |= data[i + 1] << 8;
+        if (i + 2 < data.size()) n |= data[i + 2];
+        out += digits[(n >> 18) & 63];
+        out += digits[(n >> 12) & 63];
+        out += i + 1 < data.size() ? digits[(n >> 6) & 63] : '=';
+        out += i + 2 < data.size() ? digits[n & 63] : '=';
+    }
+    return out;
+}
+
+static void TestStubFile() {
+    std::vector<uint8_t> text = MakeImage(10001, 7);
+    CHECK(Base64Decode(Base64Encode(text)) == text);
+    CHECK(Base64Decode("T0hBSQ==") == (std::vector<uint8_t>{'O', 'H', 'A', 'I'}));
+}
+
+// Runs FlashBoard against a bridge that tops out at max_baud.
+static void CheckNegotiation(int max_baud, bool with_stub, const std::vector<int>& expect_failed, int expect_baud) {
+    std::vector<uint8_t> boot, table, app;
+    std::string dir = WriteBuildDir(&boot, &table, &app);
+    FlashPlan plan;
+    std::string error;
+    CHECK(LoadFlashPlan(dir, &plan, &error));
+
+    FlashOptions options;
+    if (with_stub) {
+        options.stub_dir = dir;
+        std::ofstream(dir + "/stub_flasher_32s3.json")
+            << "{\n    \"entry\": 1077413304,\n    \"text\": \"" << Base64Encode(MakeImage(9000, 8))
+            << "\",\n    \"text_start\": 1077379072,\n    \"data\": \"" << Base64Encode(MakeImage(300, 9))
+            << "\",\n    \"data_start\": 1070279676,\n    \"bss_start\": 1070131200\n}\n";
+    }
+
+    EmulatedRom rom;
+    rom.SetMaxBaud(max_baud);
+    CHECK(rom.Start());
+    DeflateCache cache(plan);
+    FlashStatus last;
+    bool ok = FlashBoard(rom.SlavePath(), plan, cache, options, [&](const FlashStatus& s) { last = s; }, &error);
+    if (!ok) std::fprintf(stderr, "FlashBoard at max %d: %s\n", max_baud, error.c_str());
+    CHECK(ok);
+    CHECK(last.baud == expect_baud);
+    CHECK(last.stub == with_stub);
+    CHECK(rom.StubRunning() == with_stub);
+    CHECK(rom.ChipBaud() == expect_baud);
+    CHECK(last.wire_rate > 0);
+
+    std::vector<int> failed;
+    for (const BaudTrial& trial : last.trials) {
+        if (!trial.ok) failed.push_back(trial.baud);
+        if (trial.ok) CHECK(trial.baud == expect_baud && trial.probe_rate > 0);
+    }
+    CHECK(failed == expect_failed);
+
+    rom.Stop();
+    CHECK(SameFlash(rom, boot, table, app));
+    std::system(("rm -rf " + dir).c_str());
+}
+
+static void TestBaudNegotiation() {
+    CheckNegotiation(2000000, false, {}, 2000000);
+    CheckNegotiation(1500000, false, {2000000}, 1500000);
+    CheckNegotiation(921600, true, {2000000, 1500000}, 921600);
+    CheckNegotiation(115200, true, {2000000, 1500000, 921600}, 115200);
+}
+
+static void TestBatchFlash() {
+    std::vector<uint8_t> boot, table, app;
+    std::string dir = WriteBuildDir(&boot, &table, &app);
+    FlashPlan plan;
+    std::string error;
+    CHECK(LoadFlashPlan(dir, &plan, &error));
+
+    EmulatedRom roms[3];
+    std::vector<std::string> ports;
+    for (EmulatedRom& rom : roms) {
+        CHECK(rom.Start());
+        ports.push_back(rom.SlavePath());
+    }
+
+    std::atomic<int> updates{0};
+    std::vector<PortJob> jobs;
+    {
+        BatchFlash batch(plan, ports, FlashOptions(), [&] { updates++; });
+        while (batch.Running()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        jobs = batch.Snapshot();
+    }
+    CHECK(jobs.size() == 3);
+    for (const PortJob& job : jobs) {
+        if (!job.ok) std::fprintf(stderr, "%s: %s\n", job.port.c_str(), job.error.c_str());
+        CHECK(job.finished && job.ok);
+        CHECK(job.status.verified == 3);
+    }
+    for (EmulatedRom& rom : roms) {
+        rom.Stop();
+        CHECK(SameFlash(rom, boot, table, app));
+    }
+    CHECK(updates > 0);
+
+    std::system(("rm -rf " + dir).c_str());
+}
+
+static void TestSpscQueue() {
+    SpscQueue<std::vector<uint32_t>> queue(5);
+    CHECK(queue.Capacity() == 8);
+    const uint32_t count = 200000;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; i++) {
+            std::vector<uint32_t>* slot;
+            while (!(slot = queue.Back())) std::this_thread::yield();
+            slot->assign(1 + i % 3, i);
+            queue.Push();
+        }
+        queue.Close();
+    });
+    uint32_t expect = 0;
+    bool in_order = true;
+    while (true) {
+        std::vector<uint32_t>* slot = queue.Front();
+        if (!slot) {
+            if (queue.Drained()) break;
+            std::this_thread::yield();
+            continue;
+        }
+        in_order = in_order && slot->size() == 1 + expect % 3 && slot->front() == expect;
+        expect++;
+        queue.Pop();
+    }
+    producer.join();
+    CHECK(in_order);
+    CHECK(expect == count);
+}
+
+// Build folder and release archive both stream through the pipeline,
+// no file is held in memory by the plan.
+static void TestStreamFlash() {
+    std::vector<uint8_t> boot, table, app;
+    std::string dir = WriteBuildDir(&boot, &table, &app);
+    std::ifstream args_file(dir + "/flasher_args.json");
+    std::string args((std::istreambuf_iterator<char>(args_file)), std::istreambuf_iterator<char>());
+    std::vector<uint8_t> zip = MakeZip({
+        {"build/flasher_args.json", std::vector<uint8_t>(args.begin(), args.end())},
+        {"build/bootloader.bin", boot},
+        {"build/partition-table.bin", table},
+        {"build/app.bin", app},
+    });
+    const std::string archive = dir + "/release.zip";
+    std::ofstream(archive, std::ios::binary).write(reinterpret_cast<const char*>(zip.data()), zip.size());
+
+    for (const std::string& source : {dir, archive}) {
+        FlashPlan plan;
+        std::string error;
+        CHECK(LoadFlashLayout(source, &plan, &error));
+        CHECK(plan.files.size() == 3);
+        CHECK(plan.TotalBytes() == boot.size() + table.size() + app.size());
+        for (const FlashFile& file : plan.files) CHECK(file.data.empty());
+
+        EmulatedRom rom;
+        CHECK(rom.Start());
+        DeflateCache cache(plan);
+        FlashStatus last;
+        bool ok = FlashBoard(rom.SlavePath(), plan, cache, FlashOptions(), [&](const FlashStatus& s) { last = s; },
+                             &error);
+        if (!ok) std::fprintf(stderr, "stream from %s: %s\n", source.c_str(), error.c_str());
+        CHECK(ok);
+        CHECK(last.stage == "Done" && last.verified == 3);
+        // Stats of the last file, the app: every stage saw all of it.
+        const size_t app_padded = (app.size() + 3) & ~size_t(3);
+        CHECK(last.pipeline.read.bytes == app.size());
+        CHECK(last.pipeline.deflate.bytes == app_padded);
+        CHECK(last.pipeline.write.bytes == app_padded);
+        CHECK(std::string(last.pipeline.Bottleneck()) != "");
+        rom.Stop();
+        CHECK(SameFlash(rom, boot, table, app));
+    }
+
+    // Diffing works per 64 KiB segment: one changed segment, one write.
+    {
+        FlashPlan plan;
+        std::string error;
+        CHECK(LoadFlashLayout(dir, &plan, &error));
+        EmulatedRom rom;
+        CHECK(rom.Start());
+        DeflateCache cache(plan);
+        FlashOptions options;
+        CHECK(FlashBoard(rom.SlavePath(), plan, cache, options, nullptr, &error));
+        int begins = rom.DeflBegins();
+
+        app[300000] ^= 0xFF;
+        std::ofstream(dir + "/app.bin", std::ios::binary).write(reinterpret_cast<const char*>(app.data()), app.size());
+        FlashStatus last;
+        bool ok = FlashBoard(rom.SlavePath(), plan, cache, options, [&](const FlashStatus& s) { last = s; }, &error);
+        if (!ok) std::fprintf(stderr, "stream diff: %s\n", error.c_str());
+        CHECK(ok);
+        CHECK(rom.DeflBegins() == begins + 1);
+        CHECK(last.skipped == boot.size() + table.size() + app.size() - 0x10000);
+        rom.Stop();
+        CHECK(SameFlash(rom, boot, table, app));
+    }
+
+    // A corrupt archive fails the file instead of flashing garbage.
+    zip[zip.size() - 4096] ^= 0x5a;
+    std::ofstream(archive, std::ios::binary).write(reinterpret_cast<const char*>(zip.data()), zip.size());
+    {
+        FlashPlan plan;
+        std::string error;
+        CHECK(LoadFlashLayout(archive, &plan, &error));
+        EmulatedRom rom;
+        CHECK(rom.Start());
+        DeflateCache cache(plan);
+        CHECK(!FlashBoard(rom.SlavePath(), plan, cache, FlashOptions(), nullptr, &error));
+        CHECK(error.find("CRC mismatch") != std::string::npos);
+        rom.Stop();
+    }
+
+    std::system(("rm -rf " + dir).c_str());
+}
+
+int main() {
+    TestFlashImage();
+    TestDiffFlash();
+    TestFlashBoard();
+    TestBatchFlash();
+    TestStubFile();
+    TestBaudNegotiation();
+    TestSpscQueue();
+    TestStreamFlash();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("flash_test passed\n");
+    return 0;
+}
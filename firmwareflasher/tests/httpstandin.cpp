@@ -0,0 +1,162 @@
+#include "httpstandin.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string Header(const std::string& head, const std::string& name) {
+    std::string lower = head;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    size_t at = lower.find("\r\n" + name + ":");
+    if (at == std::string::npos) return "";
+    size_t begin = at + name.size() + 3;
+    size_t end = head.find("\r\n", begin);
+    std::string value = head.substr(begin, end - begin);
+    value.erase(0, value.find_first_not_of(' '));
+    return value;
+}
+
+bool SendAll(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}  // namespace
+
+HttpStandIn::~HttpStandIn() { Stop(); }
+
+bool HttpStandIn::Start() {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) return false;
+    int yes = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 4) != 0 ||
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    running_ = true;
+    thread_ = std::thread([this] { Run(); });
+    return true;
+}
+
+void HttpStandIn::Stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+std::string HttpStandIn::Url(const std::string& path) const {
+    return "http://127.0.0.1:" + std::to_string(port_) + path;
+}
+
+void HttpStandIn::SetBody(std::vector<uint8_t> body, std::string etag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = std::move(body);
+    etag_ = std::move(etag);
+}
+
+void HttpStandIn::Run() {
+    while (running_) {
+        pollfd pfd{listen_fd_, POLLIN, 0};
+        if (::poll(&pfd, 1, 50) <= 0) continue;
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        Serve(fd);
+        ::close(fd);
+    }
+}
+
+// One request per connection, answered with "Connection: close".
+void HttpStandIn::Serve(int fd) {
+    std::string head;
+    char buf[1024];
+    while (head.find("\r\n\r\n") == std::string::npos) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 2000) <= 0) return;
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        head.append(buf, static_cast<size_t>(n));
+    }
+    requests_++;
+
+    std::string method, path;
+    std::istringstream(head) >> method >> path;
+
+    std::vector<uint8_t> body;
+    std::string etag;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body = body_;
+        etag = etag_;
+    }
+
+    std::ostringstream out;
+    if (path.rfind("/redirect/", 0) == 0) {
+        last_status_ = 302;
+        out << "HTTP/1.1 302 Found\r\nLocation: " << path.substr(9)
+            << "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        SendAll(fd, out.str().data(), out.str().size());
+        return;
+    }
+    if (Header(head, "if-none-match") == etag) {
+        last_status_ = 304;
+        out << "HTTP/1.1 304 Not Modified\r\nETag: " << etag << "\r\nConnection: close\r\n\r\n";
+        SendAll(fd, out.str().data(), out.str().size());
+        return;
+    }
+
+    size_t from = 0;
+    std::string range = Header(head, "range");
+    std::string if_range = Header(head, "if-range");
+    if (range.rfind("bytes=", 0) == 0 && (if_range.empty() || if_range == etag)) {
+        from = std::stoul(range.substr(6));
+        if (from >= body.size()) {
+            last_status_ = 416;
+            out << "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" << body.size()
+                << "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            SendAll(fd, out.str().data(), out.str().size());
+            return;
+        }
+    }
+    if (from > 0) {
+        last_status_ = 206;
+        out << "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " << from << "-" << body.size() - 1 << "/"
+            << body.size() << "\r\n";
+    } else {
+        last_status_ = 200;
+        out << "HTTP/1.1 200 OK\r\n";
+    }
+    out << "ETag: " << etag << "\r\nContent-Length: " << body.size() - from
+        << "\r\nContent-Type: application/zip\r\nConnection: close\r\n\r\n";
+    if (!SendAll(fd, out.str().data(), out.str().size())) return;
+
+    size_t count = body.size() - from;
+    size_t drop = drop_after_.exchange(0);
+    if (drop > 0 && drop < count) count = drop;
+    if (SendAll(fd, body.data() + from, count)) body_sent_ += count;
+}
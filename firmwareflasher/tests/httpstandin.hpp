@@ -0,0 +1,51 @@
+#ifndef FIRMWAREFLASHER_TESTS_HTTPSTANDIN_HPP
+#define FIRMWAREFLASHER_TESTS_HTTPSTANDIN_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Release server stand-in on 127.0.0.1. Serves one archive with an ETag and
+// honours Range, If-Range and If-None-Match the way GitHub's asset storage
+// does. Paths starting with /redirect/ answer 302 to the rest of the path.
+class HttpStandIn {
+public:
+    HttpStandIn() = default;
+    ~HttpStandIn();
+
+    bool Start();
+    void Stop();
+    std::string Url(const std::string& path) const;
+
+    void SetBody(std::vector<uint8_t> body, std::string etag);
+    // The next 200/206 response closes the connection after this many body
+    // bytes, once.
+    void DropAfter(size_t bytes) { drop_after_ = bytes; }
+
+    size_t BodyBytesSent() const { return body_sent_; }
+    int Requests() const { return requests_; }
+    int LastStatus() const { return last_status_; }
+
+private:
+    void Run();
+    void Serve(int fd);
+
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;
+    std::vector<uint8_t> body_;
+    std::string etag_;
+
+    std::atomic<size_t> drop_after_{0};
+    std::atomic<size_t> body_sent_{0};
+    std::atomic<int> requests_{0};
+    std::atomic<int> last_status_{0};
+};
+
+#endif
@@ -0,0 +1,136 @@
+// Child processes through JobRunner: output, exit codes, several at once
+// and cancellation, all without the caller ever blocking.
+
+#include "jobrunner.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static JobStatus Find(const JobRunner& runner, int id) {
+    for (const JobStatus& job : runner.Snapshot()) {
+        if (job.id == id) return job;
+    }
+    return JobStatus();
+}
+
+static bool WaitDone(const JobRunner& runner, int id, int timeout_ms = 5000) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < until) {
+        if (!Find(runner, id).running) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+}
+
+static std::vector<std::string> Output(JobRunner& runner, int id) {
+    std::vector<std::string> out;
+    runner.WithOutput(id, [&](Scrollback& output) {
+        std::vector<LogLine> lines;
+        output.Copy(0, output.Count(), &lines);
+        for (const LogLine& line : lines) out.push_back(line.text);
+    });
+    return out;
+}
+
+static void TestOutputAndExit() {
+    std::atomic<int> updates{0};
+    JobRunner runner([&] { updates++; });
+    std::string error;
+    int id = runner.Start("script", {"sh", "-c", "echo out; echo err >&2; printf '10%%\\r50%%\\r'; exit 3"}, &error);
+    CHECK(id > 0);
+    CHECK(WaitDone(runner, id));
+    JobStatus job = Find(runner, id);
+    CHECK(job.exit_code == 3 && !job.cancelled);
+    CHECK(job.last_line == "50%");
+    std::vector<std::string> lines = Output(runner, id);
+    CHECK(lines == std::vector<std::string>({"out", "err"}));
+    CHECK(updates > 0);
+    CHECK(!runner.Running());
+
+    // Depending on the libc a missing program fails the spawn or exits 127.
+    int missing = runner.Start("missing", {"no-such-program-here"}, &error);
+    CHECK(missing == 0 || (WaitDone(runner, missing) && Find(runner, missing).exit_code == 127));
+    CHECK(runner.Start("empty", {}, &error) == 0);
+}
+
+static void TestConcurrent() {
+    JobRunner runner(nullptr);
+    std::string error;
+    std::vector<int> ids;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; i++) {
+        std::string script = "for n in 1 2 3 4 5; do echo job" + std::to_string(i) + " $n; sleep 0.1; done";
+        ids.push_back(runner.Start("job" + std::to_string(i), {"sh", "-c", script}, &error));
+    }
+    // Start() returns straight away, the jobs run side by side.
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+    CHECK(runner.Running());
+    for (size_t i = 0; i < ids.size(); i++) {
+        CHECK(WaitDone(runner, ids[i]));
+        std::vector<std::string> lines = Output(runner, ids[i]);
+        CHECK(lines.size() == 5);
+        CHECK(!lines.empty() && lines.back() == "job" + std::to_string(i) + " 5");
+        CHECK(Find(runner, ids[i]).exit_code == 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(seconds < 1.5);
+}
+
+static void TestCancel() {
+    JobRunner runner(nullptr);
+    std::string error;
+    // The grandchild sleep shares the pipe, cancel has to reach it too.
+    int id = runner.Start("sleeper", {"sh", "-c", "sleep 30 & sleep 30; echo never"}, &error);
+    CHECK(id > 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto start = std::chrono::steady_clock::now();
+    CHECK(runner.Cancel(id));
+    CHECK(!runner.Cancel(id));
+    CHECK(WaitDone(runner, id, 3000));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    JobStatus job = Find(runner, id);
+    CHECK(job.cancelled && job.exit_code == 128 + 15);
+
+    // Ignoring SIGTERM only buys the grace period.
+    id = runner.Start("stubborn", {"sh", "-c", "trap '' TERM; sleep 30"}, &error);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    start = std::chrono::steady_clock::now();
+    runner.CancelAll();
+    CHECK(WaitDone(runner, id, JobRunner::kKillGraceMs + 2000));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(JobRunner::kKillGraceMs - 100));
+    CHECK(Find(runner, id).exit_code == 128 + 9);
+
+    // Whatever still runs when the runner goes away is killed and reaped.
+    JobRunner* scoped = new JobRunner(nullptr);
+    CHECK(scoped->Start("orphan", {"sleep", "30"}, &error) > 0);
+    start = std::chrono::steady_clock::now();
+    delete scoped;
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
+
+int main() {
+    TestOutputAndExit();
+    TestConcurrent();
+    TestCancel();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("job_test passed\n");
+    return 0;
+}
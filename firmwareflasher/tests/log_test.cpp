@@ -0,0 +1,211 @@
+// dlog frames built here the way the firmwares' dlog.cpp writes them, fed
+// through LogDecoder in pieces, with the format strings in a small ELF.
+
+#include "logdecoder.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static const uint32_t kRodata = 0x3f400020;
+
+static void Put(std::vector<uint8_t>& out, size_t at, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) out[at + i] = (v >> (8 * i)) & 0xFF;
+}
+
+// Argument encodings as dlog.h's dlogput makes them.
+static void Int(std::vector<uint8_t>& args, int32_t v) {
+    args.push_back('i');
+    for (int i = 0; i < 4; i++) args.push_back((static_cast<uint32_t>(v) >> (8 * i)) & 0xFF);
+}
+
+static void Long(std::vector<uint8_t>& args, int64_t v) {
+    args.push_back('I');
+    for (int i = 0; i < 8; i++) args.push_back((static_cast<uint64_t>(v) >> (8 * i)) & 0xFF);
+}
+
+static void Double(std::vector<uint8_t>& args, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, 8);
+    args.push_back('d');
+    for (int i = 0; i < 8; i++) args.push_back((bits >> (8 * i)) & 0xFF);
+}
+
+static void String(std::vector<uint8_t>& args, const std::string& s) {
+    args.push_back('s');
+    args.push_back(static_cast<uint8_t>(s.size()));
+    args.insert(args.end(), s.begin(), s.end());
+}
+
+static std::vector<uint8_t> Frame(uint32_t address, const std::vector<uint8_t>& args) {
+    std::vector<uint8_t> frame(11, 0);
+    frame[0] = LogDecoder::kFrameStart;
+    frame[1] = static_cast<uint8_t>(9 + args.size());
+    Put(frame, 2, address, 4);
+    Put(frame, 6, 123456, 4);
+    frame[10] = 1;
+    frame.insert(frame.end(), args.begin(), args.end());
+    frame.push_back(Crc8(frame.data() + 1, frame.size() - 1));
+    return frame;
+}
+
+// ELF32 with the format strings in .flash.rodata at kRodata, then
+// .shstrtab. Returns each string's address in addresses.
+static std::vector<uint8_t> MakeElf(const std::vector<std::string>& strings, std::vector<uint32_t>* addresses) {
+    std::vector<uint8_t> rodata;
+    for (const std::string& s : strings) {
+        addresses->push_back(kRodata + static_cast<uint32_t>(rodata.size()));
+        rodata.insert(rodata.end(), s.begin(), s.end());
+        rodata.push_back(0);
+    }
+    const std::string shstr = std::string("\0.flash.rodata\0.shstrtab\0", 25);
+    std::vector<uint8_t> elf(52, 0);
+    const uint32_t rodata_off = static_cast<uint32_t>(elf.size());
+    elf.insert(elf.end(), rodata.begin(), rodata.end());
+    const uint32_t shstr_off = static_cast<uint32_t>(elf.size());
+    elf.insert(elf.end(), shstr.begin(), shstr.end());
+    while (elf.size() % 4) elf.push_back(0);
+    const uint32_t shoff = static_cast<uint32_t>(elf.size());
+    elf.resize(shoff + 40 * 3, 0);
+
+    const uint8_t ident[] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::memcpy(elf.data(), ident, sizeof(ident));
+    Put(elf, 16, 2, 2);
+    Put(elf, 18, 94, 2);
+    Put(elf, 32, shoff, 4);
+    Put(elf, 46, 40, 2);
+    Put(elf, 48, 3, 2);
+    Put(elf, 50, 2, 2);
+    size_t at = shoff + 40;
+    Put(elf, at, 1, 4);
+    Put(elf, at + 4, 1, 4);       // SHT_PROGBITS
+    Put(elf, at + 8, 0x2, 4);     // SHF_ALLOC
+    Put(elf, at + 12, kRodata, 4);
+    Put(elf, at + 16, rodata_off, 4);
+    Put(elf, at + 20, static_cast<uint32_t>(rodata.size()), 4);
+    at += 40;
+    Put(elf, at, 15, 4);
+    Put(elf, at + 4, 3, 4);
+    Put(elf, at + 16, shstr_off, 4);
+    Put(elf, at + 20, static_cast<uint32_t>(shstr.size()), 4);
+    return elf;
+}
+
+static std::string FeedAll(LogDecoder& decoder, const std::vector<uint8_t>& bytes, size_t chunk) {
+    std::string out;
+    for (size_t at = 0; at < bytes.size(); at += chunk) {
+        decoder.Feed(bytes.data() + at, std::min(chunk, bytes.size() - at), &out);
+    }
+    return out;
+}
+
+static void TestFormat() {
+    std::vector<uint8_t> args;
+    Int(args, -5);
+    Int(args, 0xfffffffb);
+    Long(args, 1234567890123LL);
+    Double(args, 2.5);
+    String(args, "DOOR");
+    Int(args, 'x');
+    CHECK(FormatRecord("%d %u %lld %.2f [%-6s] %c %% end\n", args.data(), args.size()) ==
+          "-5 4294967291 1234567890123 2.50 [DOOR  ] x % end\n");
+    // Length modifiers follow the tag, not the format.
+    args.clear();
+    Int(args, 255);
+    Long(args, -1);
+    CHECK(FormatRecord("%hhx %ld", args.data(), args.size()) == "ff -1");
+    // More conversions than arguments, or an argument cut short.
+    CHECK(FormatRecord("%d and %d", args.data(), 5) == "255 and <?>");
+    CHECK(FormatRecord("%s", args.data(), 3) == "<?>");
+    CHECK(FormatRecord("plain", nullptr, 0) == "plain");
+}
+
+static void TestDecode() {
+    const std::string dir = "log_test_" + std::to_string(getpid());
+    std::filesystem::create_directories(dir);
+    std::vector<uint32_t> addresses;
+    std::vector<uint8_t> elf = MakeElf({"Received: %s\r\n", "temp %d.%d C\n"}, &addresses);
+    {
+        std::ofstream out(dir + "/sensor.elf", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(elf.data()), static_cast<std::streamsize>(elf.size()));
+    }
+
+    LogDecoder decoder;
+    std::string error;
+    CHECK(!decoder.LoadElf(dir + "/missing.elf", &error));
+    CHECK(!decoder.HasElf());
+    CHECK(decoder.LoadElf(dir, &error));
+    CHECK(decoder.HasElf() && decoder.ElfPath() == dir + "/sensor.elf");
+
+    std::vector<uint8_t> args;
+    String(args, "INTRUDER INTRUDER 7");
+    std::vector<uint8_t> received = Frame(addresses[0], args);
+    args.clear();
+    Int(args, 21);
+    Int(args, 5);
+    std::vector<uint8_t> temp = Frame(addresses[1], args);
+    args.clear();
+    Int(args, 3);
+    std::vector<uint8_t> dropped = Frame(0, args);
+
+    std::string boot = "ets Jun  8 2016 00:22:57\r\nrst:0x1\r\n";
+    std::vector<uint8_t> stream(boot.begin(), boot.end());
+    stream.insert(stream.end(), received.begin(), received.end());
+    stream.insert(stream.end(), temp.begin(), temp.end());
+    stream.push_back('1');
+    stream.insert(stream.end(), dropped.begin(), dropped.end());
+    std::string want = boot + "Received: INTRUDER INTRUDER 7\r\ntemp 21.5 C\n1dlog: 3 records dropped\n";
+
+    // Every split of the stream comes out the same.
+    for (size_t chunk : {stream.size(), size_t{1}, size_t{2}, size_t{7}, size_t{13}}) {
+        LogDecoder split;
+        CHECK(split.LoadElf(dir + "/sensor.elf", &error));
+        CHECK(FeedAll(split, stream, chunk) == want);
+        CHECK(split.Records() == 3 && split.BadFrames() == 0);
+    }
+
+    // A corrupted frame is dropped and the decoder finds the next one.
+    std::vector<uint8_t> bad = received;
+    bad[14] ^= 0x20;
+    std::vector<uint8_t> resync(bad);
+    resync.insert(resync.end(), temp.begin(), temp.end());
+    std::string out = FeedAll(decoder, resync, 4);
+    CHECK(decoder.BadFrames() == 1);
+    CHECK(out.size() >= 12 && out.compare(out.size() - 12, 12, "temp 21.5 C\n") == 0);
+
+    // Without the ELF, or with a different build's, the address and the
+    // arguments still show.
+    LogDecoder bare;
+    CHECK(FeedAll(bare, temp, temp.size()) == "[dlog 0x3f40002f] 21 5\n");
+    CHECK(bare.UnknownFormats() == 1);
+    CHECK(FeedAll(bare, received, 3) == "[dlog 0x3f400020] \"INTRUDER INTRUDER 7\"\n");
+
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    TestFormat();
+    TestDecode();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("log_test passed\n");
+    return 0;
+}
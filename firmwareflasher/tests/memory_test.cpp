@@ -0,0 +1,360 @@
+// ELF, linker map and the memory tree built from them, on a small
+// Xtensa-like build written here byte by byte.
+
+#include "memoryreport.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+struct TestSection {
+    std::string name;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t addr;
+    uint32_t size;
+};
+
+struct TestSymbol {
+    std::string name;
+    uint8_t type;                 // STT_*
+    uint16_t section;
+    uint32_t value;
+    uint32_t size;
+};
+
+static void Put(std::vector<uint8_t>& out, size_t at, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) out[at + i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint32_t AddString(std::vector<uint8_t>& table, const std::string& s) {
+    uint32_t at = static_cast<uint32_t>(table.size());
+    table.insert(table.end(), s.begin(), s.end());
+    table.push_back(0);
+    return at;
+}
+
+// ELF32 little endian: the given sections after the null one, then
+// .symtab, .strtab and .shstrtab. Section contents are left out, only the
+// headers and tables matter here.
+static std::vector<uint8_t> MakeElf(const std::vector<TestSection>& sections, const std::vector<TestSymbol>& symbols) {
+    std::vector<uint8_t> shstr(1, 0);
+    std::vector<uint8_t> str(1, 0);
+    std::vector<uint8_t> symtab(16, 0);
+    for (const TestSymbol& s : symbols) {
+        size_t at = symtab.size();
+        symtab.resize(at + 16);
+        Put(symtab, at, AddString(str, s.name), 4);
+        Put(symtab, at + 4, s.value, 4);
+        Put(symtab, at + 8, s.size, 4);
+        symtab[at + 12] = 0x10 | s.type;   // STB_GLOBAL
+        Put(symtab, at + 14, s.section, 2);
+    }
+    const uint32_t shnum = static_cast<uint32_t>(sections.size()) + 4;
+    const uint32_t symtab_index = shnum - 3;
+    std::vector<uint32_t> names;
+    for (const TestSection& s : sections) names.push_back(AddString(shstr, s.name));
+    uint32_t symtab_name = AddString(shstr, ".symtab");
+    uint32_t strtab_name = AddString(shstr, ".strtab");
+    uint32_t shstrtab_name = AddString(shstr, ".shstrtab");
+
+    std::vector<uint8_t> elf(52, 0);
+    const uint32_t symtab_off = static_cast<uint32_t>(elf.size());
+    elf.insert(elf.end(), symtab.begin(), symtab.end());
+    const uint32_t str_off = static_cast<uint32_t>(elf.size());
+    elf.insert(elf.end(), str.begin(), str.end());
+    const uint32_t shstr_off = static_cast<uint32_t>(elf.size());
+    elf.insert(elf.end(), shstr.begin(), shstr.end());
+    while (elf.size() % 4) elf.push_back(0);
+    const uint32_t shoff = static_cast<uint32_t>(elf.size());
+    elf.resize(shoff + 40 * shnum, 0);
+
+    const uint8_t ident[] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::memcpy(elf.data(), ident, sizeof(ident));
+    Put(elf, 16, 2, 2);           // ET_EXEC
+    Put(elf, 18, 94, 2);          // EM_XTENSA
+    Put(elf, 20, 1, 4);
+    Put(elf, 32, shoff, 4);
+    Put(elf, 40, 52, 2);
+    Put(elf, 46, 40, 2);
+    Put(elf, 48, shnum, 2);
+    Put(elf, 50, shnum - 1, 2);
+
+    auto header = [&](uint32_t index, uint32_t name, uint32_t type, uint32_t flags, uint32_t addr, uint32_t offset,
+                      uint32_t size, uint32_t link, uint32_t entsize) {
+        size_t at = shoff + 40 * index;
+        Put(elf, at, name, 4);
+        Put(elf, at + 4, type, 4);
+        Put(elf, at + 8, flags, 4);
+        Put(elf, at + 12, addr, 4);
+        Put(elf, at + 16, offset, 4);
+        Put(elf, at + 20, size, 4);
+        Put(elf, at + 24, link, 4);
+        Put(elf, at + 36, entsize, 4);
+    };
+    for (size_t i = 0; i < sections.size(); i++) {
+        const TestSection& s = sections[i];
+        header(static_cast<uint32_t>(i + 1), names[i], s.type, s.flags, s.addr, 0, s.size, 0, 0);
+    }
+    header(symtab_index, symtab_name, 2, 0, 0, symtab_off, static_cast<uint32_t>(symtab.size()), symtab_index + 1, 16);
+    header(symtab_index + 1, strtab_name, 3, 0, 0, str_off, static_cast<uint32_t>(str.size()), 0, 0);
+    header(symtab_index + 2, shstrtab_name, 3, 0, 0, shstr_off, static_cast<uint32_t>(shstr.size()), 0, 0);
+    return elf;
+}
+
+static void WriteFile(const std::string& path, const void* data, size_t len) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(len));
+}
+
+// Section indices in MakeElf order: 1 .iram0.text, 2 .flash.text,
+// 3 .dram0.bss, 4 .flash.rodata, 5 .comment.
+static const std::vector<TestSection> kSections = {
+    {".iram0.text", 1, 0x6, 0x40080000, 0x100},
+    {".flash.text", 1, 0x6, 0x400d0020, 0x200},
+    {".dram0.bss", 8, 0x3, 0x3ffb0000, 0x80},
+    {".flash.rodata", 1, 0x2, 0x3f400020, 0x40},
+    {".comment", 1, 0x30, 0, 0x20},
+};
+
+// What idf.py leaves in build/: the ELF, its map and flasher_args.json.
+static void WriteBuild(const std::string& dir, bool echo_in_iram, uint32_t loop_size) {
+    std::filesystem::create_directories(dir);
+    std::vector<TestSymbol> symbols = {
+        {"timer_start", 2, 1, 0x40080000, 0x20},
+        {"_ZN8TFT_eSPI10pushPixelsEPKvm", 2, 1, 0x40080040, 0x40},
+        {"loop", 2, 2, 0x400d0080, loop_size},
+        {"_ZL6counts", 1, 3, 0x3ffb0000, 0x40},
+        {"kIndexHtml", 1, 4, 0x3f400020, 0x40},
+        {"no_size", 2, 2, 0x400d0100, 0},
+        {"section_start", 0, 2, 0x400d0020, 4},
+    };
+    if (echo_in_iram) {
+        symbols.push_back({"_Z4echov", 2, 1, 0x40080020, 0x20});
+    } else {
+        symbols.push_back({"_Z4echov", 2, 2, 0x400d0020, 0x30});
+    }
+    std::vector<uint8_t> elf = MakeElf(kSections, symbols);
+    WriteFile(dir + "/sensor.elf", elf.data(), elf.size());
+
+    std::string map =
+        "Archive member included to satisfy reference by file (symbol)\n"
+        "\n"
+        "esp-idf/main/libmain.a(main.cpp.obj)\n"
+        "                              (app_main)\n"
+        "\n"
+        "Linker script and memory map\n"
+        "\n"
+        "LOAD esp-idf/main/libmain.a\n"
+        "\n"
+        ".iram0.text     0x40080000      0x100\n"
+        "                0x40080000                _iram_text_start = ABSOLUTE (.)\n"
+        " *(.iram1 .iram1.*)\n"
+        " .iram1.0       0x40080000       0x20 esp-idf/driver/libdriver.a(timer_legacy.c.obj)\n"
+        "                0x40080000                timer_start\n"
+        " .iram1.1       0x40080020       0x20 esp-idf/main/libmain.a(main.cpp.obj)\n"
+        " .iram1.2._ZN8TFT_eSPI10pushPixelsEPKvm\n"
+        "                0x40080040       0x40 esp-idf/TFT_eSPI/libTFT_eSPI.a(TFT_eSPI.cpp.obj)\n"
+        " *fill*         0x40080080       0x80 \n"
+        "\n"
+        ".flash.text     0x400d0020      0x200\n"
+        " .text._Z4echov\n"
+        "                0x400d0020       0x30 esp-idf/main/libmain.a(main.cpp.obj)\n"
+        " .text.loop     0x400d0080       0x60 esp-idf/main/libmain.a(main.cpp.obj)\n"
+        " .text.empty    0x400d00e0        0x0 esp-idf/main/libmain.a(main.cpp.obj)\n"
+        "\n"
+        ".dram0.bss      0x3ffb0000       0x80\n"
+        " .bss._ZL6counts\n"
+        "                0x3ffb0000       0x40 esp-idf/main/libmain.a(main.cpp.obj)\n"
+        " COMMON         0x3ffb0040       0x40 esp-idf/freertos/libfreertos.a(tasks.c.obj)\n"
+        "\n"
+        ".flash.rodata   0x3f400020       0x40\n"
+        " .rodata.kIndexHtml\n"
+        "                0x3f400020       0x40 CMakeFiles/sensor.elf.dir/project_elf_src_esp32.c.obj\n"
+        "\n"
+        "/DISCARD/\n"
+        " .text.unused   0x00000000       0x10 esp-idf/main/libmain.a(main.cpp.obj)\n";
+    WriteFile(dir + "/sensor.map", map.data(), map.size());
+
+    std::string args = "{\n    \"app\" : { \"offset\" : \"0x10000\", \"file\" : \"sensor.bin\", \"encrypted\" : \"false\" }\n}\n";
+    WriteFile(dir + "/flasher_args.json", args.data(), args.size());
+}
+
+static const MemoryNode* Child(const MemoryNode& node, const std::string& label) {
+    for (const MemoryNode& child : node.children) {
+        if (child.label == label) return &child;
+    }
+    return nullptr;
+}
+
+static void TestReadElf(const std::string& dir) {
+    ElfImage elf;
+    std::string error;
+    CHECK(ReadElf(dir + "/sensor.elf", &elf, &error));
+    CHECK(elf.machine == "xtensa");
+    CHECK(elf.sections.size() == kSections.size() + 4);
+    CHECK(elf.sections[3].name == ".dram0.bss" && elf.sections[3].nobits && elf.sections[3].alloc);
+    CHECK(!elf.sections[5].alloc);
+    // NOTYPE and zero sized symbols are not functions or objects one can weigh.
+    CHECK(elf.symbols.size() == 6);
+    CHECK(Demangle("_ZN8TFT_eSPI10pushPixelsEPKvm") == "TFT_eSPI::pushPixels(void const*, unsigned long)");
+    CHECK(Demangle("app_main") == "app_main");
+
+    CHECK(!ReadElf(dir + "/sensor.map", &elf, &error));
+    CHECK(!ReadElf(dir + "/missing.elf", &elf, &error));
+
+    // The test binary itself: ELF64 with thousands of symbols.
+    CHECK(ReadElf("/proc/self/exe", &elf, &error));
+    bool found = false;
+    for (const ElfSymbol& symbol : elf.symbols) {
+        if (symbol.function && Demangle(symbol.name) == "main") found = true;
+    }
+    CHECK(found);
+}
+
+static void TestReadMap(const std::string& dir) {
+    LinkerMap map;
+    std::string error;
+    CHECK(ReadLinkerMap(dir + "/sensor.map", &map, &error));
+    // Fill, empty and discarded input sections are not kept.
+    CHECK(map.inputs.size() == 8);
+    const MapInput* input = map.Find(0x40080050);
+    CHECK(input && input->section == ".iram1.2._ZN8TFT_eSPI10pushPixelsEPKvm");
+    CHECK(input && input->component == "TFT_eSPI" && input->output == ".iram0.text");
+    input = map.Find(0x400d0020);
+    CHECK(input && input->section == ".text._Z4echov" && input->size == 0x30);
+    CHECK(map.Find(0x40080090) == nullptr);   // fill
+    CHECK(map.Find(0x10) == nullptr);
+    input = map.Find(0x3ffb0040);
+    CHECK(input && input->section == "COMMON" && input->component == "freertos");
+
+    CHECK(ComponentOf("esp-idf/main/libmain.a(main.cpp.obj)") == "main");
+    CHECK(ComponentOf("CMakeFiles/sensor.elf.dir/project_elf_src_esp32.c.obj") == "project_elf_src_esp32.c.obj");
+    CHECK(ComponentOf("/opt/xtensa/lib/libc.a(lib_a-memcpy.o)") == "c");
+
+    CHECK(!ReadLinkerMap(dir + "/flasher_args.json", &map, &error));
+}
+
+static void TestReport(const std::string& dir) {
+    MemoryReport report;
+    std::string error;
+    CHECK(AnalyzeBuild(dir, DefaultHotPaths(), &report, &error));
+    CHECK(report.elf_path == dir + "/sensor.elf" && report.map_path == dir + "/sensor.map");
+    CHECK(report.sections.size() == 4);   // .comment is not on the chip
+    CHECK(RegionOf(".iram0.text") == MemoryRegion::Iram);
+    CHECK(RegionOf(".dram0.bss") == MemoryRegion::Dram);
+    CHECK(RegionOf(".flash.text") == MemoryRegion::FlashCode);
+    CHECK(RegionOf(".flash.rodata") == MemoryRegion::FlashData);
+    CHECK(RegionOf(".rtc.text") == MemoryRegion::Rtc);
+
+    int hot = 0;
+    for (const MemorySymbol& symbol : report.symbols) {
+        if (symbol.hot) hot++;
+        if (symbol.name == "echo()") CHECK(symbol.hot && symbol.section == ".flash.text" && symbol.component == "main");
+        if (symbol.name == "loop") CHECK(!symbol.hot && symbol.component == "main");
+        if (symbol.name == "counts") CHECK(!symbol.function && symbol.component == "main");
+    }
+    CHECK(hot == 3);
+
+    MemoryNode tree = BuildMemoryTree(report, nullptr);
+    CHECK(tree.label == "sensor.elf");
+    CHECK(tree.size == 0x100 + 0x200 + 0x80 + 0x40);
+    CHECK(!tree.children.empty() && tree.children[0].label == "Hot paths" && tree.children[0].flagged);
+    const MemoryNode* hot_node = Child(tree, "Hot paths");
+    const MemoryNode* echo = hot_node ? Child(*hot_node, "echo()  Flash code") : nullptr;
+    CHECK(echo && echo->flagged && echo->size == 0x30);
+    const MemoryNode* push = hot_node ? Child(*hot_node, "TFT_eSPI::pushPixels(void const*, unsigned long)  IRAM") : nullptr;
+    CHECK(push && !push->flagged);
+
+    // Region > section > component > symbol.
+    const MemoryNode* iram = Child(tree, "IRAM");
+    const MemoryNode* text = iram ? Child(*iram, ".iram0.text") : nullptr;
+    CHECK(text && text->size == 0x100);
+    const MemoryNode* driver = text ? Child(*text, "driver") : nullptr;
+    CHECK(driver && driver->size == 0x20 && Child(*driver, "timer_start"));
+    const MemoryNode* dram = Child(tree, "DRAM");
+    const MemoryNode* bss = dram ? Child(*dram, ".dram0.bss") : nullptr;
+    const MemoryNode* freertos = bss ? Child(*bss, "freertos") : nullptr;
+    CHECK(freertos && freertos->size == 0x40);
+    // Regions stay in a fixed order after the hot paths.
+    CHECK(tree.children.size() == 5 && tree.children[1].label == "IRAM" && tree.children[2].label == "DRAM");
+
+    // An .elf without a map: everything is in one bucket.
+    std::filesystem::remove(dir + "/sensor.map");
+    CHECK(AnalyzeBuild(dir + "/sensor.elf", {}, &report, &error));
+    CHECK(report.map_path.empty());
+    tree = BuildMemoryTree(report, nullptr);
+    CHECK(tree.children.size() == 4 && tree.children[0].label == "IRAM");
+    const MemoryNode* flash = Child(tree, "Flash code");
+    const MemoryNode* flash_text = flash ? Child(*flash, ".flash.text") : nullptr;
+    const MemoryNode* nomap = flash_text ? Child(*flash_text, "(no map)") : nullptr;
+    CHECK(nomap && nomap->size == 0x30 + 0x60);
+
+    CHECK(!AnalyzeBuild(dir + "/empty", {}, &report, &error));
+}
+
+static void TestCompare(const std::string& before_dir, const std::string& after_dir) {
+    MemoryReport before;
+    MemoryReport after;
+    std::string error;
+    CHECK(AnalyzeBuild(before_dir, DefaultHotPaths(), &before, &error));
+    CHECK(AnalyzeBuild(after_dir, {"echo"}, &after, &error));
+    MemoryNode tree = BuildMemoryTree(after, &before);
+    CHECK(tree.before == tree.size);
+
+    // echo() moved from flash into IRAM: a new hot path node, the old one
+    // kept at size 0.
+    const MemoryNode* hot = Child(tree, "Hot paths");
+    CHECK(hot && !hot->flagged);
+    const MemoryNode* now = hot ? Child(*hot, "echo()  IRAM") : nullptr;
+    const MemoryNode* was = hot ? Child(*hot, "echo()  Flash code") : nullptr;
+    CHECK(now && now->size == 0x20 && now->before == 0);
+    CHECK(was && was->size == 0 && was->before == 0x30);
+
+    // loop grew, and siblings sort by how much they changed.
+    const MemoryNode* flash = Child(tree, "Flash code");
+    const MemoryNode* text = flash ? Child(*flash, ".flash.text") : nullptr;
+    const MemoryNode* main = text ? Child(*text, "main") : nullptr;
+    CHECK(main && main->children.size() == 2);
+    if (main && main->children.size() == 2) {
+        CHECK(main->children[0].label == "loop" && main->children[0].size == 0xA0 && main->children[0].before == 0x60);
+        CHECK(main->children[1].label == "echo()" && main->children[1].size == 0);
+    }
+}
+
+int main() {
+    std::string dir = std::filesystem::temp_directory_path().string() + "/memory_test_" + std::to_string(getpid());
+    std::filesystem::create_directories(dir + "/empty");
+    WriteBuild(dir + "/before", false, 0x60);
+    TestReadElf(dir + "/before");
+    TestReadMap(dir + "/before");
+    TestReport(dir + "/before");
+
+    WriteBuild(dir + "/before", false, 0x60);
+    WriteBuild(dir + "/after", true, 0xA0);
+    TestCompare(dir + "/before", dir + "/after");
+    std::filesystem::remove_all(dir);
+
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("memory_test passed\n");
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Scrollback bookkeeping, and a SerialMonitor reading a pty as fast as the
+// kernel hands the bytes over.
+
+#include "scrollback.hpp"
+#include "serialmonitor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static void Feed(Scrollback& scrollback, const std::string& text) {
+    scrollback.Append(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+static std::vector<LogLine> All(const Scrollback& scrollback) {
+    std::vector<LogLine> lines;
+    scrollback.Copy(0, scrollback.Count(), &lines);
+    return lines;
+}
+
+static void TestLines() {
+    Scrollback scrollback;
+    // Split across appends, CRLF, IDF colour codes and an Arduino log line.
+    Feed(scrollback, "\x1b[0;31mE (1234) wifi: conn");
+    Feed(scrollback, "ect failed\x1b[0m\r\nW (1300) nvs: low\r\n");
+    Feed(scrollback, "[   512][I][api.cpp:12] apirouting(): up\nplain\npart");
+    std::vector<LogLine> lines = All(scrollback);
+    CHECK(lines.size() == 4);
+    CHECK(lines[0].text == "E (1234) wifi: connect failed" && lines[0].level == LogLevel::Error);
+    CHECK(lines[1].text == "W (1300) nvs: low" && lines[1].level == LogLevel::Warning);
+    CHECK(lines[2].level == LogLevel::Info);
+    CHECK(lines[3].text == "plain" && lines[3].level == LogLevel::None);
+    CHECK(scrollback.Partial() == "part");
+    CHECK(lines[3].seq == 3);
+
+    // Overlong lines wrap, and their newline does not add an empty one.
+    Scrollback wrap;
+    Feed(wrap, std::string(Scrollback::kMaxLineLength, 'a') + "\n" + std::string(10, 'b') + "\n");
+    lines = All(wrap);
+    CHECK(lines.size() == 2);
+    CHECK(lines[0].text.size() == Scrollback::kMaxLineLength && lines[1].text == "bbbbbbbbbb");
+
+    // A bare carriage return redraws the line.
+    Scrollback progress;
+    Feed(progress, "Receiving objects:  10%\rReceiving objects:  55%\rReceiving objects: 100%, done.\r\nnext\r");
+    lines = All(progress);
+    CHECK(lines.size() == 1 && lines[0].text == "Receiving objects: 100%, done.");
+    CHECK(progress.Partial() == "next");
+}
+
+static void TestEviction() {
+    // Room for about 100 lines of 40 bytes, the text ring wraps many times.
+    Scrollback scrollback(4000, 1000);
+    char line[64];
+    for (int i = 0; i < 1000; i++) {
+        std::snprintf(line, sizeof(line), "I (%d) line %08d .....................\n", i, i);
+        Feed(scrollback, line);
+    }
+    std::vector<LogLine> lines = All(scrollback);
+    CHECK(!lines.empty() && lines.size() <= 100);
+    CHECK(scrollback.Evicted() + lines.size() == 1000);
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::snprintf(line, sizeof(line), "line %08d ", static_cast<int>(lines[i].seq));
+        CHECK(lines[i].text.find(line) != std::string::npos);
+    }
+    CHECK(lines.back().seq == 999);
+
+    // The line cap evicts as well.
+    Scrollback capped(1 << 20, 10);
+    for (int i = 0; i < 25; i++) Feed(capped, "x\n");
+    CHECK(capped.Count() == 10 && capped.Evicted() == 15);
+    CHECK(capped.SeqAt(0) == 15 && capped.IndexOf(20) == 5 && capped.IndexOf(3) == 0);
+}
+
+static void TestFilter() {
+    Scrollback scrollback(2000, 1000);
+    for (int i = 0; i < 50; i++) {
+        Feed(scrollback, i % 5 == 0 ? "E (1) alarm: INTRUDER\n" : "I (1) loop: tick\n");
+    }
+    std::string error;
+    CHECK(scrollback.SetFilter("intruder", &error));
+    CHECK(scrollback.Count() > 0);
+    size_t before = scrollback.Count();
+    // New lines are matched as they arrive, evicted matches drop out.
+    Feed(scrollback, "E (2) alarm: intruder again\nI (2) loop: tick\n");
+    CHECK(scrollback.Count() >= before);
+    std::vector<LogLine> lines = All(scrollback);
+    for (const LogLine& line : lines) CHECK(line.level == LogLevel::Error);
+    CHECK(lines.back().text == "E (2) alarm: intruder again");
+    uint64_t seq = lines.back().seq;
+    CHECK(scrollback.IndexOf(seq) == scrollback.Count() - 1);
+    CHECK(scrollback.IndexOf(seq + 1) == scrollback.Count());
+
+    for (int i = 0; i < 200; i++) Feed(scrollback, "I (3) loop: tick\n");
+    CHECK(scrollback.Count() == 0);
+
+    CHECK(!scrollback.SetFilter("(unclosed", &error));
+    CHECK(!error.empty() && scrollback.Filter() == "intruder");
+    CHECK(scrollback.SetFilter("", &error));
+    CHECK(scrollback.Count() == scrollback.Lines());
+}
+
+// Writes numbered lines into a pty as fast as it takes them and checks
+// every one arrived, in order.
+static void TestMonitor() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0);
+    termios tio{};
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    std::atomic<int> updates{0};
+    SerialMonitor monitor([&] { updates++; });
+    std::string error;
+    CHECK(monitor.Start(ptsname(master), 2000000, &error));
+
+    const int kLines = 50000;
+    std::string data;
+    char line[64];
+    for (int i = 0; i < kLines; i++) {
+        std::snprintf(line, sizeof(line), "%c (%d) sensor: echo %d us\r\n", "EWIDV"[i % 5], i, i * 7);
+        data += line;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t at = 0; at < data.size();) {
+        ssize_t n = write(master, data.data() + at, std::min<size_t>(4096, data.size() - at));
+        CHECK(n > 0);
+        if (n <= 0) break;
+        at += static_cast<size_t>(n);
+    }
+    while (monitor.With([](Scrollback& s) { return s.BytesIn(); }) < data.size() &&
+           std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    monitor.Stop();
+    CHECK(monitor.Error().empty());
+
+    std::vector<LogLine> lines = monitor.With([](Scrollback& s) { return All(s); });
+    CHECK(lines.size() == static_cast<size_t>(kLines));
+    for (int i = 0; i < kLines && i < static_cast<int>(lines.size()); i++) {
+        std::snprintf(line, sizeof(line), "%c (%d) sensor: echo %d us", "EWIDV"[i % 5], i, i * 7);
+        if (lines[i].text != line) {
+            CHECK(lines[i].text == line);
+            break;
+        }
+    }
+    // 2 Mbaud is 200 KB/s of text, the monitor has to keep well ahead.
+    std::printf("monitor: %zu bytes in %.3f s, %d updates\n", data.size(), seconds, updates.load());
+    CHECK(data.size() / seconds > 200000);
+    CHECK(updates > 0);
+    close(master);
+}
+
+int main() {
+    TestLines();
+    TestEviction();
+    TestFilter();
+    TestMonitor();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("monitor_test passed\n");
+    return 0;
+}
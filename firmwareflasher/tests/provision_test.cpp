@@ -0,0 +1,301 @@
+// Reads generated NVS images back the way the IDF nvs component does and
+// provisions a board against EmulatedRom.
+
+#include "deflatecache.hpp"
+#include "emulatedrom.hpp"
+#include "flashplan.hpp"
+#include "nvsimage.hpp"
+#include "provision.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <zlib.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static uint32_t GetU32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static uint32_t NvsCrc(const uint8_t* data, size_t len) {
+    return static_cast<uint32_t>(crc32(0xFFFFFFFF, data, static_cast<uInt>(len)));
+}
+
+struct NvsItem {
+    uint8_t type = 0;
+    std::vector<uint8_t> data;    // little endian value, string or whole blob
+};
+
+// Walks every page, checking header, entry and data CRCs, and returns the
+// items as "namespace/key". Blob chunks are put back together through
+// their index entry.
+static bool ReadNvs(const std::vector<uint8_t>& image, std::map<std::string, NvsItem>* items, size_t* pages_used) {
+    std::map<int, std::string> namespaces;
+    std::map<std::string, std::map<int, std::vector<uint8_t>>> chunks;
+    std::map<std::string, std::pair<uint32_t, int>> blobs;
+    *pages_used = 0;
+    bool ok = true;
+    for (size_t at = 0; at + 4096 <= image.size(); at += 4096) {
+        const uint8_t* page = image.data() + at;
+        uint32_t state = GetU32(page);
+        if (state == 0xFFFFFFFF) continue;
+        (*pages_used)++;
+        if ((state != 0xFFFFFFFE && state != 0xFFFFFFFC) || page[8] != 0xFE ||
+            GetU32(page + 28) != NvsCrc(page + 4, 24) || GetU32(page + 4) != at / 4096) {
+            return false;
+        }
+        for (int i = 0; i < 126;) {
+            int bits = (page[32 + i / 4] >> (2 * (i % 4))) & 3;
+            if (bits == 3) break;
+            if (bits != 2) return false;
+            const uint8_t* e = page + 64 + i * 32;
+            uint8_t covered[28];
+            std::memcpy(covered, e, 4);
+            std::memcpy(covered + 4, e + 8, 24);
+            if (GetU32(e + 4) != NvsCrc(covered, 28)) return false;
+            int span = e[2];
+            if (span < 1 || i + span > 126) return false;
+            for (int j = 1; j < span; j++) {
+                if (((page[32 + (i + j) / 4] >> (2 * ((i + j) % 4))) & 3) != 2) return false;
+            }
+            std::string key(reinterpret_cast<const char*>(e + 8), strnlen(reinterpret_cast<const char*>(e + 8), 16));
+            uint8_t type = e[1];
+            if (e[0] == 0) {
+                namespaces[e[24]] = key;
+            } else {
+                std::string name = namespaces[e[0]] + "/" + key;
+                if (type == 0x21 || type == 0x42) {
+                    size_t len = e[24] | e[25] << 8;
+                    const uint8_t* data = e + 32;
+                    if (len > (span - 1) * 32u || GetU32(e + 28) != NvsCrc(data, len)) return false;
+                    if (type == 0x21) {
+                        (*items)[name] = NvsItem{type, std::vector<uint8_t>(data, data + len)};
+                    } else {
+                        chunks[name][e[3]].assign(data, data + len);
+                    }
+                } else if (type == 0x48) {
+                    blobs[name] = {GetU32(e + 24), e[28]};
+                } else {
+                    (*items)[name] = NvsItem{type, std::vector<uint8_t>(e + 24, e + 32)};
+                }
+            }
+            i += span;
+        }
+    }
+    for (const auto& blob : blobs) {
+        NvsItem item{0x48, {}};
+        for (int c = 0; c < blob.second.second; c++) {
+            auto& parts = chunks[blob.first];
+            if (!parts.count(c)) return false;
+            item.data.insert(item.data.end(), parts[c].begin(), parts[c].end());
+        }
+        ok = ok && item.data.size() == blob.second.first;
+        (*items)[blob.first] = item;
+    }
+    return ok;
+}
+
+static std::string Text(const NvsItem& item) {
+    if (item.data.empty() || item.data.back() != 0) return "<not a string>";
+    return std::string(item.data.begin(), item.data.end() - 1);
+}
+
+static void TestNvsImage() {
+    NvsImage nvs(0x6000);
+    std::vector<uint8_t> big(9000);
+    for (size_t i = 0; i < big.size(); i++) big[i] = static_cast<uint8_t>(i * 7);
+    std::string long_text(1500, 'x');
+    CHECK(nvs.SetU8("one", "small", 42));
+    CHECK(nvs.SetU32("one", "word", 0xA1B2C3D4));
+    CHECK(nvs.SetString("two", "name", "hello"));
+    CHECK(nvs.SetString("two", "long", long_text));
+    CHECK(nvs.SetBlob("two", "big", big));
+    CHECK(nvs.SetString("one", "after", "tail"));
+    CHECK(nvs.Data().size() == 0x6000);
+
+    std::map<std::string, NvsItem> items;
+    size_t pages = 0;
+    CHECK(ReadNvs(nvs.Data(), &items, &pages));
+    // The blob spans three pages, the last page always stays erased.
+    CHECK(pages >= 3 && pages <= 5);
+    CHECK(items["one/small"].type == 0x01 && items["one/small"].data[0] == 42);
+    CHECK(items["one/word"].type == 0x04 && GetU32(items["one/word"].data.data()) == 0xA1B2C3D4);
+    CHECK(Text(items["two/name"]) == "hello");
+    CHECK(Text(items["two/long"]) == long_text);
+    CHECK(items["two/big"].data == big);
+    CHECK(Text(items["one/after"]) == "tail");
+    // Only the page being filled is active, the ones before it are full.
+    CHECK(GetU32(nvs.Data().data()) == 0xFFFFFFFC);
+
+    NvsImage small(0x2000);
+    CHECK(!small.SetBlob("ns", "big", big));
+    CHECK(small.Error() == "NVS partition full");
+    CHECK(!small.SetString("ns", "key_that_is_too_long", "x"));
+    CHECK(!small.SetString("ns", "text", std::string(5000, 'y')));
+}
+
+static std::string WriteConfig(const std::string& text) {
+    char path[] = "/tmp/provisionXXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    std::ofstream(path) << text;
+    return path;
+}
+
+static void TestProvisionConfig() {
+    std::string path = WriteConfig(
+        "# fleet settings\n"
+        "wifi_ssid = Home\n"
+        "wifi_pass=correcthorse\n"
+        "ap_pass=hubsecret1\n"
+        "disarm=4321\n"
+        "touch_cal=300, 3500, 280, 3600, 7\n");
+    ProvisionConfig config;
+    std::string error;
+    CHECK(LoadProvisionConfig(path, &config, &error));
+    CHECK(config.wifi_ssid == "Home" && config.wifi_pass == "correcthorse");
+    CHECK(config.touch_cal == std::vector<uint16_t>({300, 3500, 280, 3600, 7}));
+    CHECK(config.pair_key.size() == 32);
+    // The generated key went back into the file.
+    ProvisionConfig again;
+    CHECK(LoadProvisionConfig(path, &again, &error));
+    CHECK(again.pair_key == config.pair_key);
+
+    std::vector<uint8_t> image;
+    const uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x0a, 0xb1, 0xc2};
+    CHECK(ModuleId(config, mac) == "ESP_MOTION_0AB1C2");
+    CHECK(BuildProvisionImage(config, false, mac, 0x6000, &image, &error));
+    std::map<std::string, NvsItem> items;
+    size_t pages = 0;
+    CHECK(ReadNvs(image, &items, &pages));
+    CHECK(Text(items["provision/pass"]) == "hubsecret1");
+    CHECK(Text(items["provision/module"]) == "ESP_MOTION_0AB1C2");
+    CHECK(Text(items["provision/disarm"]) == "4321");
+    CHECK(Text(items["provision/pairkey"]) == config.pair_key);
+    CHECK(!items.count("provision/ssid") && !items.count("provision/touchcal"));
+
+    items.clear();
+    CHECK(BuildProvisionImage(config, true, mac, 0x6000, &image, &error));
+    CHECK(ReadNvs(image, &items, &pages));
+    CHECK(Text(items["provision/ssid"]) == "Home");
+    CHECK(Text(items["provision/pass"]) == "correcthorse");
+    CHECK(Text(items["provision/appass"]) == "hubsecret1");
+    CHECK(items["provision/touchcal"].data == std::vector<uint8_t>({0x2c, 0x01, 0xac, 0x0d, 0x18, 0x01, 0x10, 0x0e, 7, 0}));
+    CHECK(!items.count("provision/module"));
+    std::remove(path.c_str());
+
+    path = WriteConfig("ap_pass=short\n");
+    CHECK(!LoadProvisionConfig(path, &config, &error));
+    std::remove(path.c_str());
+    path = WriteConfig("touch_cal=1,2,3\n");
+    CHECK(!LoadProvisionConfig(path, &config, &error));
+    std::remove(path.c_str());
+    path = WriteConfig("colour=blue\n");
+    CHECK(!LoadProvisionConfig(path, &config, &error));
+    CHECK(error.find("unknown key colour") != std::string::npos);
+    std::remove(path.c_str());
+}
+
+// partition-table.bin with nvs somewhere other than the usual 0x9000.
+static std::vector<uint8_t> PartitionTable() {
+    std::vector<uint8_t> table(3072, 0xFF);
+    auto add = [&](size_t index, uint8_t type, uint8_t subtype, uint32_t offset, uint32_t size, const char* label) {
+        uint8_t* p = table.data() + index * 32;
+        std::memset(p, 0, 32);
+        p[0] = 0xAA;
+        p[1] = 0x50;
+        p[2] = type;
+        p[3] = subtype;
+        for (int i = 0; i < 4; i++) {
+            p[4 + i] = (offset >> (8 * i)) & 0xFF;
+            p[8 + i] = (size >> (8 * i)) & 0xFF;
+        }
+        std::strcpy(reinterpret_cast<char*>(p + 12), label);
+    };
+    add(0, 0x01, 0x01, 0x9000, 0x1000, "phy_init");
+    add(1, 0x01, 0x02, 0xA000, 0x5000, "nvs");
+    add(2, 0x00, 0x00, 0x10000, 0x100000, "factory");
+    return table;
+}
+
+static void TestProvisionFlash() {
+    char dir_template[] = "/tmp/provisionflashXXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    std::vector<uint8_t> boot(20000, 0x5A), table = PartitionTable(), app(300000);
+    for (size_t i = 0; i < app.size(); i++) app[i] = static_cast<uint8_t>(i % 251);
+    auto write = [&](const std::string& name, const std::vector<uint8_t>& data) {
+        std::ofstream(dir + "/" + name, std::ios::binary)
+            .write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    write("bootloader.bin", boot);
+    write("partition-table.bin", table);
+    write("app.bin", app);
+    std::ofstream(dir + "/flasher_args.json") << R"({
+    "flash_files" : { "0x0" : "bootloader.bin", "0x8000" : "partition-table.bin", "0x10000" : "app.bin" },
+    "extra_esptool_args" : { "chip" : "esp32s3" }
+})";
+    std::string path = WriteConfig("wifi_ssid=Home\nwifi_pass=correcthorse\npair_key=abc123\n");
+    auto config = std::make_shared<ProvisionConfig>();
+    std::string error;
+    CHECK(LoadProvisionConfig(path, config.get(), &error));
+    std::remove(path.c_str());
+
+    // Streamed from the folder, so the table comes through ReadFlashFile.
+    FlashPlan plan;
+    CHECK(LoadFlashLayout(dir, &plan, &error));
+    EmulatedRom rom;
+    CHECK(rom.Start());
+    FlashOptions options;
+    options.provision = config;
+    DeflateCache cache(plan);
+    FlashStatus last;
+    bool ok = FlashBoard(rom.SlavePath(), plan, cache, options, [&](const FlashStatus& s) { last = s; }, &error);
+    if (!ok) std::fprintf(stderr, "FlashBoard: %s\n", error.c_str());
+    CHECK(ok);
+    CHECK(last.verified == 4);
+    CHECK(last.done == last.total && last.total == boot.size() + table.size() + app.size() + 0x5000);
+    rom.Stop();
+
+    const std::vector<uint8_t>& flash = rom.Flash();
+    CHECK(std::memcmp(flash.data() + 0x10000, app.data(), app.size()) == 0);
+    std::vector<uint8_t> nvs(flash.begin() + 0xA000, flash.begin() + 0xF000);
+    std::map<std::string, NvsItem> items;
+    size_t pages = 0;
+    CHECK(ReadNvs(nvs, &items, &pages));
+    CHECK(pages == 1);
+    // The emulated chip is an ESP32-S3, so it gets the hub's settings.
+    CHECK(Text(items["provision/ssid"]) == "Home");
+    CHECK(Text(items["provision/pairkey"]) == "abc123");
+    // Nothing outside the partition was touched.
+    CHECK(flash[0x9000] == 0xFF && flash[0xF000] == 0xFF);
+
+    std::system(("rm -rf " + dir).c_str());
+}
+
+int main() {
+    TestNvsImage();
+    TestProvisionConfig();
+    TestProvisionFlash();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("provision_test passed\n");
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "testzip.hpp"
+
+#include <zlib.h>
+
+static void Put16(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(v & 0xff);
+    out.push_back((v >> 8) & 0xff);
+}
+
+static void Put32(std::vector<uint8_t>& out, uint32_t v) {
+    Put16(out, v & 0xffff);
+    Put16(out, v >> 16);
+}
+
+std::vector<uint8_t> MakeZip(const std::vector<ZipEntry>& entries) {
+    std::vector<uint8_t> zip, central;
+    for (const ZipEntry& entry : entries) {
+        uLongf packed_size = compressBound(static_cast<uLong>(entry.data.size()));
+        std::vector<uint8_t> packed(packed_size);
+        z_stream zs{};
+        deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        zs.next_in = const_cast<Bytef*>(entry.data.data());
+        zs.avail_in = static_cast<uInt>(entry.data.size());
+        zs.next_out = packed.data();
+        zs.avail_out = static_cast<uInt>(packed.size());
+        deflate(&zs, Z_FINISH);
+        packed.resize(zs.total_out);
+        deflateEnd(&zs);
+        uint32_t crc = static_cast<uint32_t>(crc32(0, entry.data.data(), static_cast<uInt>(entry.data.size())));
+
+        uint32_t local_at = static_cast<uint32_t>(zip.size());
+        Put32(zip, 0x04034b50);
+        Put16(zip, 20);
+        Put16(zip, 0);
+        Put16(zip, 8);
+        Put32(zip, 0);
+        Put32(zip, crc);
+        Put32(zip, static_cast<uint32_t>(packed.size()));
+        Put32(zip, static_cast<uint32_t>(entry.data.size()));
+        Put16(zip, static_cast<uint32_t>(entry.name.size()));
+        Put16(zip, 0);
+        zip.insert(zip.end(), entry.name.begin(), entry.name.end());
+        zip.insert(zip.end(), packed.begin(), packed.end());
+
+        Put32(central, 0x02014b50);
+        Put16(central, 20);
+        Put16(central, 20);
+        Put16(central, 0);
+        Put16(central, 8);
+        Put32(central, 0);
+        Put32(central, crc);
+        Put32(central, static_cast<uint32_t>(packed.size()));
+        Put32(central, static_cast<uint32_t>(entry.data.size()));
+        Put16(central, static_cast<uint32_t>(entry.name.size()));
+        Put16(central, 0);
+        Put16(central, 0);
+        Put16(central, 0);
+        Put16(central, 0);
+        Put32(central, 0);
+        Put32(central, local_at);
+        central.insert(central.end(), entry.name.begin(), entry.name.end());
+    }
+    uint32_t central_at = static_cast<uint32_t>(zip.size());
+    zip.insert(zip.end(), central.begin(), central.end());
+    Put32(zip, 0x06054b50);
+    Put16(zip, 0);
+    Put16(zip, 0);
+    Put16(zip, static_cast<uint32_t>(entries.size()));
+    Put16(zip, static_cast<uint32_t>(entries.size()));
+    Put32(zip, static_cast<uint32_t>(central.size()));
+    Put32(zip, central_at);
+    Put16(zip, 0);
+    return zip;
+}
@@ -0,0 +1,13 @@
+#ifndef FIRMWAREFLASHER_TESTS_TESTZIP_HPP
+#define FIRMWAREFLASHER_TESTS_TESTZIP_HPP
+
+#include "zipstream.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Minimal zip writer: deflated entries with sizes in the local headers and
+// a central directory, the way release pipelines pack a build folder.
+std::vector<uint8_t> MakeZip(const std::vector<ZipEntry>& entries);
+
+#endif
@@ -0,0 +1,377 @@
+#include "zipstream.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+constexpr uint32_t kLocalHeader = 0x04034b50;
+constexpr uint32_t kCentralHeader = 0x02014b50;
+constexpr uint32_t kEndOfCentral = 0x06054b50;
+constexpr uint32_t kDescriptor = 0x08074b50;
+constexpr uint32_t kZip64EndOfCentral = 0x06064b50;
+constexpr uint32_t kZip64Locator = 0x07064b50;
+constexpr uint16_t kFlagEncrypted = 0x0001;
+constexpr uint16_t kFlagDescriptor = 0x0008;
+constexpr size_t kLocalHeaderSize = 30;
+constexpr size_t kOutChunk = 32 * 1024;
+constexpr size_t kCentralHeaderSize = 46;
+constexpr size_t kEndOfCentralSize = 22;
+constexpr size_t kReadChunk = 64 * 1024;
+
+uint16_t GetU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t GetU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t GetU64(const uint8_t* p) {
+    return GetU32(p) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+}  // namespace
+
+ZipStreamReader::ZipStreamReader(Callbacks callbacks) : callbacks_(std::move(callbacks)) {}
+
+ZipStreamReader::~ZipStreamReader() {
+    if (zs_ready_) inflateEnd(&zs_);
+}
+
+bool ZipStreamReader::Fail(const std::string& what) {
+    failed_ = true;
+    error_ = what;
+    return false;
+}
+
+bool ZipStreamReader::Feed(const uint8_t* data, size_t len) {
+    if (failed_) return false;
+    if (done_) return true;
+    in_.insert(in_.end(), data, data + len);
+    size_t pos = 0;
+    while (!done_ && !failed_ && Step(pos)) {
+    }
+    in_.erase(in_.begin(), in_.begin() + pos);
+    return !failed_;
+}
+
+bool ZipStreamReader::FinishEntry(uint32_t crc, uint64_t size) {
+    if (crc_ != crc || size_ != size) {
+        return Fail(name_ + ": CRC mismatch, archive is corrupt");
+    }
+    if (callbacks_.end) callbacks_.end();
+    state_ = State::Signature;
+    return true;
+}
+
+bool ZipStreamReader::Step(size_t& pos) {
+    const size_t avail = in_.size() - pos;
+    const uint8_t* p = in_.data() + pos;
+
+    if (state_ == State::Signature) {
+        if (avail < 4) return false;
+        uint32_t sig = GetU32(p);
+        if (sig == kCentralHeader || sig == kEndOfCentral) {
+            done_ = true;
+            return false;
+        }
+        if (sig != kLocalHeader) {
+            return Fail("not a zip archive");
+        }
+        if (avail < kLocalHeaderSize) return false;
+        size_t name_len = GetU16(p + 26);
+        size_t extra_len = GetU16(p + 28);
+        if (avail < kLocalHeaderSize + name_len + extra_len) return false;
+
+        flags_ = GetU16(p + 6);
+        method_ = GetU16(p + 8);
+        expect_crc_ = GetU32(p + 14);
+        remaining_ = GetU32(p + 18);
+        expect_size_ = GetU32(p + 22);
+        name_.assign(reinterpret_cast<const char*>(p + kLocalHeaderSize), name_len);
+
+        // Zip64 (what "zip -" writes for piped input) moves the sizes into
+        // an extra field and widens the data descriptor.
+        zip64_ = false;
+        const uint8_t* extra = p + kLocalHeaderSize + name_len;
+        for (size_t at = 0; at + 4 <= extra_len;) {
+            uint16_t id = GetU16(extra + at);
+            uint16_t size = GetU16(extra + at + 2);
+            if (id == 0x0001 && size >= 16 && at + 4 + size <= extra_len) {
+                zip64_ = true;
+                expect_size_ = GetU64(extra + at + 4);
+                remaining_ = GetU64(extra + at + 12);
+            }
+            at += 4 + size;
+        }
+        pos += kLocalHeaderSize + name_len + extra_len;
+
+        if (flags_ & kFlagEncrypted) {
+            return Fail(name_ + ": encrypted entries are not supported");
+        }
+        if (method_ != Z_DEFLATED && method_ != 0) {
+            return Fail(name_ + ": unsupported compression method " + std::to_string(method_));
+        }
+        if ((flags_ & kFlagDescriptor) && method_ == 0) {
+            return Fail(name_ + ": stored entry without sizes");
+        }
+        if (method_ == Z_DEFLATED) {
+            if (zs_ready_) {
+                inflateReset(&zs_);
+            } else {
+                inflateInit2(&zs_, -MAX_WBITS);
+                zs_ready_ = true;
+            }
+        }
+        crc_ = crc32(0, nullptr, 0);
+        size_ = 0;
+        if (callbacks_.begin) callbacks_.begin(name_, (flags_ & kFlagDescriptor) ? 0 : expect_size_);
+        state_ = State::Data;
+        if (!(flags_ & kFlagDescriptor) && remaining_ == 0 && method_ == 0) {
+            return FinishEntry(expect_crc_, expect_size_);
+        }
+        return true;
+    }
+
+    if (state_ == State::Data) {
+        return StepData(pos);
+    }
+
+    // Data descriptor after an entry streamed without sizes, with or
+    // without its optional signature.
+    if (avail < 4) return false;
+    size_t skip = GetU32(p) == kDescriptor ? 4 : 0;
+    size_t len = zip64_ ? 20 : 12;
+    if (avail < skip + len) return false;
+    uint32_t crc = GetU32(p + skip);
+    uint64_t size = zip64_ ? GetU64(p + skip + 12) : GetU32(p + skip + 8);
+    pos += skip + len;
+    return FinishEntry(crc, size);
+}
+
+bool ZipStreamReader::StepData(size_t& pos) {
+    const bool sized = !(flags_ & kFlagDescriptor);
+    size_t avail = in_.size() - pos;
+    if (sized && avail > remaining_) avail = static_cast<size_t>(remaining_);
+    if (avail == 0 && !(sized && remaining_ == 0)) return false;
+
+    if (method_ == 0) {
+        const uint8_t* p = in_.data() + pos;
+        crc_ = crc32(crc_, p, static_cast<uInt>(avail));
+        size_ += avail;
+        if (callbacks_.data) callbacks_.data(p, avail);
+        pos += avail;
+        remaining_ -= avail;
+        if (remaining_ == 0) return FinishEntry(expect_crc_, expect_size_);
+        return true;
+    }
+
+    uint8_t out[kOutChunk];
+    zs_.next_in = in_.data() + pos;
+    zs_.avail_in = static_cast<uInt>(avail);
+    int rc = Z_OK;
+    bool moved = false;
+    do {
+        zs_.next_out = out;
+        zs_.avail_out = sizeof(out);
+        rc = inflate(&zs_, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            return Fail(name_ + ": bad deflate data");
+        }
+        size_t produced = sizeof(out) - zs_.avail_out;
+        if (produced > 0) {
+            crc_ = crc32(crc_, out, static_cast<uInt>(produced));
+            size_ += produced;
+            if (callbacks_.data) callbacks_.data(out, produced);
+            moved = true;
+        }
+    } while (rc == Z_OK && zs_.avail_out == 0);
+
+    size_t consumed = avail - zs_.avail_in;
+    pos += consumed;
+    remaining_ -= sized ? consumed : 0;
+    moved = moved || consumed > 0;
+
+    if (rc == Z_STREAM_END) {
+        if (!sized) {
+            state_ = State::Descriptor;
+            return true;
+        }
+        if (remaining_ != 0) {
+            return Fail(name_ + ": compressed size mismatch");
+        }
+        return FinishEntry(expect_crc_, expect_size_);
+    }
+    if (sized && remaining_ == 0) {
+        return Fail(name_ + ": deflate stream is truncated");
+    }
+    return moved;
+}
+
+ZipStreamReader::Callbacks CollectZipEntries(std::vector<ZipEntry>* entries) {
+    ZipStreamReader::Callbacks callbacks;
+    callbacks.begin = [entries](const std::string& name, uint64_t size) {
+        entries->push_back(ZipEntry{name, {}});
+        entries->back().data.reserve(static_cast<size_t>(size));
+    };
+    callbacks.data = [entries](const uint8_t* data, size_t len) {
+        entries->back().data.insert(entries->back().data.end(), data, data + len);
+    };
+    return callbacks;
+}
+
+namespace {
+
+bool ReadAt(std::ifstream& in, uint64_t offset, size_t len, std::vector<uint8_t>* out) {
+    out->resize(len);
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(reinterpret_cast<char*>(out->data()), static_cast<std::streamsize>(len));
+    return static_cast<size_t>(in.gcount()) == len;
+}
+
+}  // namespace
+
+bool ReadZipDirectory(const std::string& path, std::vector<ZipDirEntry>* entries, std::string* error) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        *error = "cannot open " + path;
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+
+    // The end record sits behind an archive comment of up to 64 KiB.
+    size_t tail_len = static_cast<size_t>(std::min<uint64_t>(file_size, kEndOfCentralSize + 0xFFFF));
+    std::vector<uint8_t> tail;
+    if (!ReadAt(in, file_size - tail_len, tail_len, &tail)) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    size_t end_at = tail_len;
+    for (size_t i = tail_len >= kEndOfCentralSize ? tail_len - kEndOfCentralSize + 1 : 0; i-- > 0;) {
+        if (GetU32(tail.data() + i) == kEndOfCentral) {
+            end_at = i;
+            break;
+        }
+    }
+    if (end_at == tail_len) {
+        *error = path + " is not a zip archive";
+        return false;
+    }
+    const uint8_t* end = tail.data() + end_at;
+    uint64_t count = GetU16(end + 10);
+    uint64_t dir_size = GetU32(end + 12);
+    uint64_t dir_offset = GetU32(end + 16);
+    if (end_at >= 20 && GetU32(end - 20) == kZip64Locator) {
+        std::vector<uint8_t> record;
+        if (!ReadAt(in, GetU64(end - 20 + 8), 56, &record) || GetU32(record.data()) != kZip64EndOfCentral) {
+            *error = path + ": bad Zip64 end record";
+            return false;
+        }
+        count = GetU64(record.data() + 32);
+        dir_size = GetU64(record.data() + 40);
+        dir_offset = GetU64(record.data() + 48);
+    }
+
+    std::vector<uint8_t> dir;
+    if (dir_offset + dir_size > file_size || !ReadAt(in, dir_offset, static_cast<size_t>(dir_size), &dir)) {
+        *error = path + ": central directory out of range";
+        return false;
+    }
+    entries->clear();
+    size_t pos = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        const uint8_t* p = dir.data() + pos;
+        if (pos + kCentralHeaderSize > dir.size() || GetU32(p) != kCentralHeader) {
+            *error = path + ": bad central directory";
+            return false;
+        }
+        size_t name_len = GetU16(p + 28);
+        size_t extra_len = GetU16(p + 30);
+        size_t comment_len = GetU16(p + 32);
+        if (pos + kCentralHeaderSize + name_len + extra_len + comment_len > dir.size()) {
+            *error = path + ": bad central directory";
+            return false;
+        }
+        ZipDirEntry entry;
+        entry.name.assign(reinterpret_cast<const char*>(p + kCentralHeaderSize), name_len);
+        entry.size = GetU32(p + 24);
+        uint64_t compressed = GetU32(p + 20);
+        entry.local_offset = GetU32(p + 42);
+
+        // The Zip64 field only carries the values that overflowed, in
+        // this order.
+        const uint8_t* extra = p + kCentralHeaderSize + name_len;
+        for (size_t at = 0; at + 4 <= extra_len;) {
+            uint16_t id = GetU16(extra + at);
+            uint16_t size = GetU16(extra + at + 2);
+            if (id == 0x0001 && at + 4 + size <= extra_len) {
+                const uint8_t* field = extra + at + 4;
+                const uint8_t* field_end = field + size;
+                if (entry.size == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.size = GetU64(field);
+                    field += 8;
+                }
+                if (compressed == 0xFFFFFFFF && field + 8 <= field_end) {
+                    field += 8;
+                }
+                if (entry.local_offset == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.local_offset = GetU64(field);
+                }
+            }
+            at += 4 + size;
+        }
+        entries->push_back(std::move(entry));
+        pos += kCentralHeaderSize + name_len + extra_len + comment_len;
+    }
+    return true;
+}
+
+bool ReadZipEntry(const std::string& path, const ZipDirEntry& entry,
+                  const std::function<bool(const uint8_t* data, size_t len)>& data, std::string* error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        *error = "cannot open " + path;
+        return false;
+    }
+    in.seekg(static_cast<std::streamoff>(entry.local_offset));
+
+    bool started = false, finished = false, stopped = false, wrong = false;
+    ZipStreamReader::Callbacks callbacks;
+    callbacks.begin = [&](const std::string& name, uint64_t) {
+        if (started) return;
+        started = true;
+        wrong = name != entry.name;
+    };
+    callbacks.data = [&](const uint8_t* p, size_t len) {
+        if (!finished && !stopped && !wrong && !data(p, len)) stopped = true;
+    };
+    callbacks.end = [&] { finished = true; };
+    ZipStreamReader reader(std::move(callbacks));
+
+    std::vector<uint8_t> buf(kReadChunk);
+    while (!finished && !stopped && !wrong) {
+        in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+        size_t n = static_cast<size_t>(in.gcount());
+        if (n == 0) break;
+        // Errors past the end of this entry belong to the next one.
+        if (!reader.Feed(buf.data(), n) && !finished) {
+            *error = reader.Error();
+            return false;
+        }
+    }
+    if (wrong) {
+        *error = path + ": central directory does not match " + entry.name;
+        return false;
+    }
+    if (stopped) {
+        *error = "stopped";
+        return false;
+    }
+    if (!finished) {
+        *error = entry.name + ": archive ends early";
+        return false;
+    }
+    return true;
+}
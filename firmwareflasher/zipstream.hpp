@@ -0,0 +1,88 @@
+#ifndef FIRMWAREFLASHER_ZIPSTREAM_HPP
+#define FIRMWAREFLASHER_ZIPSTREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// Reads a zip archive front to back as its bytes arrive, without the
+// central directory at the end, so entries can be unpacked while the
+// archive is still downloading. Every entry is checked against its CRC-32
+// as it is inflated. Only stored and deflated entries are supported, which
+// is what zip tools and CI pipelines produce.
+class ZipStreamReader {
+public:
+    struct Callbacks {
+        std::function<void(const std::string& name, uint64_t size)> begin;
+        std::function<void(const uint8_t* data, size_t len)> data;
+        std::function<void()> end;   // only after the CRC matched
+    };
+
+    explicit ZipStreamReader(Callbacks callbacks);
+    ~ZipStreamReader();
+    ZipStreamReader(const ZipStreamReader&) = delete;
+    ZipStreamReader& operator=(const ZipStreamReader&) = delete;
+
+    // False once the archive turned out to be corrupt, see Error().
+    bool Feed(const uint8_t* data, size_t len);
+    // True when every entry was read and the central directory reached.
+    bool Finished() const { return done_; }
+    const std::string& Error() const { return error_; }
+
+private:
+    enum class State { Signature, Data, Descriptor };
+
+    bool Step(size_t& pos);
+    bool StepData(size_t& pos);
+    bool FinishEntry(uint32_t crc, uint64_t size);
+    bool Fail(const std::string& what);
+
+    Callbacks callbacks_;
+    std::vector<uint8_t> in_;
+    State state_ = State::Signature;
+    bool done_ = false;
+    bool failed_ = false;
+    std::string error_;
+
+    // Entry being read.
+    std::string name_;
+    uint16_t flags_ = 0;
+    uint16_t method_ = 0;
+    bool zip64_ = false;
+    uint32_t expect_crc_ = 0;
+    uint64_t expect_size_ = 0;
+    uint64_t remaining_ = 0;      // compressed bytes left, without a descriptor
+    uint32_t crc_ = 0;
+    uint64_t size_ = 0;
+    z_stream zs_{};
+    bool zs_ready_ = false;
+};
+
+struct ZipEntry {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+// Callbacks that collect every file of the archive into entries.
+ZipStreamReader::Callbacks CollectZipEntries(std::vector<ZipEntry>* entries);
+
+// Central directory record of an archive on disk, enough to read one entry
+// without going through the ones before it.
+struct ZipDirEntry {
+    std::string name;
+    uint64_t size = 0;            // uncompressed
+    uint64_t local_offset = 0;    // of its local header
+};
+
+bool ReadZipDirectory(const std::string& path, std::vector<ZipDirEntry>* entries, std::string* error);
+
+// Streams one entry of an archive on disk through ZipStreamReader, so it
+// is CRC checked like a download. data returns false to stop early.
+bool ReadZipEntry(const std::string& path, const ZipDirEntry& entry,
+                  const std::function<bool(const uint8_t* data, size_t len)>& data, std::string* error);
+
+#endif